@@ -72,9 +72,19 @@
 #include <replace/replace.h>  // for poll(2)
 #endif
 
+#include <libplayerinterface/udp_frame.h>
+#include <libplayerinterface/shm_ring.h>
+
 #include "playerc.h"
 #include "error.h"
 
+// Number of partially received UDP messages to keep
+#define PLAYERC_UDP_REASM_SLOTS 8
+
+// Receive buffer for the UDP socket; a camera image arrives as a burst of
+// a few hundred frames, which overflows the usual system default
+#define PLAYERC_UDP_RCVBUF_SIZE (1<<20)
+
 #if defined (WIN32)
   #define snprintf _snprintf
   #define strdup _strdup
@@ -107,6 +117,16 @@ int playerc_client_readpacket(playerc_client_t *client,
 int playerc_client_writepacket(playerc_client_t *client,
                                player_msghdr_t *header,
                                const char *data);
+int playerc_client_readframes(playerc_client_t *client);
+int playerc_client_writeframes(playerc_client_t *client,
+                               player_msghdr_t *header,
+                               const char *msg, int msglen);
+int playerc_client_readmulticast(playerc_client_t *client,
+                                 player_msghdr_t *header,
+                                 char *data);
+int playerc_client_peeksocks(playerc_client_t *client, int timeout,
+                             int multicast);
+int playerc_client_multicasting(playerc_client_t *client);
 void playerc_client_push(playerc_client_t *client,
                          player_msghdr_t *header, void *data);
 int playerc_client_pop(playerc_client_t *client,
@@ -115,6 +135,7 @@ void *playerc_client_dispatch(playerc_client_t *client,
                               player_msghdr_t *header, void *data);
 
 int timed_recv(int s, void *buf, size_t len, int flags, int timeout);
+void playerc_client_closeshm(playerc_client_t *client);
 
 // this method performs a select before the read so we can have a timeout
 // this stops the client hanging forever if the target disappears from the network
@@ -205,6 +226,8 @@ playerc_client_t *playerc_client_create(playerc_mclient_t *mclient, const char *
 
   client->request_timeout = 5.0;
 
+  client->shm_size = PLAYERC_SHM_SIZE;
+
   client->retry_limit = 0;
   client->retry_time = 2.0;
 
@@ -230,6 +253,8 @@ void playerc_client_destroy(playerc_client_t *client)
 
   free(client->data);
   free(client->read_xdrdata);
+  udpframe_reasm_free(client->udp_reasm);
+  playerc_client_closeshm(client);
   free(client->host);
   free(client);
   return;
@@ -243,6 +268,111 @@ void playerc_client_set_transport(playerc_client_t* client,
   client->transport = transport;
 }
 
+// Set multicast reception
+void playerc_client_set_multicast(playerc_client_t* client, int enable)
+{
+  client->multicast = enable;
+}
+
+// Set the encoding to ask the server for
+void playerc_client_set_encoding(playerc_client_t* client, int encoding)
+{
+  client->encoding = encoding;
+}
+
+// Set the size of the shared memory ring to use with a local server
+void playerc_client_set_shm(playerc_client_t* client, size_t size)
+{
+  client->shm_size = size;
+}
+
+// Release the shared memory rings
+void playerc_client_closeshm(playerc_client_t *client)
+{
+  if (client->shm)
+  {
+    shmring_close(client->shm);
+    free(client->shm);
+    client->shm = NULL;
+  }
+  if (client->shm_offer)
+  {
+    shmring_unlink(client->shm_offer);
+    shmring_close(client->shm_offer);
+    free(client->shm_offer);
+    client->shm_offer = NULL;
+  }
+}
+
+// Offer the server a shared memory ring to write our messages into.  The
+// ring is taken into use when the reply is read (see readpacket).
+static int playerc_client_offer_shm(playerc_client_t *client)
+{
+  player_device_shm_req_t req;
+  shmring_t *ring;
+
+  ring = (shmring_t*)malloc(sizeof(shmring_t));
+  assert(ring);
+  if (shmring_create(ring, client->shm_size) < 0)
+  {
+    free(ring);
+    return -1;
+  }
+
+  memset(&req, 0, sizeof(req));
+  strncpy(req.name, ring->name, sizeof(req.name) - 1);
+  req.name_count = strlen(req.name) + 1;
+  req.layout = playerxdr_raw_layout();
+  client->shm_offer = ring;
+  playerc_client_request(client, NULL, PLAYER_PLAYER_REQ_SHM, &req, NULL);
+
+  // Mapped by both ends now, or never will be
+  shmring_unlink(ring);
+  if (client->shm_offer)
+  {
+    playerc_client_closeshm(client);
+    return -1;
+  }
+  return 0;
+}
+
+// Switch the server to the raw encoding, or to delivery through shared
+// memory, if it can give them to us.  An empty request goes first to
+// learn the server's layout: servers that predate the encoding request
+// NACK that, whereas they would silently drop a request with a body they
+// cannot decode.
+static int playerc_client_negotiate_encoding(playerc_client_t *client,
+                                             int shm)
+{
+  player_device_encoding_req_t req;
+  player_device_encoding_req_t *rep = NULL;
+  int ret;
+
+  if (playerc_client_request(client, NULL, PLAYER_PLAYER_REQ_ENCODING,
+                             NULL, (void**)&rep) < 0 || !rep)
+  {
+    if (client->encoding == PLAYER_ENCODING_RAW)
+      PLAYERC_WARN("server does not support the raw encoding; using XDR");
+    return -1;
+  }
+  req.encoding = PLAYER_ENCODING_RAW;
+  req.layout = playerxdr_raw_layout();
+  ret = 0;
+  if (rep->layout != req.layout)
+  {
+    if (client->encoding == PLAYER_ENCODING_RAW)
+      PLAYERC_WARN("server's message layout differs from ours; using XDR");
+  }
+  else if (shm && playerc_client_offer_shm(client) == 0)
+    ret = 0;
+  else if (client->encoding == PLAYER_ENCODING_RAW)
+    ret = playerc_client_request(client, NULL, PLAYER_PLAYER_REQ_ENCODING,
+                                 &req, NULL);
+  player_device_encoding_req_t_free(rep);
+  // client->read_encoding follows the replies (see readpacket)
+  return ret;
+}
+
 // Connect to the server
 int playerc_client_connect(playerc_client_t *client)
 {
@@ -253,6 +383,7 @@ int playerc_client_connect(playerc_client_t *client)
 #endif
   char banner[PLAYER_IDENT_STRLEN];
   int ret;
+  int shm;
   //double t;
   /*
   struct timeval last;
@@ -267,9 +398,19 @@ int playerc_client_connect(playerc_client_t *client)
 #endif
   struct sockaddr_in clientaddr;
 
+  // A new connection starts out in XDR, without shared memory
+  client->read_encoding = PLAYER_ENCODING_XDR;
+  playerc_client_closeshm(client);
+
   // Construct socket
   if(client->transport == PLAYERC_TRANSPORT_UDP)
   {
+    // Start with a clean slate for the framing
+    udpframe_reasm_free(client->udp_reasm);
+    client->udp_reasm = udpframe_reasm_alloc(PLAYERC_UDP_REASM_SLOTS);
+    assert(client->udp_reasm);
+    client->udp_seq = 0;
+
 #if defined (WIN32)
     if((client->sock = socket(PF_INET, SOCK_DGRAM, 0)) == INVALID_SOCKET)
 #else
@@ -296,6 +437,14 @@ int playerc_client_connect(playerc_client_t *client)
       STRERROR(PLAYERC_ERR2, "bind() failed with error [%d: %s]");
       return -1;
     }
+
+    // Not fatal if the system caps the size
+    {
+      int bufsize = PLAYERC_UDP_RCVBUF_SIZE;
+      if(setsockopt(client->sock, SOL_SOCKET, SO_RCVBUF,
+                    (const char*)&bufsize, sizeof(bufsize)) < 0)
+        PLAYERC_WARN("failed to set UDP receive buffer size");
+    }
   }
   else
   {
@@ -492,6 +641,12 @@ int playerc_client_connect(playerc_client_t *client)
   //set the datamode to pull
   playerc_client_datamode(client, PLAYER_DATAMODE_PULL);
 
+  // A server on this machine can write our messages into shared memory
+  shm = (client->transport == PLAYERC_TRANSPORT_TCP) && client->shm_size &&
+        ((ntohl(client->server.sin_addr.s_addr) >> 24) == 127);
+  if (client->encoding == PLAYER_ENCODING_RAW || shm)
+    playerc_client_negotiate_encoding(client, shm);
+
   PLAYERC_WARN4("[%s] connected on [%s:%d] with sock %d\n", banner, client->host, client->port, client->sock);
 
   client->connected = 1;
@@ -569,6 +724,7 @@ int playerc_client_disconnect_retry(playerc_client_t *client)
 // Disconnect from the server
 int playerc_client_disconnect(playerc_client_t *client)
 {
+  playerc_client_closeshm(client);
 #if defined (WIN32)
   if (closesocket(client->sock) != 0)
   {
@@ -661,9 +817,47 @@ int playerc_client_peek(playerc_client_t *client, int timeout)
 
 // Test to see if there is pending data. Don't send a data request.
 int playerc_client_internal_peek(playerc_client_t *client, int timeout)
+{
+  return playerc_client_peeksocks(client, timeout, 1);
+}
+
+// Test for messages in the shared memory ring, reading the doorbells off
+// the socket if it is readable
+int playerc_client_shm_ready(playerc_client_t *client, int readable)
+{
+  char doorbell[256];
+  const char *buf;
+  size_t len;
+  int i, nbytes;
+
+  if (!client->shm)
+    return 0;
+  // poll() said this will not block; more doorbells just wake us again.
+  // A message that did not fit into the ring stays on the socket until
+  // its empty record comes up in the ring.
+  if (readable)
+  {
+    nbytes = recv(client->sock, doorbell, sizeof(doorbell), MSG_PEEK);
+    if (nbytes == 0)
+    {
+      PLAYERC_ERR("server closed the connection");
+      return -1;
+    }
+    for (i = 0; i < nbytes && !doorbell[i]; i++);
+    if (i > 0)
+      recv(client->sock, doorbell, i, 0);
+  }
+  return shmring_peek(client->shm, &buf, &len) != 0;
+}
+
+// Test to see if there is pending data on the connection and, if multicast
+// is non-zero, on the devices' multicast sockets.
+int playerc_client_peeksocks(playerc_client_t *client, int timeout,
+                             int multicast)
 {
   int count;
-  struct pollfd fd;
+  int i, nfds;
+  struct pollfd fds[1 + PLAYER_MAX_DEVICES];
 
   if (client->sock < 0)
   {
@@ -671,13 +865,28 @@ int playerc_client_internal_peek(playerc_client_t *client, int timeout)
     return -1;
   }
 
-  fd.fd = client->sock;
-  //fd.events = POLLIN | POLLHUP;
-  fd.events = POLLIN | POLLPRI | POLLERR | POLLHUP | POLLNVAL;
-  fd.revents = 0;
+  // The socket only wakes us up when the ring was empty
+  if (playerc_client_shm_ready(client, 0))
+    return 1;
+
+  fds[0].fd = client->sock;
+  //fds[0].events = POLLIN | POLLHUP;
+  fds[0].events = POLLIN | POLLPRI | POLLERR | POLLHUP | POLLNVAL;
+  fds[0].revents = 0;
+  nfds = 1;
+
+  for (i = 0; multicast && (i < client->device_count); i++)
+  {
+    if (client->device[i]->mcast_sock < 0)
+      continue;
+    fds[nfds].fd = client->device[i]->mcast_sock;
+    fds[nfds].events = POLLIN;
+    fds[nfds].revents = 0;
+    nfds++;
+  }
 
   // Wait for incoming data
-  count = poll(&fd, 1, timeout);
+  count = poll(fds, nfds, timeout);
   if (count < 0)
   {
     if(errno == EINTR)
@@ -689,12 +898,20 @@ int playerc_client_internal_peek(playerc_client_t *client, int timeout)
       return(playerc_client_disconnect_retry(client));
     }
   }
-  if (count > 0 && (fd.revents & POLLHUP))
+  if (count > 0 && (fds[0].revents & POLLHUP))
   {
     PLAYERC_ERR("socket disconnected");
     //playerc_client_disconnect(client);
     return(playerc_client_disconnect_retry(client));
   }
+  if (client->shm && (fds[0].revents & POLLIN))
+  {
+    // Only a doorbell; what counts is the ring
+    if ((i = playerc_client_shm_ready(client, 1)) < 0)
+      return(playerc_client_disconnect_retry(client));
+    if (!i)
+      count--;
+  }
   return count;
 }
 
@@ -748,24 +965,30 @@ int playerc_client_read_nonblock_withproxy(playerc_client_t *client, void ** pro
     // See if there is any queued data.
     if (playerc_client_pop (client, &header, client->data) < 0)
     {
-      // If there is no queued data, peek at the socket
-      if((ret = playerc_client_internal_peek(client,0)) <= 0)
+      // Data arriving over multicast doesn't go through the connection
+      if((ret = playerc_client_readmulticast(client, &header, client->data)) < 0)
+        return ret;
+      if(ret == 0)
       {
-        // If we haven't requested sata there will be no SYNCH message to wait further for, thus if we have got data from the internal queue this time
-        // We need to return true
-        if (!client->data_requested && client->data_received)
+        // If there is no queued data, peek at the socket
+        if((ret = playerc_client_peeksocks(client,0,0)) <= 0)
         {
-          client->data_received = 0;
-          if (proxy)
-            *proxy = client->id;
-          return 1;
+          // If we haven't requested sata there will be no SYNCH message to wait further for, thus if we have got data from the internal queue this time
+          // We need to return true
+          if (!client->data_requested && client->data_received)
+          {
+            client->data_received = 0;
+            if (proxy)
+              *proxy = client->id;
+            return 1;
+          }
+          else
+            return 0;
         }
-        else
-          return 0;
+        // There's data on the socket, so read a packet (blocking).
+        if((ret = playerc_client_readpacket (client, &header, client->data)) < 0)
+          return ret;
       }
-      // There's data on the socket, so read a packet (blocking).
-      if((ret = playerc_client_readpacket (client, &header, client->data)) < 0)
-        return ret;
     }
     // One way or another, we got a new packet into (header,client->data),
     // so process it
@@ -783,8 +1006,15 @@ int playerc_client_read_nonblock_withproxy(playerc_client_t *client, void ** pro
         }
         if(!client->data_received)
         {
-          PLAYERC_WARN ("No data recieved with SYNC");
-          ret = -1;
+          // Multicast data doesn't come between the request and the
+          // SYNCH, so there may legitimately be none yet
+          if(playerc_client_multicasting(client))
+            ret = 0;
+          else
+          {
+            PLAYERC_WARN ("No data recieved with SYNC");
+            ret = -1;
+          }
         }
         else
         {
@@ -1018,6 +1248,21 @@ int playerc_client_get_devlist(playerc_client_t *client)
 }
 
 
+// Get the server's performance counters
+int playerc_client_get_stats(playerc_client_t *client,
+                             player_device_stats_req_t **stats)
+{
+  *stats = NULL;
+  if(playerc_client_request(client, NULL, PLAYER_PLAYER_REQ_STATS,
+                            NULL, (void**)stats) < 0 || *stats == NULL)
+  {
+    PLAYERC_ERR("failed to get response");
+    return(-1);
+  }
+  return(0);
+}
+
+
 // Get the driver info for all devices.  The data is written into the
 // proxy structure rather than returned to the caller.
 int playerc_client_get_driverinfo(playerc_client_t *client)
@@ -1115,6 +1360,151 @@ int playerc_client_unsubscribe(playerc_client_t *client, int code, int index)
 }
 
 
+// Switch a device's data between its multicast group and the connection
+int playerc_client_multicast(playerc_client_t *client, int code, int index,
+                             int enable, uint32_t *group, uint16_t *port)
+{
+  player_device_multicast_req_t req, *resp;
+
+  memset(&req, 0, sizeof(req));
+  req.addr.interf = code;
+  req.addr.index = index;
+  req.enable = enable ? 1 : 0;
+
+  if (playerc_client_request(client, NULL, PLAYER_PLAYER_REQ_MULTICAST,
+                             (void*)&req, (void**)&resp) < 0)
+    return -1;
+
+  *group = resp->group;
+  *port = resp->enable ? resp->port : 0;
+  player_device_multicast_req_t_free(resp);
+  return 0;
+}
+
+
+// Open a socket for a device's multicast group
+int playerc_client_openmulticast(playerc_client_t *client,
+                                 playerc_device_t *device,
+                                 uint32_t group, uint16_t port)
+{
+  struct sockaddr_in addr;
+  struct ip_mreq mreq;
+  int bufsize = PLAYERC_UDP_RCVBUF_SIZE;
+  int one = 1;
+  int sock;
+#if defined (WIN32)
+  unsigned long setting = 1;
+#else
+  int flags;
+#endif
+
+  playerc_client_closemulticast(client, device);
+
+  if ((sock = socket(PF_INET, SOCK_DGRAM, 0)) < 0)
+  {
+    STRERROR (PLAYERC_ERR2, "socket call failed with error [%d: %s]");
+    return -1;
+  }
+
+  // Several clients on this host may be listening to the same group
+  if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR,
+                 (const char*)&one, sizeof(one)) < 0)
+    PLAYERC_WARN("failed to set SO_REUSEADDR on multicast socket");
+
+  // All groups share a port, so bind to the group itself where the
+  // system allows it; otherwise we would see the other groups too.
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+#if defined (WIN32)
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+#else
+  addr.sin_addr.s_addr = group;
+#endif
+  addr.sin_port = htons(port);
+  if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+  {
+    STRERROR (PLAYERC_ERR2, "bind call failed with error [%d: %s]");
+#if defined (WIN32)
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+    return -1;
+  }
+
+  mreq.imr_multiaddr.s_addr = group;
+  mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                 (const char*)&mreq, sizeof(mreq)) < 0)
+  {
+    STRERROR (PLAYERC_ERR2, "failed to join multicast group [%d: %s]");
+#if defined (WIN32)
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+    return -1;
+  }
+
+  if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF,
+                 (const char*)&bufsize, sizeof(bufsize)) < 0)
+    PLAYERC_WARN("failed to set UDP receive buffer size");
+
+  // playerc_client_readmulticast() drains the socket without polling it
+#if defined (WIN32)
+  if (ioctlsocket(sock, FIONBIO, &setting) == SOCKET_ERROR)
+#else
+  if (((flags = fcntl(sock, F_GETFL)) == -1) ||
+      (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1))
+#endif
+  {
+    STRERROR (PLAYERC_ERR2, "failed to make multicast socket non-blocking [%d: %s]");
+#if defined (WIN32)
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+    return -1;
+  }
+
+  device->mcast_sock = sock;
+  device->mcast_reasm = udpframe_reasm_alloc(PLAYERC_UDP_REASM_SLOTS);
+  assert(device->mcast_reasm);
+  return 0;
+}
+
+
+// Close a device's multicast socket
+void playerc_client_closemulticast(playerc_client_t *client,
+                                   playerc_device_t *device)
+{
+  if (device->mcast_sock < 0)
+    return;
+#if defined (WIN32)
+  closesocket(device->mcast_sock);
+#else
+  close(device->mcast_sock);
+#endif
+  device->mcast_sock = -1;
+  udpframe_reasm_free(device->mcast_reasm);
+  device->mcast_reasm = NULL;
+}
+
+
+// Is any device receiving its data over multicast?
+int playerc_client_multicasting(playerc_client_t *client)
+{
+  int i;
+
+  for (i = 0; i < client->device_count; i++)
+  {
+    if (client->device[i]->mcast_sock >= 0)
+      return 1;
+  }
+  return 0;
+}
+
+
 // Register a callback.  Will be called when after data has been read
 // by the indicated device.
 int playerc_client_addcallback(playerc_client_t *client, playerc_device_t *device,
@@ -1155,13 +1545,164 @@ int playerc_client_delcallback(playerc_client_t *client, playerc_device_t *devic
 }
 
 
+// Decode the body of a packet.  Returns the decoded length, or -1 on
+// error.
+static int playerc_client_decodebody(playerc_client_t *client,
+                                     player_msghdr_t *header,
+                                     char *body, char *data)
+{
+  player_pack_fn_t packfunc;
+  int decode_msglen;
+  int control_reply;
+
+  if (!header->size)
+    return 0;
+
+  // The replies to encoding and shared memory requests are always
+  // XDR-encoded, and set how what follows them arrives
+  control_reply = (header->addr.interf == PLAYER_PLAYER_CODE) &&
+                  (header->type == PLAYER_MSGTYPE_RESP_ACK) &&
+                  ((header->subtype == PLAYER_PLAYER_REQ_ENCODING) ||
+                   (header->subtype == PLAYER_PLAYER_REQ_SHM));
+
+  // Locate the appropriate unpacking function for the message body
+  if(!(packfunc = playerxdr_get_encodefunc(header->addr.interf, header->type,
+                                           header->subtype,
+                                           control_reply ? PLAYER_ENCODING_XDR :
+                                           client->read_encoding)))
+  {
+    // TODO: Allow the user to register a callback to handle unsupported
+    // messages
+    PLAYERC_ERR4("skipping message from %s:%u with unsupported type %s:%u",
+               interf_to_str(header->addr.interf), header->addr.index, msgtype_to_str(header->type), header->subtype);
+    return(-1);
+  }
+
+  // Unpack the body
+  if((decode_msglen = (*packfunc)(body, header->size, data,
+                                  PLAYERXDR_DECODE)) < 0)
+  {
+    PLAYERC_ERR4("decoding failed on message from %s:%u with type %s:%u",
+               interf_to_str(header->addr.interf), header->addr.index, msgtype_to_str(header->type), header->subtype);
+    return(-1);
+  }
+
+  if (control_reply && (header->subtype == PLAYER_PLAYER_REQ_ENCODING))
+    client->read_encoding = ((player_device_encoding_req_t*)data)->encoding;
+  else if (control_reply && client->shm_offer &&
+           ((player_device_shm_req_t*)data)->enable)
+  {
+    // Everything after this reply comes through the ring
+    client->shm = client->shm_offer;
+    client->shm_offer = NULL;
+    client->read_encoding = PLAYER_ENCODING_RAW;
+  }
+  return decode_msglen;
+}
+
+// Read a packet from the shared memory ring, waiting for the server's
+// doorbell while it is empty.  Returns 1 if the packet is on the socket
+// instead.
+static int playerc_client_readshm(playerc_client_t *client,
+                                  player_msghdr_t *header,
+                                  char *data)
+{
+  struct timeval start;
+  struct timeval curr;
+  const char *buf;
+  size_t len;
+  int ret;
+  int decode_msglen;
+
+  gettimeofday(&start, NULL);
+  while((ret = shmring_peek(client->shm, &buf, &len)) == 0)
+  {
+    gettimeofday(&curr, NULL);
+    if (tdiff(start, curr) >= client->request_timeout)
+    {
+      PLAYERC_ERR("timed out waiting for the shared memory ring");
+      return -1;
+    }
+    if (playerc_client_peeksocks(client, 10, 0) < 0)
+      return -1;
+    // A failed reconnection leaves no ring; a successful one a new one
+    if (client->sock < 0 || !client->shm)
+      return -1;
+  }
+  if (ret < 0)
+  {
+    PLAYERC_ERR("shared memory ring is corrupt");
+    return -1;
+  }
+
+  // An empty record stands for a message too large for the ring
+  if (len == 0)
+  {
+    shmring_consume(client->shm);
+    return 1;
+  }
+
+  if (len < PLAYERXDR_MSGHDR_SIZE ||
+      player_msghdr_pack((char*)buf, PLAYERXDR_MSGHDR_SIZE,
+                         header, PLAYERXDR_DECODE) < 0 ||
+      header->size > len - PLAYERXDR_MSGHDR_SIZE)
+  {
+    PLAYERC_ERR("failed to unpack header");
+    shmring_consume(client->shm);
+    return -1;
+  }
+
+  // The decoded message does not point into the ring, so the record can
+  // go as soon as it is decoded
+  decode_msglen = playerc_client_decodebody(client, header,
+                                            (char*)buf + PLAYERXDR_MSGHDR_SIZE,
+                                            data);
+  shmring_consume(client->shm);
+  if (decode_msglen < 0)
+    return -1;
+
+  // Rewrite the header with the decoded message length
+  header->size = decode_msglen;
+  return 0;
+}
+
+// Skip the doorbells in front of a message that the server sent over the
+// socket because it did not fit into the shared memory ring, up to the
+// 1 byte that announces it
+static int playerc_client_skipdoorbells(playerc_client_t *client)
+{
+  char c;
+  int nbytes;
+
+  for(;;)
+  {
+    nbytes = timed_recv(client->sock, &c, 1, 0,
+                        (int) client->request_timeout * 1000);
+    if (nbytes <= 0)
+    {
+      if (errno == EINTR)
+        continue;
+      PLAYERC_ERR("failed to read a message too large for the shared memory ring");
+      return -1;
+    }
+    if (c)
+      break;
+  }
+  if (c != 1)
+  {
+    PLAYERC_ERR1("unexpected byte %d in front of a message", c);
+    return -1;
+  }
+  return 0;
+}
+
 // Read a raw packet
 int playerc_client_readpacket(playerc_client_t *client,
                               player_msghdr_t *header,
                               char *data)
 {
   int nbytes;
-  player_pack_fn_t packfunc;
+  int ret;
   int decode_msglen;
 
   if (client->sock < 0)
@@ -1170,6 +1711,22 @@ int playerc_client_readpacket(playerc_client_t *client,
     return -1;
   }
 
+  // A local server may be writing our messages into shared memory
+  if(client->shm)
+  {
+    if((ret = playerc_client_readshm(client, header, data)) <= 0)
+      return ret;
+    if(playerc_client_skipdoorbells(client) < 0)
+      return -1;
+  }
+
+  // Over UDP, whole messages are reassembled from frames
+  if(client->transport == PLAYERC_TRANSPORT_UDP)
+  {
+    if(playerc_client_readframes(client) < 0)
+      return -1;
+  }
+
   while(client->read_xdrdata_len < PLAYERXDR_MSGHDR_SIZE)
   {
     nbytes = timed_recv(client->sock,
@@ -1214,6 +1771,15 @@ int playerc_client_readpacket(playerc_client_t *client,
           client->read_xdrdata_len - PLAYERXDR_MSGHDR_SIZE);
   client->read_xdrdata_len -= PLAYERXDR_MSGHDR_SIZE;
 
+  if((client->transport == PLAYERC_TRANSPORT_UDP) &&
+     (client->read_xdrdata_len < header->size))
+  {
+    PLAYERC_ERR2("truncated UDP message, %d of %d bytes",
+                 (int) client->read_xdrdata_len, header->size);
+    client->read_xdrdata_len = 0;
+    return -1;
+  }
+
   while(client->read_xdrdata_len < header->size)
   {
     nbytes = timed_recv(client->sock,
@@ -1240,44 +1806,16 @@ int playerc_client_readpacket(playerc_client_t *client,
     client->read_xdrdata_len += nbytes;
   }
 
-  if (header->size)
-  {
-  // Locate the appropriate unpacking function for the message body
-    if(!(packfunc = playerxdr_get_packfunc(header->addr.interf, header->type,
-                                         header->subtype)))
-    {
-      // TODO: Allow the user to register a callback to handle unsupported
-      // messages
-      PLAYERC_ERR4("skipping message from %s:%u with unsupported type %s:%u",
-                 interf_to_str(header->addr.interf), header->addr.index, msgtype_to_str(header->type), header->subtype);
-
-      // Slide over the body
-      memmove(client->read_xdrdata,
-            client->read_xdrdata + header->size,
-            client->read_xdrdata_len - header->size);
-      client->read_xdrdata_len -= header->size;
-
-      return(-1);
-    }
+  decode_msglen = playerc_client_decodebody(client, header,
+                                            client->read_xdrdata, data);
 
-    // Unpack the body
-    if((decode_msglen = (*packfunc)(client->read_xdrdata,
-                                  header->size, data, PLAYERXDR_DECODE)) < 0)
-    {
-      PLAYERC_ERR4("decoding failed on message from %s:%u with type %s:%u",
-                 interf_to_str(header->addr.interf), header->addr.index, msgtype_to_str(header->type), header->subtype);
-      return(-1);
-    }
-  }
-  else
-  {
-    decode_msglen = 0;
-  }
   // Slide over the body
   memmove(client->read_xdrdata,
           client->read_xdrdata + header->size,
           client->read_xdrdata_len - header->size);
   client->read_xdrdata_len -= header->size;
+  if (decode_msglen < 0)
+    return(-1);
 
   // Rewrite the header with the decoded message length
   header->size = decode_msglen;
@@ -1349,6 +1887,14 @@ int playerc_client_writepacket(playerc_client_t *client,
   // Send the message
   length = PLAYERXDR_MSGHDR_SIZE + encode_msglen;
   bytes = PLAYERXDR_MSGHDR_SIZE + encode_msglen;
+  if(client->transport == PLAYERC_TRANSPORT_UDP)
+  {
+    ret = playerc_client_writeframes(client, header, write_xdrdata, length);
+    free(write_xdrdata);
+    if(ret < 0)
+      return(playerc_client_disconnect_retry(client));
+    return 0;
+  }
   do
   {
     ret = send(client->sock, &write_xdrdata[length-bytes],
@@ -1375,6 +1921,172 @@ int playerc_client_writepacket(playerc_client_t *client,
 }
 
 
+// Receive UDP frames until a whole message is in read_xdrdata
+int playerc_client_readframes(playerc_client_t *client)
+{
+  char dgram[UDPFRAME_MAX_SIZE + 1];
+  const char *msg;
+  size_t msglen;
+  int nbytes;
+
+  for(;;)
+  {
+    nbytes = timed_recv(client->sock, dgram, sizeof(dgram), 0,
+                        (int) client->request_timeout * 1000);
+    if (nbytes <= 0)
+    {
+      if(nbytes == 0)
+        return -1;
+      if(errno == EINTR)
+        continue;
+      STRERROR (PLAYERC_ERR2, "recv failed with error [%d: %s]");
+      if(playerc_client_disconnect_retry(client) < 0)
+        return(-1);
+      else
+        continue;
+    }
+
+    // Invalid, stale or incomplete; wait for the next one
+    if(udpframe_reasm_add(client->udp_reasm, dgram, nbytes, &msg, &msglen) <= 0)
+      continue;
+    if((msglen < PLAYERXDR_MSGHDR_SIZE) || (msglen > PLAYERXDR_MAX_MESSAGE_SIZE))
+    {
+      PLAYERC_WARN1("discarding UDP message of %d bytes", (int) msglen);
+      continue;
+    }
+
+    memcpy(client->read_xdrdata, msg, msglen);
+    client->read_xdrdata_len = msglen;
+    return 0;
+  }
+}
+
+
+// Read a message from the devices' multicast sockets, if one is waiting.
+// Returns 1 if a message was read into (header,data), 0 if there was
+// none, and -1 on error.
+int playerc_client_readmulticast(playerc_client_t *client,
+                                 player_msghdr_t *header,
+                                 char *data)
+{
+  char dgram[UDPFRAME_MAX_SIZE + 1];
+  const char *msg;
+  size_t msglen;
+  player_pack_fn_t packfunc;
+  playerc_device_t *device;
+  int decode_msglen;
+  int nbytes;
+  int i;
+
+  for (i = 0; i < client->device_count; i++)
+  {
+    device = client->device[i];
+    if (device->mcast_sock < 0)
+      continue;
+
+    while ((nbytes = recv(device->mcast_sock, dgram, sizeof(dgram), 0)) > 0)
+    {
+      // Invalid, stale or incomplete; try the next one
+      if (udpframe_reasm_add(device->mcast_reasm, dgram, nbytes,
+                             &msg, &msglen) <= 0)
+        continue;
+
+      if ((msglen < PLAYERXDR_MSGHDR_SIZE) ||
+          (player_msghdr_pack((char*) msg, PLAYERXDR_MSGHDR_SIZE,
+                              header, PLAYERXDR_DECODE) < 0) ||
+          (msglen < PLAYERXDR_MSGHDR_SIZE + header->size))
+      {
+        PLAYERC_WARN1("discarding malformed multicast message of %d bytes",
+                      (int) msglen);
+        continue;
+      }
+
+      // Only this device's data should be on its group
+      if ((header->type != PLAYER_MSGTYPE_DATA) ||
+          (header->addr.interf != device->addr.interf) ||
+          (header->addr.index != device->addr.index))
+        continue;
+
+      decode_msglen = 0;
+      if (header->size)
+      {
+        if (!(packfunc = playerxdr_get_packfunc(header->addr.interf,
+                                                header->type,
+                                                header->subtype)))
+        {
+          PLAYERC_ERR4("skipping message from %s:%u with unsupported type %s:%u",
+                       interf_to_str(header->addr.interf), header->addr.index,
+                       msgtype_to_str(header->type), header->subtype);
+          continue;
+        }
+        if ((decode_msglen = (*packfunc)((char*) msg + PLAYERXDR_MSGHDR_SIZE,
+                                         header->size, data,
+                                         PLAYERXDR_DECODE)) < 0)
+        {
+          PLAYERC_ERR4("decoding failed on message from %s:%u with type %s:%u",
+                       interf_to_str(header->addr.interf), header->addr.index,
+                       msgtype_to_str(header->type), header->subtype);
+          continue;
+        }
+      }
+      header->size = decode_msglen;
+      return 1;
+    }
+
+    if ((nbytes < 0) && (ErrNo != ERRNO_EAGAIN) && (errno != EINTR))
+    {
+      STRERROR (PLAYERC_ERR2, "recv failed with error [%d: %s]");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+// Send an encoded message as UDP frames
+int playerc_client_writeframes(playerc_client_t *client,
+                               player_msghdr_t *header,
+                               const char *msg, int msglen)
+{
+  char dgram[UDPFRAME_MAX_SIZE];
+  udpframe_hdr_t fhdr;
+  int i, len, ret;
+
+  fhdr.magic = UDPFRAME_MAGIC;
+  fhdr.flags = 0;
+  fhdr.seq = client->udp_seq++;
+  fhdr.msglen = msglen;
+  udpframe_hdr_stream(&fhdr, header);
+  fhdr.nfrags = udpframe_count(msglen);
+
+  for(i = 0; i < fhdr.nfrags; i++)
+  {
+    fhdr.frag = i;
+    len = msglen - i * UDPFRAME_MAX_PAYLOAD;
+    if(len > UDPFRAME_MAX_PAYLOAD)
+      len = UDPFRAME_MAX_PAYLOAD;
+
+    udpframe_hdr_pack(dgram, &fhdr);
+    memcpy(dgram + UDPFRAME_HDR_SIZE, msg + i * UDPFRAME_MAX_PAYLOAD, len);
+
+    while((ret = send(client->sock, dgram, UDPFRAME_HDR_SIZE + len, 0)) < 0)
+    {
+#if defined (WIN32)
+      if(errno != ERRNO_EAGAIN && errno != WSAEINPROGRESS)
+#else
+      if(errno != ERRNO_EAGAIN && errno != EINTR && errno != EWOULDBLOCK)
+#endif
+      {
+        STRERROR (PLAYERC_ERR2, "send on frame failed with error [%d: %s]");
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
 // Push a packet onto the incoming queue.
 void playerc_client_push(playerc_client_t *client,
                          player_msghdr_t *header, void *data)
@@ -66,6 +66,8 @@ void playerc_device_init(playerc_device_t *device, playerc_client_t *client,
   device->subscribed = 0;
   device->callback_count = 0;
   device->putmsg = putmsg;
+  device->mcast_sock = -1;
+  device->mcast_reasm = NULL;
 
   if (device->client)
     playerc_client_adddevice(device->client, device);
@@ -77,7 +79,10 @@ void playerc_device_init(playerc_device_t *device, playerc_client_t *client,
 void playerc_device_term(playerc_device_t *device)
 {
   if (device->client)
+  {
+    playerc_client_closemulticast(device->client, device);
     playerc_client_deldevice(device->client, device);
+  }
   return;
 }
 
@@ -90,6 +95,13 @@ int playerc_device_subscribe(playerc_device_t *device, int access)
                                device->drivername, sizeof(device->drivername)) != 0)
     return -1;
   device->subscribed = 1;
+
+  // Move the data to multicast if the client wants it, or if we had it
+  // there before a reconnection.  Not fatal: the data then just keeps
+  // coming over the connection.
+  if ((device->client->multicast || (device->mcast_sock >= 0)) &&
+      (device->client->transport == PLAYERC_TRANSPORT_TCP))
+    playerc_device_multicast(device, 1);
   return 0;
 }
 
@@ -99,11 +111,49 @@ int playerc_device_subscribe(playerc_device_t *device, int access)
 int playerc_device_unsubscribe(playerc_device_t *device)
 {
   device->subscribed = 0;
+  playerc_client_closemulticast(device->client, device);
   return playerc_client_unsubscribe(device->client,
                                     device->addr.interf,
                                     device->addr.index);
 }
 
+// Switch the device's data between multicast and the connection
+int playerc_device_multicast(playerc_device_t *device, int enable)
+{
+  uint32_t group;
+  uint16_t port;
+
+  if (device->client->transport != PLAYERC_TRANSPORT_TCP)
+  {
+    PLAYERC_ERR("multicast data needs the TCP transport");
+    return -1;
+  }
+
+  if (playerc_client_multicast(device->client, device->addr.interf,
+                               device->addr.index, enable, &group, &port) != 0)
+  {
+    PLAYERC_WARN2("multicast request refused for %s:%d",
+                  interf_to_str(device->addr.interf), device->addr.index);
+    playerc_client_closemulticast(device->client, device);
+    return -1;
+  }
+
+  if (!port)
+  {
+    playerc_client_closemulticast(device->client, device);
+    return 0;
+  }
+
+  if (playerc_client_openmulticast(device->client, device, group, port) != 0)
+  {
+    // We can't receive it, so have it sent over the connection again
+    playerc_client_multicast(device->client, device->addr.interf,
+                             device->addr.index, 0, &group, &port);
+    return -1;
+  }
+  return 1;
+}
+
 // Query the capabilities of a device
 int playerc_device_hascapability(playerc_device_t *device, uint32_t type, uint32_t subtype)
 {
@@ -114,6 +114,9 @@ int playerc_mclient_peek(playerc_mclient_t *mclient, int timeout)
     mclient->pollfd[i].fd = mclient->client[i]->sock;
     mclient->pollfd[i].events = POLLIN;
     mclient->pollfd[i].revents = 0;
+    // Messages already in a shared memory ring don't ring again
+    if (playerc_client_shm_ready(mclient->client[i], 0))
+      return 1;
   }
 
   // Wait for incoming data 
@@ -131,7 +134,7 @@ int playerc_mclient_peek(playerc_mclient_t *mclient, int timeout)
 // Read from a bunch of clients
 int playerc_mclient_read(playerc_mclient_t *mclient, int timeout)
 {
-  int i, count;
+  int i, count, ready;
 
   // Configure poll structure to wait for incoming data 
   for (i = 0; i < mclient->client_count; i++)
@@ -145,6 +148,9 @@ int playerc_mclient_read(playerc_mclient_t *mclient, int timeout)
       if(playerc_client_requestdata(mclient->client[i]) < 0)
         PLAYERC_ERR("playerc_client_requestdata errored");
     }
+    // Messages already in a shared memory ring don't ring again
+    if(playerc_client_shm_ready(mclient->client[i], 0))
+      timeout = 0;
   }
 
   // Wait for incoming data 
@@ -159,8 +165,16 @@ int playerc_mclient_read(playerc_mclient_t *mclient, int timeout)
   count = 0;
   for (i = 0; i < mclient->client_count; i++)
   {
-    if(mclient->client[i]->qlen ||
-       (mclient->pollfd[i].revents & POLLIN) > 0)
+    ready = mclient->client[i]->qlen ||
+            (mclient->pollfd[i].revents & POLLIN) > 0;
+    // Over shared memory the socket only carries doorbells, which may
+    // be for messages we have already read
+    if(ready && !mclient->client[i]->qlen && mclient->client[i]->shm)
+      ready = playerc_client_shm_ready(mclient->client[i],
+                                       mclient->pollfd[i].revents & POLLIN);
+    else if(!ready)
+      ready = playerc_client_shm_ready(mclient->client[i], 0);
+    if(ready)
     {
       if(playerc_client_read_nonblock(mclient->client[i])>0)
       {
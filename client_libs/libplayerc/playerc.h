@@ -116,6 +116,11 @@ extern "C" {
 
 #define PLAYERC_QUEUE_RING_SIZE 512
 
+/** Default size of the shared memory ring used with a server on the same
+    machine; messages of up to half this size fit in it, larger ones
+    come over the socket */
+#define PLAYERC_SHM_SIZE (16*1024*1024)
+
 /** @} */
 
 /**
@@ -565,6 +570,32 @@ typedef struct _playerc_client_t
   char *read_xdrdata;
   size_t read_xdrdata_len;
 
+  /** @internal Reassembly of incoming UDP frames */
+  struct udpframe_reasm *udp_reasm;
+  /** @internal Sequence number of the next outgoing UDP message */
+  uint32_t udp_seq;
+
+  /** If non-zero, devices ask to receive their data over multicast when
+   * they are subscribed.  Use @ref playerc_client_set_multicast() to set
+   * this value. */
+  int multicast;
+
+  /** Encoding the client asks the server to send message bodies in
+   * (PLAYER_ENCODING_*).  Use @ref playerc_client_set_encoding() to set
+   * this value. */
+  int encoding;
+  /** @internal Encoding of the message bodies the server is sending. */
+  int read_encoding;
+
+  /** Size of the shared memory ring to take messages from when the server
+   * is on the same machine, or 0 to always use the connection.  Use @ref
+   * playerc_client_set_shm() to set this value. */
+  size_t shm_size;
+  /** @internal Shared memory ring the server writes messages into */
+  struct shmring *shm;
+  /** @internal Ring offered to the server, until it replies */
+  struct shmring *shm_offer;
+
 
   /** Server time stamp on the last packet. */
   double datatime;
@@ -609,6 +640,59 @@ PLAYERC_EXPORT void playerc_client_destroy(playerc_client_t *client);
 PLAYERC_EXPORT void playerc_client_set_transport(playerc_client_t* client,
                                   unsigned int transport);
 
+/** @brief Receive data over multicast where the server offers it.
+
+When enabled, every device subsequently subscribed asks the server for
+its data to be delivered on the device's multicast group rather than
+over the client's own connection; devices the server does not publish
+over multicast keep using the connection.  Requests and replies always
+use the connection.  Only the TCP transport supports this.  See also
+@ref playerc_device_multicast().
+
+@param client Pointer to client object.
+@param enable Non-zero to enable.
+*/
+PLAYERC_EXPORT void playerc_client_set_multicast(playerc_client_t* client,
+                                                 int enable);
+
+/** @brief Choose the encoding of the messages the server sends.
+
+With PLAYER_ENCODING_RAW, the client asks the server when it connects
+to send message bodies in the memory layout of the message structures
+rather than in XDR, which saves converting every field at both ends.
+The server agrees only if its structures are laid out exactly as the
+client's (same interface definitions, byte order and alignment), which
+in practice means a server on the same machine or on one of the same
+architecture running the same version of Player; otherwise, and with
+older servers, XDR is kept.  Requests, multicast data and messages of
+types defined in plugins are always XDR-encoded.  The default is
+PLAYER_ENCODING_XDR.
+
+@param client Pointer to client object.
+@param encoding PLAYER_ENCODING_XDR or PLAYER_ENCODING_RAW
+*/
+PLAYERC_EXPORT void playerc_client_set_encoding(playerc_client_t* client,
+                                                int encoding);
+
+/** @brief Choose the size of the shared memory ring used with a local server.
+
+When the client connects over TCP to a server on the loopback interface,
+it creates a ring buffer of this size in shared memory and asks the
+server to write the messages for it there, in the raw encoding (see
+@ref playerc_client_set_encoding()), instead of sending them over the
+socket; the socket then only carries requests and a wake-up byte when
+the ring was empty.  Subscriptions, replace rules and the data mode
+work as over TCP.  Servers that cannot use the ring, including older
+ones, keep using the socket.  A message larger than half the ring is
+sent over the socket in its turn.  The default is PLAYERC_SHM_SIZE; 0
+disables shared memory.
+
+@param client Pointer to client object.
+@param size Ring size in bytes, rounded up to a power of two.
+*/
+PLAYERC_EXPORT void playerc_client_set_shm(playerc_client_t* client,
+                                           size_t size);
+
 /** @brief Connect to the server.
 
 @param client Pointer to client object.
@@ -723,6 +807,21 @@ playerc_error_str() to get a descriptive error message.
 */
 PLAYERC_EXPORT int playerc_client_get_devlist(playerc_client_t *client);
 
+/** @brief Get the server's performance counters.
+
+This function sends a @ref PLAYER_PLAYER_REQ_STATS request and returns
+the reply in stats; free it with player_device_stats_req_t_free().
+
+@param client Pointer to client object.
+@param stats Set to the reply.
+
+@returns Returns 0 on success, non-zero otherwise.  Use
+playerc_error_str() to get a descriptive error message.
+
+*/
+PLAYERC_EXPORT int playerc_client_get_stats(playerc_client_t *client,
+                                            player_device_stats_req_t **stats);
+
 /** @brief Subscribe a device. @internal
  */
 PLAYERC_EXPORT int playerc_client_subscribe(playerc_client_t *client, int code, int index,
@@ -732,6 +831,25 @@ PLAYERC_EXPORT int playerc_client_subscribe(playerc_client_t *client, int code,
  */
 PLAYERC_EXPORT int playerc_client_unsubscribe(playerc_client_t *client, int code, int index);
 
+/** @brief Ask for a device's data on its multicast group (enable
+non-zero) or over the connection.  On success, group (packed address)
+and port are filled in; port is 0 if the data stays on the connection.
+@internal
+ */
+PLAYERC_EXPORT int playerc_client_multicast(playerc_client_t *client, int code, int index,
+                             int enable, uint32_t *group, uint16_t *port);
+
+/** @brief Open a device's multicast socket and join the group. @internal
+ */
+PLAYERC_EXPORT int playerc_client_openmulticast(playerc_client_t *client,
+                                 struct _playerc_device_t *device,
+                                 uint32_t group, uint16_t port);
+
+/** @brief Close a device's multicast socket, if it has one. @internal
+ */
+PLAYERC_EXPORT void playerc_client_closemulticast(playerc_client_t *client,
+                                   struct _playerc_device_t *device);
+
 /** @brief Issue a request to the server and await a reply (blocking). @internal
 
 The rep_data pointer is filled with a pointer to the response data received. It is
@@ -789,6 +907,21 @@ currently queued data.
 */
 PLAYERC_EXPORT int playerc_client_internal_peek(playerc_client_t *client, int timeout);
 
+/** @brief Test for messages in the client's shared memory ring.
+
+@param client Pointer to client object.
+
+@param readable Non-zero if poll() found the client's socket readable;
+the wake-up bytes sent by the server are then read off it.
+
+@returns Returns 1 if there are messages to read (or the ring is
+corrupt, which reading reports), 0 otherwise or if the client does not
+use shared memory, and -1 if the server closed the connection.
+
+*/
+PLAYERC_EXPORT int playerc_client_shm_ready(playerc_client_t *client,
+                                            int readable);
+
 /** @brief Read data from the server (blocking).
 
 In PUSH mode this will read and process a single message. In PULL mode this
@@ -910,6 +1043,13 @@ typedef struct _playerc_device_t
   playerc_callback_fn_t callback[4];
   void *callback_data[4];
 
+  /** Socket on which multicast data for this device arrives, or -1 if
+      the data comes over the client's connection. @internal */
+  int mcast_sock;
+
+  /** Reassembly of incoming multicast frames. @internal */
+  struct udpframe_reasm *mcast_reasm;
+
 } playerc_device_t;
 
 
@@ -926,6 +1066,18 @@ PLAYERC_EXPORT int playerc_device_subscribe(playerc_device_t *device, int access
 /** @brief Unsubscribe the device. @internal */
 PLAYERC_EXPORT int playerc_device_unsubscribe(playerc_device_t *device);
 
+/** @brief Switch the device's data between the client's connection and
+the device's multicast group.
+
+@param device Pointer to a subscribed device.
+@param enable Non-zero to receive data over multicast.
+
+@returns Returns 1 if the data now arrives over multicast, 0 if it
+arrives over the connection (e.g., because the server does not publish
+this device over multicast) and -1 on error.
+*/
+PLAYERC_EXPORT int playerc_device_multicast(playerc_device_t *device, int enable);
+
 /** @brief Request capabilities of device */
 PLAYERC_EXPORT int playerc_device_hascapability(playerc_device_t *device, uint32_t type, uint32_t subtype);
 
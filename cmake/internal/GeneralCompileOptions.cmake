@@ -13,6 +13,8 @@ ENDIF (WITH_GTK)
 
 OPTION (BUILD_SHARED_LIBS "Build the Player libraries as shared libraries." ON)
 
+OPTION (ENABLE_TRACE "Compile in message tracing, turned on at run time with the server's -t option." ON)
+
 IF (NOT PLAYER_OS_WIN)
     OPTION (LARGE_FILE_SUPPORT "Compile with support for large files (>2GB)." OFF)
     EXECUTE_PROCESS (COMMAND getconf LFS_CFLAGS OUTPUT_VARIABLE LFS_FLAGS
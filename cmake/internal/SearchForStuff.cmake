@@ -81,6 +81,8 @@ ELSE (PLAYER_OS_SOLARIS)
 ENDIF (PLAYER_OS_SOLARIS)
 
 CHECK_FUNCTION_EXISTS (poll HAVE_POLL)
+CHECK_FUNCTION_EXISTS (sendmmsg HAVE_SENDMMSG)
+CHECK_FUNCTION_EXISTS (recvmmsg HAVE_RECVMMSG)
 IF (PLAYER_OS_WIN)
     CHECK_SYMBOL_EXISTS (POLLIN winsock2.h HAVE_POLLIN)
     # This macro will have been pulled in by the previous usage on Windows
@@ -142,6 +144,13 @@ ELSE (PLAYER_OS_QNX OR PLAYER_OS_OSX)
     ENDIF (HAVE_LIBRT AND HAVE_CLOCK_GETTIME_FUNC)
 ENDIF(PLAYER_OS_QNX OR PLAYER_OS_OSX)
 
+# Shared memory for the local transport
+IF (HAVE_LIBRT)
+    SET (CMAKE_REQUIRED_LIBRARIES rt)
+ENDIF (HAVE_LIBRT)
+CHECK_FUNCTION_EXISTS (shm_open HAVE_SHM_OPEN)
+SET (CMAKE_REQUIRED_LIBRARIES)
+
 # Geos check
 CHECK_LIBRARY_EXISTS (geos_c GEOSGeomFromWKB_buf "${PLAYER_EXTRA_LIB_DIRS}" HAVE_GEOS)
 
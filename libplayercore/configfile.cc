@@ -2268,6 +2268,131 @@ ConfigFile::ParseDriver(int section)
   if (driver)
     driver->alwayson = this->ReadInt(section, "alwayson", driver->alwayson) ? true : false;
 
+  // Time the driver's loop?
+  if (driver && this->ReadInt(section, "loop_histogram", 0))
+  {
+    char name[64];
+    for (device = deviceTable->GetFirstDevice(); device != NULL;
+         device = deviceTable->GetNextDevice(device))
+    {
+      if (device->driver == driver)
+        break;
+    }
+    if (device)
+      snprintf(name, sizeof(name), "%s %d:%s:%d", drivername,
+               device->addr.robot, interf_to_str(device->addr.interf),
+               device->addr.index);
+    else
+      snprintf(name, sizeof(name), "%s", drivername);
+    delete driver->loop_histogram;
+    driver->loop_histogram = new LoopHistogram(name);
+  }
+
+  // Drivers without a thread of their own run in the server's thread,
+  // which takes on their real-time settings
+  if (dynamic_cast<ThreadedDriver*>(driver) == NULL)
+  {
+    player_rt_config_t rt;
+    if (player_rt_read(this, section, &rt) != 0)
+      return false;
+    if (player_rt_requested(&rt))
+      player_rt_apply(&rt, drivername, true);
+  }
+
+  // Which devices should (also) be published over multicast?
+  if (this->GetTupleCount(section, "multicast") > 0)
+  {
+    if (!this->ParseMulticast(section, driver))
+      return false;
+  }
+
+  return true;
+}
+
+// Offset a packed IPv4 address by n (in host order)
+static uint32_t
+offset_packedaddr(uint32_t addr, int n)
+{
+  unsigned char b[4];
+  uint32_t v;
+
+  memcpy(b, &addr, sizeof(b));
+  v = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+      ((uint32_t)b[2] << 8) | (uint32_t)b[3];
+  v += n;
+  b[0] = (unsigned char)(v >> 24);
+  b[1] = (unsigned char)(v >> 16);
+  b[2] = (unsigned char)(v >> 8);
+  b[3] = (unsigned char)v;
+  memcpy(&addr, b, sizeof(b));
+  return addr;
+}
+
+// Assign multicast groups to the devices listed in a driver block.  Every
+// device gets its own group, counting up from the multicast_group option,
+// so that receivers only get the streams they joined.
+bool
+ConfigFile::ParseMulticast(int section, Driver *driver)
+{
+  const char *groupname;
+  uint32_t group;
+  unsigned char octets[4];
+  int port;
+  int count, used;
+  player_devaddr_t addr;
+  Device *device;
+
+  groupname = this->ReadString(section, "multicast_group",
+                               PLAYER_MULTICAST_DEFAULT_GROUP);
+  port = this->ReadInt(section, "multicast_port",
+                       PLAYER_MULTICAST_DEFAULT_PORT);
+  if (hostname_to_packedaddr(&group, groupname) < 0)
+  {
+    PLAYER_ERROR1("name lookup failed for multicast group \"%s\"", groupname);
+    return false;
+  }
+  // The packed address is in network byte order, so the first octet is
+  // the lowest-addressed byte
+  memcpy(octets, &group, sizeof(octets));
+  if ((octets[0] < 224) || (octets[0] > 239))
+  {
+    PLAYER_ERROR1("%s is not a multicast address", groupname);
+    return false;
+  }
+  if ((port <= 0) || (port > 65535))
+  {
+    PLAYER_ERROR1("invalid multicast port %d", port);
+    return false;
+  }
+
+  // Groups already handed out to devices of other drivers
+  used = 0;
+  for (device = deviceTable->GetFirstDevice(); device != NULL;
+       device = deviceTable->GetNextDevice(device))
+  {
+    if (device->multicast_port)
+      used++;
+  }
+
+  count = this->GetTupleCount(section, "multicast");
+  for (int i = 0; i < count; i++)
+  {
+    if (this->ReadDeviceAddr(&addr, section, "multicast", 0, i, NULL) != 0)
+    {
+      PLAYER_ERROR1("invalid device address in multicast field, entry %d", i);
+      return false;
+    }
+    device = deviceTable->GetDevice(addr, false);
+    if (!device || (device->driver != driver))
+    {
+      PLAYER_ERROR2("multicast device %s:%u is not provided by this driver",
+                    interf_to_str(addr.interf), addr.index);
+      return false;
+    }
+    device->multicast_group = offset_packedaddr(group, used++);
+    device->multicast_port = port;
+  }
+
   return true;
 }
 
@@ -59,6 +59,9 @@
 
 #include <libplayerinterface/player.h>
 
+// Forward declarations
+class Driver;
+
 /** @brief Class for loading configuration file information.
 
 This class is used to load and configure drivers from a configuration text
@@ -473,6 +476,9 @@ class PLAYERCORE_EXPORT ConfigFile
   // Parse a driver block, and update the deviceTable accordingly
   public: bool ParseDriver(int section);
 
+  // Parse the multicast options of a driver block
+  private: bool ParseMulticast(int section, Driver *driver);
+
   // Parse an interface block, and update the interface systems accordingly
   public: bool ParseInterface(int section);
 
@@ -66,7 +66,10 @@
 Device::Device(player_devaddr_t addr, Driver *device) :
 	next(NULL),
 	addr(addr),
-	driver(device)
+	driver(device),
+	multicast_group(0),
+	multicast_port(0),
+	publishes(0)
 {
   pthread_mutex_init(&accessMutex,NULL);
   memset(this->drivername, 0, sizeof(this->drivername));
@@ -183,6 +186,20 @@ Device::Unsubscribe(QueuePointer &sub_queue)
   return(-1);
 }
 
+size_t
+Device::GetSubscriptionCount(void)
+{
+  size_t count = 0;
+  Lock();
+  for(size_t i=0;i<this->len_queues;i++)
+  {
+    if(this->queues[i] != NULL)
+      count++;
+  }
+  Unlock();
+  return(count);
+}
+
 void
 Device::PutMsg(QueuePointer &resp_queue,
                player_msghdr_t* hdr,
@@ -200,6 +217,20 @@ Device::PutMsg(QueuePointer &resp_queue,
   }
 }
 
+void
+Device::PutMsg(QueuePointer &resp_queue,
+               player_msghdr_t* hdr,
+               Message &payload)
+{
+  hdr->addr = this->addr;
+  Message msg(payload,*hdr,resp_queue);
+  if(!this->InQueue->Push(msg))
+  {
+    PLAYER_ERROR4("tried to push %s/%d from/onto %s/%d\n",
+                  msgtype_to_str(hdr->type), hdr->subtype,
+                  interf_to_str(hdr->addr.interf), hdr->addr.index);
+  }
+}
 
 void
 Device::PutMsg(QueuePointer &resp_queue,
@@ -63,6 +63,21 @@
 
 #define LOCALHOST_ADDR 16777343
 
+/// Default base multicast group for devices published over multicast
+#define PLAYER_MULTICAST_DEFAULT_GROUP "239.255.76.1"
+/// Default UDP port for devices published over multicast
+#define PLAYER_MULTICAST_DEFAULT_PORT 7665
+
+/// Relaxed atomic update and read of a performance counter (see
+/// PLAYER_PLAYER_REQ_STATS), for counters that are read without a lock
+#if defined (__GNUC__)
+  #define PLAYER_STAT_ADD(x, v) __atomic_fetch_add(&(x), (v), __ATOMIC_RELAXED)
+  #define PLAYER_STAT_GET(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#else
+  #define PLAYER_STAT_ADD(x, v) ((x) += (v))
+  #define PLAYER_STAT_GET(x) (x)
+#endif
+
 // Forward declarations
 class Driver;
 
@@ -127,6 +142,19 @@ class PLAYERCORE_EXPORT Device
                 void* src,
                 bool copy=true);
 
+    /// @brief Forward a message to this device
+    ///
+    /// Like the short form of PutMsg, but the payload of @p payload is
+    /// shared rather than copied.  The caller must have checked
+    /// Message::CanShare() for the two headers.
+    ///
+    /// @param resp_queue Where to push any reply
+    /// @param hdr The message header; its address is set to this device's.
+    /// @param payload The message whose payload is passed on
+    void PutMsg(QueuePointer &resp_queue,
+                player_msghdr_t* hdr,
+                Message &payload);
+
     /// @brief Make a request of another device.
     ///
     /// This method send a request message to a device
@@ -236,6 +264,21 @@ class PLAYERCORE_EXPORT Device
     /// Pointer to the underlying driver
     Driver* driver;
 
+    /// Multicast group (packed IPv4 address) on which data from this
+    /// device can be published; only valid if @p multicast_port is non-zero
+    uint32_t multicast_group;
+
+    /// UDP port for @p multicast_group, or 0 if the device is not
+    /// published over multicast
+    uint16_t multicast_port;
+
+    /// Messages published to the subscribers of this device, updated
+    /// with PLAYER_STAT_ADD()
+    uint64_t publishes;
+
+    /// @brief Number of queues subscribed to this device.
+    size_t GetSubscriptionCount(void);
+
   private:
     /** @brief Mutex used to lock access, via Lock() and Unlock(), to
     device internals, like the list of subscribed queues. */
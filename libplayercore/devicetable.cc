@@ -73,6 +73,17 @@ DeviceTable::~DeviceTable()
   for (thisentry=head;thisentry;thisentry = thisentry->next)
     thisentry->driver->Terminate();
 
+  // The drivers have stopped; report their loop timing
+  for (thisentry=head;thisentry;thisentry = thisentry->next)
+  {
+    if (thisentry->driver->loop_histogram)
+    {
+      thisentry->driver->loop_histogram->Print();
+      delete thisentry->driver->loop_histogram;
+      thisentry->driver->loop_histogram = NULL;
+    }
+  }
+
   pthread_mutex_lock(&mutex);
   // Second, delete each device
   thisentry=head;
@@ -49,6 +49,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #if !defined WIN32
   #include <unistd.h>
   #include <netinet/in.h>
@@ -65,6 +66,7 @@
 #include <libplayercore/globals.h>
 #include <libplayercore/filewatcher.h>
 #include <libplayercore/property.h>
+#include <libplayercore/trace.h>
 #include <libplayerinterface/interface_util.h>
 
 // Default constructor for single-interface drivers.  Specify the
@@ -87,6 +89,11 @@ Driver::Driver(ConfigFile *cf, int section,
   this->subscriptions = 0;
   this->entries = 0;
   this->alwayson = false;
+  this->loop_histogram = NULL;
+  this->CurrentMessage = NULL;
+  this->stat_messages = 0;
+  this->stat_process_ns = 0;
+  memset(this->stat_hist, 0, sizeof(this->stat_hist));
 
   // Create an interface
   if(this->AddInterface(this->device_addr) != 0)
@@ -109,6 +116,11 @@ Driver::Driver(ConfigFile *cf, int section,
 
   this->subscriptions = 0;
   this->alwayson = false;
+  this->loop_histogram = NULL;
+  this->CurrentMessage = NULL;
+  this->stat_messages = 0;
+  this->stat_process_ns = 0;
+  memset(this->stat_hist, 0, sizeof(this->stat_hist));
   this->entries = 0;
 
   pthread_mutex_init(&this->accessMutex,NULL);
@@ -118,6 +130,11 @@ Driver::Driver(ConfigFile *cf, int section,
 // destructor, to free up allocated queue.
 Driver::~Driver()
 {
+  if (this->loop_histogram)
+  {
+    this->loop_histogram->Print();
+    delete this->loop_histogram;
+  }
 }
 
 // Add an interface
@@ -183,6 +200,7 @@ Driver::Publish(player_msghdr_t* hdr,
     this->Unlock();
     return;
   }
+  PLAYER_STAT_ADD(dev->publishes, 1);
   Message msg(*hdr,src,InQueue,copy);
   for(size_t i=0;i<dev->len_queues;i++)
   {
@@ -199,6 +217,90 @@ Driver::Publish(player_msghdr_t* hdr,
   this->Unlock();
 }
 
+Message*
+Driver::ForwardSource(player_msghdr_t* hdr, void* src)
+{
+  Message* msg = this->CurrentMessage;
+
+  if ((msg == NULL) || (src == NULL) || (msg->GetPayload() != src))
+    return NULL;
+  if (!Message::CanShare(msg->GetHeader(), hdr))
+    return NULL;
+  return msg;
+}
+
+void
+Driver::ForwardMessage(QueuePointer &queue,
+                       player_msghdr_t* hdr,
+                       void* src)
+{
+  Message* in;
+
+  if (!(in = this->ForwardSource(hdr, src)))
+  {
+    this->Publish(queue, hdr, src, true);
+    return;
+  }
+  Message msg(*in,*hdr,InQueue);
+  if(!queue->Push(msg))
+  {
+    PLAYER_ERROR4("tried to push %d/%d from %d:%d",
+                  hdr->type, hdr->subtype,
+                  hdr->addr.interf, hdr->addr.index);
+  }
+}
+
+void
+Driver::ForwardMessage(player_msghdr_t* hdr,
+                       void* src)
+{
+  Message* in;
+  Device* dev;
+
+  if (!(in = this->ForwardSource(hdr, src)))
+  {
+    this->Publish(hdr, src, true);
+    return;
+  }
+
+  // lock here, because we're accessing our device's queue list
+  this->Lock();
+  if(!(dev = deviceTable->GetDevice(hdr->addr,false)))
+  {
+    this->Unlock();
+    return;
+  }
+  PLAYER_STAT_ADD(dev->publishes, 1);
+  Message msg(*in,*hdr,InQueue);
+  for(size_t i=0;i<dev->len_queues;i++)
+  {
+    if(dev->queues[i] != NULL)
+    {
+      if(!dev->queues[i]->Push(msg))
+      {
+        PLAYER_ERROR4("tried to push %d/%d from %d:%d",
+                      hdr->type, hdr->subtype,
+                      hdr->addr.interf, hdr->addr.index);
+      }
+    }
+  }
+  this->Unlock();
+}
+
+void
+Driver::ForwardMessage(Device* device,
+                       player_msghdr_t* hdr,
+                       void* src)
+{
+  Message* in;
+
+  hdr->addr = device->addr;
+  if (!(in = this->ForwardSource(hdr, src)))
+    device->PutMsg(this->InQueue, hdr, src, true);
+  else
+    device->PutMsg(this->InQueue, hdr, *in);
+}
+
 void
 Driver::Publish(player_devaddr_t addr,
                 QueuePointer &queue,
@@ -364,11 +466,14 @@ void Driver::ProcessMessages(void)
 void Driver::ProcessMessages(int maxmsgs)
 {
   TestCancel();
+  if (this->loop_histogram)
+    this->loop_histogram->Tick();
   // See if we have any pending messages and process them
   if(maxmsgs == 0)
     maxmsgs = this->InQueue->GetLength();
   int currmsg = 0;
   Message* msg;
+  struct timespec start, end;
   while(((maxmsgs < 0) || (currmsg < maxmsgs)) && (msg = this->InQueue->Pop()))
   {
     player_msghdr * hdr = msg->GetHeader();
@@ -376,7 +481,18 @@ void Driver::ProcessMessages(int maxmsgs)
 
     // Try the driver's process function first
     // Drivers can override internal message handlers this way
+    Message* outer = this->CurrentMessage;
+    this->CurrentMessage = msg;
+    PLAYER_TRACE(PLAYER_TRACE_PROCESS, PLAYER_TRACE_BEGIN, msg->RefCount,
+                 this, hdr, 0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
     int ret = this->ProcessMessage(msg->Queue, hdr, data);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    PLAYER_TRACE(PLAYER_TRACE_PROCESS, PLAYER_TRACE_END, msg->RefCount,
+                 this, hdr, 0);
+    this->CurrentMessage = outer;
+    this->CountMessage((end.tv_sec - start.tv_sec) * 1000000000LL +
+                       (end.tv_nsec - start.tv_nsec));
     if(ret < 0)
     {
       // Check if it's an internal message, if that doesn't handle it, give a warning
@@ -400,6 +516,35 @@ void Driver::ProcessMessages(int maxmsgs)
   }
 }
 
+// Account for one call of ProcessMessage() that took ns nanoseconds
+void Driver::CountMessage(int64_t ns)
+{
+  unsigned int us;
+  int i;
+
+  if (ns < 0)
+    ns = 0;
+  PLAYER_STAT_ADD(this->stat_messages, 1);
+  PLAYER_STAT_ADD(this->stat_process_ns, (uint64_t)ns);
+  // Bucket index is the number of significant bits of the time in us, as
+  // in LoopHistogram
+  us = (ns >= 4000000000LL) ? 0xffffffffu : (unsigned int)(ns / 1000);
+  for (i = 0; (us > 0) && (i < PLAYER_STATS_HIST_BUCKETS - 1); i++)
+    us >>= 1;
+  PLAYER_STAT_ADD(this->stat_hist[i], 1);
+}
+
+void Driver::GetStats(player_stats_driver_t* stats)
+{
+  memset(stats, 0, sizeof(player_stats_driver_t));
+  stats->messages = PLAYER_STAT_GET(this->stat_messages);
+  stats->process_ns = PLAYER_STAT_GET(this->stat_process_ns);
+  stats->hist_count = PLAYER_STATS_HIST_BUCKETS;
+  for (int i = 0; i < PLAYER_STATS_HIST_BUCKETS; i++)
+    stats->hist[i] = PLAYER_STAT_GET(this->stat_hist[i]);
+  this->InQueue->GetStats(&stats->queue);
+}
+
 int Driver::ProcessInternalMessages(QueuePointer &resp_queue,
                                     player_msghdr * hdr, void * data)
 {
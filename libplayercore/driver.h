@@ -65,6 +65,7 @@
 #include <libplayercore/message.h>
 #include <libplayerinterface/player.h>
 #include <libplayercore/property.h>
+#include <libplayercore/realtime.h>
 
 //using namespace std;
 
@@ -97,6 +98,9 @@ capability.
 
 // Forward declarations
 class ConfigFile;
+class Device;
+class DriverScheduler;
+struct SchedulerTask;
 
 /**
 @brief Base class for all drivers.
@@ -168,6 +172,9 @@ class PLAYERCORE_EXPORT Driver
     pthread_mutex_t accessMutex;
     /** @brief Mutex used to protect the subscription count for the driver. */
     pthread_mutex_t subscriptionMutex;
+    /** @brief Add a ProcessMessage() call that took @p ns nanoseconds to
+    the counters. */
+    void CountMessage(int64_t ns);
   protected:
     /** @brief Lock access between the server and driver threads. In particular used
      * to procect the drivers thread pointer */
@@ -264,6 +271,46 @@ class PLAYERCORE_EXPORT Driver
                  void* src,
                  bool copy = true);
 
+    /** @brief Forward a message via one of this driver's interfaces.
+
+    Use this in place of Publish() when @p src is the payload of the
+    message being handled by ProcessMessage() and is passed on unchanged
+    under a rewritten header.  The outgoing message shares the incoming
+    payload rather than deep-copying it, so a chain of relays, splitters
+    and the like never duplicates it.  Falls back to a copy when @p src is
+    not the payload of CurrentMessage or the payload can't be shared under
+    @p hdr (see Message::CanShare()).  A shared payload is seen by every
+    recipient, so neither side may modify it afterwards.
+    @param hdr The message header
+    @param src The message body */
+    void ForwardMessage(player_msghdr_t* hdr, void* src);
+
+    /** @brief Forward a message to a single queue; see above.
+    @param queue the target queue.
+    @param hdr The message header
+    @param src The message body */
+    void ForwardMessage(QueuePointer &queue, player_msghdr_t* hdr, void* src);
+
+    /** @brief Forward a message to another device; see above.  Replies
+    come back on InQueue.
+    @param device the target device; hdr->addr is set to its address.
+    @param hdr The message header
+    @param src The message body */
+    void ForwardMessage(Device* device, player_msghdr_t* hdr, void* src);
+
+    /** @brief The message to share when forwarding @p src under @p hdr.
+
+    Returns CurrentMessage if @p src is its payload and
+    Message::CanShare() holds, NULL otherwise. */
+    Message* ForwardSource(player_msghdr_t* hdr, void* src);
+
+    /** @brief Message being handled by ProcessMessage().
+
+    Set by ProcessMessages() for the duration of each ProcessMessage()
+    call, NULL otherwise.  Drivers that pop messages off queues of their
+    own should set it in the same way to forward them without copies. */
+    Message* CurrentMessage;
+
 
     /** @brief Default device address (single-interface drivers) */
     player_devaddr_t device_addr;
@@ -281,6 +328,26 @@ class PLAYERCORE_EXPORT Driver
     to reflect that setting). */
     bool alwayson;
 
+    /** @brief Loop period histogram.
+
+    Set from the "loop_histogram" parameter in the config file; NULL
+    unless it is turned on.  Updated on every call of ProcessMessages()
+    and printed when the server shuts down. */
+    LoopHistogram* loop_histogram;
+
+    /** @brief ProcessMessage() counters.
+
+    Updated by ProcessMessages() with PLAYER_STAT_ADD(), and read with
+    GetStats() (see PLAYER_PLAYER_REQ_STATS). */
+    uint64_t stat_messages;
+    uint64_t stat_process_ns;
+    uint64_t stat_hist[PLAYER_STATS_HIST_BUCKETS];
+
+    /** @brief Get the driver's counters, including those of its InQueue.
+
+    The name is left empty. */
+    void GetStats(player_stats_driver_t* stats);
+
     /** @brief Queue for all incoming messages for this driver */
     QueuePointer InQueue;
 
@@ -587,12 +654,34 @@ class PLAYERCORE_EXPORT ThreadedDriver : public Driver
     /// Barrier to synchronise threads on setup
     PlayerBarrier SetupBarrier;
 
+    /// Scheduler state while the driver is run as a task, NULL otherwise
+    SchedulerTask* Task;
+
+    /// Set when the config file asks for the driver to be run as a task
+    /// (@c scheduling "task")
+    bool TaskRequested;
+
+    /// Real-time settings from the config file (rt_policy, rt_priority,
+    /// cpu_affinity, prefault_stack), applied to the driver's thread
+    player_rt_config_t RtConfig;
+
+    friend class DriverScheduler;
+
   protected:
     /** enable thread cancellation and test for cancellation
      *
      * This should only ever be called from the driver thread with *no* locks held*/
     void TestCancel();
 
+    /** @brief Can the driver be run as a task?
+
+    Set this in the constructor of drivers whose Main() does nothing but
+    wait for messages and process them, and which never block otherwise.
+    Such drivers can then be run on the shared DriverScheduler rather than
+    in a thread of their own, by giving them the @c scheduling "task"
+    option; MainStep() is called in place of Main().  Defaults to false. */
+    bool TaskCapable;
+
 
   public:
 
@@ -663,6 +752,13 @@ class PLAYERCORE_EXPORT ThreadedDriver : public Driver
     driver thread exits. */
     virtual void MainQuit(void) {};
 
+    /** @brief One pass of the main loop, for drivers run as tasks.
+
+    Called by the DriverScheduler whenever data arrives on the driver's
+    queue (see TaskCapable).  Must not block.  The default processes the
+    pending messages, which is all most message-driven drivers do. */
+    virtual void MainStep(void) { this->ProcessMessages(); }
+
     /** @brief Wait for new data to arrive on the driver's queue.
 
     Call this method to block until a new message arrives on
@@ -46,6 +46,7 @@
 #include <libplayercore/devicetable.h>
 #include <libplayercore/drivertable.h>
 #include <libplayercore/filewatcher.h>
+#include <libplayercore/scheduler.h>
 #include <libplayercore/playertime.h>
 #include <libplayercore/wallclocktime.h>
 
@@ -67,6 +68,9 @@ PLAYERCORE_EXPORT PlayerTime* GlobalTime;
 // global class for watching for changes in files and sockets
 PLAYERCORE_EXPORT FileWatcher* fileWatcher;
 
+// shared worker pool for drivers that run as tasks
+PLAYERCORE_EXPORT DriverScheduler* driverScheduler;
+
 PLAYERCORE_EXPORT char playerversion[32];
 
 PLAYERCORE_EXPORT bool player_quit;
@@ -87,6 +91,7 @@ player_globals_init()
   driverTable = new DriverTable();
   GlobalTime = new WallclockTime();
   fileWatcher = new FileWatcher();
+  driverScheduler = new DriverScheduler();
   strncpy(playerversion, PLAYER_VERSION, sizeof(playerversion));
   player_quit = false;
   player_quiet_startup = false;
@@ -100,6 +105,8 @@ player_globals_fini()
 {
   delete deviceTable;
   delete driverTable;
+  // after the device table, as stopping task drivers needs the workers
+  delete driverScheduler;
   delete GlobalTime;
   delete fileWatcher;
 #if HAVE_PLAYERSD
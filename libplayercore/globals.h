@@ -57,12 +57,14 @@ class DeviceTable;
 class PlayerTime;
 class DriverTable;
 class FileWatcher;
+class DriverScheduler;
 struct player_sd;
 
 PLAYERCORE_EXPORT extern DeviceTable* deviceTable;
 PLAYERCORE_EXPORT extern PlayerTime* GlobalTime;
 PLAYERCORE_EXPORT extern DriverTable* driverTable;
 PLAYERCORE_EXPORT extern FileWatcher* fileWatcher;
+PLAYERCORE_EXPORT extern DriverScheduler* driverScheduler;
 PLAYERCORE_EXPORT extern char playerversion[];
 PLAYERCORE_EXPORT extern bool player_quit;
 PLAYERCORE_EXPORT extern bool player_quiet_startup;
@@ -56,6 +56,7 @@
 #include <libplayerinterface/playerxdr.h>
 
 #include <libplayercore/message.h>
+#include <libplayercore/trace.h>
 #include <replace/replace.h>
 
 Message::Message(const struct player_msghdr & aHeader,
@@ -90,6 +91,40 @@ Message::Message(const Message & rhs)
   pthread_mutex_unlock(rhs.Lock);
 }
 
+Message::Message(const Message & rhs,
+                 const struct player_msghdr & aHeader,
+                 QueuePointer &_queue) : Queue(_queue)
+{
+  assert(rhs.Lock);
+  pthread_mutex_lock(rhs.Lock);
+
+  assert(rhs.RefCount);
+  assert(*(rhs.RefCount));
+  Lock = rhs.Lock;
+  Data = rhs.Data;
+  Header = aHeader;
+  Header.size = rhs.Header.size;
+  RefCount = rhs.RefCount;
+  (*RefCount)++;
+
+  pthread_mutex_unlock(rhs.Lock);
+}
+
+bool
+Message::CanShare(const player_msghdr_t* from, const player_msghdr_t* to)
+{
+  player_free_fn_t freefunc;
+
+  if ((from->addr.interf == to->addr.interf) &&
+      (from->type == to->type) &&
+      (from->subtype == to->subtype))
+    return true;
+  // The payload is released through the header of the last reference
+  freefunc = playerxdr_get_freefunc(from->addr.interf, from->type, from->subtype);
+  return (freefunc != NULL) &&
+    (freefunc == playerxdr_get_freefunc(to->addr.interf, to->type, to->subtype));
+}
+
 Message::~Message()
 {
   this->DecRef();
@@ -112,6 +147,8 @@ void Message::CreateMessage(const struct player_msghdr & aHeader,
   {
     Data = NULL;
     Header.size = 0;
+    PLAYER_TRACE(PLAYER_TRACE_CREATE, PLAYER_TRACE_INSTANT, this->RefCount,
+                 NULL, &this->Header, 0);
     return;
   }
   // Force header size to be same as data size
@@ -141,6 +178,8 @@ void Message::CreateMessage(const struct player_msghdr & aHeader,
   {
     this->Data = (uint8_t*)data;
   }
+  PLAYER_TRACE(PLAYER_TRACE_CREATE, PLAYER_TRACE_INSTANT, this->RefCount,
+               NULL, &this->Header, this->Header.size);
 }
 
 bool
@@ -202,6 +241,11 @@ MessageQueue::MessageQueue(bool _Replace, size_t _Maxlen)
   this->data_requested = false;
   this->data_delivered = false;
   this->drop_count = 0;
+  this->stat_pushes = this->stat_pops = this->stat_drops = 0;
+  this->stat_replaced = this->stat_ignored = 0;
+  this->stat_max_length = 0;
+  this->notify_fn = NULL;
+  this->notify_arg = NULL;
 }
 
 MessageQueue::~MessageQueue()
@@ -276,6 +320,66 @@ MessageQueue::AddReplaceRule(const player_devaddr_t &device,
                         _type, _subtype, _replace);
 }
 
+/// @brief Add a replacement rule ahead of the existing ones
+MessageReplaceRule*
+MessageQueue::PushReplaceRule(int _host, int _robot, int _interf, int _index,
+                              int _type, int _subtype, int _replace)
+{
+  MessageReplaceRule* rule;
+
+  this->Lock();
+  rule = new MessageReplaceRule(_host, _robot, _interf, _index,
+                                _type, _subtype, _replace);
+  rule->next = this->replaceRules;
+  this->replaceRules = rule;
+  this->Unlock();
+  return(rule);
+}
+
+/// @brief Remove a replacement rule from the list
+void
+MessageQueue::RemoveReplaceRule(int _host, int _robot, int _interf, int _index,
+                                int _type, int _subtype, bool haveLock)
+{
+  MessageReplaceRule** curr;
+  MessageReplaceRule* tmp;
+
+  if(!haveLock)
+    this->Lock();
+  for(curr=&this->replaceRules;*curr;)
+  {
+    if((*curr)->Equivalent(_host, _robot, _interf, _index, _type, _subtype))
+    {
+      tmp = *curr;
+      *curr = tmp->next;
+      delete tmp;
+    }
+    else
+      curr = &(*curr)->next;
+  }
+  if(!haveLock)
+    this->Unlock();
+}
+
+/// @brief Remove a rule added by PushReplaceRule()
+void
+MessageQueue::RemoveReplaceRule(MessageReplaceRule* rule)
+{
+  MessageReplaceRule** curr;
+
+  this->Lock();
+  for(curr=&this->replaceRules;*curr;curr=&(*curr)->next)
+  {
+    if(*curr == rule)
+    {
+      *curr = rule->next;
+      delete rule;
+      break;
+    }
+  }
+  this->Unlock();
+}
+
 int
 MessageQueue::CheckReplace(player_msghdr_t* hdr)
 {
@@ -398,6 +502,21 @@ MessageQueue::GetLength(void)
   return(len);
 }
 
+void
+MessageQueue::GetStats(player_stats_queue_t* stats)
+{
+  this->Lock();
+  stats->pushes = this->stat_pushes;
+  stats->pops = this->stat_pops;
+  stats->drops = this->stat_drops;
+  stats->replaced = this->stat_replaced;
+  stats->ignored = this->stat_ignored;
+  stats->length = this->Length;
+  stats->max_length = this->stat_max_length;
+  stats->limit = this->Maxlen;
+  this->Unlock();
+}
+
 void
 MessageQueue::ClearFilter(void)
 {
@@ -413,6 +532,17 @@ MessageQueue::DataAvailable(void)
 {
   pthread_mutex_lock(&this->condMutex);
   pthread_cond_broadcast(&this->cond);
+  if (this->notify_fn)
+    (*this->notify_fn)(this->notify_arg);
+  pthread_mutex_unlock(&this->condMutex);
+}
+
+void
+MessageQueue::SetNotify(void (*fn)(void*), void* arg)
+{
+  pthread_mutex_lock(&this->condMutex);
+  this->notify_fn = fn;
+  this->notify_arg = arg;
   pthread_mutex_unlock(&this->condMutex);
 }
 
@@ -452,6 +582,11 @@ MessageQueue::PushFront(Message & msg, bool haveLock)
     this->head = newelt;
   }
   this->Length++;
+  this->stat_pushes++;
+  PLAYER_TRACE(PLAYER_TRACE_PUSH, PLAYER_TRACE_INSTANT, msg.RefCount, this,
+               msg.GetHeader(), this->Length);
+  if(this->Length > this->stat_max_length)
+    this->stat_max_length = this->Length;
   if(!haveLock)
     this->Unlock();
 }
@@ -480,6 +615,11 @@ MessageQueue::PushBack(Message & msg, bool haveLock)
     this->tail = newelt;
   }
   this->Length++;
+  this->stat_pushes++;
+  PLAYER_TRACE(PLAYER_TRACE_PUSH, PLAYER_TRACE_INSTANT, msg.RefCount, this,
+               msg.GetHeader(), this->Length);
+  if(this->Length > this->stat_max_length)
+    this->stat_max_length = this->Length;
   if(!haveLock)
     this->Unlock();
 }
@@ -499,6 +639,9 @@ MessageQueue::Push(Message & msg)
   if (PLAYER_PLAYER_MSG_REPLACE_RULE_IGNORE == replaceOp)
   {
     // drop silently
+    this->stat_ignored++;
+    PLAYER_TRACE(PLAYER_TRACE_DROP, PLAYER_TRACE_INSTANT, msg.RefCount, this,
+                 hdr, this->Length);
     this->Unlock();
     return(true);
   }
@@ -507,6 +650,9 @@ MessageQueue::Push(Message & msg)
   {
     // record the fact that we are dropping a message
     this->drop_count++;
+    this->stat_drops++;
+    PLAYER_TRACE(PLAYER_TRACE_DROP, PLAYER_TRACE_INSTANT, msg.RefCount, this,
+                 hdr, this->Length);
     this->Unlock();
     return(true);
   }
@@ -521,6 +667,7 @@ MessageQueue::Push(Message & msg)
         this->Remove(el);
         delete el->msg;
         delete el;
+        this->stat_replaced++;
         break;
       }
     }
@@ -571,6 +718,9 @@ MessageQueue::Pop()
          (el->msg->GetHeader()->type == PLAYER_MSGTYPE_DATA))
         this->data_delivered = true;
       this->Remove(el);
+      this->stat_pops++;
+      PLAYER_TRACE(PLAYER_TRACE_POP, PLAYER_TRACE_INSTANT, el->msg->RefCount,
+                   this, el->msg->GetHeader(), this->Length);
       Unlock();
       Message* retmsg = el->msg;
       delete el;
@@ -148,6 +148,14 @@ class PLAYERCORE_EXPORT Message
     /// Copy pointers from existing message and increment refcount.
     Message(const Message & rhs);
 
+    /// Create a message that shares the payload of an existing one under a
+    /// new header, with an associated queue.  The payload is not copied;
+    /// its refcount is incremented.  Only valid if CanShare() holds for the
+    /// two headers.
+    Message(const Message & rhs,
+            const struct player_msghdr & Header,
+            QueuePointer &_queue);
+
     /// Destroy message, dec ref counts and delete data if ref count == 0
     ~Message();
 
@@ -182,6 +190,14 @@ class PLAYERCORE_EXPORT Message
              ((subtype < 0) || (hdr->subtype == (uint8_t)subtype)));
     }    
     
+    /** @brief Can a payload be passed on under another header?
+
+    Returns true if a payload that arrived with header @p from may be
+    shared by a message with header @p to: both describe the same kind of
+    payload, so whichever message releases it last frees it correctly.
+    */
+    static bool CanShare(const player_msghdr_t* from, const player_msghdr_t* to);
+
     /// Get pointer to header.
     player_msghdr_t * GetHeader() {return &Header;};
     /// Get pointer to payload.
@@ -382,6 +398,20 @@ class PLAYERCORE_EXPORT MessageQueue
      * */
     void AddReplaceRule(const player_devaddr_t &device,
                         int _type, int _subtype, int _replace);
+    /** Add a replacement rule ahead of all the existing ones, so that it
+     * takes precedence over them (e.g., over a client's own catch-all
+     * rules).  Arguments are as for AddReplaceRule().  Returns the new
+     * rule, to be passed to RemoveReplaceRule() when it is no longer
+     * wanted. */
+    MessageReplaceRule* PushReplaceRule(int _host, int _robot, int _interf, int _index,
+                                        int _type, int _subtype, int _replace);
+    /** Remove the replacement rule with exactly this signature, if there
+     * is one. */
+    void RemoveReplaceRule(int _host, int _robot, int _interf, int _index,
+                           int _type, int _subtype, bool haveLock=false);
+    /** Remove a rule returned by PushReplaceRule(), leaving any others
+     * with the same signature in place. */
+    void RemoveReplaceRule(MessageReplaceRule* rule);
     /// @brief Check whether a message with the given header should replace
     /// any existing message of the same signature, be ignored or accepted.
     int CheckReplace(player_msghdr_t* hdr);
@@ -395,6 +425,12 @@ class PLAYERCORE_EXPORT MessageQueue
     /** Signal that new data is available.  Calling this method will
      release any threads currently waiting on this queue. */
     void DataAvailable(void);
+    /** Set a function to be called, with @p arg, every time DataAvailable()
+     is.  The function runs with an internal lock held, so it must be
+     quick and must not call back into this queue.  Once SetNotify()
+     returns, the previous function is not running and will not be called
+     again.  Pass NULL to remove it.  Used by the DriverScheduler. */
+    void SetNotify(void (*fn)(void*), void* arg);
     /// @brief Check whether a message passes the current filter.
     bool Filter(Message& msg);
     /// @brief Clear (i.e., turn off) message filter.
@@ -408,6 +444,9 @@ class PLAYERCORE_EXPORT MessageQueue
     /// @brief Get current length of queue, in elements.
     size_t GetLength(void);
 
+    /// @brief Get the queue's counters (see PLAYER_PLAYER_REQ_STATS).
+    void GetStats(player_stats_queue_t* stats);
+
     /// @brief Set the data_requested flag
     void SetDataRequested(bool d, bool haveLock);
 
@@ -440,6 +479,9 @@ class PLAYERCORE_EXPORT MessageQueue
     pthread_cond_t cond;
     /// @brief Mutex to go with condition variable cond.
     pthread_mutex_t condMutex;
+    /// Called from DataAvailable(), see SetNotify()
+    void (*notify_fn)(void*);
+    void* notify_arg;
     /// @brief Current filter values
     bool filter_on;
     int filter_host, filter_robot, filter_interf,
@@ -452,8 +494,13 @@ class PLAYERCORE_EXPORT MessageQueue
     bool data_requested;
     /// @brief Flag that data was sent (in PULL mode)
     bool data_delivered;
-    /// @brief Count of the number of messages discarded due to queue overflow.
-    bool drop_count;
+    /// @brief Count of the number of messages discarded due to queue
+    /// overflow since the last SYNCH message.
+    uint32_t drop_count;
+    /// @brief Counters returned by GetStats(), updated under the lock.
+    uint64_t stat_pushes, stat_pops, stat_drops, stat_replaced, stat_ignored;
+    /// @brief Longest the queue has been.
+    size_t stat_max_length;
 };
 
 
@@ -58,6 +58,10 @@
 #include <libplayercore/playertime.h>
 #include <libplayercore/wallclocktime.h>
 #include <libplayercore/property.h>
+#include <libplayercore/realtime.h>
+#include <libplayercore/scheduler.h>
+#include <libplayercore/serialframer.h>
+#include <libplayercore/trace.h>
 #include <playerconfig.h>
 
 #endif
@@ -0,0 +1,351 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *                      
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+
+/*
+ * Real-time scheduling, CPU pinning and loop timing for driver threads
+ */
+
+#if HAVE_CONFIG_H
+  #include <config.h>
+#endif
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if !defined (WIN32)
+  #include <pthread.h>
+  #include <sched.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+#if defined (__linux__)
+  #include <alloca.h>
+#endif
+
+#include <libplayercommon/playercommon.h>
+#include <libplayercore/configfile.h>
+#include <libplayercore/realtime.h>
+
+int
+player_rt_read(ConfigFile* cf, int section, player_rt_config_t* rt)
+{
+  const char* policy;
+  int i;
+
+  memset(rt, 0, sizeof(*rt));
+#if !defined (WIN32)
+  rt->policy = SCHED_OTHER;
+#endif
+  if (cf == NULL)
+    return 0;
+
+  policy = cf->ReadString(section, "rt_policy", "other");
+  if (strcmp(policy, "other") != 0)
+  {
+#if defined (WIN32)
+    PLAYER_WARN1("rt_policy \"%s\" is not supported on this platform", policy);
+#else
+    if (strcmp(policy, "fifo") == 0)
+      rt->policy = SCHED_FIFO;
+    else if (strcmp(policy, "rr") == 0)
+      rt->policy = SCHED_RR;
+    else
+    {
+      PLAYER_ERROR1("unknown rt_policy \"%s\"", policy);
+      return -1;
+    }
+    rt->priority = cf->ReadInt(section, "rt_priority",
+                               sched_get_priority_min(rt->policy));
+    if ((rt->priority < sched_get_priority_min(rt->policy)) ||
+        (rt->priority > sched_get_priority_max(rt->policy)))
+    {
+      PLAYER_ERROR3("rt_priority %d is outside [%d, %d]", rt->priority,
+                    sched_get_priority_min(rt->policy),
+                    sched_get_priority_max(rt->policy));
+      return -1;
+    }
+#endif
+  }
+
+  rt->cpu_count = cf->GetTupleCount(section, "cpu_affinity");
+  if (rt->cpu_count > PLAYER_RT_MAX_CPUS)
+  {
+    PLAYER_ERROR1("cpu_affinity lists more than %d CPUs", PLAYER_RT_MAX_CPUS);
+    return -1;
+  }
+  for (i = 0; i < rt->cpu_count; i++)
+  {
+    rt->cpus[i] = cf->ReadTupleInt(section, "cpu_affinity", i, -1);
+    if ((rt->cpus[i] < 0) || (rt->cpus[i] >= PLAYER_RT_MAX_CPUS))
+    {
+      PLAYER_ERROR1("invalid CPU %d in cpu_affinity", rt->cpus[i]);
+      return -1;
+    }
+  }
+
+  i = cf->ReadInt(section, "prefault_stack", 0);
+  if (i < 0)
+  {
+    PLAYER_ERROR1("invalid prefault_stack %d", i);
+    return -1;
+  }
+  rt->prefault_stack = (size_t)i * 1024;
+  return 0;
+}
+
+bool
+player_rt_requested(const player_rt_config_t* rt)
+{
+#if !defined (WIN32)
+  if (rt->policy != SCHED_OTHER)
+    return true;
+#endif
+  return (rt->cpu_count > 0) || (rt->prefault_stack > 0);
+}
+
+#if defined (__linux__)
+// Touch the given number of bytes below the current stack frame.  Kept
+// out of line so that the block is released when it returns.
+static void __attribute__ ((noinline))
+prefault_stack(size_t size)
+{
+  volatile char* p = (volatile char*)alloca(size);
+  size_t i;
+  long page = sysconf(_SC_PAGESIZE);
+
+  for (i = 0; i < size; i += page)
+    p[i] = 0;
+}
+#endif
+
+int
+player_rt_apply(const player_rt_config_t* rt, const char* who,
+                bool raise_only)
+{
+  int ret = 0;
+#if defined (WIN32)
+  if (player_rt_requested(rt))
+  {
+    PLAYER_WARN1("real-time settings for %s are not supported on this "
+                 "platform", who);
+    ret = -1;
+  }
+#else
+  struct sched_param param;
+  int policy;
+  int err;
+
+  if (rt->policy != SCHED_OTHER)
+  {
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    if (!raise_only || (policy == SCHED_OTHER) ||
+        (param.sched_priority < rt->priority))
+    {
+      memset(&param, 0, sizeof(param));
+      param.sched_priority = rt->priority;
+      if ((err = pthread_setschedparam(pthread_self(), rt->policy, &param)))
+      {
+        PLAYER_WARN3("failed to set %s priority %d for %s",
+                     (rt->policy == SCHED_FIFO) ? "fifo" : "rr",
+                     rt->priority, who);
+        PLAYER_WARN1("  %s", strerror(err));
+        ret = -1;
+      }
+      else
+        PLAYER_MSG3(2, "%s runs with %s priority %d", who,
+                    (rt->policy == SCHED_FIFO) ? "fifo" : "rr", rt->priority);
+    }
+  }
+
+  if (rt->cpu_count > 0)
+  {
+#if defined (__linux__)
+    cpu_set_t set;
+    int i;
+
+    CPU_ZERO(&set);
+    for (i = 0; i < rt->cpu_count; i++)
+      CPU_SET(rt->cpus[i], &set);
+    if ((err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)))
+    {
+      PLAYER_WARN2("failed to set the CPU affinity of %s: %s", who,
+                   strerror(err));
+      ret = -1;
+    }
+#else
+    PLAYER_WARN1("cpu_affinity for %s is not supported on this platform", who);
+    ret = -1;
+#endif
+  }
+
+  if (rt->prefault_stack > 0)
+  {
+#if defined (__linux__)
+    prefault_stack(rt->prefault_stack);
+#else
+    PLAYER_WARN1("prefault_stack for %s is not supported on this platform",
+                 who);
+    ret = -1;
+#endif
+  }
+#endif
+  return ret;
+}
+
+int
+player_rt_lock_memory(void)
+{
+#if defined (WIN32)
+  PLAYER_WARN("locking memory is not supported on this platform");
+  return -1;
+#else
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+  {
+    PLAYER_WARN1("failed to lock memory: %s", strerror(errno));
+    return -1;
+  }
+  return 0;
+#endif
+}
+
+static double
+loophist_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+LoopHistogram::LoopHistogram(const char* name)
+{
+  strncpy(this->name, name, sizeof(this->name) - 1);
+  this->name[sizeof(this->name) - 1] = '\0';
+  this->last = -1;
+  this->count = 0;
+  this->sum = 0;
+  this->sumsq = 0;
+  this->min = 0;
+  this->max = 0;
+  memset(this->buckets, 0, sizeof(this->buckets));
+}
+
+void
+LoopHistogram::Tick()
+{
+  double now = loophist_now();
+  double dt;
+  unsigned int us;
+  int i;
+
+  if (this->last < 0)
+  {
+    this->last = now;
+    return;
+  }
+  dt = now - this->last;
+  this->last = now;
+
+  if ((this->count == 0) || (dt < this->min))
+    this->min = dt;
+  if ((this->count == 0) || (dt > this->max))
+    this->max = dt;
+  this->count++;
+  this->sum += dt;
+  this->sumsq += dt * dt;
+
+  // Bucket index is the number of significant bits of the period in us
+  us = (dt >= 4e3) ? 0xffffffffu : (unsigned int)(dt * 1e6);
+  for (i = 0; (us > 0) && (i < PLAYER_LOOPHIST_BUCKETS - 1); i++)
+    us >>= 1;
+  this->buckets[i]++;
+}
+
+// Format a period given in us
+static void
+loophist_format(char* buf, size_t len, double us)
+{
+  if (us < 1e3)
+    snprintf(buf, len, "%.0f us", us);
+  else if (us < 1e6)
+    snprintf(buf, len, "%.0f ms", us / 1e3);
+  else
+    snprintf(buf, len, "%.0f s", us / 1e6);
+}
+
+void
+LoopHistogram::Print() const
+{
+  double mean, var;
+  char lo[32], hi[32];
+  int i;
+
+  if (this->count == 0)
+  {
+    PLAYER_MSG1(0, "loop histogram for %s: no loops", this->name);
+    return;
+  }
+  mean = this->sum / this->count;
+  var = this->sumsq / this->count - mean * mean;
+  PLAYER_MSG6(0, "loop histogram for %s: %llu loops, period mean %.3f ms, "
+              "stddev %.3f ms, min %.3f ms, max %.3f ms", this->name,
+              (unsigned long long)this->count, mean * 1e3,
+              (var > 0) ? sqrt(var) * 1e3 : 0.0,
+              this->min * 1e3, this->max * 1e3);
+  for (i = 0; i < PLAYER_LOOPHIST_BUCKETS; i++)
+  {
+    if (this->buckets[i] == 0)
+      continue;
+    loophist_format(lo, sizeof(lo), (i == 0) ? 0 : ldexp(1.0, i - 1));
+    if (i == PLAYER_LOOPHIST_BUCKETS - 1)
+      PLAYER_MSG3(0, "  %10s -           : %llu (%.1f%%)", lo,
+                  (unsigned long long)this->buckets[i],
+                  100.0 * this->buckets[i] / this->count);
+    else
+    {
+      loophist_format(hi, sizeof(hi), ldexp(1.0, i));
+      PLAYER_MSG4(0, "  %10s - %-10s: %llu (%.1f%%)", lo, hi,
+                  (unsigned long long)this->buckets[i],
+                  100.0 * this->buckets[i] / this->count);
+    }
+  }
+}
@@ -0,0 +1,154 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *                      
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+
+/*
+ * Real-time scheduling, CPU pinning and loop timing for driver threads
+ */
+#ifndef _REALTIME_H
+#define _REALTIME_H
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERCORE_EXPORT
+  #elif defined (playercore_EXPORTS)
+    #define PLAYERCORE_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERCORE_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERCORE_EXPORT
+#endif
+
+#include <stddef.h>
+#include <libplayerinterface/player.h>
+
+class ConfigFile;
+
+/** Largest number of CPUs that can be listed in cpu_affinity */
+#define PLAYER_RT_MAX_CPUS 64
+
+/** Number of buckets in a loop histogram; bucket i > 0 counts periods
+    of [2^(i-1), 2^i) microseconds, the last one everything longer */
+#define PLAYER_LOOPHIST_BUCKETS 26
+
+/** @brief Real-time settings for the thread that runs a driver
+
+Read from the driver's section of the configuration file:
+
+- rt_policy (string): "other" (the default), "fifo" or "rr"
+- rt_priority (integer): priority for the fifo and rr policies; defaults
+  to the lowest one
+- cpu_affinity (tuple of integers): CPUs the thread may run on
+- prefault_stack (integer): kilobytes of stack to touch before the driver
+  starts, so that its first loops don't take page faults.  Together with
+  the server's -m option the pages stay resident.
+
+Threaded drivers apply the settings on their own thread before
+MainSetup() is called.  Drivers without a thread, like bumpersafe and
+lasersafe, run in the server's main thread, so their settings are
+applied to that thread; when several of them ask for a priority the
+highest one is kept. */
+typedef struct player_rt_config
+{
+  /** SCHED_OTHER, SCHED_FIFO or SCHED_RR */
+  int policy;
+  /** Priority for SCHED_FIFO and SCHED_RR */
+  int priority;
+  /** CPUs to pin the thread to; none if cpu_count is 0 */
+  int cpus[PLAYER_RT_MAX_CPUS];
+  int cpu_count;
+  /** Bytes of stack to prefault */
+  size_t prefault_stack;
+} player_rt_config_t;
+
+/** Read the real-time options of a configuration file section.  cf may
+    be NULL, in which case the defaults are used.
+    @return 0 on success, -1 if an option was invalid */
+PLAYERCORE_EXPORT int player_rt_read(ConfigFile* cf, int section,
+                                     player_rt_config_t* rt);
+
+/** True if any of the settings differ from the defaults */
+PLAYERCORE_EXPORT bool player_rt_requested(const player_rt_config_t* rt);
+
+/** Apply settings to the calling thread.  Failures, typically for lack of
+    privileges, are reported as warnings naming @p who.  With @p raise_only
+    the priority is only changed if that makes it higher.
+    @return 0 if everything was applied, -1 otherwise */
+PLAYERCORE_EXPORT int player_rt_apply(const player_rt_config_t* rt,
+                                      const char* who, bool raise_only);
+
+/** Lock all current and future pages of the process into memory.
+    @return 0 on success, -1 otherwise */
+PLAYERCORE_EXPORT int player_rt_lock_memory(void);
+
+/** @brief Histogram of the period of a driver's loop
+
+Enabled for a driver with the driver-independent option
+
+@verbatim
+loop_histogram 1
+@endverbatim
+
+Every call of Driver::ProcessMessages() counts as one pass of the loop.
+The time between passes is collected in power-of-two buckets, and the
+histogram is printed when the server shuts down. */
+class PLAYERCORE_EXPORT LoopHistogram
+{
+  public:
+    LoopHistogram(const char* name);
+
+    /** Record one pass of the loop */
+    void Tick();
+
+    /** Print the histogram and summary statistics */
+    void Print() const;
+
+  private:
+    char name[64];
+    double last;
+    uint64_t count;
+    double sum;
+    double sumsq;
+    double min;
+    double max;
+    uint64_t buckets[PLAYER_LOOPHIST_BUCKETS];
+};
+
+#endif
@@ -165,14 +165,14 @@ int RemoteDriver::ProcessMessage(QueuePointer & resp_queue,
 						hdr->addr.host, hdr->addr.robot, hdr->addr.interf, hdr->addr.index);
 			return -1;
 		}
-		ConnectionMap[resp_queue].first->PutMsg(hdr, data);
+		ConnectionMap[resp_queue].first->PutMsg(hdr, data, ForwardSource(hdr, data));
 	}
 	else
 	{
 		// if it is another type of message then forward it to a client
 		if (QueueMap.count(resp_queue) > 0)
 		{
-			Publish(QueueMap[resp_queue], hdr, data);
+			ForwardMessage(QueueMap[resp_queue], hdr, data);
 		}
 	}
 
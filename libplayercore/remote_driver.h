@@ -91,6 +91,9 @@ public:
 	virtual void Unsubscribe(player_devaddr_t addr) {subscription_count--;};
 
 	virtual void PutMsg(player_msghdr_t* hdr, void* src) {throw "unimplemented";};
+	/// Forward a message; @p payload, if not NULL, is a message whose
+	/// payload is src and may be shared rather than copied
+	virtual void PutMsg(player_msghdr_t* hdr, void* src, Message* payload) {PutMsg(hdr, src);};
 
 	int subscription_count;
 	QueuePointer ConnectionQueue;
@@ -0,0 +1,346 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *                      
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/*
+ * Cooperative scheduler for message-driven drivers
+ */
+
+#if HAVE_CONFIG_H
+  #include <config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if !defined (WIN32)
+  #include <unistd.h>
+#endif
+
+#include <libplayercommon/playercommon.h>
+#include <libplayercore/driver.h>
+#include <libplayercore/message.h>
+#include <libplayercore/scheduler.h>
+
+// Scheduling state of a task
+#define TASK_IDLE    0
+#define TASK_QUEUED  1
+#define TASK_RUNNING 2
+
+// A driver run by the scheduler
+struct SchedulerTask
+{
+  ThreadedDriver* driver;
+  DriverScheduler* scheduler;
+  int state;
+  // Woken while running; run again when done
+  bool again;
+  // Asked to stop
+  bool stop;
+  // MainSetup() has been called
+  bool started;
+  // When the task was put on the run queue
+  double wake_time;
+  SchedulerTask* next;
+};
+
+static double
+sched_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+DriverScheduler::DriverScheduler()
+{
+  pthread_mutex_init(&this->lock, NULL);
+  pthread_cond_init(&this->cond, NULL);
+  this->head = this->tail = NULL;
+  this->worker_count = 0;
+  this->workers = NULL;
+  this->quit = false;
+  this->steps = 0;
+  this->latency_sum = 0;
+  this->latency_max = 0;
+}
+
+DriverScheduler::~DriverScheduler()
+{
+  int i;
+
+  pthread_mutex_lock(&this->lock);
+  this->quit = true;
+  pthread_cond_broadcast(&this->cond);
+  pthread_mutex_unlock(&this->lock);
+
+  if (this->workers)
+  {
+    for (i = 0; i < this->worker_count; i++)
+      pthread_join(this->workers[i], NULL);
+    delete [] this->workers;
+
+    PLAYER_MSG4(2, "driver scheduler: %d workers ran %llu steps, wake latency mean %.1f us, max %.1f us",
+                this->worker_count, (unsigned long long) this->steps,
+                this->steps ? 1e6 * this->latency_sum / this->steps : 0.0,
+                1e6 * this->latency_max);
+  }
+
+  pthread_cond_destroy(&this->cond);
+  pthread_mutex_destroy(&this->lock);
+}
+
+void
+DriverScheduler::SetWorkerCount(int count)
+{
+  pthread_mutex_lock(&this->lock);
+  if (this->workers)
+    PLAYER_WARN("driver scheduler already running; worker count not changed");
+  else
+    this->worker_count = count;
+  pthread_mutex_unlock(&this->lock);
+}
+
+bool
+DriverScheduler::StartWorkers()
+{
+  int i;
+
+  if (this->workers)
+    return this->worker_count > 0;
+
+  if (this->worker_count <= 0)
+  {
+#if defined (_SC_NPROCESSORS_ONLN)
+    this->worker_count = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (this->worker_count <= 0)
+      this->worker_count = 1;
+  }
+
+  this->workers = new pthread_t[this->worker_count];
+  for (i = 0; i < this->worker_count; i++)
+  {
+    if (pthread_create(this->workers + i, NULL, &DriverScheduler::WorkerMain, this) != 0)
+    {
+      PLAYER_WARN2("driver scheduler could only start %d of %d workers",
+                   i, this->worker_count);
+      break;
+    }
+  }
+  // Carry on with the workers that did start
+  this->worker_count = i;
+  if (this->worker_count == 0)
+    return false;
+  PLAYER_MSG1(2, "driver scheduler started with %d workers", this->worker_count);
+  return true;
+}
+
+bool
+DriverScheduler::Add(ThreadedDriver* driver)
+{
+  SchedulerTask* task;
+  bool running;
+
+  pthread_mutex_lock(&this->lock);
+  running = this->StartWorkers();
+  pthread_mutex_unlock(&this->lock);
+  if (!running)
+    return false;
+
+  task = new SchedulerTask;
+  memset(task, 0, sizeof(SchedulerTask));
+  task->driver = driver;
+  task->scheduler = this;
+  task->state = TASK_IDLE;
+  driver->Task = task;
+
+  // From now on, data arriving on the queue wakes the task
+  driver->InQueue->SetNotify(&DriverScheduler::Notify, task);
+
+  // Queue it right away, to run MainSetup()
+  pthread_mutex_lock(&this->lock);
+  this->Wake(task);
+  pthread_mutex_unlock(&this->lock);
+  return true;
+}
+
+void
+DriverScheduler::Stop(ThreadedDriver* driver)
+{
+  SchedulerTask* task = driver->Task;
+
+  assert(task);
+  pthread_mutex_lock(&this->lock);
+  task->stop = true;
+  this->Wake(task);
+  pthread_mutex_unlock(&this->lock);
+}
+
+void
+DriverScheduler::GetStats(uint64_t* steps, double* mean_latency, double* max_latency)
+{
+  pthread_mutex_lock(&this->lock);
+  *steps = this->steps;
+  *mean_latency = this->steps ? this->latency_sum / this->steps : 0.0;
+  *max_latency = this->latency_max;
+  pthread_mutex_unlock(&this->lock);
+}
+
+void
+DriverScheduler::Notify(void* arg)
+{
+  SchedulerTask* task = reinterpret_cast<SchedulerTask*>(arg);
+  DriverScheduler* self = task->scheduler;
+
+  pthread_mutex_lock(&self->lock);
+  self->Wake(task);
+  pthread_mutex_unlock(&self->lock);
+}
+
+void
+DriverScheduler::Wake(SchedulerTask* task)
+{
+  if (task->state == TASK_RUNNING)
+  {
+    task->again = true;
+  }
+  else if (task->state == TASK_IDLE)
+  {
+    task->state = TASK_QUEUED;
+    task->wake_time = sched_now();
+    task->next = NULL;
+    if (this->tail)
+      this->tail->next = task;
+    else
+      this->head = task;
+    this->tail = task;
+    pthread_cond_signal(&this->cond);
+  }
+}
+
+void
+DriverScheduler::Run(SchedulerTask* task)
+{
+  ThreadedDriver* driver = task->driver;
+  bool stop;
+  int ret;
+
+  pthread_mutex_lock(&this->lock);
+  stop = task->stop;
+  pthread_mutex_unlock(&this->lock);
+
+  if (!stop)
+  {
+    if (!task->started)
+    {
+      task->started = true;
+      driver->SetupSuccessful = false;
+      ret = driver->MainSetup();
+      if (ret == 0)
+        driver->SetupSuccessful = true;
+      else
+      {
+        PLAYER_ERROR1("Driver failed to Setup (%d)", ret);
+        stop = true;
+      }
+    }
+    if (!stop)
+      driver->MainStep();
+  }
+
+  pthread_mutex_lock(&this->lock);
+  if (!stop && !task->stop)
+  {
+    // Data that arrived while we were running gets another step
+    task->state = TASK_IDLE;
+    if (task->again)
+    {
+      task->again = false;
+      this->Wake(task);
+    }
+    pthread_mutex_unlock(&this->lock);
+    return;
+  }
+  pthread_mutex_unlock(&this->lock);
+
+  // The task is done.  Detach it from the queue first, so that nothing
+  // can wake it any more, then finish up the way a driver thread does;
+  // this may start a new task for the driver if it was restarted.
+  driver->InQueue->SetNotify(NULL, NULL);
+  ThreadedDriver::DummyMainQuit(driver);
+  delete task;
+}
+
+void*
+DriverScheduler::WorkerMain(void* arg)
+{
+  DriverScheduler* self = reinterpret_cast<DriverScheduler*>(arg);
+  SchedulerTask* task;
+  double latency;
+
+  pthread_mutex_lock(&self->lock);
+  for (;;)
+  {
+    while (!self->quit && !self->head)
+      pthread_cond_wait(&self->cond, &self->lock);
+    if (self->quit)
+      break;
+
+    task = self->head;
+    self->head = task->next;
+    if (!self->head)
+      self->tail = NULL;
+    task->state = TASK_RUNNING;
+    task->again = false;
+
+    latency = sched_now() - task->wake_time;
+    self->steps++;
+    self->latency_sum += latency;
+    if (latency > self->latency_max)
+      self->latency_max = latency;
+
+    pthread_mutex_unlock(&self->lock);
+    self->Run(task);
+    pthread_mutex_lock(&self->lock);
+  }
+  pthread_mutex_unlock(&self->lock);
+
+  return NULL;
+}
@@ -0,0 +1,148 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *                      
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/*
+ * Cooperative scheduler for message-driven drivers
+ */
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERCORE_EXPORT
+  #elif defined (playercore_EXPORTS)
+    #define PLAYERCORE_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERCORE_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERCORE_EXPORT
+#endif
+
+#include <pthread.h>
+#include <libplayerinterface/player.h>
+
+class ThreadedDriver;
+struct SchedulerTask;
+
+/** @brief Runs drivers as tasks on a shared pool of worker threads
+
+By default every ThreadedDriver gets a thread of its own, which for filters,
+splitters and the like spends nearly all of its time blocked on the
+driver's queue.  A driver that sets ThreadedDriver::TaskCapable and is
+configured with
+
+@verbatim
+scheduling "task"
+@endverbatim
+
+is run by the scheduler instead.  Whenever data becomes available on the
+driver's queue, be it a message pushed by another driver or a file
+descriptor registered with the global FileWatcher becoming ready, the
+driver is queued and the next free worker calls its
+ThreadedDriver::MainStep().  MainSetup() and MainQuit() are called on a
+worker as well, so the driver sees the same sequence of calls as it does
+from its own thread.  A task never runs on two workers at once.
+
+A task must not block: while it does, it holds up one of the workers.
+Drivers that wait on hardware or sleep in their main loop should keep a
+thread of their own.
+
+The number of workers is set with the -w option of the server, and
+defaults to the number of CPUs. */
+class PLAYERCORE_EXPORT DriverScheduler
+{
+  public:
+    DriverScheduler();
+    ~DriverScheduler();
+
+    /** Set the number of worker threads.  Only has an effect before the
+        first task is added; 0 means one worker per CPU. */
+    void SetWorkerCount(int count);
+
+    /** Start running a driver as a task.  The driver's MainSetup() is
+        called on a worker, followed by MainStep() every time its queue
+        gets data.  Called from ThreadedDriver::StartThread().  Returns
+        false if no worker could be started, in which case the driver
+        needs a thread of its own. */
+    bool Add(ThreadedDriver* driver);
+
+    /** Ask a task to stop.  Like cancelling a driver thread this does not
+        wait: MainQuit() is called on a worker once the task is not
+        running, after which the driver's thread state goes to stopped.
+        Called from ThreadedDriver::StopThread(). */
+    void Stop(ThreadedDriver* driver);
+
+    /** Number of MainStep() calls so far, and the mean and largest delay
+        [s] between a task being woken and it starting to run. */
+    void GetStats(uint64_t* steps, double* mean_latency, double* max_latency);
+
+  private:
+    // Queue notification hook; arg is the SchedulerTask
+    static void Notify(void* arg);
+    // Worker thread main loop
+    static void* WorkerMain(void* arg);
+
+    // Put a task on the run queue, or flag it to run again if it is
+    // running now; called with the lock held
+    void Wake(SchedulerTask* task);
+    // Run one step of a task on the calling worker
+    void Run(SchedulerTask* task);
+    // Start the workers if they are not running yet; called with the
+    // lock held.  Returns false if there are no workers.
+    bool StartWorkers();
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    // Run queue (singly-linked through SchedulerTask::next)
+    SchedulerTask* head;
+    SchedulerTask* tail;
+
+    int worker_count;
+    pthread_t* workers;
+    bool quit;
+
+    // Statistics
+    uint64_t steps;
+    double latency_sum;
+    double latency_max;
+};
+
+#endif
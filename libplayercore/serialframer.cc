@@ -0,0 +1,348 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *                      
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/*
+ * Buffered reader for framed serial protocols
+ */
+
+#if HAVE_CONFIG_H
+  #include <config.h>
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#if !defined (WIN32)
+  #include <unistd.h>
+  #include <sys/uio.h>
+  #include <poll.h>
+#endif
+
+#include <replace/replace.h>
+#include <libplayercommon/playercommon.h>
+#include <libplayercore/globals.h>
+#include <libplayercore/playertime.h>
+#include "serialframer.h"
+
+SerialFrameRules::SerialFrameRules(const uint8_t* start, size_t start_len,
+                                   size_t header_len)
+{
+  assert(start_len <= SERIALFRAMER_MAX_START);
+  assert(header_len >= start_len);
+  memcpy(this->start, start, start_len);
+  this->start_len = start_len;
+  this->header_len = header_len;
+}
+
+SerialFramer::SerialFramer(int fd, SerialFrameRules* rules, size_t bufsize)
+{
+  this->fd = fd;
+  this->rules = rules;
+  for(this->size = 64; this->size < bufsize; this->size <<= 1);
+  this->mask = this->size - 1;
+  this->buf = (uint8_t*)malloc(this->size);
+  assert(this->buf);
+  this->head = this->tail = 0;
+  this->frame_time = 0;
+  memset(&this->stats, 0, sizeof(this->stats));
+}
+
+SerialFramer::~SerialFramer()
+{
+  free(this->buf);
+}
+
+void
+SerialFramer::SetFd(int fd)
+{
+  this->fd = fd;
+  this->Flush();
+}
+
+void
+SerialFramer::Flush()
+{
+  this->head = this->tail = 0;
+}
+
+void
+SerialFramer::Peek(size_t off, uint8_t* dst, size_t len) const
+{
+  size_t i = (this->head + off) & this->mask;
+  size_t first = this->size - i;
+  if(first >= len)
+    memcpy(dst, this->buf + i, len);
+  else
+  {
+    memcpy(dst, this->buf + i, first);
+    memcpy(dst + first, this->buf, len - first);
+  }
+}
+
+ssize_t
+SerialFramer::NextFrame(uint8_t* frame, size_t maxlen, bool* started)
+{
+  const SerialFrameRules* r = this->rules;
+  uint8_t header[256];
+  ssize_t len;
+  size_t i;
+
+  assert(r->header_len <= sizeof(header));
+  while(this->tail - this->head >= r->start_len)
+  {
+    // Look for the start pattern
+    for(i = 0; i < r->start_len; i++)
+      if(this->buf[(this->head + i) & this->mask] != r->start[i])
+        break;
+    if(i < r->start_len)
+    {
+      this->head++;
+      this->stats.skipped++;
+      continue;
+    }
+    if(!*started)
+    {
+      *started = true;
+      GlobalTime->GetTimeDouble(&this->frame_time);
+    }
+
+    if(this->tail - this->head < r->header_len)
+      return 0;
+    this->Peek(0, header, r->header_len);
+    len = this->rules->FrameLength(header);
+    if(len < (ssize_t)r->header_len || (size_t)len > this->size)
+    {
+      // Not a frame after all
+      this->head++;
+      this->stats.skipped++;
+      continue;
+    }
+    if(this->tail - this->head < (size_t)len)
+      return 0;
+
+    if((size_t)len > maxlen)
+    {
+      PLAYER_WARN2("skipping %d byte frame (buffer holds %d)",
+                   (int)len, (int)maxlen);
+      this->head += len;
+      this->stats.bad_frames++;
+      continue;
+    }
+    this->Peek(0, frame, len);
+    if(!this->rules->CheckFrame(frame, len))
+    {
+      this->head++;
+      this->stats.bad_frames++;
+      continue;
+    }
+    this->head += len;
+    this->stats.frames++;
+    return len;
+  }
+  return 0;
+}
+
+ssize_t
+SerialFramer::Fill(int timeout)
+{
+#if defined (WIN32)
+  PLAYER_ERROR("SerialFramer is not supported on this platform");
+  return -1;
+#else
+  struct iovec iov[2];
+  int iovcnt;
+  size_t w, free_bytes;
+  ssize_t n;
+
+  // Make room if the buffer is full; that can only be junk, since frames
+  // longer than the buffer are rejected
+  if(this->tail - this->head == this->size)
+  {
+    this->head++;
+    this->stats.skipped++;
+  }
+
+  // If we may block, go straight to read(); otherwise wait for the
+  // device first so that we don't block in read()
+  if(timeout >= 0)
+  {
+    struct pollfd ufd;
+    ufd.fd = this->fd;
+    ufd.events = POLLIN;
+    ufd.revents = 0;
+    this->stats.polls++;
+    int ret = poll(&ufd, 1, timeout);
+    if(ret < 0)
+      return (errno == EINTR) ? 0 : -1;
+    if(ret == 0)
+      return 0;
+  }
+
+  // Read into the free part of the ring, which may wrap around
+  w = this->tail & this->mask;
+  free_bytes = this->size - (this->tail - this->head);
+  iov[0].iov_base = this->buf + w;
+  if(w + free_bytes <= this->size)
+  {
+    iov[0].iov_len = free_bytes;
+    iovcnt = 1;
+  }
+  else
+  {
+    iov[0].iov_len = this->size - w;
+    iov[1].iov_base = this->buf;
+    iov[1].iov_len = free_bytes - iov[0].iov_len;
+    iovcnt = 2;
+  }
+
+  this->stats.reads++;
+  n = readv(this->fd, iov, iovcnt);
+  if(n < 0)
+  {
+    if(errno == EINTR || errno == EAGAIN)
+      return 0;
+    PLAYER_ERROR1("error reading serial device: %s", strerror(errno));
+    return -1;
+  }
+  if(n == 0)
+  {
+    PLAYER_MSG0(2, "eof on serial device");
+    return -1;
+  }
+  this->tail += n;
+  this->stats.bytes += n;
+  return n;
+#endif
+}
+
+ssize_t
+SerialFramer::ReadFrame(uint8_t* frame, size_t maxlen, int timeout,
+                        int start_timeout)
+{
+  double now, stop_time = 0, stop_time_start = 0;
+  bool started = false;
+  ssize_t len;
+  int wait;
+
+  if(start_timeout < 0)
+    start_timeout = timeout;
+  if(timeout >= 0)
+  {
+    GlobalTime->GetTimeDouble(&now);
+    stop_time = now + timeout / 1e3;
+    stop_time_start = now + start_timeout / 1e3;
+  }
+
+  for(;;)
+  {
+    if((len = this->NextFrame(frame, maxlen, &started)) > 0)
+      return len;
+
+    wait = -1;
+    if(timeout >= 0)
+    {
+      GlobalTime->GetTimeDouble(&now);
+      wait = (int)(1e3 * ((started ? stop_time : stop_time_start) - now));
+      if(wait < 0)
+        wait = 0;
+    }
+    if((len = this->Fill(wait)) < 0)
+      return -1;
+    // Nothing came in although we were already out of time
+    if(len == 0 && wait == 0)
+      return 0;
+  }
+}
+
+static uint16_t crc16_ccitt_table[256];
+static uint16_t crc16_ibm_table[256];
+
+// Fill in the CRC tables before anybody can use them
+static struct crc16_tables
+{
+  crc16_tables()
+  {
+    for(int i = 0; i < 256; i++)
+    {
+      uint16_t c = i << 8;
+      for(int j = 0; j < 8; j++)
+        c = (c & 0x8000) ? (c << 1) ^ 0x1021 : (c << 1);
+      crc16_ccitt_table[i] = c;
+
+      c = i;
+      for(int j = 0; j < 8; j++)
+        c = (c & 1) ? (c >> 1) ^ 0xA001 : (c >> 1);
+      crc16_ibm_table[i] = c;
+    }
+  }
+} crc16_tables_init;
+
+uint16_t
+serial_crc16_ccitt(const uint8_t* data, size_t len, uint16_t crc)
+{
+  while(len--)
+    crc = (crc << 8) ^ crc16_ccitt_table[((crc >> 8) ^ *data++) & 0xFF];
+  return crc;
+}
+
+uint16_t
+serial_crc16_ibm(const uint8_t* data, size_t len, uint16_t crc)
+{
+  while(len--)
+    crc = (crc >> 8) ^ crc16_ibm_table[(crc ^ *data++) & 0xFF];
+  return crc;
+}
+
+uint16_t
+serial_crc16_sick(const uint8_t* data, size_t len)
+{
+  uint16_t crc = 0;
+  uint8_t prev = 0;
+
+  // Each step only shifts the CRC by one bit, so there is no table to be
+  // had; the branch on the top bit is replaced by a mask.
+  while(len--)
+  {
+    crc = (uint16_t)(crc << 1) ^ (0x8005 & -(crc >> 15));
+    crc ^= (uint16_t)(*data | (prev << 8));
+    prev = *data++;
+  }
+  return crc;
+}
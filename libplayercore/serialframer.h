@@ -0,0 +1,190 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *                      
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/*
+ * Buffered reader for framed serial protocols
+ */
+#ifndef _SERIALFRAMER_H
+#define _SERIALFRAMER_H
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERCORE_EXPORT
+  #elif defined (playercore_EXPORTS)
+    #define PLAYERCORE_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERCORE_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERCORE_EXPORT
+#endif
+
+#include <sys/types.h>
+#include <stddef.h>
+#include <libplayerinterface/player.h>
+
+/// Default size of the SerialFramer read buffer (rounded up to a power of 2)
+#define SERIALFRAMER_DEFAULT_BUFSIZE 4096
+/// Longest start-of-frame pattern
+#define SERIALFRAMER_MAX_START 8
+
+/** @brief Framing rules of a serial protocol
+
+Tells a SerialFramer how to find frames in a byte stream.  A frame starts
+with a fixed pattern, its total length can be worked out from its first
+@p header_len bytes, and it can optionally be checked (CRC, checksum) once
+complete.  Derive from this class and implement FrameLength() and, if the
+protocol has one, CheckFrame(). */
+class PLAYERCORE_EXPORT SerialFrameRules
+{
+  public:
+    /** @param start Bytes every frame starts with
+        @param start_len Number of start bytes (at most SERIALFRAMER_MAX_START)
+        @param header_len Number of bytes needed to call FrameLength()
+        (at least @p start_len) */
+    SerialFrameRules(const uint8_t* start, size_t start_len, size_t header_len);
+    virtual ~SerialFrameRules() {}
+
+    /** Total length of the frame, start and checksum included, given its
+        first @p header_len bytes.  Return -1 if they cannot be the start
+        of a frame. */
+    virtual ssize_t FrameLength(const uint8_t* header) = 0;
+
+    /** Check a complete frame, typically its checksum.  Frames that fail
+        are skipped and the search for a frame resumes one byte after the
+        start of the bad one. */
+    virtual bool CheckFrame(const uint8_t* frame, size_t len) { return true; }
+
+    uint8_t start[SERIALFRAMER_MAX_START];
+    size_t start_len;
+    size_t header_len;
+};
+
+/// Counters kept by a SerialFramer
+typedef struct serialframer_stats
+{
+  /// read() calls
+  unsigned long reads;
+  /// poll() calls
+  unsigned long polls;
+  /// Bytes read
+  unsigned long bytes;
+  /// Good frames returned
+  unsigned long frames;
+  /// Bytes skipped while looking for the start of a frame
+  unsigned long skipped;
+  /// Frames dropped because they failed CheckFrame() or were too long
+  unsigned long bad_frames;
+} serialframer_stats_t;
+
+/** @brief Buffered reader for framed serial protocols
+
+Serial drivers traditionally read their device a byte at a time until a
+frame header shows up, which costs a system call (or two, with select())
+per byte.  A SerialFramer instead reads as much as is available into a
+ring buffer, usually a whole frame or more per read(), and cuts frames out
+of it according to a SerialFrameRules object.
+
+The framer owns neither the file descriptor nor the rules.  Any code that
+flushes the device (tcflush()) or reopens it should call Flush() or
+SetFd() so that stale buffered bytes go as well.  A framer is not thread
+safe; use it from the thread that talks to the device. */
+class PLAYERCORE_EXPORT SerialFramer
+{
+  public:
+    SerialFramer(int fd, SerialFrameRules* rules,
+                 size_t bufsize = SERIALFRAMER_DEFAULT_BUFSIZE);
+    ~SerialFramer();
+
+    /// Read from another file descriptor; drops anything buffered
+    void SetFd(int fd);
+    /// Drop anything buffered
+    void Flush();
+
+    /** Read the next good frame.
+        @param frame Where to copy the frame, start and checksum included
+        @param maxlen Size of @p frame; longer frames are skipped
+        @param timeout Time to wait for the whole frame [ms]; -1 blocks
+        @param start_timeout Time to wait for the start of the frame [ms];
+        -1 to use @p timeout
+        @return The frame length, 0 on timeout, -1 on error or end of file */
+    ssize_t ReadFrame(uint8_t* frame, size_t maxlen, int timeout = -1,
+                      int start_timeout = -1);
+
+    /// Time at which the start of the last frame was found
+    double GetFrameTime() const { return this->frame_time; }
+    /// Counters since creation
+    const serialframer_stats_t& GetStats() const { return this->stats; }
+
+  private:
+    // Try to cut a frame out of the buffered bytes; returns its length, 0
+    // if more bytes are needed
+    ssize_t NextFrame(uint8_t* frame, size_t maxlen, bool* started);
+    // Copy buffered bytes starting at offset off from the head
+    void Peek(size_t off, uint8_t* dst, size_t len) const;
+    // Read what is available into the buffer; returns bytes read, 0 on
+    // timeout and -1 on error
+    ssize_t Fill(int timeout);
+
+    int fd;
+    SerialFrameRules* rules;
+    uint8_t* buf;
+    // Buffer size (a power of 2) and mask for the indices
+    size_t size, mask;
+    // Free-running read and write indices
+    size_t head, tail;
+    double frame_time;
+    serialframer_stats_t stats;
+};
+
+/// CRC-16/CCITT (polynomial 0x1021, MSB first), table driven.  Pass the
+/// previous result as @p crc to continue a computation.
+PLAYERCORE_EXPORT uint16_t serial_crc16_ccitt(const uint8_t* data, size_t len,
+                                              uint16_t crc = 0xFFFF);
+
+/// CRC-16/IBM (polynomial 0x8005, reflected), table driven; this is the
+/// Modbus CRC with the default @p crc of 0xFFFF.
+PLAYERCORE_EXPORT uint16_t serial_crc16_ibm(const uint8_t* data, size_t len,
+                                            uint16_t crc = 0xFFFF);
+
+/// Checksum of SICK LMS2xx / PLS telegrams (polynomial 0x8005, fed with
+/// pairs of bytes).
+PLAYERCORE_EXPORT uint16_t serial_crc16_sick(const uint8_t* data, size_t len);
+
+#endif
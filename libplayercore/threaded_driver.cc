@@ -74,6 +74,40 @@
 #include <libplayercore/globals.h>
 #include <libplayercore/filewatcher.h>
 #include <libplayercore/property.h>
+#include <libplayercore/realtime.h>
+#include <libplayercore/scheduler.h>
+
+// Read the scheduling option of a driver; true if it asks to be run as a
+// task
+static bool
+read_scheduling(ConfigFile *cf, int section)
+{
+	const char *mode;
+
+	if (cf == NULL)
+		return false;
+	mode = cf->ReadString(section, "scheduling", "thread");
+	if (strcmp(mode, "task") == 0)
+		return true;
+	if (strcmp(mode, "thread") != 0)
+		PLAYER_WARN1("unknown scheduling \"%s\"; using a thread", mode);
+	return false;
+}
+
+// Name of a driver as given in the config file, for messages
+static const char*
+driver_name(Driver *driver)
+{
+	Device *device;
+
+	for (device = deviceTable->GetFirstDevice(); device != NULL;
+	     device = deviceTable->GetNextDevice(device))
+	{
+		if (device->driver == driver)
+			return device->drivername;
+	}
+	return "driver";
+}
 
 // Default constructor for single-interface drivers.  Specify the
 // interface code and buffer sizes.
@@ -82,6 +116,11 @@ ThreadedDriver::ThreadedDriver(ConfigFile *cf, int section, bool overwrite_cmds,
 	ThreadState(PLAYER_THREAD_STATE_STOPPED)
 {
 	memset (&driverthread, 0, sizeof (driverthread));
+	Task = NULL;
+	TaskRequested = read_scheduling(cf, section);
+	TaskCapable = false;
+	if (player_rt_read(cf, section, &RtConfig) != 0)
+		SetError(-1);
 }
 
 // this is the other constructor, used by multi-interface drivers.
@@ -90,6 +129,11 @@ ThreadedDriver::ThreadedDriver(ConfigFile *cf, int section, bool overwrite_cmds,
 	ThreadState(PLAYER_THREAD_STATE_STOPPED)
 {
 	memset (&driverthread, 0, sizeof (driverthread));
+	Task = NULL;
+	TaskRequested = read_scheduling(cf, section);
+	TaskCapable = false;
+	if (player_rt_read(cf, section, &RtConfig) != 0)
+		SetError(-1);
 }
 
 // destructor, to free up allocated queue.
@@ -127,6 +171,19 @@ void ThreadedDriver::TestCancel()
 void
 ThreadedDriver::StartThread(void)
 {
+  if (ThreadState == PLAYER_THREAD_STATE_STOPPED && TaskRequested && TaskCapable)
+  {
+    if (player_rt_requested(&RtConfig))
+      PLAYER_WARN("real-time settings are ignored for drivers run as tasks");
+    ThreadState = PLAYER_THREAD_STATE_RUNNING;
+    if (driverScheduler->Add(this))
+      return;
+    PLAYER_WARN("driver scheduler has no workers; starting a thread for the driver");
+    ThreadState = PLAYER_THREAD_STATE_STOPPED;
+  }
+  else if (ThreadState == PLAYER_THREAD_STATE_STOPPED && TaskRequested)
+    PLAYER_WARN("driver can't be run as a task; starting a thread for it");
+
   if (ThreadState == PLAYER_THREAD_STATE_STOPPED)
   {
     SetupBarrier.SetValue(2);
@@ -151,7 +208,12 @@ ThreadedDriver::StartThread(void)
 void
 ThreadedDriver::StopThread(void)
 {
-  if (ThreadState == PLAYER_THREAD_STATE_RUNNING)
+  if (ThreadState == PLAYER_THREAD_STATE_RUNNING && Task)
+  {
+    driverScheduler->Stop(this);
+    ThreadState = PLAYER_THREAD_STATE_STOPPING;
+  }
+  else if (ThreadState == PLAYER_THREAD_STATE_RUNNING)
   {
 	PLAYER_MSG2(5,"Cancelling thread %p belonging to driver %p",driverthread,this);
     pthread_cancel(driverthread);
@@ -184,6 +246,9 @@ ThreadedDriver::DummyMain(void *devicep)
   // sync with start thread
   tdriver.SetupBarrier.Wait();
 
+  if (player_rt_requested(&tdriver.RtConfig))
+    player_rt_apply(&tdriver.RtConfig, driver_name(&tdriver), false);
+
   pthread_cleanup_push(&DummyMainQuit, devicep);
   int ret = tdriver.MainSetup();
   // Run the overloaded Main() in the subclassed device.
@@ -202,7 +267,8 @@ ThreadedDriver::DummyMain(void *devicep)
   return NULL;
 }
 
-/* Dummy main cleanup (just calls real main cleanup) */
+/* Dummy main cleanup (just calls real main cleanup).  Also used by the
+   DriverScheduler when a task finishes. */
 void
 ThreadedDriver::DummyMainQuit(void *devicep)
 {
@@ -215,6 +281,7 @@ ThreadedDriver::DummyMainQuit(void *devicep)
     driver->MainQuit();
   driver->Lock();
   memset (&driver->driverthread, 0, sizeof (driver->driverthread));
+  driver->Task = NULL;
   if (driver->ThreadState == PLAYER_THREAD_STATE_RESTARTING)
   {
     driver->ThreadState = PLAYER_THREAD_STATE_STOPPED;
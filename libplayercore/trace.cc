@@ -0,0 +1,335 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *                      
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+
+/*
+ * Message tracing
+ */
+
+#if HAVE_CONFIG_H
+  #include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#if !defined (WIN32)
+  #include <unistd.h>
+#endif
+
+#include <libplayercommon/playercommon.h>
+#include <libplayerinterface/interface_util.h>
+#include <libplayercore/trace.h>
+
+volatile int player_trace_on = 0;
+
+#if defined (ENABLE_TRACE)
+
+#if defined (__GNUC__)
+  #define TRACE_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+  #define TRACE_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+  #define TRACE_FENCE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#else
+  #define TRACE_LOAD(x) (x)
+  #define TRACE_STORE(x, v) ((x) = (v))
+  #define TRACE_FENCE()
+#endif
+
+typedef struct trace_event
+{
+  /** CLOCK_MONOTONIC, in ns */
+  uint64_t ts;
+  const void* id;
+  const void* obj;
+  uint32_t arg;
+  uint16_t interf;
+  uint16_t index;
+  uint8_t type;
+  uint8_t subtype;
+  uint8_t event;
+  uint8_t has_hdr;
+  char phase;
+} trace_event_t;
+
+/** Ring of one thread.  Only that thread writes to it; head is the
+    number of events written so far, and is published after the event. */
+typedef struct trace_ring
+{
+  int tid;
+  size_t size;
+  uint64_t head;
+  trace_event_t* events;
+  struct trace_ring* next;
+} trace_ring_t;
+
+static const char* trace_names[] =
+  { "create", "push", "drop", "pop", "ProcessMessage", "encode", "write" };
+static const char* trace_objs[] =
+  { NULL, "queue", "queue", "queue", "driver", "client", "client" };
+static const char* trace_args[] =
+  { "size", "length", "length", "length", NULL, "bytes", "bytes" };
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+// Rings are kept until the process exits, also those of threads that
+// are gone, so that their events can be written out
+static trace_ring_t* trace_rings = NULL;
+static size_t trace_size = 0;
+static int trace_threads = 0;
+
+static void
+trace_init_key(void)
+{
+  pthread_key_create(&trace_key, NULL);
+}
+
+// Ring of the calling thread, created on its first event
+static trace_ring_t*
+trace_get_ring(void)
+{
+  trace_ring_t* ring;
+
+  if ((ring = (trace_ring_t*)pthread_getspecific(trace_key)))
+    return ring;
+  if (!(ring = (trace_ring_t*)calloc(1, sizeof(trace_ring_t))))
+    return NULL;
+  pthread_mutex_lock(&trace_lock);
+  ring->size = trace_size;
+  ring->events = (trace_event_t*)calloc(ring->size, sizeof(trace_event_t));
+  if (!ring->events)
+  {
+    pthread_mutex_unlock(&trace_lock);
+    free(ring);
+    return NULL;
+  }
+  ring->tid = ++trace_threads;
+  ring->next = trace_rings;
+  trace_rings = ring;
+  pthread_mutex_unlock(&trace_lock);
+  pthread_setspecific(trace_key, ring);
+  return ring;
+}
+
+int
+player_trace_start(size_t events)
+{
+  size_t size;
+
+  pthread_once(&trace_once, trace_init_key);
+  // Rings are indexed with a mask; threads that already have one keep it
+  for (size = 1; size < events; size <<= 1)
+    ;
+  pthread_mutex_lock(&trace_lock);
+  trace_size = size;
+  pthread_mutex_unlock(&trace_lock);
+  player_trace_on = 1;
+  return 0;
+}
+
+void
+player_trace_record(int event, char phase, const void* id, const void* obj,
+                    const player_msghdr_t* hdr, uint32_t arg)
+{
+  trace_ring_t* ring;
+  trace_event_t* e;
+  struct timespec ts;
+  uint64_t head;
+
+  if (!(ring = trace_get_ring()))
+    return;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  head = ring->head;
+  e = ring->events + (head & (ring->size - 1));
+  e->ts = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  e->id = id;
+  e->obj = obj;
+  e->arg = arg;
+  e->event = (uint8_t)event;
+  e->phase = phase;
+  if ((e->has_hdr = (hdr != NULL)))
+  {
+    e->interf = hdr->addr.interf;
+    e->index = hdr->addr.index;
+    e->type = hdr->type;
+    e->subtype = hdr->subtype;
+  }
+  TRACE_STORE(ring->head, head + 1);
+}
+
+// Write one event as a JSON object, after an earlier one
+static void
+trace_write_event(FILE* fp, const trace_event_t* e, int pid, int tid)
+{
+  char name[64];
+
+  // Ends of spans only carry the result; the rest is on the beginning
+  if (e->phase == PLAYER_TRACE_END)
+  {
+    fprintf(fp, ",\n{\"ph\":\"E\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+            pid, tid, e->ts / 1e3);
+    if (trace_args[e->event])
+      fprintf(fp, ",\"args\":{\"%s\":%u}", trace_args[e->event], e->arg);
+    fprintf(fp, "}");
+    return;
+  }
+  if (e->has_hdr && (e->event != PLAYER_TRACE_PUSH) &&
+      (e->event != PLAYER_TRACE_POP))
+    snprintf(name, sizeof(name), "%s %s:%u", trace_names[e->event],
+             interf_to_str(e->interf), e->index);
+  else
+    snprintf(name, sizeof(name), "%s", trace_names[e->event]);
+  fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"message\",\"ph\":\"%c\",%s"
+          "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{",
+          name, e->phase,
+          (e->phase == PLAYER_TRACE_INSTANT) ? "\"s\":\"t\"," : "",
+          pid, tid, e->ts / 1e3);
+  fprintf(fp, "\"msg\":\"%p\"", e->id);
+  if (trace_objs[e->event])
+    fprintf(fp, ",\"%s\":\"%p\"", trace_objs[e->event], e->obj);
+  if (e->has_hdr)
+    fprintf(fp, ",\"device\":\"%s:%u\",\"type\":\"%s\",\"subtype\":%u",
+            interf_to_str(e->interf), e->index, msgtype_to_str(e->type),
+            e->subtype);
+  if (trace_args[e->event] && (e->phase == PLAYER_TRACE_INSTANT))
+    fprintf(fp, ",\"%s\":%u", trace_args[e->event], e->arg);
+  fprintf(fp, "}}");
+}
+
+int
+player_trace_write(const char* filename)
+{
+  trace_ring_t* ring;
+  trace_event_t* copy;
+  uint64_t head, first, i;
+  bool empty = true;
+  int pid, depth;
+  FILE* fp;
+
+  if (!(fp = fopen(filename, "w")))
+  {
+    PLAYER_ERROR2("failed to open trace file %s: %s", filename, strerror(errno));
+    return -1;
+  }
+#if defined (WIN32)
+  pid = 0;
+#else
+  pid = getpid();
+#endif
+  fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+  pthread_mutex_lock(&trace_lock);
+  for (ring = trace_rings; ring; ring = ring->next)
+  {
+    if (!(copy = (trace_event_t*)malloc(ring->size * sizeof(trace_event_t))))
+      continue;
+    head = TRACE_LOAD(ring->head);
+    first = (head > ring->size) ? head - ring->size : 0;
+    for (i = first; i < head; i++)
+      copy[i & (ring->size - 1)] = ring->events[i & (ring->size - 1)];
+    // Leave out what the thread may have overwritten while we copied
+    TRACE_FENCE();
+    i = TRACE_LOAD(ring->head);
+    if (i > ring->size && i - ring->size > first)
+      first = i - ring->size;
+
+    fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+            empty ? "" : ",", pid, ring->tid, ring->tid);
+    empty = false;
+    // The ring may begin in the middle of spans, whose ends are dropped
+    depth = 0;
+    for (i = first; i < head; i++)
+    {
+      trace_event_t* e = copy + (i & (ring->size - 1));
+      if (e->phase == PLAYER_TRACE_BEGIN)
+        depth++;
+      else if (e->phase == PLAYER_TRACE_END)
+      {
+        if (depth == 0)
+          continue;
+        depth--;
+      }
+      trace_write_event(fp, e, pid, ring->tid);
+    }
+    free(copy);
+  }
+  pthread_mutex_unlock(&trace_lock);
+
+  fprintf(fp, "\n]}\n");
+  if (fclose(fp) != 0)
+  {
+    PLAYER_ERROR2("failed to write trace file %s: %s", filename, strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+#else
+
+int
+player_trace_start(size_t events)
+{
+  PLAYER_WARN("message tracing was not compiled in (see the ENABLE_TRACE option)");
+  return -1;
+}
+
+void
+player_trace_record(int event, char phase, const void* id, const void* obj,
+                    const player_msghdr_t* hdr, uint32_t arg)
+{
+}
+
+int
+player_trace_write(const char* filename)
+{
+  PLAYER_WARN("message tracing was not compiled in (see the ENABLE_TRACE option)");
+  return -1;
+}
+
+#endif
+
+void
+player_trace_stop(void)
+{
+  player_trace_on = 0;
+}
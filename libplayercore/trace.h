@@ -0,0 +1,139 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *                      
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/*
+ * Message tracing
+ */
+#ifndef _PLAYERTRACE_H
+#define _PLAYERTRACE_H
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERCORE_EXPORT
+  #elif defined (playercore_EXPORTS)
+    #define PLAYERCORE_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERCORE_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERCORE_EXPORT
+#endif
+
+#include <stddef.h>
+#include <libplayerinterface/player.h>
+#include <playerconfig.h>
+
+/** @brief Message tracing
+
+When the library is built with the ENABLE_TRACE CMake option (the
+default), the path of messages through the server can be recorded and
+written out in the Chrome trace event format, which chrome://tracing and
+the Perfetto UI (https://ui.perfetto.dev) open.  Tracing is off until
+player_trace_start() is called, e.g. by the server's -t option; until
+then each trace point costs a test of a global flag.
+
+Every thread records into a ring of its own, without locks, and keeps
+only the most recent events when the ring wraps around.  The events are:
+
+- create: a message is created (Message)
+- push, drop, pop: a message is put on, discarded by or taken off a
+  queue (MessageQueue)
+- ProcessMessage: span of a driver's ProcessMessage() call
+  (Driver::ProcessMessages())
+- encode, write: spans of the encoding of a message for a client and of
+  its write to the socket or shared memory ring (PlayerTCP::WriteClient())
+
+Each event carries the reference count address of its message, which is
+shared by every copy of a message, including those forwarded without a
+copy of the payload; searching the trace for it shows one message from
+its creation to its delivery. */
+
+/** Trace events, see PLAYER_TRACE() */
+#define PLAYER_TRACE_CREATE   0
+#define PLAYER_TRACE_PUSH     1
+#define PLAYER_TRACE_DROP     2
+#define PLAYER_TRACE_POP      3
+#define PLAYER_TRACE_PROCESS  4
+#define PLAYER_TRACE_ENCODE   5
+#define PLAYER_TRACE_WRITE    6
+
+/** Phases of a trace event: an instant, or the beginning or end of a span */
+#define PLAYER_TRACE_INSTANT  'i'
+#define PLAYER_TRACE_BEGIN    'B'
+#define PLAYER_TRACE_END      'E'
+
+/** Default number of events kept per thread */
+#define PLAYER_TRACE_DEFAULT_EVENTS 65536
+
+/** Non-zero while events are recorded; read it through PLAYER_TRACE() */
+PLAYERCORE_EXPORT extern volatile int player_trace_on;
+
+/** Start recording, keeping the last @p events events of each thread.
+    @return 0 on success, -1 if tracing is not compiled in */
+PLAYERCORE_EXPORT int player_trace_start(size_t events);
+
+/** Stop recording; what was recorded is kept */
+PLAYERCORE_EXPORT void player_trace_stop(void);
+
+/** Record an event; use PLAYER_TRACE() instead.  @p id identifies the
+    message, @p obj the queue, driver or client concerned, @p hdr (may be
+    NULL) the message's header and @p arg is a length or byte count. */
+PLAYERCORE_EXPORT void player_trace_record(int event, char phase,
+                                           const void* id, const void* obj,
+                                           const player_msghdr_t* hdr,
+                                           uint32_t arg);
+
+/** Write the recorded events to @p filename as Chrome trace JSON.
+    Safe to call while recording; events overwritten during the copy are
+    left out.
+    @return 0 on success, -1 otherwise */
+PLAYERCORE_EXPORT int player_trace_write(const char* filename);
+
+/** Record a trace event if tracing is compiled in and turned on */
+#if defined (ENABLE_TRACE)
+  #define PLAYER_TRACE(event, phase, id, obj, hdr, arg) \
+    do { \
+      if (player_trace_on) \
+        player_trace_record(event, phase, id, obj, hdr, arg); \
+    } while (0)
+#else
+  #define PLAYER_TRACE(event, phase, id, obj, hdr, arg) do { } while (0)
+#endif
+
+#endif
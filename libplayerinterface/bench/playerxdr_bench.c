@@ -0,0 +1,446 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2005 -
+ *     Brian Gerkey
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/** @ingroup utils */
+/** @{ */
+/** @defgroup util_playerxdr_bench playerxdr_bench
+ @brief Microbenchmarks for the generated XDR functions
+
+@par Synopsis
+
+@b playerxdr_bench measures the functions that playerxdrgen.py generates
+for every message of every interface in libplayerinterface/interfaces.
+For each message a payload is filled with pseudo-random values, with
+dynamic arrays of a representative length, and the following operations
+are timed through the function table, as the server and the client
+libraries call them:
+
+- pack: XDR encoding into a buffer
+- unpack: XDR decoding from that buffer, including the allocation of
+  the dynamic arrays
+- clone: deep copy into a newly allocated structure
+- free: release of a clone and its dynamic arrays
+
+Every decoded message is encoded again and compared with the first
+encoding, so the benchmark also checks that pack and unpack agree.
+
+@par Usage
+
+@verbatim
+playerxdr_bench [options] [filter]
+@endverbatim
+
+Where [options] can be:
+- -e \<elements\> : length of dynamic arrays of non-byte types (default: 1081)
+- -b \<bytes\> : length of dynamic byte arrays, such as images (default: 230400)
+- -t \<ms\> : minimum measurement time per operation (default: 20)
+- -j : print one JSON object per message instead of a table
+- -r : measure the raw (native layout) encoding instead of XDR; see
+  @ref rawencoding
+- -c : check the encoding of every message instead of timing it (see
+  below)
+
+Only messages whose name (interface:type:subtype, e.g. ranger:data:range)
+contains [filter] are measured.  Arrays inside the elements of an array
+are limited to 16 elements or 256 bytes, so that nested messages stay
+a sensible size.
+
+@par Output
+
+For each message, the size of the XDR encoding and of the structure with
+its dynamic data, then ns/msg and GB/s for each operation.  GB/s is
+computed over the encoded size for pack and unpack and over the
+structure size for clone and free.  The exit status is non-zero if a
+message could not be packed or did not survive the round trip.
+
+@par Checks
+
+With -c nothing is timed.  Besides the round trip, each message is
+filled a second time into memory that starts out as garbage, as a
+decoded or cloned message does, and must encode to the same bytes: the
+raw encoding has to clear padding, pointers and unused array elements.
+The XDR encoding is also compared with the one written through a stdio
+stream, which goes through xdr_u_int() for every word instead of the
+bulk byte-swapping of xdr_bulk.c.  The build registers these checks as
+tests, with odd array lengths as well as the defaults.
+
+@verbatim
+message                                     wire       mem |    pack ns   GB/s |  unpack ns   GB/s | ...
+ranger:data:range                           8656      8652 |     5850.4   1.48 |     8040.2   1.08 | ...
+@endverbatim
+*/
+/** @} */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libplayerinterface/player.h>
+#include <libplayerinterface/playerxdr.h>
+#include <libplayerinterface/functiontable.h>
+
+/* Decoded or cloned messages in one timed batch */
+#define BENCH_BATCH 32
+/* Upper bound on the memory used by one batch */
+#define BENCH_BATCH_BYTES (16*1024*1024)
+
+#define BENCH_MIN(a,b) ((unsigned int)(a) < (unsigned int)(b) ? (unsigned int)(a) : (unsigned int)(b))
+#define BENCH_INNER(n) BENCH_MIN(n, 16)
+#define BENCH_INNER_BYTES(n) BENCH_MIN(n, 256)
+#define BENCH_REAL(seed) ((double)(bench_rand(seed) % 20000) / 1000.0 - 10.0)
+
+typedef void (*bench_fill_fn_t)(void* msg, unsigned int n, unsigned int nbytes,
+                                unsigned int* seed);
+typedef int (*bench_xdr_fn_t)(XDR* xdrs, void* msg);
+
+typedef struct
+{
+  const char* name;
+  uint16_t interf;
+  uint8_t type;
+  uint8_t subtype;
+  size_t size;
+  bench_fill_fn_t fill;
+  bench_xdr_fn_t xdr;
+} bench_msg_t;
+
+/* Byte that new messages and their dynamic arrays are filled with before
+   their members are set */
+static int bench_fill_byte = 0;
+
+static void*
+bench_alloc(size_t count, size_t size)
+{
+  void* p = malloc(count * size);
+  if(p)
+    memset(p, bench_fill_byte, count * size);
+  return p;
+}
+
+static unsigned int
+bench_rand(unsigned int* seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+#include "playerxdr_bench_gen.h"
+
+static double
+bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef struct
+{
+  double ns;
+  double gbps;
+} bench_result_t;
+
+static void
+bench_result(bench_result_t* r, double ns, unsigned long ops, size_t bytes)
+{
+  r->ns = ns / ops;
+  r->gbps = r->ns > 0 ? bytes / r->ns : 0;
+}
+
+/* The checks of -c, on a message whose encoding (wire bytes at buf) has
+   already survived the round trip.  Returns 0 if they pass. */
+static int
+bench_check(const bench_msg_t* b, player_pack_fn_t pack, player_free_fn_t freefn,
+            int raw, void* msg, const char* buf, int wire, size_t bufsize,
+            unsigned int elements, unsigned int nbytes)
+{
+  unsigned int seed = 1;
+  void* dirty;
+  char* buf2;
+  FILE* f;
+  XDR xdrs;
+  int len, ret = 0;
+
+  buf2 = malloc(bufsize);
+
+  /* Same message, built over garbage */
+  bench_fill_byte = 0xa5;
+  dirty = bench_alloc(1, b->size);
+  b->fill(dirty, elements, nbytes, &seed);
+  bench_fill_byte = 0;
+  if((len = pack(buf2, bufsize, dirty, PLAYERXDR_ENCODE)) != wire ||
+     memcmp(buf, buf2, wire) != 0)
+  {
+    fprintf(stderr, "%s: encoding depends on uninitialised memory\n", b->name);
+    ret = -1;
+  }
+  freefn(dirty);
+
+  /* Same message, one word at a time */
+  if(!raw)
+  {
+    f = tmpfile();
+    xdrstdio_create(&xdrs, f, XDR_ENCODE);
+    len = b->xdr(&xdrs, msg) == 1 ? (int)xdr_getpos(&xdrs) : -1;
+    xdr_destroy(&xdrs);
+    rewind(f);
+    if(len != wire || fread(buf2, 1, len, f) != (size_t)len ||
+       memcmp(buf, buf2, wire) != 0)
+    {
+      fprintf(stderr, "%s: encoding differs from the per-word XDR one\n", b->name);
+      ret = -1;
+    }
+    fclose(f);
+  }
+
+  free(buf2);
+  return ret;
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "USAGE: playerxdr_bench [-e elements] [-b bytes] [-t ms] [-j] [-r] [-c] [filter]\n");
+}
+
+int
+main(int argc, char** argv)
+{
+  unsigned int elements = 1081;
+  unsigned int nbytes = 230400;
+  double mintime = 20e6;
+  int json = 0;
+  int raw = 0;
+  int check = 0;
+  const char* filter = NULL;
+  const bench_msg_t* b;
+  int ch, failed = 0, count = 0;
+
+  while((ch = getopt(argc, argv, "e:b:t:jrch")) != -1)
+  {
+    switch(ch)
+    {
+      case 'e':
+        elements = atoi(optarg);
+        break;
+      case 'b':
+        nbytes = atoi(optarg);
+        break;
+      case 't':
+        mintime = atof(optarg) * 1e6;
+        break;
+      case 'j':
+        json = 1;
+        break;
+      case 'r':
+        raw = 1;
+        break;
+      case 'c':
+        check = 1;
+        break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+  if(optind < argc)
+    filter = argv[optind];
+
+  playerxdr_ftable_init();
+
+  if(!json && !check)
+    printf("%-38s %9s %9s | %10s %6s | %10s %6s | %10s %6s | %10s %6s\n",
+           "message", "wire", "mem", "pack ns", "GB/s", "unpack ns", "GB/s",
+           "clone ns", "GB/s", "free ns", "GB/s");
+
+  for(b = bench_msgs; b->name; b++)
+  {
+    player_pack_fn_t pack;
+    player_clone_fn_t clone;
+    player_free_fn_t freefn;
+    player_cleanup_fn_t cleanup;
+    player_sizeof_fn_t sizeoffn;
+    bench_result_t rpack, runpack, rclone, rfree;
+    unsigned int seed = 1;
+    unsigned long ops;
+    char *buf, *buf2;
+    void* msg;
+    void* out[BENCH_BATCH];
+    size_t bufsize, mem;
+    int wire, wire2, batch, i;
+    double t, t0, tfree;
+
+    if(filter && !strstr(b->name, filter))
+      continue;
+    count++;
+
+    if(raw)
+      pack = playerxdr_get_rawpackfunc(b->interf, b->type, b->subtype);
+    else
+      pack = playerxdr_get_packfunc(b->interf, b->type, b->subtype);
+    clone = playerxdr_get_clonefunc(b->interf, b->type, b->subtype);
+    freefn = playerxdr_get_freefunc(b->interf, b->type, b->subtype);
+    cleanup = playerxdr_get_cleanupfunc(b->interf, b->type, b->subtype);
+    sizeoffn = playerxdr_get_sizeoffunc(b->interf, b->type, b->subtype);
+    if(!pack || !clone || !freefn || !cleanup || !sizeoffn)
+    {
+      fprintf(stderr, "%s: not in the function table\n", b->name);
+      failed = 1;
+      continue;
+    }
+
+    msg = bench_alloc(1, b->size);
+    b->fill(msg, elements, nbytes, &seed);
+    mem = sizeoffn(msg);
+
+    /* XDR widens every element to at least 4 bytes */
+    bufsize = 8 * mem + 65536;
+    buf = malloc(bufsize);
+    buf2 = malloc(bufsize);
+    if((wire = pack(buf, bufsize, msg, PLAYERXDR_ENCODE)) < 0)
+    {
+      fprintf(stderr, "%s: failed to pack\n", b->name);
+      failed = 1;
+      goto next;
+    }
+
+    batch = BENCH_BATCH_BYTES / (mem + 1);
+    if(batch > BENCH_BATCH)
+      batch = BENCH_BATCH;
+    else if(batch < 1)
+      batch = 1;
+    for(i = 0; i < batch; i++)
+      out[i] = calloc(1, b->size);
+
+    /* Round trip */
+    if(pack(buf, wire, out[0], PLAYERXDR_DECODE) < 0 ||
+       (wire2 = pack(buf2, bufsize, out[0], PLAYERXDR_ENCODE)) != wire ||
+       memcmp(buf, buf2, wire) != 0)
+    {
+      fprintf(stderr, "%s: round trip does not match\n", b->name);
+      failed = 1;
+    }
+    cleanup(out[0]);
+
+    if(check)
+    {
+      if(bench_check(b, pack, freefn, raw, msg, buf, wire, bufsize,
+                     elements, nbytes) != 0)
+        failed = 1;
+      for(i = 0; i < batch; i++)
+        free(out[i]);
+      goto next;
+    }
+
+    /* pack */
+    ops = 0;
+    t0 = bench_now();
+    do
+    {
+      for(i = 0; i < BENCH_BATCH; i++)
+        pack(buf2, bufsize, msg, PLAYERXDR_ENCODE);
+      ops += BENCH_BATCH;
+    } while((t = bench_now() - t0) < mintime);
+    bench_result(&rpack, t, ops, wire);
+
+    /* unpack; the decoded arrays are released outside the timed part */
+    ops = 0;
+    t = 0;
+    do
+    {
+      t0 = bench_now();
+      for(i = 0; i < batch; i++)
+        pack(buf, wire, out[i], PLAYERXDR_DECODE);
+      t += bench_now() - t0;
+      for(i = 0; i < batch; i++)
+        cleanup(out[i]);
+      ops += batch;
+    } while(t < mintime);
+    bench_result(&runpack, t, ops, wire);
+    for(i = 0; i < batch; i++)
+      free(out[i]);
+
+    /* clone and free */
+    ops = 0;
+    t = 0;
+    tfree = 0;
+    do
+    {
+      t0 = bench_now();
+      for(i = 0; i < batch; i++)
+        out[i] = clone(msg);
+      t += bench_now() - t0;
+      t0 = bench_now();
+      for(i = 0; i < batch; i++)
+        freefn(out[i]);
+      tfree += bench_now() - t0;
+      ops += batch;
+    } while(t < mintime);
+    bench_result(&rclone, t, ops, mem);
+    bench_result(&rfree, tfree, ops, mem);
+
+    if(json)
+      printf("{\"message\":\"%s\",\"wire_bytes\":%d,\"mem_bytes\":%lu,"
+             "\"pack_ns\":%.1f,\"pack_gbps\":%.3f,\"unpack_ns\":%.1f,\"unpack_gbps\":%.3f,"
+             "\"clone_ns\":%.1f,\"clone_gbps\":%.3f,\"free_ns\":%.1f,\"free_gbps\":%.3f}\n",
+             b->name, wire, (unsigned long)mem, rpack.ns, rpack.gbps,
+             runpack.ns, runpack.gbps, rclone.ns, rclone.gbps, rfree.ns, rfree.gbps);
+    else
+      printf("%-38s %9d %9lu | %10.1f %6.2f | %10.1f %6.2f | %10.1f %6.2f | %10.1f %6.2f\n",
+             b->name, wire, (unsigned long)mem, rpack.ns, rpack.gbps,
+             runpack.ns, runpack.gbps, rclone.ns, rclone.gbps, rfree.ns, rfree.gbps);
+    fflush(stdout);
+
+next:
+    free(buf);
+    free(buf2);
+    freefn(msg);
+  }
+
+  if(count == 0)
+  {
+    fprintf(stderr, "no message matches \"%s\"\n", filter ? filter : "");
+    return 1;
+  }
+  if(check)
+    printf("%d messages checked%s\n", count, failed ? ", some failed" : "");
+  return failed;
+}
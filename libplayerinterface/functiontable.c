@@ -320,6 +320,31 @@ playerxdr_get_sizeoffunc(uint16_t interf, uint8_t type, uint8_t subtype)
   return(NULL);
 }
 
+player_pack_fn_t
+playerxdr_get_rawpackfunc(uint16_t interf, uint8_t type, uint8_t subtype)
+{
+  playerxdr_function_t* row=NULL;
+
+  if ((row = playerxdr_get_ftrow (interf, type, subtype)) != NULL)
+    return(row->rawpackfunc);
+
+  return(NULL);
+}
+
+player_pack_fn_t
+playerxdr_get_encodefunc(uint16_t interf, uint8_t type, uint8_t subtype,
+                         int encoding)
+{
+  playerxdr_function_t* row=NULL;
+
+  if ((row = playerxdr_get_ftrow (interf, type, subtype)) == NULL)
+    return(NULL);
+  // Types without a raw function (e.g. from plugins) stay XDR-encoded
+  if (encoding == PLAYER_ENCODING_RAW && row->rawpackfunc)
+    return(row->rawpackfunc);
+  return(row->packfunc);
+}
+
 // Deep copy a message structure
 unsigned int
 playerxdr_deepcopy_message(void* src, void* dest, uint16_t interf, uint8_t type, uint8_t subtype)
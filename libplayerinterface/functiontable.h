@@ -99,6 +99,9 @@ typedef struct
   player_clone_fn_t clonefunc;
   player_free_fn_t freefunc;
   player_sizeof_fn_t sizeoffunc;
+  /** Raw (native layout) packing function, NULL if there is none; see
+      @ref rawencoding */
+  player_pack_fn_t rawpackfunc;
 } playerxdr_function_t;
 
 /** @brief Look up the XDR packing function for a given message signature.
@@ -128,6 +131,27 @@ PLAYERXDR_EXPORT player_free_fn_t playerxdr_get_freefunc(uint16_t interf, uint8_
 PLAYERXDR_EXPORT player_sizeof_fn_t playerxdr_get_sizeoffunc(uint16_t interf, uint8_t type,
                                     uint8_t subtype);
 
+/** @brief Look up the raw (native layout) packing function for a given
+ * message signature.
+ *
+ * @returns A pointer to the function, or NULL if there is none; only the
+ * built-in message types have one.
+ */
+PLAYERXDR_EXPORT player_pack_fn_t playerxdr_get_rawpackfunc(uint16_t interf, uint8_t type,
+                                    uint8_t subtype);
+
+/** @brief Look up the function that encodes a given message signature in
+ * a given wire encoding.
+ *
+ * @param encoding : PLAYER_ENCODING_XDR or PLAYER_ENCODING_RAW
+ *
+ * @returns The raw packing function if @p encoding is PLAYER_ENCODING_RAW
+ * and the type has one, the XDR packing function otherwise, or NULL if the
+ * message signature is unknown.
+ */
+PLAYERXDR_EXPORT player_pack_fn_t playerxdr_get_encodefunc(uint16_t interf, uint8_t type,
+                                    uint8_t subtype, int encoding);
+
 /** @brief Add an entry to the function table.
  *
  * @param f : the message signature and function to add
@@ -0,0 +1,168 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+#/*
+# *  Player - One Hell of a Robot Server
+# *  Copyright (C) 2007
+# *     Toby Collett
+# *
+# *
+# *  This library is free software; you can redistribute it and/or
+# *  modify it under the terms of the GNU Lesser General Public
+# *  License as published by the Free Software Foundation; either
+# *  version 2.1 of the License, or (at your option) any later version.
+# *
+# *  This library is distributed in the hope that it will be useful,
+# *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+# *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# *  Lesser General Public License for more details.
+# *
+# *  You should have received a copy of the GNU Lesser General Public
+# *  License along with this library; if not, write to the Free Software
+# *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+# */
+
+# Generates the payload fillers and the message table used by
+# playerxdr_bench.  For every struct parsed by playerxdrgen a
+# bench_fill_<type> function is written that fills scalars and fixed
+# arrays with pseudo-random values and allocates dynamic arrays with
+# bench_alloc(); for every message declared in the interface definitions
+# an entry, with its fill and XDR functions, is added to bench_msgs[].
+
+from __future__ import print_function
+
+import glob
+import os
+import re
+import sys
+
+import playerxdrgen
+from playerinterfacegen import get_interface
+
+USAGE = 'USAGE: playerxdrbenchgen.py <output.h> <interface dir> <interface-spec.h> [<interface-spec.h> ...]'
+
+REAL_TYPES = ['float', 'double']
+BYTE_TYPES = ['char', 'int8_t', 'uint8_t']
+
+
+def value(typename):
+  if typename in REAL_TYPES:
+    return '(%s)BENCH_REAL(seed)' % typename
+  elif typename == 'bool_t':
+    return '(bool_t)(bench_rand(seed) & 1)'
+  else:
+    return '(%s)bench_rand(seed)' % typename
+
+
+def is_struct(typename):
+  return typename.startswith('player_')
+
+
+def gen_fill(out, datatype):
+  names = datatype.GetVarNames()
+  countvars = []
+  for member in datatype.members:
+    for var in member.variables:
+      if var.array and var.countvar in names:
+        countvars.append(var.countvar)
+
+  out.write("""
+void
+bench_fill_%(t)s(%(t)s* msg, unsigned int n, unsigned int nbytes, unsigned int* seed)
+{
+  unsigned int ii;
+  (void)n; (void)nbytes; (void)ii;
+""" % {'t': datatype.typename})
+
+  for member in datatype.members:
+    t = member.typename
+    if t in BYTE_TYPES:
+      limit = 'nbytes'
+    else:
+      limit = 'n'
+    for var in member.variables:
+      if var.Name in countvars:
+        continue
+      subs = {'name': var.Name, 'count': var.countvar, 'type': t,
+              'size': var.arraysize, 'limit': limit}
+      if is_struct(t) and var.array:
+        # elements of an array get smaller arrays of their own
+        subs['fill'] = ('bench_fill_%s(&msg->%s%%s, BENCH_INNER(n), '
+                        'BENCH_INNER_BYTES(nbytes), seed);' % (t, var.Name))
+      elif is_struct(t):
+        subs['fill'] = ('bench_fill_%s(&msg->%s%%s, n, nbytes, seed);' %
+                        (t, var.Name))
+      else:
+        subs['fill'] = 'msg->%s%%s = %s;' % (var.Name, value(t))
+
+      if not var.array:
+        out.write('  ' + subs['fill'] % '' + '\n')
+        continue
+
+      if var.pointer:
+        out.write("""  msg->%(count)s = %(limit)s;
+  msg->%(name)s = bench_alloc(%(limit)s ? %(limit)s : 1, sizeof(%(type)s));
+  if(msg->%(name)s == NULL)
+    msg->%(count)s = 0;
+""" % subs)
+        bound = 'msg->%s' % var.countvar
+      elif var.countvar in names:
+        out.write('  msg->%(count)s = BENCH_MIN(%(size)s, %(limit)s);\n' % subs)
+        bound = 'msg->%s' % var.countvar
+      else:
+        bound = var.arraysize
+      out.write('  for(ii = 0; ii < %s; ii++)\n    %s\n' %
+                (bound, subs['fill'] % '[ii]'))
+
+  out.write('}\n')
+
+
+def gen_table(out, interface_dirs):
+  msgpattern = re.compile('message\s*{\s*(?P<type>\w*)\s*,\s*(?P<subtype>\w*)\s*,\s*(?P<subtypecode>\w*)\s*,\s*(?P<datatype>\w*)\s*}\s*;')
+  out.write('\nstatic const bench_msg_t bench_msgs[] =\n{\n')
+  for d in interface_dirs:
+    files = glob.glob(os.path.join(d, '*.def'))
+    files.sort()
+    for f in files:
+      code, name = get_interface(f)
+      data = open(f, 'r').read()
+      for m in msgpattern.finditer(data):
+        if m.group('datatype') == 'NULL':
+          continue
+        out.write('  {"%(i)s:%(tl)s:%(sl)s", PLAYER_%(I)s_CODE, PLAYER_MSGTYPE_%(T)s, '
+                  'PLAYER_%(I)s_%(T)s_%(S)s,\n    sizeof(%(d)s), '
+                  '(bench_fill_fn_t)bench_fill_%(d)s, (bench_xdr_fn_t)xdr_%(d)s},\n' %
+                  {'i': name, 'I': name.upper(),
+                   'tl': m.group('type').lower(), 'T': m.group('type').upper(),
+                   'sl': m.group('subtype').lower(), 'S': m.group('subtype').upper(),
+                   'd': m.group('datatype')})
+  out.write('  {NULL, 0, 0, 0, 0, NULL, NULL}\n};\n')
+
+
+if __name__ == '__main__':
+  if len(sys.argv) < 4:
+    print(USAGE)
+    sys.exit(-1)
+
+  outfilename = sys.argv[1]
+  interface_dir = sys.argv[2]
+  instream = ''
+  for f in sys.argv[3:]:
+    infile = open(f, 'r')
+    instream += infile.read()
+    infile.close()
+
+  out = open(outfilename, 'w+')
+  out.write('/* START OF AUTOGENERATED CODE */\n')
+  out.write('/* This file was automatically generated by playerxdrbenchgen.py */\n')
+
+  datatypes = [playerxdrgen.DataType(s) for s in playerxdrgen.find_structs(instream)]
+  for d in datatypes:
+    out.write('void bench_fill_%(t)s(%(t)s* msg, unsigned int n, '
+              'unsigned int nbytes, unsigned int* seed);\n' % {'t': d.typename})
+  for d in datatypes:
+    gen_fill(out, d)
+  gen_table(out, [interface_dir])
+
+  out.write('/* END OF AUTOGENERATED CODE */\n')
+  out.close()
@@ -12,6 +12,7 @@ import string
 import sys
 import os
 import os.path
+import zlib
 
 USAGE = 'USAGE: playerxdrgen.y [-distro] <interface-spec.h> [<extra_interface-spec.h>] <pack.c> <pack.h>'
 
@@ -23,6 +24,9 @@ hasdynamic = []    # A list of types that contain dynamic data. During pass 1,
                     # other types, necessary deep copy/clean up functions can
                     # be created and called.
 
+structtypes = []   # Every structure type seen so far, so that the raw encoding
+                    # can recurse into members of those types.
+
 class DataTypeMember:
   arraypattern = re.compile('\[(.*?)\]')
   pointerpattern = re.compile('\*')
@@ -111,6 +115,7 @@ class DataType:
       
     if self.dynamic:
       hasdynamic.append (self.typename)
+    structtypes.append (self.typename)
 
       
   def GetVarNames(self):
@@ -129,6 +134,13 @@ class DataType:
     return False
 
 
+# Primitive types whose arrays are (un)packed in one pass by the
+# playerxdr_bulk* functions rather than element by element
+bulkprocs = {'float' : 'playerxdr_bulk32',
+             'int32_t' : 'playerxdr_bulk32',
+             'uint32_t' : 'playerxdr_bulk32',
+             'double' : 'playerxdr_bulk64'}
+
 class MethodGenerator:
   def __init__(self,headerfile,sourcefile):
     self.headerfile = headerfile
@@ -191,6 +203,8 @@ int xdr_%(typename)s (XDR* xdrs, %(typename)s * msg)
               sourcefile.write('    ' + member.typename + '* ' + var.pointervar + ' = msg->' + var.Name + ';\n')
               sourcefile.write('    if(xdr_bytes(xdrs, (char**)&' + var.pointervar + ', &msg->' + var.countvar + ', msg->' + var.countvar + ') != 1)\n      return(0);\n')
               sourcefile.write('  }\n')
+            elif member.typename in bulkprocs:
+              self.gen_bulk_array(var, bulkprocs[member.typename], 'msg->' + var.countvar)
             else:
               sourcefile.write('  {\n')
               sourcefile.write('    ' + member.typename + '* ' + var.pointervar + ' = msg->' + var.Name + ';\n')
@@ -216,6 +230,8 @@ int xdr_%(typename)s (XDR* xdrs, %(typename)s * msg)
                                 ', &msg->' + var.countvar +
                                 ', ' + var.arraysize + ') != 1)\n      return(0);\n')
                 sourcefile.write('  }\n')
+              elif member.typename in bulkprocs:
+                self.gen_bulk_array(var, bulkprocs[member.typename], var.arraysize)
               else:
                 sourcefile.write('  {\n')
                 sourcefile.write('    ' + member.typename + '* ' + var.pointervar +
@@ -232,6 +248,9 @@ int xdr_%(typename)s (XDR* xdrs, %(typename)s * msg)
               if xdr_proc == 'xdr_u_char' or xdr_proc == 'xdr_char':
                 sourcefile.write('  if(xdr_opaque(xdrs, (char*)&msg->' +
                                   var.Name + ', ' + var.arraysize + ') != 1)\n    return(0);\n')
+              elif member.typename in bulkprocs:
+                sourcefile.write('  if(' + bulkprocs[member.typename] + '(xdrs, msg->' +
+                                  var.Name + ', ' + var.arraysize + ') != 1)\n    return(0);\n')
               else:
                 sourcefile.write('  if(xdr_vector(xdrs, (char*)&msg->' +
                                   var.Name + ', ' + var.arraysize +
@@ -244,6 +263,21 @@ int xdr_%(typename)s (XDR* xdrs, %(typename)s * msg)
     sourcefile.write('  return(1);\n}\n')
 
 
+  # Variable-length array of a primitive type: the length, checked
+  # against maxsize as xdr_array() does, then all the elements in one go.
+  def gen_bulk_array(self, var, bulkproc, maxsize):
+    self.sourcefile.write("""  {
+    u_int %(len)s = msg->%(count)s;
+    if(xdr_u_int(xdrs, &%(len)s) != 1 || %(len)s > %(max)s)
+      return(0);
+    msg->%(count)s = %(len)s;
+    if(%(proc)s(xdrs, msg->%(name)s, %(len)s) != 1)
+      return(0);
+  }
+""" % {"len" : var.Name + '_len', "count" : var.countvar, "max" : maxsize,
+       "proc" : bulkproc, "name" : var.Name})
+
+
   def gen_external_pack(self,datatype):
     self.headerfile.write("PLAYERXDR_EXPORT int %(prefix)s_pack(void* buf, size_t buflen, %(typename)s * msg, int op);\n" % {"typename":datatype.typename, "prefix":datatype.prefix})
 
@@ -266,6 +300,161 @@ int xdr_%(typename)s (XDR* xdrs, %(typename)s * msg)
 } """ % {"typename":datatype.typename, "prefix":datatype.prefix})
 
 
+  # Raw (native layout) encoding: the structure as it is in memory,
+  # followed by the contents of its dynamic arrays, each prefixed with its
+  # length in bytes.  Pointers, padding and the elements of fixed arrays
+  # beyond their count are cleared in the encoded copy of the structure,
+  # so that no stale memory goes on the wire; pointers are filled in
+  # again on decoding.
+  def gen_raw(self,datatype):
+    subs = {"typename":datatype.typename, "prefix":datatype.prefix}
+    self.headerfile.write("PLAYERXDR_EXPORT int %(prefix)s_rawpack(void* buf, size_t buflen, %(typename)s * msg, int op);\n" % subs)
+
+    self.gen_rawzero(datatype)
+    if datatype.typename in hasdynamic:
+      self.gen_raw_dynamic(datatype)
+      subs["dynamic"] = """
+  if(raw_%(typename)s(&r, msg) != 1)
+    return(-1);""" % subs
+    else:
+      subs["dynamic"] = ""
+
+    self.sourcefile.write("""
+int
+%(prefix)s_rawpack(void* buf, size_t buflen, %(typename)s * msg, int op)
+{
+  playerxdr_raw_t r;
+  if(!buflen)
+    return 0;
+  playerxdr_raw_create(&r, buf, buflen, op);
+  if(playerxdr_raw_bytes(&r, msg, sizeof(%(typename)s)) != 1)
+    return(-1);
+  rawzero_%(typename)s(op == PLAYERXDR_ENCODE ? (char*)buf : (char*)msg);%(dynamic)s
+  return(playerxdr_raw_finish(&r, sizeof(%(typename)s)));
+}""" % subs)
+
+
+  # Clears the pointers, the padding and the unused elements of counted
+  # fixed arrays of a structure at p, recursing into nested structures
+  def gen_rawzero(self,datatype):
+    t = datatype.typename
+    names = datatype.GetVarNames()
+    counttypes = {}
+    for member in datatype.members:
+      for var in member.variables:
+        counttypes[var.Name] = member.typename
+    zero = ""
+    prev = None
+    for member in datatype.members:
+      for var in member.variables:
+        vs = {"t" : t, "name" : var.Name, "count" : var.countvar,
+              "type" : member.typename, "size" : var.arraysize,
+              "prev" : prev}
+        if prev is not None:
+          zero += """
+  PLAYERXDR_RAW_PAD(p, %(t)s, %(prev)s, %(name)s);""" % vs
+        prev = var.Name
+        if var.pointer:
+          zero += """
+  memset(p + offsetof(%(t)s, %(name)s), 0, sizeof(void*));""" % vs
+        elif var.array and var.countvar in names:
+          vs["ctype"] = counttypes[var.countvar]
+          zero += """
+  memcpy(&%(name)s_count, p + offsetof(%(t)s, %(count)s), sizeof(%(name)s_count));
+  n = (size_t)%(name)s_count;
+  if(n > (%(size)s))
+    n = %(size)s;""" % vs
+          if member.typename in structtypes:
+            zero += """
+  for(ii = 0; ii < n; ii++)
+    rawzero_%(type)s(p + offsetof(%(t)s, %(name)s) + ii*sizeof(%(type)s));""" % vs
+          zero += """
+  memset(p + offsetof(%(t)s, %(name)s) + n*sizeof(%(type)s), 0,
+         ((%(size)s) - n)*sizeof(%(type)s));""" % vs
+        elif var.array and member.typename in structtypes:
+          zero += """
+  for(ii = 0; ii < %(size)s; ii++)
+    rawzero_%(type)s(p + offsetof(%(t)s, %(name)s) + ii*sizeof(%(type)s));""" % vs
+        elif member.typename in structtypes:
+          zero += """
+  rawzero_%(type)s(p + offsetof(%(t)s, %(name)s));""" % vs
+    if prev is not None:
+      zero += """
+  PLAYERXDR_RAW_TAIL(p, %(t)s, %(prev)s);""" % {"t" : t, "prev" : prev}
+
+    decl = ""
+    if "for(ii" in zero:
+      decl += "\n  unsigned ii;"
+    if "n = " in zero:
+      decl += "\n  size_t n;"
+    for member in datatype.members:
+      for var in member.variables:
+        if "&%s_count," % var.Name in zero:
+          decl += "\n  %s %s_count;" % (counttypes[var.countvar], var.Name)
+    self.sourcefile.write("""
+static void
+rawzero_%(typename)s(char* p)
+{%(decl)s%(zero)s
+}
+""" % {"typename" : t, "decl" : decl, "zero" : zero})
+
+
+  def gen_raw_dynamic(self,datatype):
+    names = datatype.GetVarNames()
+    subs = {"typename":datatype.typename}
+    body = ""
+    for member in datatype.members:
+      for var in member.variables:
+        vs = {"name" : var.Name, "count" : var.countvar, "type" : member.typename,
+              "size" : var.arraysize}
+        if var.pointer:
+          if member.typename in structtypes:
+            body += """
+  if(playerxdr_raw_array(r, (void**)&msg->%(name)s, msg->%(count)s, sizeof(%(type)s), &block) != 1)
+    return(0);
+  for(ii = 0; ii < msg->%(count)s; ii++)
+    rawzero_%(type)s(block + ii*sizeof(%(type)s));""" % vs
+            if member.dynamic:
+              body += """
+  for(ii = 0; ii < msg->%(count)s; ii++)
+    if(raw_%(type)s(r, &msg->%(name)s[ii]) != 1)
+      return(0);""" % vs
+          else:
+            body += """
+  if(playerxdr_raw_array(r, (void**)&msg->%(name)s, msg->%(count)s, sizeof(%(type)s), NULL) != 1)
+    return(0);""" % vs
+        elif member.dynamic and var.array:
+          if var.countvar in names:
+            body += """
+  if(msg->%(count)s > %(size)s)
+    return(0);
+  for(ii = 0; ii < msg->%(count)s; ii++)""" % vs
+          else:
+            body += """
+  for(ii = 0; ii < %(size)s; ii++)""" % vs
+          body += """
+    if(raw_%(type)s(r, &msg->%(name)s[ii]) != 1)
+      return(0);""" % vs
+        elif member.dynamic:
+          body += """
+  if(raw_%(type)s(r, &msg->%(name)s) != 1)
+    return(0);""" % vs
+
+    subs["body"] = body
+    subs["bodydecl"] = ""
+    if "for(ii" in body:
+      subs["bodydecl"] += "\n  unsigned ii;"
+    if "block" in body:
+      subs["bodydecl"] += "\n  char* block;"
+    self.sourcefile.write("""
+static int
+raw_%(typename)s(playerxdr_raw_t* r, %(typename)s * msg)
+{%(bodydecl)s%(body)s
+  return(1);
+}
+""" % subs)
+
+
   def gen_copy(self,datatype):
     # If type is not in hasdynamic, not going to write a function so may as well just continue with the next struct
     self.headerfile.write("PLAYERXDR_EXPORT unsigned int %(typename)s_copy(%(typename)s *dest, const %(typename)s *src);\n" % {"typename":datatype.typename, "prefix":datatype.prefix})
@@ -455,6 +644,32 @@ unsigned int %(typename)s_sizeof(%(typename)s *msg)
 }""")
   
     
+def strip_comments(instream):
+  """Return instream without comments and blank lines."""
+  # strip C++-style comments
+  pattern = re.compile('//.*')
+  instream = pattern.sub('', instream)
+
+  # strip C-style comments
+  pattern = re.compile('/\*.*?\*/', re.MULTILINE | re.DOTALL)
+  instream = pattern.sub('', instream)
+
+  # strip blank lines
+  pattern = re.compile('^\s*?\n', re.MULTILINE)
+  return pattern.sub('', instream)
+
+
+def find_structs(instream):
+  """Return the body of every player_* struct typedef in instream, with
+  comments and blank lines stripped."""
+  instream = strip_comments(instream)
+
+  # find structs
+  pattern = re.compile('typedef\s+struct\s+player_\w+[^}]+\}[^;]+',
+                   re.MULTILINE)
+  return pattern.findall(instream)
+
+
 if __name__ == '__main__':
 
   if len(sys.argv) < 4:
@@ -517,6 +732,8 @@ if __name__ == '__main__':
 
 #include <libplayerinterface/player.h>
 #include <libplayerinterface/functiontable.h>
+#include <libplayerinterface/xdr_bulk.h>
+#include <libplayerinterface/raw_encoding.h>
 #ifdef __cplusplus
   extern "C" {
 #endif
@@ -531,9 +748,14 @@ if __name__ == '__main__':
 
 #define PLAYERXDR_MSGHDR_SIZE 40
 #define PLAYERXDR_MAX_MESSAGE_SIZE (4*PLAYER_MAX_MESSAGE_SIZE)
-""")
+
+/* Checksum of the definitions the message structures were generated
+   from; part of playerxdr_raw_layout() */
+#define PLAYERXDR_RAW_DEFS 0x%(defs)08xu
+""" % {"defs" : zlib.crc32(' '.join(strip_comments(instream).split()).encode()) & 0xffffffff})
     sourcefile.write("""
 #include <%(headerfilename)s>
+#include <stddef.h>
 #include <string.h>
 
 #include <stdlib.h>
@@ -553,22 +775,7 @@ if __name__ == '__main__':
     sourcefile.write('#include <stdlib.h>\n\n')
 
 
-  # strip C++-style comments
-  pattern = re.compile('//.*')
-  instream = pattern.sub('', instream)
-
-  # strip C-style comments
-  pattern = re.compile('/\*.*?\*/', re.MULTILINE | re.DOTALL)
-  instream = pattern.sub('', instream)
-
-  # strip blank lines
-  pattern = re.compile('^\s*?\n', re.MULTILINE)
-  instream = pattern.sub('', instream)
-
-  # find structs
-  pattern = re.compile('typedef\s+struct\s+player_\w+[^}]+\}[^;]+',
-                   re.MULTILINE)
-  structs = pattern.findall(instream)
+  structs = find_structs(instream)
 
   print('Found ' + repr(len(structs)) + ' struct(s)')
   
@@ -589,6 +796,8 @@ if __name__ == '__main__':
     gen.gen_clone(current)
     gen.gen_free(current)    
     gen.gen_sizeof(current)    
+    if distro:
+      gen.gen_raw(current)
     sourcefile.write('\n')
     
   headerfile.write('\n#ifdef __cplusplus\n}\n#endif\n\n')
@@ -0,0 +1,142 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libplayerinterface/playerxdr.h"
+#include "raw_encoding.h"
+
+// Bump when the encoding itself changes
+#define PLAYERXDR_RAW_VERSION 1
+
+void
+playerxdr_raw_create(playerxdr_raw_t* r, void* buf, size_t len, int op)
+{
+  r->buf = (char*)buf;
+  r->len = len;
+  r->pos = 0;
+  r->op = op;
+}
+
+int
+playerxdr_raw_bytes(playerxdr_raw_t* r, void* data, size_t len)
+{
+  if(len > r->len - r->pos)
+    return(0);
+  if(r->op == PLAYERXDR_ENCODE)
+    memcpy(r->buf + r->pos, data, len);
+  else
+    memcpy(data, r->buf + r->pos, len);
+  r->pos += len;
+  return(1);
+}
+
+int
+playerxdr_raw_array(playerxdr_raw_t* r, void** data, unsigned int count,
+                    size_t size, char** block)
+{
+  uint32_t len;
+
+  if(size && count > UINT32_MAX / size)
+    return(0);
+  if(r->op == PLAYERXDR_ENCODE)
+  {
+    len = count * size;
+    if(len && *data == NULL)
+      return(0);
+    if(playerxdr_raw_bytes(r, &len, sizeof(len)) != 1 ||
+       len > r->len - r->pos)
+      return(0);
+    if(block)
+      *block = r->buf + r->pos;
+    memcpy(r->buf + r->pos, *data, len);
+  }
+  else
+  {
+    if(playerxdr_raw_bytes(r, &len, sizeof(len)) != 1 ||
+       len != count * size || len > r->len - r->pos)
+      return(0);
+    // allocated even when empty, as the XDR functions do
+    if((*data = malloc(len)) == NULL && len)
+      return(0);
+    if(len)
+      memcpy(*data, r->buf + r->pos, len);
+    if(block)
+      *block = (char*)*data;
+  }
+  r->pos += len;
+  return(1);
+}
+
+int
+playerxdr_raw_finish(playerxdr_raw_t* r, size_t decoded_size)
+{
+  if(r->op == PLAYERXDR_ENCODE)
+    return((int)r->pos);
+  if(r->pos != r->len)
+    return(-1);
+  return((int)decoded_size);
+}
+
+uint32_t
+playerxdr_raw_layout(void)
+{
+  struct { char c; double d; } align_double;
+  struct { char c; int64_t i; } align_int64;
+  struct { char c; float f; } align_float;
+  // Hashed in the machine's byte order, so that machines that differ
+  // only in byte order get different signatures
+  uint32_t props[] = {PLAYERXDR_RAW_DEFS,
+                      PLAYERXDR_RAW_VERSION,
+                      (uint32_t)sizeof(void*),
+                      (uint32_t)sizeof(long),
+                      (uint32_t)sizeof(bool_t),
+                      (uint32_t)((char*)&align_double.d - (char*)&align_double),
+                      (uint32_t)((char*)&align_int64.i - (char*)&align_int64),
+                      (uint32_t)((char*)&align_float.f - (char*)&align_float)};
+  const unsigned char* p = (const unsigned char*)props;
+  uint32_t hash = 2166136261u;
+  size_t ii;
+
+  // FNV-1a
+  for(ii = 0; ii < sizeof(props); ii++)
+    hash = (hash ^ p[ii]) * 16777619u;
+  return(hash);
+}
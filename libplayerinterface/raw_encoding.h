@@ -0,0 +1,147 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/** @ingroup libplayerinterface
+    @defgroup rawencoding Raw encoding
+
+Support for the native-layout ("raw") encoding of message bodies, the
+alternative to XDR that a client can ask for with
+@ref PLAYER_PLAYER_REQ_ENCODING.  A raw message body is the message
+structure as it is laid out in memory, with its pointers, its padding
+and the unused elements of its counted fixed-size arrays cleared,
+followed by the contents of each dynamic array in the order of the
+structure's members, each prefixed with its length in bytes as a
+native uint32_t.  Both ends must therefore agree on the layout of every
+structure, which they check by comparing playerxdr_raw_layout().
+
+playerxdrgen.py writes a <type>_rawpack() function, with the same
+signature and return values as <type>_pack(), for every built-in
+message structure; the functions below are the building blocks it uses.
+*/
+
+#ifndef _RAW_ENCODING_H
+#define _RAW_ENCODING_H
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERINTERFACE_EXPORT
+  #elif defined (playerinterface_EXPORTS)
+    #define PLAYERINTERFACE_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERINTERFACE_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERINTERFACE_EXPORT
+#endif
+
+#include <stddef.h>
+#include <playerconfig.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @ingroup rawencoding
+@{
+*/
+
+/// Offset of the first byte after member @p m of structure type @p t
+#define PLAYERXDR_RAW_END(t, m) (offsetof(t, m) + sizeof(((t*)0)->m))
+
+/// Clear the padding, if any, between members @p a and @p b of the
+/// structure of type @p t at @p p
+#define PLAYERXDR_RAW_PAD(p, t, a, b) \
+  memset((p) + PLAYERXDR_RAW_END(t, a), 0, offsetof(t, b) - PLAYERXDR_RAW_END(t, a))
+
+/// Clear the padding, if any, after the last member @p a of the
+/// structure of type @p t at @p p
+#define PLAYERXDR_RAW_TAIL(p, t, a) \
+  memset((p) + PLAYERXDR_RAW_END(t, a), 0, sizeof(t) - PLAYERXDR_RAW_END(t, a))
+
+/// A buffer being encoded into or decoded from
+typedef struct playerxdr_raw
+{
+  /// The buffer
+  char* buf;
+  /// Its length
+  size_t len;
+  /// Current position
+  size_t pos;
+  /// PLAYERXDR_ENCODE or PLAYERXDR_DECODE
+  int op;
+} playerxdr_raw_t;
+
+/// Start encoding into (@p op = PLAYERXDR_ENCODE) or decoding from
+/// (PLAYERXDR_DECODE) the @p len bytes at @p buf.
+PLAYERINTERFACE_EXPORT void playerxdr_raw_create(playerxdr_raw_t* r, void* buf, size_t len, int op);
+
+/// Copy @p len bytes from @p data into the buffer, or from the buffer
+/// into @p data.
+/// @return 1 on success, 0 if the buffer is too short
+PLAYERINTERFACE_EXPORT int playerxdr_raw_bytes(playerxdr_raw_t* r, void* data, size_t len);
+
+/// Encode or decode a dynamic array of @p count elements of @p size
+/// bytes.  On encoding the array at *@p data is written after its length;
+/// on decoding the length is checked against @p count and a new array is
+/// allocated into *@p data.  If @p block is not NULL it is set to the
+/// copy of the elements that was just written (on encoding) or to the new
+/// array (on decoding), so that the caller can fix up elements that have
+/// dynamic arrays of their own.
+/// @return 1 on success, 0 on failure
+PLAYERINTERFACE_EXPORT int playerxdr_raw_array(playerxdr_raw_t* r, void** data, unsigned int count,
+                                               size_t size, char** block);
+
+/// Finish encoding or decoding.
+/// @return the encoded length, or @p decoded_size when decoding, as the
+/// <type>_pack() functions do; -1 if a decoded buffer was not used up
+PLAYERINTERFACE_EXPORT int playerxdr_raw_finish(playerxdr_raw_t* r, size_t decoded_size);
+
+/// Signature of the memory layout of the message structures in this
+/// build: a checksum of the interface definitions combined with the byte
+/// order, type sizes and alignments of the machine.  Two ends can use
+/// the raw encoding between them if and only if their signatures match.
+PLAYERINTERFACE_EXPORT uint32_t playerxdr_raw_layout(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined (HAVE_SHM_OPEN) && !defined (WIN32)
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+#include "shm_ring.h"
+
+#define SHMRING_MAGIC 0x504c5352u
+#define SHMRING_VERSION 1
+// Data area offset; the header keeps head and tail on separate cache lines
+#define SHMRING_HDR_SIZE 256
+// Smallest data area
+#define SHMRING_MIN_SIZE 4096
+#define SHMRING_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+
+typedef struct shmring_hdr
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t size;
+  char pad0[64 - 16];
+  // Written by the producer only
+  uint64_t head;
+  char pad1[64 - 8];
+  // Written by the consumer only
+  uint64_t tail;
+  char pad2[64 - 8];
+} shmring_hdr_t;
+
+#define SHMRING_HDR(r) ((shmring_hdr_t*)(r)->map)
+
+// head and tail are the only words shared between the two processes.
+// Every access is sequentially consistent: besides publishing the records,
+// this orders the producer's store of head before its load of tail and
+// the consumer's store of tail before its load of head, so that either
+// the producer sees that the consumer has emptied the ring or the
+// consumer sees the new record.
+#if defined (__GNUC__)
+  #define SHMRING_LOAD(p) __atomic_load_n(p, __ATOMIC_SEQ_CST)
+  #define SHMRING_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+#else
+  #define SHMRING_LOAD(p) (*(volatile uint64_t*)(p))
+  #define SHMRING_STORE(p, v) (*(volatile uint64_t*)(p) = (v))
+#endif
+
+#if defined (HAVE_SHM_OPEN) && !defined (WIN32)
+
+int
+shmring_create(shmring_t* r, size_t size)
+{
+  static unsigned int seq = 0;
+  uint64_t datasize = SHMRING_MIN_SIZE;
+  shmring_hdr_t* hdr;
+  int fd = -1;
+  int i;
+
+  memset(r, 0, sizeof(shmring_t));
+  while(datasize < size)
+    datasize <<= 1;
+
+  // A ring left behind by a process that had the same pid is skipped
+  for(i = 0; i < 16 && fd < 0; i++)
+  {
+    snprintf(r->name, sizeof(r->name), SHMRING_NAME_PREFIX "%ld-%u",
+             (long)getpid(), seq++);
+    fd = shm_open(r->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0 && errno != EEXIST)
+      break;
+  }
+  if(fd < 0)
+  {
+    r->name[0] = '\0';
+    return(-1);
+  }
+
+  r->maplen = SHMRING_HDR_SIZE + datasize;
+  if(ftruncate(fd, r->maplen) < 0 ||
+     (r->map = mmap(NULL, r->maplen, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0)) == MAP_FAILED)
+  {
+    r->map = NULL;
+    close(fd);
+    shmring_unlink(r);
+    return(-1);
+  }
+  close(fd);
+
+  hdr = SHMRING_HDR(r);
+  hdr->magic = SHMRING_MAGIC;
+  hdr->version = SHMRING_VERSION;
+  hdr->size = datasize;
+  SHMRING_STORE(&hdr->head, 0);
+  SHMRING_STORE(&hdr->tail, 0);
+  r->data = (char*)r->map + SHMRING_HDR_SIZE;
+  r->size = datasize;
+  return(0);
+}
+
+int
+shmring_attach(shmring_t* r, const char* name)
+{
+  shmring_hdr_t* hdr;
+  struct stat st;
+  uint64_t size;
+  int fd;
+
+  memset(r, 0, sizeof(shmring_t));
+  if(strncmp(name, SHMRING_NAME_PREFIX, strlen(SHMRING_NAME_PREFIX)) ||
+     strchr(name + 1, '/') ||
+     strlen(name) >= sizeof(r->name))
+    return(-1);
+  strcpy(r->name, name);
+
+  if((fd = shm_open(name, O_RDWR, 0)) < 0)
+    return(-1);
+  if(fstat(fd, &st) < 0 || st.st_uid != geteuid() ||
+     st.st_size < SHMRING_HDR_SIZE + SHMRING_MIN_SIZE)
+  {
+    close(fd);
+    return(-1);
+  }
+  r->maplen = st.st_size;
+  r->map = mmap(NULL, r->maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(r->map == MAP_FAILED)
+  {
+    r->map = NULL;
+    return(-1);
+  }
+
+  // The size is read once; the consumer cannot change it afterwards
+  hdr = SHMRING_HDR(r);
+  size = hdr->size;
+  if(hdr->magic != SHMRING_MAGIC || hdr->version != SHMRING_VERSION ||
+     size < SHMRING_MIN_SIZE || (size & (size - 1)) ||
+     size > r->maplen - SHMRING_HDR_SIZE)
+  {
+    shmring_close(r);
+    return(-1);
+  }
+  r->data = (char*)r->map + SHMRING_HDR_SIZE;
+  r->size = size;
+  return(0);
+}
+
+void
+shmring_unlink(shmring_t* r)
+{
+  if(r->name[0])
+    shm_unlink(r->name);
+  r->name[0] = '\0';
+}
+
+void
+shmring_close(shmring_t* r)
+{
+  if(r->map)
+    munmap(r->map, r->maplen);
+  r->map = NULL;
+  r->data = NULL;
+  r->size = 0;
+}
+
+#else
+
+int
+shmring_create(shmring_t* r, size_t size)
+{
+  memset(r, 0, sizeof(shmring_t));
+  return(-1);
+}
+
+int
+shmring_attach(shmring_t* r, const char* name)
+{
+  memset(r, 0, sizeof(shmring_t));
+  return(-1);
+}
+
+void
+shmring_unlink(shmring_t* r)
+{
+  r->name[0] = '\0';
+}
+
+void
+shmring_close(shmring_t* r)
+{
+  r->map = NULL;
+  r->data = NULL;
+  r->size = 0;
+}
+
+#endif
+
+size_t
+shmring_max_record(const shmring_t* r)
+{
+  // Any record of up to half the data area fits into an empty ring,
+  // wherever the previous record ended
+  return(r->size / 2 - 4);
+}
+
+int
+shmring_write(shmring_t* r, const void* buf, size_t len, int* doorbell)
+{
+  shmring_hdr_t* hdr = SHMRING_HDR(r);
+  uint64_t head, tail, off, contig, need, reclen;
+
+  *doorbell = 0;
+  if(len > shmring_max_record(r))
+    return(-1);
+
+  head = hdr->head;
+  tail = SHMRING_LOAD(&hdr->tail);
+  if(tail > head || head - tail > r->size || (tail & 7))
+    return(-2);
+
+  reclen = SHMRING_ALIGN(4 + len);
+  off = head & (r->size - 1);
+  contig = r->size - off;
+  need = reclen <= contig ? reclen : contig + reclen;
+  if(r->size - (head - tail) < need)
+    return(0);
+
+  if(reclen > contig)
+  {
+    *(uint32_t*)(r->data + off) = SHMRING_WRAP;
+    off = 0;
+  }
+  *(uint32_t*)(r->data + off) = (uint32_t)len;
+  memcpy(r->data + off + 4, buf, len);
+
+  SHMRING_STORE(&hdr->head, head + need);
+  *doorbell = (SHMRING_LOAD(&hdr->tail) == head);
+  return(1);
+}
+
+int
+shmring_peek(shmring_t* r, const char** buf, size_t* len)
+{
+  shmring_hdr_t* hdr = SHMRING_HDR(r);
+  uint64_t head, tail, off;
+  uint32_t reclen;
+
+  tail = hdr->tail;
+  for(;;)
+  {
+    head = SHMRING_LOAD(&hdr->head);
+    if(head == tail)
+      return(0);
+    if(head < tail || head - tail > r->size || (head & 7))
+      return(-1);
+
+    off = tail & (r->size - 1);
+    reclen = *(volatile uint32_t*)(r->data + off);
+    if(reclen != SHMRING_WRAP)
+      break;
+    tail += r->size - off;
+    SHMRING_STORE(&hdr->tail, tail);
+  }
+
+  if(4 + (uint64_t)reclen > r->size - off ||
+     SHMRING_ALIGN(4 + (uint64_t)reclen) > head - tail)
+    return(-1);
+  *buf = r->data + off + 4;
+  *len = reclen;
+  r->pending = SHMRING_ALIGN(4 + (uint64_t)reclen);
+  return(1);
+}
+
+void
+shmring_consume(shmring_t* r)
+{
+  shmring_hdr_t* hdr = SHMRING_HDR(r);
+
+  SHMRING_STORE(&hdr->tail, hdr->tail + r->pending);
+  r->pending = 0;
+}
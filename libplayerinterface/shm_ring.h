@@ -0,0 +1,154 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/** @ingroup libplayerinterface
+    @defgroup shmring Shared Memory Rings
+
+Single-producer, single-consumer ring buffers in POSIX shared memory,
+used to deliver messages to clients on the same machine as the server.
+The client (the consumer) creates the ring and passes its name to the
+server (the producer), which attaches to it.  A ring starts with a
+header holding two 64-bit counters, the number of bytes ever written
+(head) and ever consumed (tail), each on its own cache line, followed
+by a power-of-two data area.  Every record is a native uint32 length
+followed by that many bytes, padded to 8 bytes; a length of
+SHMRING_WRAP means that the rest of the data area is unused and the
+next record is at its start.
+
+The producer reports when a record lands in a ring that the consumer
+had emptied, so that it can wake the consumer through some other
+channel; the consumer must look at the ring before waiting on that
+channel.  The producer never trusts the consumer's counter, and the
+consumer bounds-checks every record.
+*/
+
+#ifndef _SHM_RING_H
+#define _SHM_RING_H
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERINTERFACE_EXPORT
+  #elif defined (playerinterface_EXPORTS)
+    #define PLAYERINTERFACE_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERINTERFACE_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERINTERFACE_EXPORT
+#endif
+
+#include <stddef.h>
+#include <libplayerinterface/player.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @ingroup shmring
+@{
+*/
+
+/// Every ring name starts with this
+#define SHMRING_NAME_PREFIX "/player-shm-"
+/// Largest ring name, including the terminating NULL
+#define SHMRING_NAME_LEN 64
+/// Record length marking the end of the used part of the data area
+#define SHMRING_WRAP 0xffffffffu
+
+/// A mapped ring, as seen by one of its two ends
+typedef struct shmring
+{
+  /// Name of the shared memory object
+  char name[SHMRING_NAME_LEN];
+  /// The whole mapping, header included
+  void* map;
+  /// Length of the mapping
+  size_t maplen;
+  /// Start of the data area
+  char* data;
+  /// Size of the data area, a power of two
+  uint64_t size;
+  /// Consumer: padded size of the record returned by shmring_peek()
+  uint64_t pending;
+} shmring_t;
+
+/// Create a ring with a data area of at least @p size bytes, as the
+/// consumer.  @return 0 on success, -1 on error (or if shared memory is
+/// not available on this platform)
+PLAYERINTERFACE_EXPORT int shmring_create(shmring_t* r, size_t size);
+
+/// Map the ring created by the consumer under @p name, as the producer.
+/// The name must start with SHMRING_NAME_PREFIX and the object must be
+/// owned by the calling user.  @return 0 on success, -1 on error
+PLAYERINTERFACE_EXPORT int shmring_attach(shmring_t* r, const char* name);
+
+/// Remove the name of a ring; the mappings stay valid
+PLAYERINTERFACE_EXPORT void shmring_unlink(shmring_t* r);
+
+/// Unmap a ring
+PLAYERINTERFACE_EXPORT void shmring_close(shmring_t* r);
+
+/// Largest record that the ring will ever accept
+PLAYERINTERFACE_EXPORT size_t shmring_max_record(const shmring_t* r);
+
+/// Append a record, as the producer.  @p doorbell is set to 1 if the
+/// consumer had consumed everything before this record, and may be
+/// waiting for it.
+/// @return 1 if the record was written, 0 if the ring is too full for
+/// now, -1 if the record is larger than shmring_max_record() and -2 if
+/// the consumer's counter is invalid
+PLAYERINTERFACE_EXPORT int shmring_write(shmring_t* r, const void* buf, size_t len,
+                                         int* doorbell);
+
+/// Look at the oldest record, as the consumer.  The record stays in the
+/// ring until shmring_consume() is called.
+/// @return 1 if there is a record, 0 if the ring is empty, -1 if the ring
+/// is corrupt
+PLAYERINTERFACE_EXPORT int shmring_peek(shmring_t* r, const char** buf, size_t* len);
+
+/// Release the record returned by the last call to shmring_peek()
+PLAYERINTERFACE_EXPORT void shmring_consume(shmring_t* r);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,447 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "udp_frame.h"
+
+// Size of the table of the newest message delivered for each stream
+#define UDPFRAME_DONE_SIZE 64
+
+// The stream a message belongs to
+typedef struct udpframe_stream
+{
+  player_devaddr_t addr;
+  uint8_t type;
+  uint8_t subtype;
+  uint32_t key;
+} udpframe_stream_t;
+
+// One partially received message
+typedef struct udpframe_slot
+{
+  int used;
+  uint32_t seq;
+  udpframe_stream_t stream;
+  uint32_t msglen;
+  uint16_t flags;
+  uint16_t nfrags;
+  uint16_t nrecv;
+  // Last time this slot was touched; the oldest slot is evicted first
+  unsigned int stamp;
+  // Message being reassembled
+  char* buf;
+  size_t bufsize;
+  // One flag per fragment received
+  unsigned char* have;
+  size_t havesize;
+} udpframe_slot_t;
+
+// Newest replaceable message delivered for a stream
+typedef struct udpframe_done
+{
+  int valid;
+  udpframe_stream_t stream;
+  uint32_t seq;
+} udpframe_done_t;
+
+struct udpframe_reasm
+{
+  int num_slots;
+  udpframe_slot_t* slots;
+  unsigned int clock;
+  unsigned int dropped;
+  udpframe_done_t done[UDPFRAME_DONE_SIZE];
+};
+
+// Is sequence number a older than b (with wrap-around)?
+static int
+seq_older(uint32_t a, uint32_t b)
+{
+  return((int32_t)(a - b) < 0);
+}
+
+static void
+put16(char* buf, uint16_t v)
+{
+  buf[0] = (char)(v >> 8);
+  buf[1] = (char)(v);
+}
+
+static void
+put32(char* buf, uint32_t v)
+{
+  buf[0] = (char)(v >> 24);
+  buf[1] = (char)(v >> 16);
+  buf[2] = (char)(v >> 8);
+  buf[3] = (char)(v);
+}
+
+static uint16_t
+get16(const char* buf)
+{
+  const unsigned char* b = (const unsigned char*)buf;
+  return((uint16_t)((b[0] << 8) | b[1]));
+}
+
+static uint32_t
+get32(const char* buf)
+{
+  const unsigned char* b = (const unsigned char*)buf;
+  return(((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+         ((uint32_t)b[2] << 8) | (uint32_t)b[3]);
+}
+
+int
+udpframe_count(size_t msglen)
+{
+  if(msglen == 0)
+    return(1);
+  return((int)((msglen + UDPFRAME_MAX_PAYLOAD - 1) / UDPFRAME_MAX_PAYLOAD));
+}
+
+// FNV-1a hash of a stream
+static uint32_t
+stream_key(const player_devaddr_t* addr, uint8_t type, uint8_t subtype)
+{
+  uint32_t v[6];
+  uint32_t h = 2166136261u;
+  int i, j;
+
+  v[0] = addr->host;
+  v[1] = addr->robot;
+  v[2] = addr->interf;
+  v[3] = addr->index;
+  v[4] = type;
+  v[5] = subtype;
+  for(i = 0; i < 6; i++)
+  {
+    for(j = 0; j < 32; j += 8)
+    {
+      h ^= (v[i] >> j) & 0xff;
+      h *= 16777619u;
+    }
+  }
+  return(h);
+}
+
+// Do a frame and a stream belong to the same stream?
+static int
+same_stream(const udpframe_stream_t* s, const udpframe_hdr_t* hdr)
+{
+  return((s->key == hdr->key) &&
+         (s->addr.host == hdr->addr.host) &&
+         (s->addr.robot == hdr->addr.robot) &&
+         (s->addr.interf == hdr->addr.interf) &&
+         (s->addr.index == hdr->addr.index) &&
+         (s->type == hdr->type) &&
+         (s->subtype == hdr->subtype));
+}
+
+static void
+set_stream(udpframe_stream_t* s, const udpframe_hdr_t* hdr)
+{
+  s->addr = hdr->addr;
+  s->type = hdr->type;
+  s->subtype = hdr->subtype;
+  s->key = hdr->key;
+}
+
+uint32_t
+udpframe_key(const player_msghdr_t* hdr)
+{
+  return(stream_key(&hdr->addr, hdr->type, hdr->subtype));
+}
+
+void
+udpframe_hdr_stream(udpframe_hdr_t* fhdr, const player_msghdr_t* hdr)
+{
+  fhdr->addr = hdr->addr;
+  fhdr->type = hdr->type;
+  fhdr->subtype = hdr->subtype;
+  fhdr->key = udpframe_key(hdr);
+}
+
+void
+udpframe_hdr_pack(char* buf, const udpframe_hdr_t* hdr)
+{
+  put16(buf + 0, hdr->magic);
+  put16(buf + 2, hdr->flags);
+  put32(buf + 4, hdr->seq);
+  put32(buf + 8, hdr->msglen);
+  put32(buf + 12, hdr->addr.host);
+  put32(buf + 16, hdr->addr.robot);
+  put16(buf + 20, hdr->addr.interf);
+  put16(buf + 22, hdr->addr.index);
+  buf[24] = (char)hdr->type;
+  buf[25] = (char)hdr->subtype;
+  put16(buf + 26, hdr->frag);
+  put16(buf + 28, hdr->nfrags);
+}
+
+int
+udpframe_hdr_unpack(const char* buf, size_t len, udpframe_hdr_t* hdr)
+{
+  size_t payload;
+
+  if(len < UDPFRAME_HDR_SIZE)
+    return(-1);
+
+  hdr->magic = get16(buf + 0);
+  hdr->flags = get16(buf + 2);
+  hdr->seq = get32(buf + 4);
+  hdr->msglen = get32(buf + 8);
+  hdr->addr.host = get32(buf + 12);
+  hdr->addr.robot = get32(buf + 16);
+  hdr->addr.interf = get16(buf + 20);
+  hdr->addr.index = get16(buf + 22);
+  hdr->type = (uint8_t)buf[24];
+  hdr->subtype = (uint8_t)buf[25];
+  hdr->frag = get16(buf + 26);
+  hdr->nfrags = get16(buf + 28);
+  hdr->key = stream_key(&hdr->addr, hdr->type, hdr->subtype);
+
+  if(hdr->magic != UDPFRAME_MAGIC)
+    return(-1);
+  if(hdr->nfrags != udpframe_count(hdr->msglen))
+    return(-1);
+  if(hdr->frag >= hdr->nfrags)
+    return(-1);
+
+  // Every fragment but the last one is full
+  if(hdr->frag < hdr->nfrags - 1)
+    payload = UDPFRAME_MAX_PAYLOAD;
+  else
+    payload = hdr->msglen - (size_t)hdr->frag * UDPFRAME_MAX_PAYLOAD;
+  if(len - UDPFRAME_HDR_SIZE != payload)
+    return(-1);
+
+  return(0);
+}
+
+udpframe_reasm_t*
+udpframe_reasm_alloc(int slots)
+{
+  udpframe_reasm_t* r;
+
+  if(slots < 1)
+    slots = 1;
+
+  r = (udpframe_reasm_t*)calloc(1, sizeof(udpframe_reasm_t));
+  if(!r)
+    return(NULL);
+  r->num_slots = slots;
+  r->slots = (udpframe_slot_t*)calloc(slots, sizeof(udpframe_slot_t));
+  if(!r->slots)
+  {
+    free(r);
+    return(NULL);
+  }
+  return(r);
+}
+
+void
+udpframe_reasm_free(udpframe_reasm_t* r)
+{
+  int i;
+
+  if(!r)
+    return;
+  for(i = 0; i < r->num_slots; i++)
+  {
+    free(r->slots[i].buf);
+    free(r->slots[i].have);
+  }
+  free(r->slots);
+  free(r);
+}
+
+unsigned int
+udpframe_reasm_dropped(const udpframe_reasm_t* r)
+{
+  return(r->dropped);
+}
+
+// Apply the replace rule for a new frame.  Returns -1 if the frame
+// belongs to a message that has already been superseded.
+static int
+udpframe_reasm_replace(udpframe_reasm_t* r, const udpframe_hdr_t* hdr)
+{
+  udpframe_done_t* done;
+  udpframe_slot_t* slot;
+  int i;
+
+  done = r->done + (hdr->key % UDPFRAME_DONE_SIZE);
+  if(done->valid && same_stream(&done->stream, hdr) &&
+     !seq_older(done->seq, hdr->seq))
+    return(-1);
+
+  for(i = 0; i < r->num_slots; i++)
+  {
+    slot = r->slots + i;
+    if(!slot->used || !same_stream(&slot->stream, hdr) ||
+       !(slot->flags & UDPFRAME_FLAG_REPLACE))
+      continue;
+    if(seq_older(hdr->seq, slot->seq))
+      return(-1);
+    if(seq_older(slot->seq, hdr->seq))
+    {
+      // An older copy of this stream will never be delivered now
+      slot->used = 0;
+      r->dropped++;
+    }
+  }
+  return(0);
+}
+
+// Remember the newest replaceable message delivered for a stream
+static void
+udpframe_reasm_delivered(udpframe_reasm_t* r, const udpframe_hdr_t* hdr)
+{
+  udpframe_done_t* done;
+
+  if(!(hdr->flags & UDPFRAME_FLAG_REPLACE))
+    return;
+  done = r->done + (hdr->key % UDPFRAME_DONE_SIZE);
+  done->valid = 1;
+  set_stream(&done->stream, hdr);
+  done->seq = hdr->seq;
+}
+
+int
+udpframe_reasm_add(udpframe_reasm_t* r,
+                   const char* dgram, size_t len,
+                   const char** msg, size_t* msglen)
+{
+  udpframe_hdr_t hdr;
+  udpframe_slot_t* slot;
+  udpframe_slot_t* oldest;
+  size_t payload;
+  int i;
+
+  if(udpframe_hdr_unpack(dgram, len, &hdr) < 0)
+    return(-1);
+
+  if((hdr.flags & UDPFRAME_FLAG_REPLACE) &&
+     (udpframe_reasm_replace(r, &hdr) < 0))
+    return(-1);
+
+  // Unfragmented messages are handed back in place
+  if(hdr.nfrags == 1)
+  {
+    udpframe_reasm_delivered(r, &hdr);
+    *msg = dgram + UDPFRAME_HDR_SIZE;
+    *msglen = hdr.msglen;
+    return(1);
+  }
+
+  // Find the slot for this message, or take a free one, or evict the
+  // oldest one
+  slot = NULL;
+  oldest = NULL;
+  for(i = 0; i < r->num_slots; i++)
+  {
+    udpframe_slot_t* s = r->slots + i;
+    if(s->used && (s->seq == hdr.seq) && same_stream(&s->stream, &hdr))
+    {
+      slot = s;
+      break;
+    }
+    if(!oldest || !s->used ||
+       (oldest->used && (s->stamp < oldest->stamp)))
+      oldest = s;
+  }
+
+  if(!slot)
+  {
+    slot = oldest;
+    if(slot->used)
+      r->dropped++;
+
+    if(slot->bufsize < hdr.msglen)
+    {
+      char* buf = (char*)realloc(slot->buf, hdr.msglen);
+      if(!buf)
+        return(-1);
+      slot->buf = buf;
+      slot->bufsize = hdr.msglen;
+    }
+    if(slot->havesize < hdr.nfrags)
+    {
+      unsigned char* have = (unsigned char*)realloc(slot->have, hdr.nfrags);
+      if(!have)
+        return(-1);
+      slot->have = have;
+      slot->havesize = hdr.nfrags;
+    }
+    memset(slot->have, 0, hdr.nfrags);
+
+    slot->used = 1;
+    slot->seq = hdr.seq;
+    set_stream(&slot->stream, &hdr);
+    slot->msglen = hdr.msglen;
+    slot->flags = hdr.flags;
+    slot->nfrags = hdr.nfrags;
+    slot->nrecv = 0;
+  }
+  else if((slot->msglen != hdr.msglen) || (slot->nfrags != hdr.nfrags))
+    return(-1);
+
+  slot->stamp = ++r->clock;
+
+  // Duplicate
+  if(slot->have[hdr.frag])
+    return(0);
+
+  payload = len - UDPFRAME_HDR_SIZE;
+  memcpy(slot->buf + (size_t)hdr.frag * UDPFRAME_MAX_PAYLOAD,
+         dgram + UDPFRAME_HDR_SIZE, payload);
+  slot->have[hdr.frag] = 1;
+  slot->nrecv++;
+
+  if(slot->nrecv < slot->nfrags)
+    return(0);
+
+  slot->used = 0;
+  udpframe_reasm_delivered(r, &hdr);
+  *msg = slot->buf;
+  *msglen = slot->msglen;
+  return(1);
+}
@@ -0,0 +1,170 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/** @ingroup libplayerinterface
+    @defgroup udpframe UDP Framing
+
+Framing used by the UDP transport.  Every encoded message is split into
+one or more datagrams, each carrying a small frame header followed by up
+to UDPFRAME_MAX_PAYLOAD bytes of the XDR-encoded message:
+
+@verbatim
+  uint16 magic   (UDPFRAME_MAGIC)
+  uint16 flags   (UDPFRAME_FLAG_*)
+  uint32 seq     message sequence number, per sender
+  uint32 msglen  total length of the encoded message
+  uint32 host    device address of the message
+  uint32 robot
+  uint16 interf
+  uint16 index
+  uint8  type    message type
+  uint8  subtype message subtype
+  uint16 frag    index of this fragment
+  uint16 nfrags  number of fragments in the message
+@endverbatim
+
+All fields are in network byte order.  The address, type and subtype
+name the stream the message belongs to.  Fragments of a message sent with
+UDPFRAME_FLAG_REPLACE are dropped by the receiver as soon as a newer
+message of the same stream is seen, mirroring the replace rules of the
+message queues: a late piece of an old laser scan is never worth
+waiting for.
+*/
+
+#ifndef _UDP_FRAME_H
+#define _UDP_FRAME_H
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERINTERFACE_EXPORT
+  #elif defined (playerinterface_EXPORTS)
+    #define PLAYERINTERFACE_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERINTERFACE_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERINTERFACE_EXPORT
+#endif
+
+#include <stddef.h>
+#include <libplayerinterface/player.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @ingroup udpframe
+@{
+*/
+
+/// Magic number at the start of every frame
+#define UDPFRAME_MAGIC 0x5046
+/// Size of the packed frame header
+#define UDPFRAME_HDR_SIZE 30
+/// Largest message payload carried by one frame; chosen so that a frame
+/// fits in a single Ethernet MTU without IP fragmentation
+#define UDPFRAME_MAX_PAYLOAD 1400
+/// Largest datagram produced by the framing
+#define UDPFRAME_MAX_SIZE (UDPFRAME_HDR_SIZE + UDPFRAME_MAX_PAYLOAD)
+/// Older messages of the same stream may be discarded
+#define UDPFRAME_FLAG_REPLACE 0x0001
+
+/// Frame header
+typedef struct udpframe_hdr
+{
+  uint16_t magic;
+  uint16_t flags;
+  uint32_t seq;
+  uint32_t msglen;
+  player_devaddr_t addr;
+  uint8_t type;
+  uint8_t subtype;
+  uint16_t frag;
+  uint16_t nfrags;
+  /// Hash of the stream, not sent; set by udpframe_hdr_stream() and
+  /// udpframe_hdr_unpack()
+  uint32_t key;
+} udpframe_hdr_t;
+
+/// Number of frames needed for a message of the given encoded length
+PLAYERINTERFACE_EXPORT int udpframe_count(size_t msglen);
+
+/// Hash of the stream (address, type and subtype) of a message header
+PLAYERINTERFACE_EXPORT uint32_t udpframe_key(const player_msghdr_t* hdr);
+
+/// Fill in the stream fields and key of a frame header from the header
+/// of the message it carries
+PLAYERINTERFACE_EXPORT void udpframe_hdr_stream(udpframe_hdr_t* fhdr,
+                                                const player_msghdr_t* hdr);
+
+/// Pack a frame header into buf, which must hold UDPFRAME_HDR_SIZE bytes
+PLAYERINTERFACE_EXPORT void udpframe_hdr_pack(char* buf, const udpframe_hdr_t* hdr);
+
+/// Unpack and check a frame header.
+/// @return 0 on success, -1 if the datagram is not a valid frame
+PLAYERINTERFACE_EXPORT int udpframe_hdr_unpack(const char* buf, size_t len,
+                                               udpframe_hdr_t* hdr);
+
+/// Reassembly state for the frames coming from one peer
+typedef struct udpframe_reasm udpframe_reasm_t;
+
+/// Create a reassembler that tracks up to @p slots partial messages
+PLAYERINTERFACE_EXPORT udpframe_reasm_t* udpframe_reasm_alloc(int slots);
+
+/// Destroy a reassembler
+PLAYERINTERFACE_EXPORT void udpframe_reasm_free(udpframe_reasm_t* r);
+
+/// Add a datagram to a reassembler.  When it completes a message, 1 is
+/// returned and @p msg / @p msglen describe the encoded message; the
+/// buffer stays valid until the next call.  Returns 0 if more fragments
+/// are needed and -1 if the datagram was invalid or stale.
+PLAYERINTERFACE_EXPORT int udpframe_reasm_add(udpframe_reasm_t* r,
+                                              const char* dgram, size_t len,
+                                              const char** msg, size_t* msglen);
+
+/// Number of partial messages discarded so far (evicted or superseded)
+PLAYERINTERFACE_EXPORT unsigned int udpframe_reasm_dropped(const udpframe_reasm_t* r);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
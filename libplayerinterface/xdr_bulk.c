@@ -0,0 +1,182 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+#include <playerconfig.h>
+
+#include <limits.h>
+#include <string.h>
+#include <sys/types.h>
+#if defined (WIN32)
+  #include <winsock2.h>
+#else
+  #include <netinet/in.h>
+#endif
+#if defined (__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+#include "xdr_bulk.h"
+
+// Copy count 4-byte words from src to dst, converting between host and
+// network byte order.  The conversion is its own inverse, so the same
+// kernel serves for encoding and decoding.
+static void
+bulk_swap32(char* dst, const char* src, unsigned int count)
+{
+  unsigned int ii = 0;
+  uint32_t w;
+
+  if(htonl(1) == 1)
+  {
+    memcpy(dst, src, (size_t)count * 4);
+    return;
+  }
+#if defined (__SSE2__)
+  for(; ii + 4 <= count; ii += 4)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(src + ii * 4));
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+    x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    _mm_storeu_si128((__m128i*)(dst + ii * 4), x);
+  }
+#endif
+  for(; ii < count; ii++)
+  {
+    memcpy(&w, src + ii * 4, 4);
+    w = htonl(w);
+    memcpy(dst + ii * 4, &w, 4);
+  }
+}
+
+// As bulk_swap32, for 8-byte words.  XDR puts the most significant
+// 4-byte word first, so the whole word ends up big-endian.
+static void
+bulk_swap64(char* dst, const char* src, unsigned int count)
+{
+  unsigned int ii = 0;
+  uint32_t w[2], t;
+
+  if(htonl(1) == 1)
+  {
+    memcpy(dst, src, (size_t)count * 8);
+    return;
+  }
+#if defined (__SSE2__)
+  for(; ii + 2 <= count; ii += 2)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(src + ii * 8));
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+    x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    _mm_storeu_si128((__m128i*)(dst + ii * 8), x);
+  }
+#endif
+  for(; ii < count; ii++)
+  {
+    memcpy(w, src + ii * 8, 8);
+    t = htonl(w[0]);
+    w[0] = htonl(w[1]);
+    w[1] = t;
+    memcpy(dst + ii * 8, w, 8);
+  }
+}
+
+int
+playerxdr_bulk32(XDR* xdrs, void* v, unsigned int count)
+{
+  char* buf;
+  unsigned int ii;
+
+  if(count == 0 || xdrs->x_op == XDR_FREE)
+    return(1);
+  if(count > UINT_MAX / 4)
+    return(0);
+
+  if((buf = (char*)xdr_inline(xdrs, count * 4)) != NULL)
+  {
+    if(xdrs->x_op == XDR_ENCODE)
+      bulk_swap32(buf, (const char*)v, count);
+    else
+      bulk_swap32((char*)v, buf, count);
+    return(1);
+  }
+
+  for(ii = 0; ii < count; ii++)
+  {
+    if(xdr_u_int(xdrs, (u_int*)v + ii) != 1)
+      return(0);
+  }
+  return(1);
+}
+
+int
+playerxdr_bulk64(XDR* xdrs, void* v, unsigned int count)
+{
+  char* buf;
+  unsigned int ii;
+  uint64_t w;
+  u_int hi, lo;
+
+  if(count == 0 || xdrs->x_op == XDR_FREE)
+    return(1);
+  if(count > UINT_MAX / 8)
+    return(0);
+
+  if((buf = (char*)xdr_inline(xdrs, count * 8)) != NULL)
+  {
+    if(xdrs->x_op == XDR_ENCODE)
+      bulk_swap64(buf, (const char*)v, count);
+    else
+      bulk_swap64((char*)v, buf, count);
+    return(1);
+  }
+
+  for(ii = 0; ii < count; ii++)
+  {
+    memcpy(&w, (char*)v + ii * 8, 8);
+    hi = (u_int)(w >> 32);
+    lo = (u_int)w;
+    if(xdr_u_int(xdrs, &hi) != 1 || xdr_u_int(xdrs, &lo) != 1)
+      return(0);
+    w = ((uint64_t)hi << 32) | lo;
+    memcpy((char*)v + ii * 8, &w, 8);
+  }
+  return(1);
+}
@@ -0,0 +1,96 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/** @ingroup libplayerinterface
+    @defgroup xdrbulk XDR bulk arrays
+
+Encoding and decoding of arrays of 4-byte and 8-byte primitive types in
+one pass over the XDR buffer.  The generated XDR functions use these for
+arrays of float, double, int32_t and uint32_t instead of xdr_array() and
+xdr_vector(), which call a conversion function per element.  The wire
+format is unchanged: every element is written big-endian, exactly as
+xdr_float(), xdr_double(), xdr_int() and xdr_u_int() write it.
+
+When the stream hands out its buffer through xdr_inline(), the whole
+array is byte-swapped in place with SSE2 where available; other streams
+fall back to one xdr_u_int() call per 4-byte word.
+*/
+
+#ifndef _XDR_BULK_H
+#define _XDR_BULK_H
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERINTERFACE_EXPORT
+  #elif defined (playerinterface_EXPORTS)
+    #define PLAYERINTERFACE_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERINTERFACE_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERINTERFACE_EXPORT
+#endif
+
+#include <rpc/types.h>
+#include <rpc/xdr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @ingroup xdrbulk
+@{
+*/
+
+/// Encode or decode @p count 4-byte elements (float, int32_t, uint32_t)
+/// at @p v, according to the direction of @p xdrs.
+/// @return 1 on success, 0 on failure, as the xdr_* functions do
+PLAYERINTERFACE_EXPORT int playerxdr_bulk32(XDR* xdrs, void* v, unsigned int count);
+
+/// Encode or decode @p count 8-byte elements (double) at @p v.
+/// @return 1 on success, 0 on failure
+PLAYERINTERFACE_EXPORT int playerxdr_bulk64(XDR* xdrs, void* v, unsigned int count);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -175,6 +175,12 @@ player_sd_printcache(player_sd_t* sd)
                sd->devs[i].interf, 
                interf_to_str(sd->devs[i].interf), 
                sd->devs[i].index);
+        if(sd->devs[i].mcast_port)
+        {
+          char group[16];
+          packedaddr_to_dottedip(group,sizeof(group),sd->devs[i].mcast_group);
+          printf("    multicast: %s:%u\n", group, sd->devs[i].mcast_port);
+        }
       }
     }
   }
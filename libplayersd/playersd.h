@@ -66,6 +66,7 @@ extern "C" {
 
 #define PLAYER_SD_SERVICENAME "_player31._tcp"
 #define PLAYER_SD_DEVICE_TXTNAME "device"
+#define PLAYER_SD_MULTICAST_TXTNAME "multicast"
 #define PLAYER_SD_NAME_MAXLEN 256
 #define PLAYER_SD_TXT_MAXLEN 256
 
@@ -85,6 +86,10 @@ typedef struct player_sd_dev
   uint32_t robot;
   uint16_t interf;
   uint16_t index;
+  // Multicast group on which the device's data is also published
+  // (packed), and its port; the port is 0 if there is none
+  uint32_t mcast_group;
+  uint16_t mcast_port;
 } player_sd_dev_t;
 
 /// Service discovery object
@@ -118,6 +123,15 @@ int player_sd_register(player_sd_t* sd,
                        const char* name, 
                        player_devaddr_t addr);
 
+/// Register the named device, also advertising the multicast group
+/// (packed address) and port on which its data is published.  A port of
+/// 0 is the same as player_sd_register().
+int player_sd_register_multicast(player_sd_t* sd,
+                                 const char* name,
+                                 player_devaddr_t addr,
+                                 uint32_t group,
+                                 uint16_t port);
+
 /// Unregister (terminate) the named device.  Returns 0 on success, non-zero 
 /// on error.
 int player_sd_unregister(player_sd_t* sd, 
@@ -215,6 +215,16 @@ int
 player_sd_register(player_sd_t* sd, 
                    const char* name, 
                    player_devaddr_t addr)
+{
+  return(player_sd_register_multicast(sd,name,addr,0,0));
+}
+
+int
+player_sd_register_multicast(player_sd_t* sd,
+                             const char* name,
+                             player_devaddr_t addr,
+                             uint32_t group,
+                             uint16_t port)
 {
   DNSServiceErrorType sdErr;
   char recordval[PLAYER_SD_TXT_MAXLEN];
@@ -255,6 +265,8 @@ player_sd_register(player_sd_t* sd,
   dev->sdDev.robot = addr.robot;
   dev->sdDev.interf = addr.interf;
   dev->sdDev.index = addr.index;
+  dev->sdDev.mcast_group = port ? group : 0;
+  dev->sdDev.mcast_port = port;
   dev->nameIdx = 1;
 
   TXTRecordCreate(&(dev->txtRecord),sizeof(dev->txtBuf),dev->txtBuf);
@@ -269,6 +281,21 @@ player_sd_register(player_sd_t* sd,
     PLAYER_ERROR1("TXTRecordSetValue returned error: %d", sdErr);
     return(-1);
   }
+  if(port)
+  {
+    memset(recordval,0,sizeof(recordval));
+    packedaddr_to_dottedip(recordval,sizeof(recordval),group);
+    snprintf(recordval+strlen(recordval),sizeof(recordval)-strlen(recordval),
+             ":%u", port);
+    if((sdErr = TXTRecordSetValue(&(dev->txtRecord),
+                                  PLAYER_SD_MULTICAST_TXTNAME,
+                                  strlen(recordval),
+                                  recordval)))
+    {
+      PLAYER_ERROR1("TXTRecordSetValue returned error: %d", sdErr);
+      return(-1);
+    }
+  }
 
   memset(nameBuf,0,sizeof(nameBuf));
   strncpy(nameBuf,name,sizeof(nameBuf)-1);
@@ -662,6 +689,28 @@ resolveCB(DNSServiceRef sdRef,
     strncpy(buf,colon+1,(value_len-(colon-value+1)));
     sddev->index = atoi(buf);
 
+    // The multicast group is optional
+    sddev->mcast_group = 0;
+    sddev->mcast_port = 0;
+    if((value = (const char*)TXTRecordGetValuePtr(txtLen,
+                                                  txtRecord,
+                                                  PLAYER_SD_MULTICAST_TXTNAME,
+                                                  &value_len)))
+    {
+      memset(buf,0,sizeof(buf));
+      strncpy(buf,value,value_len);
+      if((colon = strchr(buf,':')))
+        *colon = '\0';
+      if(!colon || (hostname_to_packedaddr(&sddev->mcast_group,buf) < 0))
+      {
+        PLAYER_WARN2("Failed to parse multicast info \"%s\" for service %s\n",
+                     buf, sddev->name);
+        sddev->mcast_group = 0;
+      }
+      else
+        sddev->mcast_port = atoi(colon+1);
+    }
+
     sddev->addr_valid = 1;
   }
   else
@@ -51,7 +51,7 @@
 #include <stddef.h>
 #include <time.h>
 #include <fcntl.h>
-#if ENABLE_TCP_NODELAY
+#if !defined (WIN32)
   #include <netinet/tcp.h>
 #endif
 
@@ -62,6 +62,7 @@
 #include <replace/replace.h>
 #include <libplayercore/playercore.h>
 #include <libplayerinterface/playerxdr.h>
+#include <libplayerinterface/shm_ring.h>
 
 #include "playertcp.h"
 #include "socket_util.h"
@@ -73,6 +74,17 @@
 
 #include "playertcp_errutils.h"
 
+/** Progress of a connection towards delivery through shared memory */
+#define PLAYERTCP_SHM_NONE    0
+/** Attached to the client's ring; the reply is queued */
+#define PLAYERTCP_SHM_PENDING 1
+/** The reply is being sent over the socket */
+#define PLAYERTCP_SHM_REPLY   2
+/** Messages go into the ring */
+#define PLAYERTCP_SHM_ACTIVE  3
+/** A message too large for the ring is being sent over the socket */
+#define PLAYERTCP_SHM_STREAM  4
+
 typedef struct playertcp_listener
 {
   int fd;
@@ -118,12 +130,40 @@ typedef struct playertcp_conn
   /** Linked list of devices to which we are subscribed */
   Device** dev_subs;
   size_t num_dev_subs;
+  /** Devices whose data this client takes from a multicast group */
+  Device** mcast_subs;
+  /** The rule, one per entry of @p mcast_subs, that drops its unicast data */
+  MessageReplaceRule** mcast_rules;
+  size_t num_mcast_subs;
+  /** Encoding of the message bodies we send (PLAYER_ENCODING_*) */
+  int encoding;
+  /** Shared memory ring of a local client (see PLAYER_PLAYER_REQ_SHM) */
+  shmring_t* shm;
+  /** One of PLAYERTCP_SHM_* */
+  int shm_state;
+  /** Identity of the message in @p writebuffer, for tracing */
+  const void* trace_msg;
   /** Flag that we should set to true when we kill the client.
    * TCPRemoteDriver uses this flag to know when the connection has been
    * closed, and thus that it should stop publishing to its queue. */
   int* kill_flag;
+  /** Where replies to our own player interface requests go, if we made
+   * any (see SetReplyQueue()) */
+  QueuePointer replies;
 } playertcp_conn_t;
 
+// Turn off Nagle's algorithm on a client's connection once all that is
+// left on it is small messages, which it would otherwise hold back until
+// the client's delayed ACK.
+static void
+playertcp_nodelay(int fd)
+{
+  int yes = 1;
+  if(setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+                (const char*)&yes, sizeof(int)) == -1)
+    PLAYER_WARN("failed to enable TCP_NODELAY");
+}
+
 void
 PlayerTCP::InitGlobals(void)
 {
@@ -167,6 +207,9 @@ PlayerTCP::PlayerTCP()
     this->host = 0;
   }
 
+  this->multicast_fn = NULL;
+  this->multicast_arg = NULL;
+
   deviceTable->AddRemoteDriverFn(TCPRemoteDriver::TCPRemoteDriver_Init,this);
 }
 
@@ -290,6 +333,13 @@ PlayerTCP::AddClient(struct sockaddr_in* cliaddr,
     this->clients[j].addr = *cliaddr;
   this->clients[j].dev_subs = NULL;
   this->clients[j].num_dev_subs = 0;
+  this->clients[j].mcast_subs = NULL;
+  this->clients[j].mcast_rules = NULL;
+  this->clients[j].num_mcast_subs = 0;
+  this->clients[j].encoding = PLAYER_ENCODING_XDR;
+  this->clients[j].shm = NULL;
+  this->clients[j].shm_state = PLAYERTCP_SHM_NONE;
+  this->clients[j].trace_msg = NULL;
   this->clients[j].kill_flag = kill_flag;
 
   // Set up for later use of poll
@@ -462,6 +512,14 @@ PlayerTCP::Close(int cli)
     }
   }
   free(this->clients[cli].dev_subs);
+  for(size_t i=0;i<this->clients[cli].num_mcast_subs;i++)
+  {
+    if(this->clients[cli].mcast_subs[i] && this->multicast_fn)
+      (*this->multicast_fn)(this->multicast_arg,
+                            this->clients[cli].mcast_subs[i], false);
+  }
+  free(this->clients[cli].mcast_subs);
+  free(this->clients[cli].mcast_rules);
   fileWatcher->RemoveFileWatch(this->clients[cli].fd);
 #if defined (WIN32)
   if (closesocket (this->clients[cli].fd) != 0)
@@ -474,8 +532,15 @@ PlayerTCP::Close(int cli)
   this->clients[cli].fd = -1;
   this->clients[cli].valid = 0;
   this->clients[cli].queue = QueuePointer();
+  this->clients[cli].replies = QueuePointer();
   free(this->clients[cli].readbuffer);
   free(this->clients[cli].writebuffer);
+  if(this->clients[cli].shm)
+  {
+    shmring_close(this->clients[cli].shm);
+    free(this->clients[cli].shm);
+    this->clients[cli].shm = NULL;
+  }
   if(this->clients[cli].kill_flag)
     *(this->clients[cli].kill_flag) = 1;
 }
@@ -618,6 +683,50 @@ PlayerTCP::DeleteClient(QueuePointer &q, bool have_lock)
     Unlock();
 }
 
+void
+PlayerTCP::SetReplyQueue(QueuePointer &q, QueuePointer &replies, bool have_lock)
+{
+  if(!have_lock)
+    Lock();
+  for(int i=0;i<this->num_clients;i++)
+  {
+    if(this->clients[i].queue == q)
+    {
+      this->clients[i].replies = replies;
+      break;
+    }
+  }
+  if(!have_lock)
+    Unlock();
+}
+
+void
+PlayerTCP::SetMulticast(playertcp_multicast_fn_t fn, void* arg)
+{
+  this->multicast_fn = fn;
+  this->multicast_arg = arg;
+}
+
+// Go back to receiving a device's data over the client's own connection
+void
+PlayerTCP::StopMulticast(int cli, Device* device)
+{
+  playertcp_conn_t* client = this->clients + cli;
+
+  for(size_t i=0;i<client->num_mcast_subs;i++)
+  {
+    if(client->mcast_subs[i] == device)
+    {
+      client->mcast_subs[i] = NULL;
+      client->queue->RemoveReplaceRule(client->mcast_rules[i]);
+      client->mcast_rules[i] = NULL;
+      if(this->multicast_fn)
+        (*this->multicast_fn)(this->multicast_arg, device, false);
+      break;
+    }
+  }
+}
+
 bool
 PlayerTCP::Listening(int port)
 {
@@ -639,6 +748,12 @@ PlayerTCP::WriteClient(int cli)
   player_msghdr_t hdr;
   void* payload;
   int encode_msglen;
+  int encoding;
+  bool encoding_reply;
+  bool shm_reply;
+  bool stream;
+  int doorbell;
+  int ret;
 
 #if HAVE_Z
   player_map_data_t* zipped_data=NULL;
@@ -647,14 +762,72 @@ PlayerTCP::WriteClient(int cli)
   client = this->clients + cli;
   for(;;)
   {
+    // A local client takes whole messages from its shared memory ring;
+    // the socket only carries a 0 byte when the ring was empty.
+    if(client->writebufferlen &&
+       (client->shm_state == PLAYERTCP_SHM_ACTIVE))
+    {
+      PLAYER_TRACE(PLAYER_TRACE_WRITE, PLAYER_TRACE_BEGIN, client->trace_msg,
+                   client, NULL, 0);
+      ret = shmring_write(client->shm, client->writebuffer,
+                          client->writebufferlen, &doorbell);
+      stream = (ret == -1);
+      if(stream)
+      {
+        // Too large for the ring: an empty record keeps its place, and
+        // the message itself follows a 1 byte on the socket
+        ret = shmring_write(client->shm, "", 0, &doorbell);
+      }
+      PLAYER_TRACE(PLAYER_TRACE_WRITE, PLAYER_TRACE_END, client->trace_msg,
+                   client, NULL,
+                   (ret > 0 && !stream) ? client->writebufferlen : 0);
+      if(ret == 0)
+      {
+        // ring is full
+        return(0);
+      }
+      else if(ret < 0)
+      {
+        PLAYER_MSG0(2,"shared memory ring is corrupt");
+        return(-1);
+      }
+      if(stream)
+      {
+        if(client->writebufferlen >= client->writebuffersize)
+        {
+          client->writebuffersize = client->writebufferlen + 1;
+          client->writebuffer = (char*)realloc(client->writebuffer,
+                                               client->writebuffersize);
+          assert(client->writebuffer);
+        }
+        memmove(client->writebuffer + 1, client->writebuffer,
+                client->writebufferlen);
+        client->writebuffer[0] = 1;
+        client->writebufferlen++;
+        client->shm_state = PLAYERTCP_SHM_STREAM;
+        continue;
+      }
+      client->writebufferlen = 0;
+
+      if(doorbell &&
+         (send(client->fd, "", 1, 0) < 0) && (ErrNo != ERRNO_EAGAIN))
+      {
+        // A full socket already wakes the client up
+        PLAYER_MSG1(2,"send() failed: %s", strerror(ErrNo));
+        return(-1);
+      }
+    }
     // try to send any bytes leftover from last time.
-    if(client->writebufferlen)
+    else if(client->writebufferlen)
     {
+      PLAYER_TRACE(PLAYER_TRACE_WRITE, PLAYER_TRACE_BEGIN, client->trace_msg,
+                   client, NULL, 0);
       numwritten = send(client->fd,
                          client->writebuffer,
                          MIN(client->writebufferlen,
                              PLAYERTCP_WRITEBUFFER_SIZE), 0);
-
+      PLAYER_TRACE(PLAYER_TRACE_WRITE, PLAYER_TRACE_END, client->trace_msg,
+                   client, NULL, (numwritten > 0) ? numwritten : 0);
 
       if(numwritten < 0)
       {
@@ -686,6 +859,18 @@ PlayerTCP::WriteClient(int cli)
       memmove(client->writebuffer, client->writebuffer + numwritten,
               client->writebufferlen - numwritten);
       client->writebufferlen -= numwritten;
+
+      // Everything after the reply to the shared memory request goes
+      // into the ring
+      if(!client->writebufferlen &&
+         (client->shm_state == PLAYERTCP_SHM_REPLY))
+      {
+        client->shm_state = PLAYERTCP_SHM_ACTIVE;
+        client->encoding = PLAYER_ENCODING_RAW;
+      }
+      else if(!client->writebufferlen &&
+              (client->shm_state == PLAYERTCP_SHM_STREAM))
+        client->shm_state = PLAYERTCP_SHM_ACTIVE;
     }
     // try to pop a pending message
     else if((msg = client->queue->Pop()))
@@ -695,6 +880,7 @@ PlayerTCP::WriteClient(int cli)
       // instances of the message on other queues.
       hdr = *msg->GetHeader();
       payload = msg->GetPayload();
+      client->trace_msg = msg->RefCount;
 
       // Make sure there's room in the buffer for the encoded messsage.
       // 4 times the message (including dynamic data) is a safe upper bound
@@ -756,11 +942,23 @@ PlayerTCP::WriteClient(int cli)
 #endif
       }
 
+      // The replies to encoding and shared memory requests are always
+      // XDR-encoded; what they grant applies to the messages after them.
+      encoding_reply = (hdr.addr.interf == PLAYER_PLAYER_CODE) &&
+              (hdr.type == PLAYER_MSGTYPE_RESP_ACK) &&
+              (hdr.subtype == PLAYER_PLAYER_REQ_ENCODING);
+      shm_reply = (hdr.addr.interf == PLAYER_PLAYER_CODE) &&
+              (hdr.type == PLAYER_MSGTYPE_RESP_ACK) &&
+              (hdr.subtype == PLAYER_PLAYER_REQ_SHM);
+      encoding = (encoding_reply || shm_reply) ?
+              PLAYER_ENCODING_XDR : client->encoding;
+
       if (payload)
       {
         // Locate the appropriate packing function
-        if(!(packfunc = playerxdr_get_packfunc(hdr.addr.interf,
-                                               hdr.type, hdr.subtype)))
+        if(!(packfunc = playerxdr_get_encodefunc(hdr.addr.interf,
+                                                 hdr.type, hdr.subtype,
+                                                 encoding)))
         {
           // TODO: Allow the user to register a callback to handle unsupported messages
           PLAYER_WARN4("skipping message from %s:%u with unsupported type %s:%u",
@@ -769,10 +967,15 @@ PlayerTCP::WriteClient(int cli)
         else
         {
           // Encode the body first
-          if((encode_msglen =
+          PLAYER_TRACE(PLAYER_TRACE_ENCODE, PLAYER_TRACE_BEGIN, msg->RefCount,
+                       client, &hdr, 0);
+          encode_msglen =
               (*packfunc)(client->writebuffer + PLAYERXDR_MSGHDR_SIZE,
                         maxsize - PLAYERXDR_MSGHDR_SIZE,
-                        payload, PLAYERXDR_ENCODE)) < 0)
+                        payload, PLAYERXDR_ENCODE);
+          PLAYER_TRACE(PLAYER_TRACE_ENCODE, PLAYER_TRACE_END, msg->RefCount,
+                       client, &hdr, (encode_msglen > 0) ? encode_msglen : 0);
+          if(encode_msglen < 0)
           {
             PLAYER_WARN4("encoding failed on message from %s:%u with type %s:%u",
                        interf_to_str(hdr.addr.interf), hdr.addr.index, msgtype_to_str(hdr.type), hdr.subtype);
@@ -788,6 +991,12 @@ PlayerTCP::WriteClient(int cli)
             delete msg;
             return(0);
           }
+          if(encoding_reply)
+            client->encoding =
+                    ((player_device_encoding_req_t*)payload)->encoding;
+          if(shm_reply && ((player_device_shm_req_t*)payload)->enable &&
+             (client->shm_state == PLAYERTCP_SHM_PENDING))
+            client->shm_state = PLAYERTCP_SHM_REPLY;
         }
       }
       else
@@ -1055,7 +1264,12 @@ PlayerTCP::ParseBuffer(int cli)
           {
             Message* msg = new Message(hdr, msg_data, client->queue);
             assert(msg);
-            this->HandlePlayerMessage(cli, msg);
+            if((client->replies != NULL) &&
+               ((hdr.type == PLAYER_MSGTYPE_RESP_ACK) ||
+                (hdr.type == PLAYER_MSGTYPE_RESP_NACK)))
+              client->replies->Push(*msg);
+            else
+              this->HandlePlayerMessage(cli, msg);
             delete msg;
 
             // Non-obvious thing: as a result of HandlePlayerMessage(), the
@@ -1255,6 +1469,7 @@ PlayerTCP::HandlePlayerMessage(int cli, Message* msg)
                     PLAYER_WARN("failed to record unsubscription");
                   else
                     client->dev_subs[i] = NULL;
+                  this->StopMulticast(cli, device);
                 }
                 break;
               default:
@@ -1367,6 +1582,274 @@ PlayerTCP::HandlePlayerMessage(int cli, Message* msg)
           break;
         }
 
+        // Request to take a device's data from its multicast group
+        case PLAYER_PLAYER_REQ_MULTICAST:
+        {
+          player_device_multicast_req_t* mreq;
+          player_device_multicast_req_t mresp;
+          Device* device;
+          size_t i;
+
+          mreq = (player_device_multicast_req_t*)payload;
+
+          mreq->addr.host = this->host;
+          mreq->addr.robot = client->port;
+          device = deviceTable->GetDevice(mreq->addr,false);
+          for(i=0;device && (i<client->num_dev_subs);i++)
+          {
+            if(client->dev_subs[i] == device)
+              break;
+          }
+          if(!device || (i==client->num_dev_subs))
+          {
+            PLAYER_WARN2("refusing multicast request for unsubscribed device %s:%u",
+                         interf_to_str(mreq->addr.interf), mreq->addr.index);
+            resphdr.type = PLAYER_MSGTYPE_RESP_NACK;
+            resp = new Message(resphdr, NULL);
+            assert(resp);
+            client->queue->Push(*resp);
+            delete resp;
+            break;
+          }
+
+          memset(&mresp,0,sizeof(mresp));
+          mresp.addr = mreq->addr;
+
+          for(i=0;i<client->num_mcast_subs;i++)
+          {
+            if(client->mcast_subs[i] == device)
+              break;
+          }
+          if(mreq->enable && (i==client->num_mcast_subs) &&
+             device->multicast_port && this->multicast_fn &&
+             ((*this->multicast_fn)(this->multicast_arg, device, true) == 0))
+          {
+            // record it, reusing a free slot if there is one
+            for(i=0;i<client->num_mcast_subs;i++)
+            {
+              if(!client->mcast_subs[i])
+                break;
+            }
+            if(i==client->num_mcast_subs)
+            {
+              client->num_mcast_subs++;
+              client->mcast_subs =
+                      (Device**)realloc(client->mcast_subs,
+                                        sizeof(Device*)*
+                                        client->num_mcast_subs);
+              assert(client->mcast_subs);
+              client->mcast_rules =
+                      (MessageReplaceRule**)realloc(client->mcast_rules,
+                                                    sizeof(MessageReplaceRule*)*
+                                                    client->num_mcast_subs);
+              assert(client->mcast_rules);
+            }
+            client->mcast_subs[i] = device;
+            // the connection is left with replies and the data of
+            // devices that are not on a group
+            playertcp_nodelay(client->fd);
+            // Stop the unicast copies of this device's data; the rule goes
+            // ahead of any the client has set itself, and is remembered so
+            // that StopMulticast() takes out this one and no other.
+            client->mcast_rules[i] =
+                    client->queue->PushReplaceRule(device->addr.host,
+                                                   device->addr.robot,
+                                                   device->addr.interf,
+                                                   device->addr.index,
+                                                   PLAYER_MSGTYPE_DATA, -1,
+                                                   PLAYER_PLAYER_MSG_REPLACE_RULE_IGNORE);
+          }
+          else if(!mreq->enable)
+            this->StopMulticast(cli, device);
+
+          // Tell the client where the data is now
+          for(i=0;i<client->num_mcast_subs;i++)
+          {
+            if(client->mcast_subs[i] == device)
+            {
+              mresp.enable = 1;
+              mresp.group = device->multicast_group;
+              mresp.port = device->multicast_port;
+              break;
+            }
+          }
+
+          resphdr.type = PLAYER_MSGTYPE_RESP_ACK;
+          resp = new Message(resphdr, (void*)&mresp, true);
+          assert(resp);
+          client->queue->Push(*resp);
+          delete resp;
+          break;
+        }
+
+        // Request change of the encoding of what we send
+        case PLAYER_PLAYER_REQ_ENCODING:
+        {
+          player_device_encoding_req_t* ereq;
+          player_device_encoding_req_t eresp;
+
+          ereq = (player_device_encoding_req_t*)payload;
+
+          // Raw only if the client's structures are laid out as ours; an
+          // empty request just asks for our layout
+          memset(&eresp,0,sizeof(eresp));
+          eresp.layout = playerxdr_raw_layout();
+          if(ereq && (ereq->encoding == PLAYER_ENCODING_RAW) &&
+             (ereq->layout == eresp.layout))
+            eresp.encoding = PLAYER_ENCODING_RAW;
+          else
+            eresp.encoding = PLAYER_ENCODING_XDR;
+
+          // The switch happens in WriteClient(), when this reply goes
+          // out, so that what is queued ahead of it is encoded as the
+          // client expects.
+          resphdr.type = PLAYER_MSGTYPE_RESP_ACK;
+          resp = new Message(resphdr, (void*)&eresp, true);
+          assert(resp);
+          client->queue->Push(*resp);
+          delete resp;
+          break;
+        }
+
+        // Request delivery through a shared memory ring
+        case PLAYER_PLAYER_REQ_SHM:
+        {
+          player_device_shm_req_t* sreq;
+          player_device_shm_req_t sresp;
+
+          sreq = (player_device_shm_req_t*)payload;
+
+          memset(&sresp,0,sizeof(sresp));
+          sresp.layout = playerxdr_raw_layout();
+          if(sreq)
+          {
+            sresp.name_count = sreq->name_count;
+            memcpy(sresp.name, sreq->name, sizeof(sresp.name));
+            sresp.name[sizeof(sresp.name)-1] = '\0';
+          }
+
+          // Only for clients on this machine, whose structures are laid
+          // out as ours, and only once
+          if(sreq && !client->shm && (sreq->layout == sresp.layout) &&
+             (client->addr.sin_family == AF_INET) &&
+             ((ntohl(client->addr.sin_addr.s_addr) >> 24) == 127))
+          {
+            client->shm = (shmring_t*)malloc(sizeof(shmring_t));
+            assert(client->shm);
+            if(shmring_attach(client->shm, sresp.name) == 0)
+            {
+              PLAYER_MSG2(2, "client %d takes its messages from shared memory ring %s",
+                          client->port, sresp.name);
+              client->shm_state = PLAYERTCP_SHM_PENDING;
+              sresp.enable = 1;
+              // the connection is left with replies, doorbells and the
+              // odd message that does not fit into the ring
+              playertcp_nodelay(client->fd);
+            }
+            else
+            {
+              PLAYER_WARN1("failed to attach to shared memory ring %s",
+                           sresp.name);
+              free(client->shm);
+              client->shm = NULL;
+            }
+          }
+
+          // The switch happens in WriteClient(), once this reply is out
+          resphdr.type = PLAYER_MSGTYPE_RESP_ACK;
+          resp = new Message(resphdr, (void*)&sresp, true);
+          assert(resp);
+          client->queue->Push(*resp);
+          delete resp;
+          break;
+        }
+
+        // Request for the performance counters
+        case PLAYER_PLAYER_REQ_STATS:
+        {
+          player_device_stats_req_t stats;
+          Driver** drivers;
+          Device* device;
+          int numdevices = 0;
+
+          memset(&stats,0,sizeof(stats));
+          GlobalTime->GetTimeDouble(&stats.time);
+
+          // The devices listed by PLAYER_PLAYER_REQ_DEVLIST, and the
+          // drivers behind them, each once
+          for(device = deviceTable->GetFirstDevice();
+              device;
+              device = deviceTable->GetNextDevice(device))
+          {
+            if((int)device->addr.robot == client->port && (device->addr.host==host))
+              numdevices++;
+          }
+          stats.devices = (player_stats_device_t*)calloc(numdevices + 1,
+                                                        sizeof(player_stats_device_t));
+          stats.drivers = (player_stats_driver_t*)calloc(numdevices + 1,
+                                                        sizeof(player_stats_driver_t));
+          drivers = (Driver**)calloc(numdevices + 1, sizeof(Driver*));
+          assert(stats.devices && stats.drivers && drivers);
+          for(device = deviceTable->GetFirstDevice();
+              device && ((int)stats.devices_count < numdevices);
+              device = deviceTable->GetNextDevice(device))
+          {
+            if(!((int)device->addr.robot == client->port && (device->addr.host==host)))
+              continue;
+            player_stats_device_t* dstats = stats.devices + stats.devices_count++;
+            dstats->addr = device->addr;
+            dstats->publishes = PLAYER_STAT_GET(device->publishes);
+            dstats->subscriptions = device->GetSubscriptionCount();
+            dstats->driver = -1;
+            if(!device->driver)
+              continue;
+            uint32_t j;
+            for(j = 0; j < stats.drivers_count; j++)
+            {
+              if(drivers[j] == device->driver)
+                break;
+            }
+            if(j == stats.drivers_count)
+            {
+              player_stats_driver_t* drstats = stats.drivers + stats.drivers_count++;
+              drivers[j] = device->driver;
+              device->driver->GetStats(drstats);
+              strncpy(drstats->name, device->drivername, sizeof(drstats->name));
+              drstats->name[sizeof(drstats->name)-1] = '\0';
+              drstats->name_count = strlen(drstats->name) + 1;
+            }
+            dstats->driver = j;
+          }
+          free(drivers);
+
+          stats.clients = (player_stats_client_t*)calloc(this->num_clients + 1,
+                                                        sizeof(player_stats_client_t));
+          assert(stats.clients);
+          for(int i = 0; i < this->num_clients; i++)
+          {
+            playertcp_conn_t* c = this->clients + i;
+            if(!c->valid || c->del)
+              continue;
+            player_stats_client_t* cstats = stats.clients + stats.clients_count++;
+            cstats->host = c->addr.sin_addr.s_addr;
+            cstats->port = ntohs(c->addr.sin_port);
+            cstats->server_port = c->port;
+            cstats->encoding = c->encoding;
+            cstats->shm = (c->shm_state >= PLAYERTCP_SHM_ACTIVE);
+            c->queue->GetStats(&cstats->queue);
+          }
+
+          resphdr.type = PLAYER_MSGTYPE_RESP_ACK;
+          resp = new Message(resphdr, (void*)&stats, true);
+          assert(resp);
+          client->queue->Push(*resp);
+          delete resp;
+          free(stats.devices);
+          free(stats.drivers);
+          free(stats.clients);
+          break;
+        }
+
         // Request change of data mode
         case PLAYER_PLAYER_REQ_DATAMODE:
         {
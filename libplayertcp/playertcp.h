@@ -135,6 +135,10 @@ struct pollfd;
 struct playertcp_listener;
 struct playertcp_conn;
 
+/** Callback used to start (@p join true) or stop publishing a device on
+    its multicast group; returns 0 on success.  See PlayerTCP::SetMulticast(). */
+typedef int (*playertcp_multicast_fn_t)(void* arg, Device* device, bool join);
+
 class PLAYERTCP_EXPORT PlayerTCP
 {
   private:
@@ -154,6 +158,12 @@ class PLAYERTCP_EXPORT PlayerTCP
     /** Total size of @p decode_readbuffer */
     int decode_readbuffersize;
 
+    /** Multicast publisher, if any */
+    playertcp_multicast_fn_t multicast_fn;
+    void* multicast_arg;
+
+    void StopMulticast(int cli, Device* device);
+
   public:
     PlayerTCP();
     ~PlayerTCP();
@@ -194,6 +204,16 @@ class PLAYERTCP_EXPORT PlayerTCP
     void ParseBuffer(int cli);
     int HandlePlayerMessage(int cli, Message* msg);
     void DeleteClient(QueuePointer &q, bool have_lock);
+    /** Send the replies to player interface requests (subscriptions)
+     * that arrive on connection @p q to @p replies instead of handling
+     * them here.  Used by TCPRemoteDriver, which sends such requests on
+     * its connections to remote servers. */
+    void SetReplyQueue(QueuePointer &q, QueuePointer &replies, bool have_lock);
+    /** Set the function that publishes devices on their multicast groups
+     * (normally PlayerUDP::JoinGroup() / LeaveGroup()).  Without one,
+     * PLAYER_PLAYER_REQ_MULTICAST requests leave data on the TCP
+     * connection. */
+    void SetMulticast(playertcp_multicast_fn_t fn, void* arg);
     bool Listening(int port);
     uint32_t GetHost() {return host;};
 };
@@ -47,6 +47,9 @@
 #include <assert.h>
 #include <string.h>
 #include <fcntl.h>
+#if !defined (WIN32)
+  #include <sys/uio.h>
+#endif
 
 #if HAVE_Z
   #include <zlib.h>
@@ -72,6 +75,18 @@ typedef struct playerudp_listener
   int port;
 } playerudp_listener_t;
 
+/** @brief An outgoing datagram: a frame header plus a slice of the
+ * connection's write buffer */
+typedef struct playerudp_frame
+{
+  /** Packed frame header */
+  char hdr[UDPFRAME_HDR_SIZE];
+  /** Offset of the payload in the write buffer */
+  int offset;
+  /** Length of the payload */
+  int len;
+} playerudp_frame_t;
+
 /** @brief A UDP Connection */
 typedef struct playerudp_conn
 {
@@ -101,12 +116,32 @@ typedef struct playerudp_conn
   char* writebuffer;
   /** Total size of @p writebuffer */
   int writebuffersize;
-  /** How much of @p writebuffer is currently in use (i.e., holding a
-    partial message) */
+  /** How much of @p writebuffer is currently in use (i.e., holding
+    encoded messages that have not been sent yet) */
   int writebufferlen;
+  /** Frames referring to @p writebuffer */
+  playerudp_frame_t* frames;
+  /** Total size of @p frames */
+  int frames_size;
+  /** Number of frames in @p frames */
+  int num_frames;
+  /** How many of @p frames have been sent */
+  int sent_frames;
+  /** Sequence number of the next outgoing message */
+  uint32_t seq;
+  /** Reassembly of incoming fragmented messages */
+  udpframe_reasm_t* reasm;
   /** Linked list of devices to which we are subscribed */
   Device** dev_subs;
   size_t num_dev_subs;
+  /** For a multicast group, the device published on it (NULL for
+   * ordinary clients) */
+  Device* group;
+  /** Number of JoinGroup() references held on the group */
+  int group_refs;
+  /** Encoding of the message bodies we send (PLAYER_ENCODING_*); always
+   * XDR for multicast groups, whose receivers are unknown */
+  int encoding;
   /** Flag that we should set to true when we kill the client.
    * TCPRemoteDriver uses this flag to know when the connection has been
    * closed, and thus that it should stop publishing to its queue. */
@@ -144,6 +179,11 @@ PlayerUDP::PlayerUDP()
   assert(this->decode_readbuffer);
   this->decode_readbufferlen = 0;
 
+  // Create the buffers for batches of incoming datagrams
+  this->recv_buffers = (char*)malloc(PLAYERUDP_BATCH_SIZE *
+                                     (UDPFRAME_MAX_SIZE + 1));
+  assert(this->recv_buffers);
+
   if(hostname_to_packedaddr(&this->host,"localhost") < 0)
   {
     PLAYER_WARN("address lookup failed for localhost");
@@ -162,6 +202,7 @@ PlayerUDP::~PlayerUDP()
   free(this->listeners);
   free(this->listen_ufds);
   free(this->decode_readbuffer);
+  free(this->recv_buffers);
 
 #if defined (WIN32)
   // Clean up the Windows sockets API (this can safely be done as many times as we like)
@@ -194,6 +235,16 @@ PlayerUDP::Listen(int* ports, int num_ports)
     }
     this->listeners[i].port = ports[i];
 
+    // Large messages arrive as bursts of fragments; give the kernel room
+    // to queue them.  Not fatal if the system caps the size.
+    int bufsize = PLAYERUDP_SOCKET_BUFFER_SIZE;
+    if(setsockopt(this->listeners[i].fd, SOL_SOCKET, SO_RCVBUF,
+                  (const char*)&bufsize, sizeof(bufsize)) < 0)
+      PLAYER_WARN("failed to set UDP receive buffer size");
+    if(setsockopt(this->listeners[i].fd, SOL_SOCKET, SO_SNDBUF,
+                  (const char*)&bufsize, sizeof(bufsize)) < 0)
+      PLAYER_WARN("failed to set UDP send buffer size");
+
     // set up for later use of poll() to accept() connections on this port
     this->listen_ufds[i].fd = this->listeners[i].fd;
     this->listen_ufds[i].events = POLLIN;
@@ -240,6 +291,9 @@ PlayerUDP::AddClient(struct sockaddr_in* cliaddr,
   this->clients[j].addr = *cliaddr;
   this->clients[j].dev_subs = NULL;
   this->clients[j].num_dev_subs = 0;
+  this->clients[j].group = NULL;
+  this->clients[j].group_refs = 0;
+  this->clients[j].encoding = PLAYER_ENCODING_XDR;
   this->clients[j].kill_flag = kill_flag;
 
   // Create an outgoing queue for this client
@@ -260,6 +314,15 @@ PlayerUDP::AddClient(struct sockaddr_in* cliaddr,
   assert(this->clients[j].writebuffer);
   this->clients[j].writebufferlen = 0;
 
+  // Outgoing frames and incoming reassembly
+  this->clients[j].frames = NULL;
+  this->clients[j].frames_size = 0;
+  this->clients[j].num_frames = 0;
+  this->clients[j].sent_frames = 0;
+  this->clients[j].seq = 0;
+  this->clients[j].reasm = udpframe_reasm_alloc(PLAYERUDP_REASM_SLOTS);
+  assert(this->clients[j].reasm);
+
   this->num_clients++;
 
   if(send_banner)
@@ -323,6 +386,8 @@ PlayerUDP::Close(int cli)
     delete msg;
   free(this->clients[cli].readbuffer);
   free(this->clients[cli].writebuffer);
+  free(this->clients[cli].frames);
+  udpframe_reasm_free(this->clients[cli].reasm);
   if(this->clients[cli].kill_flag)
     *(this->clients[cli].kill_flag) = 1;
 }
@@ -330,11 +395,8 @@ PlayerUDP::Close(int cli)
 int
 PlayerUDP::Read(int timeout)
 {
-  struct sockaddr_in fromaddr;
-  socklen_t fromlen = sizeof(fromaddr);
   int num_available;
-  playerudp_conn_t* client;
-  int cli;
+  int num_read;
 
   // Poll for incoming messages
   if((num_available = poll(this->listen_ufds, num_listeners, timeout)) < 0)
@@ -355,116 +417,184 @@ PlayerUDP::Read(int timeout)
   {
     if(this->listen_ufds[i].revents & POLLIN)
     {
-      /* Read into the decode_readbuffer, which is big enough to hold a
-       * single UDP datagram */
-      if((this->decode_readbufferlen = recvfrom(this->listen_ufds[i].fd,
-                                                this->decode_readbuffer,
-                                                PLAYERUDP_READBUFFER_SIZE,
-                                                0,
-                                                (struct sockaddr*)&fromaddr,
-                                                &fromlen)) < 0)
-      {
-#if defined (WIN32)
-          LPVOID buffer = NULL;
-          FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, NULL,
-                        ErrNo, 0, reinterpret_cast<LPTSTR> (&buffer), 0, NULL);
-          PLAYER_ERROR2("recvfrom() failed on port %d: %s", this->listeners[i].port, reinterpret_cast<LPTSTR> (buffer));
-          LocalFree(buffer);
-#else
-          PLAYER_ERROR2("recvfrom() failed on port %d: %s", this->listeners[i].port, strerror(ErrNo));
-#endif
-      }
-      else
+      if((num_read = this->ReadBatch(i)) > 0)
       {
         pthread_mutex_lock(&this->clients_mutex);
+        for(int j=0; j<num_read; j++)
+          this->HandleDatagram(i, this->recv_addrs + j,
+                               this->recv_buffers + j * (UDPFRAME_MAX_SIZE + 1),
+                               this->recv_lens[j]);
+        pthread_mutex_unlock(&this->clients_mutex);
+      }
+      num_available--;
+    }
+  }
 
-        // Do we know about this one already?
-        for(cli=0; cli<this->num_clients; cli++)
-        {
-          client = this->clients + cli;
-          if((client->addr.sin_addr.s_addr == fromaddr.sin_addr.s_addr) &&
-             (client->addr.sin_port == fromaddr.sin_port))
-          {
-            // Matched.
+  return(0);
+}
 
-            // An empty datagram signals a new client, even if he's
-            // using an old port
-            if(!this->decode_readbufferlen)
-            {
-              client->del = 1;
-              cli = this->num_clients;
-              break;
-            }
+// Read as many datagrams as are waiting on a listener (up to
+// PLAYERUDP_BATCH_SIZE) into recv_buffers.  Returns the number read.
+int
+PlayerUDP::ReadBatch(int listener)
+{
+  const int stride = UDPFRAME_MAX_SIZE + 1;
+  int num_read;
 
-            // Might we need more room to assemble the current partial message?
-            if((client->readbuffersize - client->readbufferlen) <
-               this->decode_readbufferlen)
-            {
-              // Get twice as much space.
-              client->readbuffersize *= 2;
-              // Did we hit the limit (or overflow and become negative)?
-              if((client->readbuffersize >= PLAYERXDR_MAX_MESSAGE_SIZE) ||
-                 (client->readbuffersize < 0))
-              {
-                PLAYER_WARN2("allocating maximum %d bytes to client %d's read buffer",
-                             PLAYERXDR_MAX_MESSAGE_SIZE, cli);
-                client->readbuffersize = PLAYERXDR_MAX_MESSAGE_SIZE;
-              }
-              client->readbuffer = (char*)realloc(client->readbuffer,
-                                                  client->readbuffersize);
-              assert(client->readbuffer);
-              memset(client->readbuffer + client->readbufferlen, 0,
-                     client->readbuffersize - client->readbufferlen);
-            }
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[PLAYERUDP_BATCH_SIZE];
+  struct iovec iovs[PLAYERUDP_BATCH_SIZE];
 
-            // Having allocated more space, are we full?
-            if((client->readbuffersize - client->readbufferlen) <
-               this->decode_readbufferlen)
-            {
-              PLAYER_WARN2("client %d's buffer is full (%d bytes)",
-                           cli, client->readbufferlen);
-            }
-            else
-            {
-              // Copy the new datagram into the client's buffer
-              memcpy(client->readbuffer + client->readbufferlen,
-                     this->decode_readbuffer, this->decode_readbufferlen);
-              client->readbufferlen += this->decode_readbufferlen;
+  memset(msgs, 0, sizeof(msgs));
+  for(int j=0; j<PLAYERUDP_BATCH_SIZE; j++)
+  {
+    iovs[j].iov_base = this->recv_buffers + j * stride;
+    iovs[j].iov_len = stride;
+    msgs[j].msg_hdr.msg_name = this->recv_addrs + j;
+    msgs[j].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    msgs[j].msg_hdr.msg_iov = iovs + j;
+    msgs[j].msg_hdr.msg_iovlen = 1;
+  }
 
-              // Try to parse the data received so far
-              this->ParseBuffer(cli);
-            }
+  if((num_read = recvmmsg(this->listen_ufds[listener].fd, msgs,
+                          PLAYERUDP_BATCH_SIZE, MSG_DONTWAIT, NULL)) < 0)
+  {
+    if(ErrNo == ERRNO_EAGAIN)
+      return(0);
+    PLAYER_ERROR2("recvmmsg() failed on port %d: %s",
+                  this->listeners[listener].port, strerror(ErrNo));
+    return(-1);
+  }
 
-            break;
-          }
-        }
+  for(int j=0; j<num_read; j++)
+    this->recv_lens[j] = msgs[j].msg_len;
+#else
+  socklen_t fromlen = sizeof(struct sockaddr_in);
+
+  if((this->recv_lens[0] = recvfrom(this->listen_ufds[listener].fd,
+                                    this->recv_buffers, stride, 0,
+                                    (struct sockaddr*)this->recv_addrs,
+                                    &fromlen)) < 0)
+  {
+    if(ErrNo == ERRNO_EAGAIN)
+      return(0);
+#if defined (WIN32)
+    LPVOID buffer = NULL;
+    FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, NULL,
+                  ErrNo, 0, reinterpret_cast<LPTSTR> (&buffer), 0, NULL);
+    PLAYER_ERROR2("recvfrom() failed on port %d: %s", this->listeners[listener].port, reinterpret_cast<LPTSTR> (buffer));
+    LocalFree(buffer);
+#else
+    PLAYER_ERROR2("recvfrom() failed on port %d: %s", this->listeners[listener].port, strerror(ErrNo));
+#endif
+    return(-1);
+  }
+  num_read = 1;
+#endif
+
+  return(num_read);
+}
+
+// Should be called with clients_mutex lock held
+void
+PlayerUDP::HandleDatagram(int listener, struct sockaddr_in* fromaddr,
+                          const char* data, int len)
+{
+  playerudp_conn_t* client;
+  const char* msg;
+  size_t msglen;
+  int cli;
+  int ret;
+
+  // Do we know about this one already?
+  for(cli=0; cli<this->num_clients; cli++)
+  {
+    client = this->clients + cli;
+    if((client->addr.sin_addr.s_addr == fromaddr->sin_addr.s_addr) &&
+       (client->addr.sin_port == fromaddr->sin_port))
+    {
+      // Matched.
 
-        this->DeleteClients();
+      // An empty datagram signals a new client, even if he's
+      // using an old port
+      if(!len)
+      {
+        client->del = 1;
+        cli = this->num_clients;
+        break;
+      }
 
-        if(cli >= this->num_clients)
+      if((ret = udpframe_reasm_add(client->reasm, data, len,
+                                   &msg, &msglen)) < 0)
+      {
+        PLAYER_MSG2(5, "dropping invalid or stale datagram (%d bytes) from client %d",
+                    len, cli);
+        break;
+      }
+      else if(ret == 0)
+      {
+        // Waiting for more fragments
+        break;
+      }
+
+      // Might we need more room to assemble the current partial message?
+      if((size_t)(client->readbuffersize - client->readbufferlen) < msglen)
+      {
+        // Get at least twice as much space.
+        client->readbuffersize = MAX((size_t)(client->readbuffersize * 2),
+                                     client->readbufferlen + msglen);
+        // Did we hit the limit (or overflow and become negative)?
+        if((client->readbuffersize >= PLAYERXDR_MAX_MESSAGE_SIZE) ||
+           (client->readbuffersize < 0))
         {
-          // No match; must be a new client
-          this->AddClient(&fromaddr,
-                          this->host,
-                          this->listeners[i].port,
-                          this->listeners[i].fd,
-                          true, NULL);
-
-          if(this->decode_readbufferlen > 0)
-          {
-            PLAYER_WARN1("non-empty (%u bytes) initial message from UDP client",
-                         this->decode_readbufferlen);
-          }
+          PLAYER_WARN2("allocating maximum %d bytes to client %d's read buffer",
+                       PLAYERXDR_MAX_MESSAGE_SIZE, cli);
+          client->readbuffersize = PLAYERXDR_MAX_MESSAGE_SIZE;
         }
+        client->readbuffer = (char*)realloc(client->readbuffer,
+                                            client->readbuffersize);
+        assert(client->readbuffer);
+        memset(client->readbuffer + client->readbufferlen, 0,
+               client->readbuffersize - client->readbufferlen);
+      }
 
-        num_available--;
+      // Having allocated more space, are we full?
+      if((size_t)(client->readbuffersize - client->readbufferlen) < msglen)
+      {
+        PLAYER_WARN2("client %d's buffer is full (%d bytes)",
+                     cli, client->readbufferlen);
+      }
+      else
+      {
+        // Copy the new message into the client's buffer
+        memcpy(client->readbuffer + client->readbufferlen, msg, msglen);
+        client->readbufferlen += msglen;
 
-        pthread_mutex_unlock(&this->clients_mutex);
+        // Try to parse the data received so far
+        this->ParseBuffer(cli);
       }
+
+      break;
     }
   }
 
-  return(0);
+  this->DeleteClients();
+
+  if(cli >= this->num_clients)
+  {
+    // No match; must be a new client
+    this->AddClient(fromaddr,
+                    this->host,
+                    this->listeners[listener].port,
+                    this->listeners[listener].fd,
+                    true, NULL);
+
+    if(len > 0)
+    {
+      PLAYER_WARN1("non-empty (%u bytes) initial message from UDP client",
+                   len);
+    }
+  }
 }
 
 // Should be called with clients_mutex lock held
@@ -532,6 +662,108 @@ PlayerUDP::DeleteClient(MessageQueue* q)
   }
 }
 
+// Multicast groups are kept as extra "clients" with their own socket and
+// the group as the remote address, so that they share the encoding and
+// sending path with ordinary UDP clients.
+int
+PlayerUDP::JoinGroup(Device* device)
+{
+  struct sockaddr_in addr;
+  unsigned char ttl = PLAYERUDP_MULTICAST_TTL;
+  unsigned char loop = 1;
+  int bufsize = PLAYERUDP_SOCKET_BUFFER_SIZE;
+  int sock;
+  int i;
+
+  if(!device->multicast_port)
+    return(-1);
+
+  pthread_mutex_lock(&this->clients_mutex);
+
+  // Already publishing?
+  for(i=0;i<this->num_clients;i++)
+  {
+    if(!this->clients[i].del && (this->clients[i].group == device))
+    {
+      this->clients[i].group_refs++;
+      pthread_mutex_unlock(&this->clients_mutex);
+      return(0);
+    }
+  }
+
+  if((sock = _create_and_bind_udp_socket(0,INADDR_ANY,0)) < 0)
+  {
+    PLAYER_ERROR("_create_and_bind_udp_socket() failed");
+    pthread_mutex_unlock(&this->clients_mutex);
+    return(-1);
+  }
+  // Loopback is left on so that clients on this host can join
+  if(setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL,
+                (const char*)&ttl, sizeof(ttl)) < 0)
+    PLAYER_WARN("failed to set multicast TTL");
+  if(setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP,
+                (const char*)&loop, sizeof(loop)) < 0)
+    PLAYER_WARN("failed to enable multicast loopback");
+  if(setsockopt(sock, SOL_SOCKET, SO_SNDBUF,
+                (const char*)&bufsize, sizeof(bufsize)) < 0)
+    PLAYER_WARN("failed to set UDP send buffer size");
+
+  memset(&addr,0,sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = device->multicast_group;
+  addr.sin_port = htons(device->multicast_port);
+
+  QueuePointer queue = this->AddClient(&addr, this->host,
+                                       device->multicast_port, sock,
+                                       false, NULL);
+  playerudp_conn_t* group = this->clients + (this->num_clients - 1);
+  group->group = device;
+  group->group_refs = 1;
+  // Multicast receivers never see a message they can't keep up with, so
+  // there is no point queueing more than the latest of each kind.
+  queue->SetReplace(true);
+
+  if(device->Subscribe(queue) != 0)
+  {
+    PLAYER_WARN("failed to subscribe multicast group to device");
+    group->del = 1;
+    this->DeleteClients();
+    pthread_mutex_unlock(&this->clients_mutex);
+    return(-1);
+  }
+  group->dev_subs = (Device**)calloc(1,sizeof(Device*));
+  assert(group->dev_subs);
+  group->dev_subs[0] = device;
+  group->num_dev_subs = 1;
+
+  char groupstr[16];
+  packedaddr_to_dottedip(groupstr,sizeof(groupstr),device->multicast_group);
+  PLAYER_MSG4(1, "publishing %s:%u on multicast group %s:%u",
+              interf_to_str(device->addr.interf), device->addr.index,
+              groupstr, device->multicast_port);
+
+  pthread_mutex_unlock(&this->clients_mutex);
+  return(0);
+}
+
+void
+PlayerUDP::LeaveGroup(Device* device)
+{
+  pthread_mutex_lock(&this->clients_mutex);
+  for(int i=0;i<this->num_clients;i++)
+  {
+    if(!this->clients[i].del && (this->clients[i].group == device))
+    {
+      // The connection is closed (and the device unsubscribed) on the
+      // next pass through Write()
+      if(--this->clients[i].group_refs <= 0)
+        this->clients[i].del = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&this->clients_mutex);
+}
+
 bool
 PlayerUDP::Listening(int port)
 {
@@ -546,206 +778,296 @@ PlayerUDP::Listening(int port)
 int
 PlayerUDP::WriteClient(int cli)
 {
-  int numwritten;
   playerudp_conn_t* client;
   Message* msg;
+  int ret;
+
+  client = this->clients + cli;
+  for(;;)
+  {
+    // try to send any frames leftover from last time.
+    if(client->sent_frames < client->num_frames)
+    {
+      if((ret = this->SendFrames(cli)) <= 0)
+        return(ret);
+    }
+
+    // Everything has gone out; start a new batch
+    client->num_frames = 0;
+    client->sent_frames = 0;
+    client->writebufferlen = 0;
+
+    // Encode pending messages until there is a batch worth of frames
+    while((client->num_frames < PLAYERUDP_BATCH_SIZE) &&
+          (msg = client->queue->Pop()))
+    {
+      this->EncodeMessage(cli, msg);
+      delete msg;
+    }
+
+    if(!client->num_frames)
+      return(0);
+  }
+}
+
+// Encode a message at the end of the client's write buffer and split it
+// into frames.  Returns 0 on success, -1 if the message was skipped.
+int
+PlayerUDP::EncodeMessage(int cli, Message* msg)
+{
+  playerudp_conn_t* client;
   player_pack_fn_t packfunc;
   player_msghdr_t hdr;
+  udpframe_hdr_t fhdr;
   void* payload;
+  char* buf;
   int encode_msglen;
-  socklen_t addrlen = sizeof(struct sockaddr_in);
+  int msglen;
+  int nfrags;
+  int encoding;
+  bool encoding_reply;
 #if HAVE_Z
   player_map_data_t* zipped_data=NULL;
 #endif
 
   client = this->clients + cli;
-  for(;;)
+
+  // Note that we make a COPY of the header.  This is so that we can
+  // edit the size field before sending it out, without affecting other
+  // instances of the message on other queues.
+  hdr = *msg->GetHeader();
+  payload = msg->GetPayload();
+
+  // Make sure there's room in the buffer for the encoded messsage.
+  // 4 times the message (including dynamic data) is a safe upper bound
+  size_t maxsize = PLAYERXDR_MSGHDR_SIZE + (4 * msg->GetDataSize());
+  if(client->writebufferlen + maxsize > (size_t)(client->writebuffersize))
   {
-    // try to send any bytes leftover from last time.
-    if(client->writebufferlen)
+    // Get at least twice as much space
+    client->writebuffersize = MAX((size_t)(client->writebuffersize * 2),
+                                  client->writebufferlen + maxsize);
+    // Did we hit the limit (or overflow and become negative)?
+    if((client->writebuffersize >= PLAYERXDR_MAX_MESSAGE_SIZE) ||
+       (client->writebuffersize < 0))
     {
-      numwritten = sendto(client->fd,
-                          client->writebuffer,
-                          MIN(client->writebufferlen,
-                              PLAYERUDP_WRITEBUFFER_SIZE), 0,
-                          (struct sockaddr*)&client->addr, addrlen);
+      PLAYER_WARN1("allocating maximum %d bytes to outgoing message buffer",
+                   PLAYERXDR_MAX_MESSAGE_SIZE);
+      client->writebuffersize = PLAYERXDR_MAX_MESSAGE_SIZE;
+    }
+    client->writebuffer = (char*)realloc(client->writebuffer,
+                                         client->writebuffersize);
+    assert(client->writebuffer);
+    if(client->writebufferlen + maxsize > (size_t)(client->writebuffersize))
+      maxsize = client->writebuffersize - client->writebufferlen;
+  }
+  buf = client->writebuffer + client->writebufferlen;
 
-      if(numwritten < 0)
-      {
-        if(ErrNo == ERRNO_EAGAIN)
-        {
-          // buffers are full
-          return(0);
-        }
-        else
-        {
-#if defined (WIN32)
-          LPVOID buffer = NULL;
-          FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, NULL,
-                        ErrNo, 0, reinterpret_cast<LPTSTR> (&buffer), 0, NULL);
-          PLAYER_MSG1(2, "sendto() failed: %s", reinterpret_cast<LPTSTR> (buffer));
-          LocalFree(buffer);
+  // HACK: special handling for map data to compress it before sending
+  // them out over the network.
+  if((hdr.addr.interf == PLAYER_MAP_CODE) &&
+     (hdr.type == PLAYER_MSGTYPE_RESP_ACK) &&
+     (hdr.subtype == PLAYER_MAP_REQ_GET_DATA))
+  {
+#if HAVE_Z
+    player_map_data_t* raw_data = (player_map_data_t*)payload;
+    zipped_data = (player_map_data_t*)calloc(1,sizeof(player_map_data_t));
+    assert(zipped_data);
+
+    // copy the metadata
+    *zipped_data = *raw_data;
+    uLongf count = compressBound(raw_data->data_count);
+    zipped_data->data = (int8_t*)malloc(count);
+
+    // compress the tile
+    int ret;
+    ret = compress((Bytef*)zipped_data->data,&count,
+                   (const Bytef*)raw_data->data, raw_data->data_count);
+    if((ret != Z_OK) && (ret != Z_STREAM_END))
+    {
+      PLAYER_ERROR("failed to compress map data");
+      free(zipped_data->data);
+      free(zipped_data);
+      return(-1);
+    }
+
+    zipped_data->data_count = count;
+
+    // swap the payload pointer to point at the zipped version
+    payload = (void*)zipped_data;
 #else
-          PLAYER_MSG1(2,"sendto() failed: %s", strerror(ErrNo));
+    PLAYER_WARN("not compressing map data, because zlib was not found at compile time");
 #endif
-          return(-1);
-        }
-      }
-      else if(numwritten == 0)
-      {
-        PLAYER_MSG0(2,"wrote zero bytes");
-        return(-1);
-      }
+  }
 
-      memmove(client->writebuffer, client->writebuffer + numwritten,
-              client->writebufferlen - numwritten);
-      client->writebufferlen -= numwritten;
+  // The reply to an encoding request is always XDR-encoded; the encoding
+  // it grants applies to the messages after it.
+  encoding_reply = (hdr.addr.interf == PLAYER_PLAYER_CODE) &&
+          (hdr.type == PLAYER_MSGTYPE_RESP_ACK) &&
+          (hdr.subtype == PLAYER_PLAYER_REQ_ENCODING);
+  encoding = encoding_reply ? PLAYER_ENCODING_XDR : client->encoding;
+
+  encode_msglen = 0;
+  if (payload)
+  {
+    // Locate the appropriate packing function
+    if(!(packfunc = playerxdr_get_encodefunc(hdr.addr.interf,
+                                             hdr.type, hdr.subtype,
+                                             encoding)))
+    {
+      // TODO: Allow the user to register a callback to handle unsupported messages
+      PLAYER_WARN4("skipping message from %s:%u with unsupported type %s:%u",
+                   interf_to_str(hdr.addr.interf), hdr.addr.index, msgtype_to_str(hdr.type), hdr.subtype);
+      encode_msglen = -1;
     }
-    // try to pop a pending message
-    else if((msg = client->queue->Pop()))
+    // Encode the body first
+    else if((encode_msglen =
+             (*packfunc)(buf + PLAYERXDR_MSGHDR_SIZE,
+                         maxsize - PLAYERXDR_MSGHDR_SIZE,
+                         payload, PLAYERXDR_ENCODE)) < 0)
     {
-      // Note that we make a COPY of the header.  This is so that we can
-      // edit the size field before sending it out, without affecting other
-      // instances of the message on other queues.
-      hdr = *msg->GetHeader();
-      payload = msg->GetPayload();
-
-      // Make sure there's room in the buffer for the encoded messsage.
-      // 4 times the message (including dynamic data) is a safe upper bound
-      size_t maxsize = PLAYERXDR_MSGHDR_SIZE + (4 * msg->GetDataSize());
-      if(maxsize > (size_t)(client->writebuffersize))
-      {
-        // Get at least twice as much space
-        client->writebuffersize = MAX((size_t)(client->writebuffersize * 2),
-                                        maxsize);
-        // Did we hit the limit (or overflow and become negative)?
-        if((client->writebuffersize >= PLAYERXDR_MAX_MESSAGE_SIZE) ||
-           (client->writebuffersize < 0))
-        {
-          PLAYER_WARN1("allocating maximum %d bytes to outgoing message buffer",
-                         PLAYERXDR_MAX_MESSAGE_SIZE);
-          client->writebuffersize = PLAYERXDR_MAX_MESSAGE_SIZE;
-        }
-        client->writebuffer = (char*)realloc(client->writebuffer,
-                                               client->writebuffersize);
-        assert(client->writebuffer);
-        memset(client->writebuffer, 0, client->writebuffersize);
-      }
-
-      // HACK: special handling for map data to compress it before sending
-      // them out over the network.
-      if((hdr.addr.interf == PLAYER_MAP_CODE) &&
-         (hdr.type == PLAYER_MSGTYPE_RESP_ACK) &&
-         (hdr.subtype == PLAYER_MAP_REQ_GET_DATA))
-      {
+      PLAYER_WARN4("encoding failed on message from %s:%u with type %s:%u",
+                   interf_to_str(hdr.addr.interf), hdr.addr.index, msgtype_to_str(hdr.type), hdr.subtype);
+    }
+    else if(encoding_reply)
+      client->encoding = ((player_device_encoding_req_t*)payload)->encoding;
+  }
 #if HAVE_Z
-        player_map_data_t* raw_data = (player_map_data_t*)payload;
-        zipped_data = (player_map_data_t*)calloc(1,sizeof(player_map_data_t));
-        assert(zipped_data);
-
-        // copy the metadata
-        *zipped_data = *raw_data;
-        uLongf count = compressBound(raw_data->data_count);
-        zipped_data->data = (int8_t*)malloc(count);
-
-        // compress the tile
-        int ret;
-        ret = compress((Bytef*)zipped_data->data,&count,
-                         (const Bytef*)raw_data->data, raw_data->data_count);
-        if((ret != Z_OK) && (ret != Z_STREAM_END))
-        {
-          PLAYER_ERROR("failed to compress map data");
-          free(zipped_data);
-          client->writebufferlen = 0;
-          delete msg;
-          return(0);
-        }
+  if(zipped_data)
+  {
+    free(zipped_data->data);
+    free(zipped_data);
+    zipped_data=NULL;
+  }
+#endif
+  if(encode_msglen < 0)
+    return(-1);
+
+  // Rewrite the size in the header with the length of the encoded
+  // body, then encode the header.
+  hdr.size = encode_msglen;
+  if(player_msghdr_pack(buf, PLAYERXDR_MSGHDR_SIZE, &hdr,
+                        PLAYERXDR_ENCODE) < 0)
+  {
+    PLAYER_ERROR("failed to encode msg header");
+    return(-1);
+  }
+  msglen = PLAYERXDR_MSGHDR_SIZE + hdr.size;
 
-        zipped_data->data_count = count;
+  // Split the encoded message into frames
+  nfrags = udpframe_count(msglen);
+  if(client->num_frames + nfrags > client->frames_size)
+  {
+    client->frames_size = MAX(client->frames_size * 2,
+                              client->num_frames + nfrags);
+    client->frames = (playerudp_frame_t*)realloc(client->frames,
+                                                 client->frames_size *
+                                                 sizeof(playerudp_frame_t));
+    assert(client->frames);
+  }
+
+  fhdr.magic = UDPFRAME_MAGIC;
+  fhdr.flags = 0;
+  if(((hdr.type == PLAYER_MSGTYPE_DATA) || (hdr.type == PLAYER_MSGTYPE_CMD)) &&
+     (client->queue->CheckReplace(&hdr) == PLAYER_PLAYER_MSG_REPLACE_RULE_REPLACE))
+    fhdr.flags |= UDPFRAME_FLAG_REPLACE;
+  fhdr.seq = client->seq++;
+  fhdr.msglen = msglen;
+  udpframe_hdr_stream(&fhdr, &hdr);
+  fhdr.nfrags = nfrags;
+  for(int i=0; i<nfrags; i++)
+  {
+    playerudp_frame_t* frame = client->frames + client->num_frames + i;
+    fhdr.frag = i;
+    udpframe_hdr_pack(frame->hdr, &fhdr);
+    frame->offset = client->writebufferlen + i * UDPFRAME_MAX_PAYLOAD;
+    frame->len = MIN(UDPFRAME_MAX_PAYLOAD, msglen - i * UDPFRAME_MAX_PAYLOAD);
+  }
+  client->num_frames += nfrags;
+  client->writebufferlen += msglen;
+
+  return(0);
+}
+
+// Send the client's pending frames.  Returns 1 if they all went out, 0 if
+// the socket buffer filled up and -1 on error.
+int
+PlayerUDP::SendFrames(int cli)
+{
+  playerudp_conn_t* client;
+  playerudp_frame_t* frame;
+  int numwritten;
+
+  client = this->clients + cli;
+  while(client->sent_frames < client->num_frames)
+  {
+#if HAVE_SENDMMSG
+    struct mmsghdr msgs[PLAYERUDP_BATCH_SIZE];
+    struct iovec iovs[PLAYERUDP_BATCH_SIZE][2];
+    int count = MIN(PLAYERUDP_BATCH_SIZE,
+                    client->num_frames - client->sent_frames);
+
+    memset(msgs, 0, count * sizeof(struct mmsghdr));
+    for(int i=0; i<count; i++)
+    {
+      frame = client->frames + client->sent_frames + i;
+      iovs[i][0].iov_base = frame->hdr;
+      iovs[i][0].iov_len = UDPFRAME_HDR_SIZE;
+      iovs[i][1].iov_base = client->writebuffer + frame->offset;
+      iovs[i][1].iov_len = frame->len;
+      msgs[i].msg_hdr.msg_name = &client->addr;
+      msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+      msgs[i].msg_hdr.msg_iov = iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 2;
+    }
 
-        // swap the payload pointer to point at the zipped version
-        payload = (void*)zipped_data;
+    numwritten = sendmmsg(client->fd, msgs, count, 0);
 #else
-        PLAYER_WARN("not compressing map data, because zlib was not found at compile time");
+    char dgram[UDPFRAME_MAX_SIZE];
+
+    frame = client->frames + client->sent_frames;
+    memcpy(dgram, frame->hdr, UDPFRAME_HDR_SIZE);
+    memcpy(dgram + UDPFRAME_HDR_SIZE, client->writebuffer + frame->offset,
+           frame->len);
+    if((numwritten = sendto(client->fd, dgram, UDPFRAME_HDR_SIZE + frame->len,
+                            0, (struct sockaddr*)&client->addr,
+                            sizeof(struct sockaddr_in))) > 0)
+      numwritten = 1;
 #endif
-      }
 
-      if (payload)
+    if(numwritten < 0)
+    {
+      if(ErrNo == ERRNO_EAGAIN)
       {
-        // Locate the appropriate packing function
-        if(!(packfunc = playerxdr_get_packfunc(hdr.addr.interf,
-                                               hdr.type, hdr.subtype)))
-        {
-          // TODO: Allow the user to register a callback to handle unsupported messages
-          PLAYER_WARN4("skipping message from %s:%u with unsupported type %s:%u",
-                           interf_to_str(hdr.addr.interf), hdr.addr.index, msgtype_to_str(hdr.type), hdr.subtype);
-        }
-        else
-        {
-          // Encode the body first
-          if((encode_msglen =
-              (*packfunc)(client->writebuffer + PLAYERXDR_MSGHDR_SIZE,
-                        maxsize - PLAYERXDR_MSGHDR_SIZE,
-                        payload, PLAYERXDR_ENCODE)) < 0)
-          {
-            PLAYER_WARN4("encoding failed on message from %s:%u with type %s:%u",
-                       interf_to_str(hdr.addr.interf), hdr.addr.index, msgtype_to_str(hdr.type), hdr.subtype);
-#if HAVE_Z
-            if(zipped_data)
-            {
-              free(zipped_data->data);
-              free(zipped_data);
-              zipped_data=NULL;
-            }
-#endif
-            client->writebufferlen = 0;
-            delete msg;
-            return(0);
-          }
-        }
+        // buffers are full
+        return(0);
       }
       else
       {
-        encode_msglen = 0;
-      }
-      // Rewrite the size in the header with the length of the encoded
-      // body, then encode the header.
-      hdr.size = encode_msglen;
-      if((encode_msglen = player_msghdr_pack(client->writebuffer,
-                   PLAYERXDR_MSGHDR_SIZE, &hdr,
-                   PLAYERXDR_ENCODE)) < 0)
-      {
-        PLAYER_ERROR("failed to encode msg header");
-#if HAVE_Z
-        if(zipped_data)
-        {
-          free(zipped_data->data);
-          free(zipped_data);
-          zipped_data=NULL;
-        }
+#if defined (WIN32)
+        LPVOID buffer = NULL;
+        FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, NULL,
+                      ErrNo, 0, reinterpret_cast<LPTSTR> (&buffer), 0, NULL);
+        PLAYER_MSG1(2, "sendto() failed: %s", reinterpret_cast<LPTSTR> (buffer));
+        LocalFree(buffer);
+#else
+        PLAYER_MSG1(2,"sendto() failed: %s", strerror(ErrNo));
 #endif
-        client->writebufferlen = 0;
-        delete msg;
-        return(0);
-      }
-
-      client->writebufferlen = PLAYERXDR_MSGHDR_SIZE + hdr.size;
-
-      delete msg;
-#if HAVE_Z
-      if(zipped_data)
-      {
-        free(zipped_data->data);
-        free(zipped_data);
-        zipped_data=NULL;
+        return(-1);
       }
-#endif
     }
-    else
-      return(0);
+    else if(numwritten == 0)
+    {
+      PLAYER_MSG0(2,"wrote zero datagrams");
+      return(-1);
+    }
+
+    client->sent_frames += numwritten;
   }
+
+  return(1);
 }
 
+
 int
 PlayerUDP::Write()
 {
@@ -1181,6 +1503,35 @@ PlayerUDP::HandlePlayerMessage(int cli, Message* msg)
           break;
         }
 
+        // Request change of the encoding of what we send
+        case PLAYER_PLAYER_REQ_ENCODING:
+        {
+          player_device_encoding_req_t* ereq;
+          player_device_encoding_req_t eresp;
+
+          ereq = (player_device_encoding_req_t*)payload;
+
+          // Raw only if the client's structures are laid out as ours; an
+          // empty request just asks for our layout
+          memset(&eresp,0,sizeof(eresp));
+          eresp.layout = playerxdr_raw_layout();
+          if(ereq && (ereq->encoding == PLAYER_ENCODING_RAW) &&
+             (ereq->layout == eresp.layout))
+            eresp.encoding = PLAYER_ENCODING_RAW;
+          else
+            eresp.encoding = PLAYER_ENCODING_XDR;
+
+          // The switch happens in EncodeMessage(), when this reply is
+          // encoded, so that what is queued ahead of it is encoded as the
+          // client expects.
+          resphdr.type = PLAYER_MSGTYPE_RESP_ACK;
+          resp = new Message(resphdr, (void*)&eresp, true);
+          assert(resp);
+          client->queue->Push(*resp);
+          delete resp;
+          break;
+        }
+
         // Request change of data mode
         case PLAYER_PLAYER_REQ_DATAMODE:
         {
@@ -48,6 +48,23 @@
 
 This library moves messages between Player message queues and UDP sockets.
 
+Each XDR-encoded message is sent as one or more datagrams, using the
+framing described in @ref udpframe.  Large messages (camera images, maps,
+point clouds) are split into MTU-sized fragments and reassembled by the
+receiver; a message that loses a fragment is discarded, and partial
+messages that a newer one replaces (according to the queue's replace
+rules) are dropped without waiting.  Where the platform provides them,
+datagrams are moved in batches with sendmmsg() and recvmmsg().
+
+A client starts a session by sending an empty datagram, to which the
+server replies with the (unframed) ident string.
+
+Devices listed in a driver's "multicast" option can also be published on
+an IP multicast group (see JoinGroup()).  Their data is then encoded and
+sent once per update, whatever the number of receivers, using the same
+framing; requests and replies still travel over the clients' own TCP
+connections.
+
 @todo
  - More verbose documentation on this library, including the protocol
 
@@ -81,6 +98,7 @@ This library moves messages between Player message queues and UDP sockets.
 #include <pthread.h>
 
 #include <libplayercore/playercore.h>
+#include <libplayerinterface/udp_frame.h>
 
 /** Default UDP port */
 #define PLAYERUDP_DEFAULT_PORT 6665
@@ -93,6 +111,20 @@ This library moves messages between Player message queues and UDP sockets.
     calloc() and realloc() write buffers in multiples of this size. */
 #define PLAYERUDP_WRITEBUFFER_SIZE 65536
 
+/** Maximum number of datagrams moved by one sendmmsg() or recvmmsg()
+    call.  Outgoing messages are encoded until at least this many frames
+    are ready before they are flushed. */
+#define PLAYERUDP_BATCH_SIZE 64
+
+/** Number of partially received messages tracked per client */
+#define PLAYERUDP_REASM_SLOTS 8
+
+/** Requested kernel send and receive buffer size for the UDP sockets */
+#define PLAYERUDP_SOCKET_BUFFER_SIZE (1 << 20)
+
+/** Time-to-live of multicast datagrams; 1 keeps them on the local subnet */
+#define PLAYERUDP_MULTICAST_TTL 1
+
 // Forward declarations
 struct pollfd;
 
@@ -113,15 +145,20 @@ class PLAYERUDP_EXPORT PlayerUDP
     playerudp_conn* clients;
     //struct pollfd* client_ufds;
 
-    /** Buffer in which to store decoded incoming messages.  Also used to
-     * store encoded datagrams before copying them to the appropriate
-     * client-specific buffer. */
+    /** Buffer in which to store decoded incoming messages. */
     char* decode_readbuffer;
     /** Total size of @p decode_readbuffer */
     int decode_readbuffersize;
     /** Currently-used length of @p decode_readbuffersize */
     int decode_readbufferlen;
 
+    /** Incoming datagrams, PLAYERUDP_BATCH_SIZE slots of
+     * UDPFRAME_MAX_SIZE + 1 bytes (so that oversized datagrams show up as
+     * invalid frames rather than being silently truncated). */
+    char* recv_buffers;
+    int recv_lens[PLAYERUDP_BATCH_SIZE];
+    struct sockaddr_in recv_addrs[PLAYERUDP_BATCH_SIZE];
+
   public:
     PlayerUDP();
     ~PlayerUDP();
@@ -137,12 +174,24 @@ class PLAYERUDP_EXPORT PlayerUDP
                             int* kill_flag);
     void Close(int cli);
     int Read(int timeout);
+    int ReadBatch(int listener);
+    void HandleDatagram(int listener, struct sockaddr_in* fromaddr,
+                        const char* data, int len);
     int Write();
     int WriteClient(int cli);
+    int EncodeMessage(int cli, Message* msg);
+    int SendFrames(int cli);
     void DeleteClients();
     void ParseBuffer(int cli);
     int HandlePlayerMessage(int cli, Message* msg);
     void DeleteClient(MessageQueue* q);
+    /** Start publishing a device's data on its multicast group (see
+     * Device::multicast_group).  Each call takes a reference; the device
+     * is subscribed once, by the first.  Returns 0 on success. */
+    int JoinGroup(Device* device);
+    /** Drop a reference taken by JoinGroup(); the group stops when the
+     * last one goes. */
+    void LeaveGroup(Device* device);
     bool Listening(int port);
     uint32_t GetHost() {return host;};
 };
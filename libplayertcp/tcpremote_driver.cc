@@ -51,38 +51,488 @@
 #include <netinet/tcp.h>
 #endif
 
+#include <list>
+#include <map>
+
+#include <replace/replace.h>
 #include <libplayercore/globals.h>
 #include <libplayercommon/playercommon.h>
 #include <libplayerinterface/playerxdr.h>
 #include "tcpremote_driver.h"
 #include "playertcp_errutils.h"
 
-QueuePointer TCPRemoteDriverConnection::Connect()
+/** @brief A pooled connection to one remote server.
+
+There is one link per host:port, shared by every remote device on that
+server and every local client of those devices.  The remote server sees
+a single client, subscribed once to each device that anybody here is
+using; the link counts the local subscriptions and sends the requests
+when the first one arrives and the last one leaves.
+
+Subscription requests are pipelined: they are queued like any other
+outgoing message and PlayerTCP writes them out, so subscribing to many
+devices costs one round trip rather than one per device.  The replies
+come back through a separate queue (see PlayerTCP::SetReplyQueue()) and
+are checked from Poll().
+
+When PlayerTCP drops the connection, the link reconnects in the
+background with an exponential backoff and subscribes again to every
+device that is still in use.  Requests made while it is down are refused.
+*/
+class TCPRemoteLink
 {
-	struct sockaddr_in server;
+public:
+	/// Get the link to a server, connecting to it if it is new
+	static TCPRemoteLink* Acquire(PlayerTCP* ptcp, unsigned host,
+			unsigned short port);
+	/// Give up a link obtained from Acquire()
+	static void Release(TCPRemoteLink* link);
+	/// Check on the link to a server, if there is one
+	static void Poll(unsigned host, unsigned short port);
+
+	/// What Route() makes of a message
+	enum
+	{
+		ROUTE_LOCAL, ///< from a local client; forward it
+		ROUTE_DOWN, ///< from a local client, but the link is down
+		ROUTE_DATA, ///< from the remote server, for all subscribers
+		ROUTE_REPLY, ///< reply from the remote server, for @p client
+		ROUTE_DROP ///< reply that nobody is waiting for any more
+	};
+	/// Sort out where a message that reached a remote device has to go
+	static int Route(unsigned host, unsigned short port,
+			QueuePointer &resp_queue, player_msghdr_t* hdr, QueuePointer &client);
+
+	void Subscribe(const player_devaddr_t &addr);
+	void Unsubscribe(const player_devaddr_t &addr);
+	/// Send a message to the remote server; replies to requests will be
+	/// routed back to @p client.  If @p payload is not NULL, its body
+	/// (which must be @p src) is shared instead of copied.
+	void Forward(player_msghdr_t* hdr, void* src, Message* payload,
+			const QueuePointer &client);
+
+private:
+	TCPRemoteLink(PlayerTCP* ptcp, unsigned host, unsigned short port);
+	~TCPRemoteLink();
+
+	void Open();
+	void Close();
+	void Tick();
+
+	int StartConnect();
+	int FinishConnect(bool block);
+	void Attach();
+	void Backoff();
+	void SendSubscription(const player_devaddr_t &addr, unsigned char mode);
+	void CheckReplies();
+	void NackPending();
+
+	typedef std::pair<unsigned, unsigned short> Key;
+	typedef std::map<Key, TCPRemoteLink*> Pool;
+	static Pool pool;
+	static pthread_mutex_t pool_mutex;
+
+	typedef std::map<player_devaddr_t, int, PlayerAddressCompare> SubMap;
+
+	// A request we forwarded and that the remote server has yet to answer
+	struct Pending
+	{
+		uint16_t interf;
+		uint16_t index;
+		uint8_t subtype;
+		QueuePointer client;
+	};
+
+	enum { LINK_DOWN, LINK_CONNECTING, LINK_BANNER, LINK_UP };
+
+	PlayerTCP* ptcp;
+	unsigned host;
+	unsigned short port;
+	char ipaddr[256];
+#if defined (WIN32)
+	SOCKET sock;
+#else
+	int sock;
+#endif
+	int state;
+	// Set while the first user of the link is connecting it
+	bool opening;
+	int refs;
+	int kill_flag;
+	double setup_timeout;
+	// Start of the current connection attempt
+	double attempt_start;
+	// When to try again, and how long to wait after that
+	double next_retry;
+	double retry_delay;
 	char banner[PLAYER_IDENT_STRLEN];
-	int numread, thisnumread;
-	double t1, t2;
-#if defined (WIN32)
-  unsigned long setting = 1;
-#else
-  int flags;                  /* temp for old socket access flags */
-#endif
-
-	// if kill_flag is set then we cant use the ptcp object
-	if (kill_flag)
-		return QueuePointer();
+	int bannerlen;
+	// Outgoing messages; doubles as the PlayerTCP client queue
+	QueuePointer queue;
+	// Replies to our subscription requests
+	QueuePointer replies;
+	SubMap subs;
+	std::list<Pending> pending;
+	pthread_mutex_t mutex;
+};
+
+TCPRemoteLink::Pool TCPRemoteLink::pool;
+pthread_mutex_t TCPRemoteLink::pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+close_socket(int sock)
+{
+#if defined (WIN32)
+	closesocket(sock);
+#else
+	close(sock);
+#endif
+}
 
+TCPRemoteLink::TCPRemoteLink(PlayerTCP* ptcp, unsigned host,
+		unsigned short port) :
+	ptcp(ptcp), host(host), port(port), sock(-1), state(LINK_DOWN),
+	opening(false), refs(0),
+	kill_flag(1), setup_timeout(DEFAULT_SETUP_TIMEOUT), attempt_start(0),
+	next_retry(0), retry_delay(TCPREMOTE_RECONNECT_MIN), bannerlen(0),
+	queue(false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN),
+	replies(false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN)
+{
+#if defined (WIN32)
+	// Initialise Windows sockets API (this can safely be done as many times as we like)
+	WSADATA info;
+	int result;
+	if ((result = WSAStartup (MAKEWORD (2, 2), &info)) != 0)
+	{
+		PLAYER_ERROR1 ("Failed to initialise Windows sockets API with error %d", result);
+	}
+#endif
 	packedaddr_to_dottedip(this->ipaddr, sizeof(this->ipaddr), host);
+	pthread_mutex_init(&this->mutex, NULL);
+}
+
+TCPRemoteLink::~TCPRemoteLink()
+{
+	pthread_mutex_destroy(&this->mutex);
+#if defined (WIN32)
+	// Clean up the Windows sockets API (this can safely be done as many times as we like)
+	if (WSACleanup () != 0)
+		PLAYER_ERROR1 ("Failed to clean up Windows sockets API with error %s", WSAGetLastError ());
+#endif
+}
+
+TCPRemoteLink*
+TCPRemoteLink::Acquire(PlayerTCP* ptcp, unsigned host, unsigned short port)
+{
+	TCPRemoteLink* link;
+	bool created = false;
+
+	pthread_mutex_lock(&pool_mutex);
+	Pool::iterator it = pool.find(Key(host, port));
+	if (it == pool.end())
+	{
+		link = new TCPRemoteLink(ptcp, host, port);
+		pool[Key(host, port)] = link;
+		link->opening = true;
+		created = true;
+	}
+	else
+		link = it->second;
+	link->refs++;
+	pthread_mutex_unlock(&pool_mutex);
+
+	// Only the first user of a link waits for the connection, so that an
+	// unreachable server is reported straight away.  Later users of a link
+	// that is down keep their subscriptions until it comes back.
+	if (created)
+	{
+		try
+		{
+			link->Open();
+		} catch (...)
+		{
+			link->opening = false;
+			Release(link);
+			throw;
+		}
+		link->opening = false;
+	}
+	return link;
+}
+
+void
+TCPRemoteLink::Release(TCPRemoteLink* link)
+{
+	pthread_mutex_lock(&pool_mutex);
+	if (--link->refs > 0)
+	{
+		pthread_mutex_unlock(&pool_mutex);
+		return;
+	}
+	pool.erase(Key(link->host, link->port));
+	pthread_mutex_unlock(&pool_mutex);
+
+	link->Close();
+	delete link;
+}
+
+void
+TCPRemoteLink::Poll(unsigned host, unsigned short port)
+{
+	TCPRemoteLink* link;
+
+	pthread_mutex_lock(&pool_mutex);
+	Pool::iterator it = pool.find(Key(host, port));
+	if (it == pool.end())
+	{
+		pthread_mutex_unlock(&pool_mutex);
+		return;
+	}
+	link = it->second;
+	link->refs++;
+	pthread_mutex_unlock(&pool_mutex);
+
+	link->Tick();
+	Release(link);
+}
+
+int
+TCPRemoteLink::Route(unsigned host, unsigned short port,
+		QueuePointer &resp_queue, player_msghdr_t* hdr, QueuePointer &client)
+{
+	TCPRemoteLink* link;
+	int ret = ROUTE_LOCAL;
+
+	pthread_mutex_lock(&pool_mutex);
+	Pool::iterator it = pool.find(Key(host, port));
+	if (it == pool.end())
+	{
+		pthread_mutex_unlock(&pool_mutex);
+		return ROUTE_LOCAL;
+	}
+	link = it->second;
+
+	pthread_mutex_lock(&link->mutex);
+	if (resp_queue == link->queue)
+	{
+		if (hdr->type == PLAYER_MSGTYPE_RESP_ACK ||
+				hdr->type == PLAYER_MSGTYPE_RESP_NACK)
+		{
+			// The remote server answers the requests for one device in
+			// order, so the reply is for the oldest matching request
+			ret = ROUTE_DROP;
+			for (std::list<Pending>::iterator p = link->pending.begin();
+					p != link->pending.end(); ++p)
+			{
+				if (p->interf == hdr->addr.interf && p->index == hdr->addr.index &&
+						p->subtype == hdr->subtype)
+				{
+					client = p->client;
+					link->pending.erase(p);
+					ret = ROUTE_REPLY;
+					break;
+				}
+			}
+		}
+		else
+			ret = ROUTE_DATA;
+	}
+	else if (link->state != LINK_UP &&
+			(hdr->type == PLAYER_MSGTYPE_REQ || hdr->type == PLAYER_MSGTYPE_CMD))
+		ret = ROUTE_DOWN;
+	pthread_mutex_unlock(&link->mutex);
+	pthread_mutex_unlock(&pool_mutex);
+	return ret;
+}
+
+void
+TCPRemoteLink::Subscribe(const player_devaddr_t &addr)
+{
+	pthread_mutex_lock(&this->mutex);
+	if (this->subs[addr]++ == 0 && this->state == LINK_UP)
+		this->SendSubscription(addr, PLAYER_OPEN_MODE);
+	pthread_mutex_unlock(&this->mutex);
+}
+
+void
+TCPRemoteLink::Unsubscribe(const player_devaddr_t &addr)
+{
+	pthread_mutex_lock(&this->mutex);
+	SubMap::iterator it = this->subs.find(addr);
+	if (it != this->subs.end() && --it->second == 0)
+	{
+		this->subs.erase(it);
+		// Explicitly unsubscribing is just a courtesy, so there's no need
+		// to wait for the reply
+		if (this->state == LINK_UP)
+			this->SendSubscription(addr, PLAYER_CLOSE_MODE);
+	}
+	pthread_mutex_unlock(&this->mutex);
+}
+
+void
+TCPRemoteLink::Forward(player_msghdr_t* hdr, void* src, Message* payload,
+		const QueuePointer &client)
+{
+	if (hdr->type == PLAYER_MSGTYPE_REQ)
+	{
+		Pending p;
+		p.interf = hdr->addr.interf;
+		p.index = hdr->addr.index;
+		p.subtype = hdr->subtype;
+		p.client = client;
+		pthread_mutex_lock(&this->mutex);
+		this->pending.push_back(p);
+		pthread_mutex_unlock(&this->mutex);
+	}
+	if (payload)
+	{
+		Message msg(*payload, *hdr, this->queue);
+		this->queue->Push(msg);
+	}
+	else
+	{
+		Message msg(*hdr, src, this->queue);
+		this->queue->Push(msg);
+	}
+}
 
+// Refuse the requests that were still waiting for the remote server.  The
+// NACKs go to the remote devices as if the server had sent them, so
+// Route() pairs them with the requests and RemoteDriver passes them on to
+// the clients that made them.
+void
+TCPRemoteLink::NackPending()
+{
+	player_msghdr_t hdr;
+	Device* dev;
+
+	pthread_mutex_lock(&this->mutex);
+	std::list<Pending>::iterator p = this->pending.begin();
+	while (p != this->pending.end())
+	{
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.addr.host = this->host;
+		hdr.addr.robot = this->port;
+		hdr.addr.interf = p->interf;
+		hdr.addr.index = p->index;
+		hdr.type = PLAYER_MSGTYPE_RESP_NACK;
+		hdr.subtype = p->subtype;
+		GlobalTime->GetTimeDouble(&hdr.timestamp);
+		if ((dev = deviceTable->GetDevice(hdr.addr, false)))
+		{
+			dev->PutMsg(this->queue, &hdr, NULL);
+			++p;
+		}
+		else
+			p = this->pending.erase(p);
+	}
+	pthread_mutex_unlock(&this->mutex);
+}
+
+void
+TCPRemoteLink::Open()
+{
 	// We can't talk to ourselves
-	if (this->ptcp->GetHost() == host && this->ptcp->Listening(port))
+	if (this->ptcp->GetHost() == this->host && this->ptcp->Listening(this->port))
 	{
 		PLAYER_ERROR3("tried to connect to self (%s:%d:%d)\n", this->ipaddr,
-				host, port);
+				this->host, this->port);
 		throw "Tried to connect to self";
 	}
 
+	if (this->StartConnect() < 0 || this->FinishConnect(true) < 0)
+	{
+		if (this->sock >= 0)
+			close_socket(this->sock);
+		this->sock = -1;
+		this->state = LINK_DOWN;
+		throw "Connection Failed";
+	}
+	this->Attach();
+}
+
+void
+TCPRemoteLink::Close()
+{
+	if (this->state == LINK_UP)
+	{
+		// Have we already been killed?
+		if (!this->kill_flag)
+		{
+			// Let PlayerTCP close the connection and clean up.
+			this->ptcp->DeleteClient(this->queue, pthread_equal(this->ptcp->thread,
+					pthread_self()));
+			this->kill_flag = 1;
+		}
+	}
+	else if (this->sock >= 0)
+		close_socket(this->sock);
+	this->sock = -1;
+	this->state = LINK_DOWN;
+}
+
+void
+TCPRemoteLink::Tick()
+{
+	double t;
+
+	if (this->opening)
+		return;
+	this->CheckReplies();
+
+	switch (this->state)
+	{
+	case LINK_UP:
+		if (!this->kill_flag)
+			break;
+		PLAYER_WARN2("lost connection to remote server %s:%u; reconnecting",
+				this->ipaddr, this->port);
+		pthread_mutex_lock(&this->mutex);
+		this->sock = -1;
+		this->state = LINK_DOWN;
+		pthread_mutex_unlock(&this->mutex);
+		// Nobody is going to answer these now
+		this->NackPending();
+		GlobalTime->GetTimeDouble(&t);
+		this->next_retry = t + this->retry_delay;
+		break;
+	case LINK_DOWN:
+		GlobalTime->GetTimeDouble(&t);
+		if (t < this->next_retry)
+			break;
+		PLAYER_MSG2(2, "reconnecting to remote server %s:%u", this->ipaddr,
+				this->port);
+		if (this->StartConnect() < 0)
+			this->Backoff();
+		break;
+	default:
+		switch (this->FinishConnect(false))
+		{
+		case 1:
+			PLAYER_MSG2(1, "reconnected to remote server %s:%u", this->ipaddr,
+					this->port);
+			this->Attach();
+			break;
+		case -1:
+			this->Backoff();
+			break;
+		}
+		break;
+	}
+}
+
+// Start a non-blocking connection attempt
+int
+TCPRemoteLink::StartConnect()
+{
+	struct sockaddr_in server;
+#if defined (WIN32)
+	unsigned long setting = 1;
+#else
+	int flags;                  /* temp for old socket access flags */
+#endif
+
 	// Construct socket
 #if defined (WIN32)
 	if((this->sock = socket(PF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
@@ -91,61 +541,23 @@ QueuePointer TCPRemoteDriverConnection::Connect()
 #endif
 	{
 		STRERROR (PLAYER_ERROR1, "socket() failed; socket not created: %s");
-		throw "Connection failed";
+		this->sock = -1;
+		return -1;
 	}
 
-	server.sin_family = PF_INET;
-	server.sin_addr.s_addr = host;
-	server.sin_port = htons(port);
-
-	// Connect the socket
-	if (connect(this->sock, (struct sockaddr*) &server, sizeof(server)) < 0)
-	{
-		PLAYER_ERROR3("connect call on [%s:%u] failed with error [%s]",
-				this->ipaddr, port, strerror(errno));
-#if defined (WIN32)
-		closesocket(this->sock);
-#else
-		close(this->sock);
-#endif
-		sock=-1;
-		throw "Connection Failed";
-	}
-
-	PLAYER_MSG2(2, "connected to: %s:%u\n", this->ipaddr, host);
-
 	// make the socket non-blocking
 #if defined (WIN32)
-	if (ioctlsocket(sock, FIONBIO, &setting) == SOCKET_ERROR)
+	if (ioctlsocket(this->sock, FIONBIO, &setting) == SOCKET_ERROR)
 	{
 		STRERROR(PLAYER_ERROR1, "ioctlsocket error: %s");
-		closesocket(sock);
-		sock=INVALID_SOCKET;
-		throw "Connection failed";
+		return -1;
 	}
 #else
-	/*
-	* get the current access flags
-	*/
-	if((flags = fcntl(sock, F_GETFL)) == -1)
-	{
-		perror("create_and_bind_socket():fcntl() while getting socket "
-				"access flags; socket not created.");
-		close(sock);
-		sock=-1;
-		throw "Connection failed";
-	}
-	/*
-	* OR the current flags with O_NONBLOCK (so we won't block),
-	* and write them back
-	*/
-	if(fcntl(sock, F_SETFL, flags | O_NONBLOCK ) == -1)
+	if((flags = fcntl(this->sock, F_GETFL)) == -1 ||
+			fcntl(this->sock, F_SETFL, flags | O_NONBLOCK) == -1)
 	{
-		perror("create_and_bind_socket():fcntl() failed while setting socket "
-				"access flags; socket not created.");
-		close(sock);
-		sock=-1;
-		throw "Connection failed";
+		STRERROR(PLAYER_ERROR1, "fcntl() failed while setting socket access flags: %s");
+		return -1;
 	}
 #endif // defined (WIN32)
 
@@ -156,124 +568,160 @@ QueuePointer TCPRemoteDriverConnection::Connect()
 			== -1)
 	{
 		PLAYER_ERROR("failed to enable TCP_NODELAY - setsockopt failed");
-		close(this->sock);
-		sock=-1;
-		throw "Connection Failed";
+		return -1;
 	}
 #endif
 
-	// Get the banner.
-	GlobalTime->GetTimeDouble(&t1);
-	numread = 0;
-	while (numread < (int) sizeof(banner))
+	server.sin_family = PF_INET;
+	server.sin_addr.s_addr = this->host;
+	server.sin_port = htons(this->port);
+
+	GlobalTime->GetTimeDouble(&this->attempt_start);
+	this->bannerlen = 0;
+	this->state = LINK_CONNECTING;
+
+	if (connect(this->sock, (struct sockaddr*) &server, sizeof(server)) < 0)
 	{
-		if ((thisnumread = recv(this->sock, banner + numread, sizeof(banner)
-				- numread, 0)) < 0)
-		{
-			if (errno!= EAGAIN)
-			{
-				PLAYER_ERROR("error reading banner from remote device");
-#if defined (WIN32)
-				closesocket(this->sock);
-#else
-				close(this->sock);
-#endif
-				sock=-1;
-				throw "Connection Failed";
-			}
-		}
-		else
-			numread += thisnumread;
-		GlobalTime->GetTimeDouble(&t2);
-		if ((t2 - t1) > this->setup_timeout)
+#if defined (WIN32)
+		if (ErrNo != WSAEWOULDBLOCK)
+#else
+		if (ErrNo != EINPROGRESS)
+#endif
 		{
-			PLAYER_ERROR("timed out reading banner from remote server");
-#if defined (WIN32)
-			closesocket(this->sock);
-#else
-			close(this->sock);
-#endif
-			sock=-1;
-			throw "Connection Failed";
+			STRERROR(PLAYER_ERROR1, "connect call failed with error [%s]");
+			return -1;
 		}
 	}
+	else
+		this->state = LINK_BANNER;
+	return 0;
+}
 
-	PLAYER_MSG0(5, "Adding new TCPRemoteDriver to the PlayerTCP Client List");
-
-	// Add this socket for monitoring
-	this->kill_flag = 0;
+// Carry on with a connection attempt until the banner is in.  Returns 1
+// once it is, -1 on failure, and 0 if we'd have to wait (only when not
+// blocking).
+int
+TCPRemoteLink::FinishConnect(bool block)
+{
+	struct pollfd ufd;
+	double t;
+	int ret, err;
+	socklen_t errlen;
 
-	// create a place holder queue, but we cant actually add the client connection until we get a subscription
-	ConnectionQueue = QueuePointer(false,PLAYER_MSGQUEUE_DEFAULT_MAXLEN);
+	for (;;)
+	{
+		GlobalTime->GetTimeDouble(&t);
+		if ((t - this->attempt_start) > this->setup_timeout)
+		{
+			PLAYER_ERROR2("timed out connecting to remote server %s:%u",
+					this->ipaddr, this->port);
+			return -1;
+		}
 
-	return ConnectionQueue;
-}
+		ufd.fd = this->sock;
+		ufd.events = (this->state == LINK_CONNECTING) ? POLLOUT : POLLIN;
+		ufd.revents = 0;
+		if ((ret = poll(&ufd, 1, block ? 10 : 0)) < 0)
+		{
+			if (ErrNo == EINTR)
+				continue;
+			STRERROR(PLAYER_ERROR1, "poll() failed: %s");
+			return -1;
+		}
+		if (ret == 0)
+		{
+			if (!block)
+				return 0;
+			continue;
+		}
 
-QueuePointer TCPRemoteDriverConnection::Disconnect()
-{
-	QueuePointer ret=ConnectionQueue;
-	ConnectionQueue = QueuePointer();
-	return ret;
-}
+		if (this->state == LINK_CONNECTING)
+		{
+			err = 0;
+			errlen = sizeof(err);
+			getsockopt(this->sock, SOL_SOCKET, SO_ERROR,
+					reinterpret_cast<char*> (&err), &errlen);
+			if (err)
+			{
+				PLAYER_ERROR3("connect call on [%s:%u] failed with error [%s]",
+						this->ipaddr, this->port, strerror(err));
+				return -1;
+			}
+			PLAYER_MSG2(2, "connected to: %s:%u\n", this->ipaddr, this->port);
+			this->state = LINK_BANNER;
+			continue;
+		}
 
-void TCPRemoteDriverConnection::PutMsg(player_msghdr_t* hdr, void* src)
-{
-	Message msg(*hdr,src,ConnectionQueue);
-	ConnectionQueue->Push(msg);
+		// Get the banner.
+		if ((ret = recv(this->sock, this->banner + this->bannerlen,
+				sizeof(this->banner) - this->bannerlen, 0)) <= 0)
+		{
+			if (ret < 0 && ErrNo == ERRNO_EAGAIN)
+				continue;
+			PLAYER_ERROR("error reading banner from remote device");
+			return -1;
+		}
+		this->bannerlen += ret;
+		if (this->bannerlen == (int) sizeof(this->banner))
+			return 1;
+	}
 }
 
-void TCPRemoteDriverConnection::Subscribe(player_devaddr_t addr)
+// Hand the connected socket over to PlayerTCP and subscribe to everything
+// we are using
+void
+TCPRemoteLink::Attach()
 {
-	if (SubscribeRemote(addr, PLAYER_OPEN_MODE) != 0)
-		throw "Failed to subscribe";
+	Message* msg;
+	bool have_lock = pthread_equal(this->ptcp->thread, pthread_self());
 
-	if (kill_flag)
-		return;
+	PLAYER_MSG0(5, "Adding new TCPRemoteDriver to the PlayerTCP Client List");
 
-	// we need to do this after the subscription as we directly
-	// manipulate the socket in our subscribe and unsubscribe
-	this->ptcp->AddClient(NULL, host, port, this->sock,
-			false, &this->kill_flag, pthread_equal(this->ptcp->thread, pthread_self()),ConnectionQueue);
+	// Drop whatever was sent while we were down
+	while ((msg = this->queue->Pop()))
+		delete msg;
+	while ((msg = this->replies->Pop()))
+		delete msg;
 
+	this->kill_flag = 0;
+	this->retry_delay = TCPREMOTE_RECONNECT_MIN;
+	this->ptcp->AddClient(NULL, this->host, this->port, this->sock, false,
+			&this->kill_flag, have_lock, this->queue);
+	this->ptcp->SetReplyQueue(this->queue, this->replies, have_lock);
+
+	pthread_mutex_lock(&this->mutex);
+	this->state = LINK_UP;
+	for (SubMap::iterator it = this->subs.begin(); it != this->subs.end(); ++it)
+		this->SendSubscription(it->first, PLAYER_OPEN_MODE);
+	pthread_mutex_unlock(&this->mutex);
 }
 
-void TCPRemoteDriverConnection::Unsubscribe(player_devaddr_t addr)
+void
+TCPRemoteLink::Backoff()
 {
-	// Do this before we unsubscribe as we need direct access to the socket
-	// Have we already been killed?
-	if (!this->kill_flag)
-	{
-		// Set the delete flag, letting PlayerTCP close the connection and
-		// clean up.
-		this->ptcp->DeleteClient(ConnectionQueue, pthread_equal(this->ptcp->thread,
-				pthread_self()));
-		kill_flag = 1;
-	}
-
-
-	if (SubscribeRemote(addr, PLAYER_CLOSE_MODE) != 0)
-		throw "Failed to unsubscribe";
+	double t;
+
+	if (this->sock >= 0)
+		close_socket(this->sock);
+	this->sock = -1;
+	this->state = LINK_DOWN;
+
+	GlobalTime->GetTimeDouble(&t);
+	this->next_retry = t + this->retry_delay;
+	PLAYER_MSG3(2, "will retry %s:%u in %.1f s", this->ipaddr, this->port,
+			this->retry_delay);
+	this->retry_delay *= 2;
+	if (this->retry_delay > TCPREMOTE_RECONNECT_MAX)
+		this->retry_delay = TCPREMOTE_RECONNECT_MAX;
 }
 
-// (un)subscribe to the remote device
-int TCPRemoteDriverConnection::SubscribeRemote(player_devaddr_t addr,
+// Queue a (un)subscription request; called with the mutex held
+void
+TCPRemoteLink::SendSubscription(const player_devaddr_t &addr,
 		unsigned char mode)
 {
-	int encode_msglen;
-	unsigned char buf[512];
 	player_msghdr_t hdr;
 	player_device_req_t req;
-	double t1, t2;
-
-	int numbytes, thisnumbytes;
-
-	// if we have no socket then we dont need to unsub
-#if defined (WIN32)
-	if (sock == INVALID_SOCKET)
-#else
-	if (sock < 0)
-#endif
-		return 0;
 
 	memset(&hdr, 0, sizeof(hdr));
 	hdr.addr.interf = PLAYER_PLAYER_CODE;
@@ -283,162 +731,95 @@ int TCPRemoteDriverConnection::SubscribeRemote(player_devaddr_t addr,
 
 	PLAYER_MSG4(8,"TCPRemote sub for: %d %d %d %d",addr.host, addr.robot,addr.interf,addr.index);
 
-
+	memset(&req, 0, sizeof(req));
 	req.addr = addr;
 	req.access = mode;
 	req.driver_name_count = 0;
 
-	// Encode the body
-	if ((encode_msglen = player_device_req_pack(buf + PLAYERXDR_MSGHDR_SIZE,
-			sizeof(buf) - PLAYERXDR_MSGHDR_SIZE, &req, PLAYERXDR_ENCODE)) < 0)
-	{
-		PLAYER_ERROR("failed to encode request");
-		return (-1);
-	}
-
-	// Rewrite the size in the header with the length of the encoded
-	// body, then encode the header.
-	hdr.size = encode_msglen;
-	if (player_msghdr_pack(buf, PLAYERXDR_MSGHDR_SIZE, &hdr, PLAYERXDR_ENCODE)
-			< 0)
-	{
-		PLAYER_ERROR("failed to encode header");
-		return (-1);
-	}
-
-	encode_msglen += PLAYERXDR_MSGHDR_SIZE;
-
-	// Send the request
-	GlobalTime->GetTimeDouble(&t1);
-	numbytes = 0;
-
-	while (numbytes < encode_msglen)
-	{
-		if ((thisnumbytes = send(this->sock, reinterpret_cast<const char*> (buf + numbytes), encode_msglen
-				- numbytes, 0)) < 0)
-		{
-			if (errno!= EAGAIN)
-			{
-				PLAYER_ERROR1("write failed: %s", strerror(errno));
-				return (-1);
-			}
-		}
-		else
-		{
-			numbytes += thisnumbytes;
-		}
-		GlobalTime->GetTimeDouble(&t2);
-		if ((t2 - t1) > this->setup_timeout)
-		{
-			PLAYER_ERROR(
-					"timed out sending subscription request to remote server");
-			return (-1);
-		}
-	}
-
-	// If we're closing, then stop here; we don't need to hear the response.
-	// In any case, explicitly unsubscribing is just a courtesy.
-	if (mode == PLAYER_CLOSE_MODE)
-	{
-		PLAYER_MSG5(5, "unsubscribed from remote device %s:%d:%d:%d (%s)",
-				this->ipaddr, addr.robot, addr.interf,
-				addr.index, req.driver_name);
+	Message msg(hdr, &req, this->queue);
+	this->queue->Push(msg);
+}
 
-		return (0);
-	}
+// Check the replies to our subscription requests
+void
+TCPRemoteLink::CheckReplies()
+{
+	Message* msg;
+	player_msghdr_t* hdr;
+	player_device_req_t* req;
 
-	// Receive the response header
-	GlobalTime->GetTimeDouble(&t1);
-	numbytes = 0;
-	while (numbytes < PLAYERXDR_MSGHDR_SIZE)
+	while ((msg = this->replies->Pop()))
 	{
-		if ((thisnumbytes = recv(this->sock, reinterpret_cast<char*> (buf + numbytes),
-				PLAYERXDR_MSGHDR_SIZE - numbytes, 0)) < 0)
+		hdr = msg->GetHeader();
+		req = reinterpret_cast<player_device_req_t*> (msg->GetPayload());
+		if (hdr->subtype == PLAYER_PLAYER_REQ_DEV)
 		{
-			if (errno!= EAGAIN)
-			{
-				PLAYER_ERROR1("read failed: %s", strerror(errno));
-				return (-1);
-			}
-		}
-		else
-			numbytes += thisnumbytes;
-		GlobalTime->GetTimeDouble(&t2);
-		if ((t2 - t1) > this->setup_timeout)
-		{
-			PLAYER_ERROR("timed out reading response header from remote server");
-			return (-1);
+			if (hdr->type != PLAYER_MSGTYPE_RESP_ACK || !req ||
+					req->access == PLAYER_ERROR_MODE)
+				PLAYER_ERROR2("failed to subscribe to remote device on %s:%u",
+						this->ipaddr, this->port);
+			else if (req->access != PLAYER_CLOSE_MODE)
+				PLAYER_MSG5(5, "subscribed to remote device %s:%d:%d:%d (%s)",
+						this->ipaddr, req->addr.robot, req->addr.interf,
+						req->addr.index, req->driver_name);
 		}
+		delete msg;
 	}
+}
 
-	// Decode the header
-	if (player_msghdr_pack(buf, PLAYERXDR_MSGHDR_SIZE, &hdr, PLAYERXDR_DECODE)
-			< 0)
-	{
-		PLAYER_ERROR("failed to decode header");
-		return (-1);
-	}
-
-	// Is it the right kind of message?
-	if (!Message::MatchMessage(&hdr, PLAYER_MSGTYPE_RESP_ACK,
-	PLAYER_PLAYER_REQ_DEV, hdr.addr))
-	{
-		PLAYER_ERROR4("got wrong kind of reply %d:%d %d:%d",hdr.type,hdr.subtype,hdr.addr.interf,hdr.addr.index);
-		PLAYER_ERROR4("was trying to subscribe to  %d:%d %d:%d",addr.host,addr.robot,addr.interf,addr.index);
-		return (-1);
-	}
-
-	// Receive the response body
-	GlobalTime->GetTimeDouble(&t1);
-	numbytes = 0;
-	while (numbytes < (int) hdr.size)
-	{
-		if ((thisnumbytes = recv(this->sock, reinterpret_cast<char*> (buf + PLAYERXDR_MSGHDR_SIZE
-				+ numbytes), hdr.size - numbytes, 0)) < 0)
-		{
-			if (errno!= EAGAIN)
-			{
-				PLAYER_ERROR1("read failed: %s", strerror(errno));
-				return (-1);
-			}
-		}
-		else
-			numbytes += thisnumbytes;
-		GlobalTime->GetTimeDouble(&t2);
-		if ((t2 - t1) > this->setup_timeout)
-		{
-			PLAYER_ERROR("timed out reading response body from remote server");
-			return (-1);
-		}
-	}
+TCPRemoteDriverConnection::~TCPRemoteDriverConnection()
+{
+	if (this->link)
+		TCPRemoteLink::Release(this->link);
+}
 
-	memset(&req, 0, sizeof(req));
-	// Decode the body
-	if (player_device_req_pack(buf + PLAYERXDR_MSGHDR_SIZE, hdr.size, &req,
-			PLAYERXDR_DECODE) < 0)
-	{
-		PLAYER_ERROR("failed to decode reply");
-		return (-1);
-	}
+QueuePointer TCPRemoteDriverConnection::Connect()
+{
+	if (!this->link)
+		this->link = TCPRemoteLink::Acquire(this->ptcp, this->host, this->port);
 
-	// Did we get the right access?
-	if (req.access != mode)
-	{
-		PLAYER_ERROR("got wrong access");
-		return (-1);
-	}
+	// Nothing is ever pushed onto this queue; it only tells the replies
+	// for this client apart from the others on the link.
+	ConnectionQueue = QueuePointer(false, 1);
+	return ConnectionQueue;
+}
 
+QueuePointer TCPRemoteDriverConnection::Disconnect()
+{
+	QueuePointer ret=ConnectionQueue;
+	if (this->link)
+		TCPRemoteLink::Release(this->link);
+	this->link = NULL;
+	ConnectionQueue = QueuePointer();
+	return ret;
+}
 
-	PLAYER_MSG0(5,
-			"Adding new TCPRemoteDriver to the PlayerTCP Client List...Success");
+void TCPRemoteDriverConnection::PutMsg(player_msghdr_t* hdr, void* src)
+{
+	this->PutMsg(hdr, src, NULL);
+}
 
+void TCPRemoteDriverConnection::PutMsg(player_msghdr_t* hdr, void* src,
+		Message* payload)
+{
+	if (this->link)
+		this->link->Forward(hdr, src, payload, ConnectionQueue);
+}
 
-	// Success!
-	PLAYER_MSG5(5, "subscribed to remote device %s:%d:%d:%d (%s)",
-			this->ipaddr, addr.robot, addr.interf,
-			addr.index, req.driver_name);
+void TCPRemoteDriverConnection::Subscribe(player_devaddr_t addr)
+{
+	if (!this->link)
+		throw "Not connected";
+	this->link->Subscribe(addr);
+	RemoteConnection::Subscribe(addr);
+}
 
-	return (0);
+void TCPRemoteDriverConnection::Unsubscribe(player_devaddr_t addr)
+{
+	if (!this->link)
+		return;
+	this->link->Unsubscribe(addr);
+	RemoteConnection::Unsubscribe(addr);
 }
 
 TCPRemoteDriver::TCPRemoteDriver(player_devaddr_t addr, void* arg) :
@@ -454,6 +835,40 @@ TCPRemoteDriver::~TCPRemoteDriver()
 {
 }
 
+void
+TCPRemoteDriver::Update()
+{
+	TCPRemoteLink::Poll(this->host, this->port);
+	RemoteDriver::Update();
+}
+
+int
+TCPRemoteDriver::ProcessMessage(QueuePointer & resp_queue,
+		player_msghdr * hdr, void * data)
+{
+	QueuePointer client;
+
+	switch (TCPRemoteLink::Route(this->host, this->port, resp_queue, hdr,
+			client))
+	{
+	case TCPRemoteLink::ROUTE_DATA:
+		// One remote subscription serves all our local subscribers
+		Publish(hdr, data);
+		return 0;
+	case TCPRemoteLink::ROUTE_REPLY:
+		return RemoteDriver::ProcessMessage(client, hdr, data);
+	case TCPRemoteLink::ROUTE_DROP:
+		return 0;
+	case TCPRemoteLink::ROUTE_DOWN:
+		if (hdr->type == PLAYER_MSGTYPE_REQ)
+			Publish(hdr->addr, resp_queue, PLAYER_MSGTYPE_RESP_NACK,
+					hdr->subtype);
+		return 0;
+	default:
+		return RemoteDriver::ProcessMessage(resp_queue, hdr, data);
+	}
+}
+
 Driver*
 TCPRemoteDriver::TCPRemoteDriver_Init(player_devaddr_t addr, void* arg)
 {
@@ -57,35 +57,32 @@
 #endif
 
 #define DEFAULT_SETUP_TIMEOUT 3.0
+/** Delay before the first attempt to reconnect a dropped link [s]; it
+ * doubles after every failed attempt. */
+#define TCPREMOTE_RECONNECT_MIN 0.5
+/** Longest delay between two attempts to reconnect a dropped link [s] */
+#define TCPREMOTE_RECONNECT_MAX 30.0
 
+class TCPRemoteLink;
+
+/** @brief One local client's view of a remote server.
+
+All the connections to the same host:port share one pooled TCPRemoteLink,
+and thus one socket and one PlayerTCP client, whatever the device and
+local client.  The ConnectionQueue of this object only tells RemoteDriver
+which local client a reply belongs to; the traffic itself goes through the
+link. */
 class PLAYERTCP_EXPORT TCPRemoteDriverConnection: public RemoteConnection
 {
 public:
 	TCPRemoteDriverConnection(PlayerTCP* ptcp, unsigned remote_host,
 			unsigned short remote_port) :
-		ptcp(ptcp), host(remote_host), port(remote_port), sock(-1), setup_timeout(DEFAULT_SETUP_TIMEOUT), kill_flag(0)
+		ptcp(ptcp), host(remote_host), port(remote_port), link(NULL)
 	{
-#if defined (WIN32)
-		// Initialise Windows sockets API (this can safely be done as many times as we like)
-		WSADATA info;
-		int result;
-		if ((result = WSAStartup (MAKEWORD (2, 2), &info)) != 0)
-		{
-			PLAYER_ERROR1 ("Failed to initialise Windows sockets API with error %d", result);
-		}
-#endif
 	}
 	;
 
-	virtual ~TCPRemoteDriverConnection()
-	{
-#if defined (WIN32)
-		// Clean up the Windows sockets API (this can safely be done as many times as we like)
-		if (WSACleanup () != 0)
-			PLAYER_ERROR1 ("Failed to clean up Windows sockets API with error %s", WSAGetLastError ());
-#endif
-	}
-	;
+	virtual ~TCPRemoteDriverConnection();
 
 	virtual QueuePointer Connect();
 	virtual QueuePointer Disconnect();
@@ -94,21 +91,14 @@ public:
 	virtual void Unsubscribe(player_devaddr_t addr);
 
 	void PutMsg(player_msghdr_t* hdr, void* src);
+	/// Forward a message, sharing @p payload's body if it is not NULL
+	void PutMsg(player_msghdr_t* hdr, void* src, Message* payload);
 
 private:
-	int SubscribeRemote(player_devaddr_t addr, unsigned char mode);
-
 	PlayerTCP* ptcp;
 	unsigned host;
 	unsigned short port;
-	char ipaddr[256];
-#if defined (WIN32)
-	SOCKET sock;
-#else
-	int sock;
-#endif
-	double setup_timeout;
-	int kill_flag;
+	TCPRemoteLink* link;
 };
 
 class PLAYERTCP_EXPORT TCPRemoteDriver: public RemoteDriver
@@ -117,7 +107,6 @@ private:
 	PlayerTCP* ptcp;
 	unsigned host;
 	unsigned short port;
-	//    QueuePointer queue, ret_queue;
 
 	virtual RemoteConnection *CreateConnection()
 	{
@@ -125,19 +114,16 @@ private:
 	}
 	;
 
-/*	virtual int ProcessMessage(QueuePointer & resp_queue, player_msghdr * hdr,
-			void * data)
-	{
-		PLAYER_MSG4(8, "RemoteDriver recieved message: %d %d %d %d",
-				hdr->addr.host, hdr->addr.robot, hdr->addr.interf, hdr->addr.index);
-		return RemoteDriver::ProcessMessage(resp_queue,hdr,data);
-	}*/
-
-
 public:
 	TCPRemoteDriver(player_devaddr_t addr, void* arg);
 	virtual ~TCPRemoteDriver();
 
+	/// Reconnect the shared link if it dropped, and check the replies to
+	/// our subscription requests, before the usual message processing.
+	virtual void Update();
+	virtual int ProcessMessage(QueuePointer & resp_queue, player_msghdr * hdr,
+			void * data);
+
 	static Driver* TCPRemoteDriver_Init(player_devaddr_t addr, void* arg);
 
 };
@@ -0,0 +1,665 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2005 -
+ *     Brian Gerkey
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/** @ingroup utils */
+/** @{ */
+/** @defgroup util_player_bench player_bench
+ @brief Server throughput and latency benchmark
+
+@par Synopsis
+
+@b player_bench starts a Player server inside its own process, with a
+number of @ref driver_dummy devices on the @ref interface_ranger,
+@ref interface_camera and @ref interface_pointcloud3d interfaces, and
+attaches libplayerc clients to it, first over TCP and then over UDP,
+each time with XDR and then with the raw encoding (see
+@ref PLAYER_PLAYER_REQ_ENCODING), and finally through shared memory
+(see @ref PLAYER_PLAYER_REQ_SHM), which is always raw.  Every client subscribes to every
+device and reads for a fixed time.  The results cover the whole path,
+from Message and the queues through the encoding layer and the
+transports to the client library.
+
+@par Usage
+
+@verbatim
+player_bench [options]
+@endverbatim
+
+Where [options] can be:
+- -n \<devices\> : dummy devices per interface (default: 1)
+- -c \<clients\> : number of clients (default: 1)
+- -r \<rate\> : data rate of every device, in Hz (default: 100)
+- -t \<seconds\> : measurement time per transport (default: 5)
+- -w \<seconds\> : warm-up time per transport, not measured (default: 1)
+- -i \<interfaces\> : comma-separated list of ranger, camera and
+  pointcloud3d (default: all three)
+- -T \<transports\> : comma-separated list of tcp, udp and shm (default:
+  all three)
+- -e \<encodings\> : xdr, raw or xdr,raw (default: xdr,raw)
+- -p \<port\> : server port (default: 6690)
+- -d \<level\> : server debug level (default: 0)
+
+@par Output
+
+One JSON object per line on stdout, for each transport, encoding and
+interface and for all interfaces together:
+
+@verbatim
+{"transport":"tcp","encoding":"xdr","interface":"camera","devices":1,
+ "clients":1,"rate":100,"seconds":2.003,"messages":155,"msgs_per_s":77.4,
+ "bytes":35712000,"bytes_per_s":17829790.7,"latency_us":{"p50":2716,
+ "p90":7984,"p99":10989,"p999":44257,"max":44257}}
+@endverbatim
+
+(shown on several lines here).  @b bytes counts the payload as seen by
+the client: ranges, pixels or points.  Latency is the time from the
+driver stamping the message to the client having decoded it.  The line
+for all interfaces also has @b cpu_percent, the CPU time used by the
+whole process (server, drivers and clients) during the measurement, and
+@b cpu_us_per_mb, that time per megabyte of payload.  A
+@c "result":"error" field in place of the numbers means a client failed
+to connect or subscribe; the exit status is then non-zero as well.
+
+*/
+/** @} */
+
+#include <config.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <libplayercore/playercore.h>
+#include <libplayertcp/playertcp.h>
+#include <libplayertcp/playerudp.h>
+#include <libplayerinterface/functiontable.h>
+#include <libplayerc/playerc.h>
+#include "libplayerdrivers/driverregistry.h"
+
+#define USAGE "USAGE: player_bench [-n <devices>] [-c <clients>] [-r <rate>] " \
+              "[-t <seconds>] [-w <seconds>] [-i <interfaces>] [-T <transports>] " \
+              "[-e <encodings>] [-p <port>] [-d <level>]"
+
+// Interfaces exercised by the benchmark
+#define BENCH_RANGER       0
+#define BENCH_CAMERA       1
+#define BENCH_POINTCLOUD3D 2
+#define BENCH_INTERFACES   3
+
+static const char* bench_interf_names[BENCH_INTERFACES] =
+  { "ranger", "camera", "pointcloud3d" };
+
+// Command line options
+static int opt_devices = 1;
+static int opt_clients = 1;
+static double opt_rate = 100;
+static double opt_seconds = 5;
+static double opt_warmup = 1;
+static bool opt_interf[BENCH_INTERFACES] = { true, true, true };
+static bool opt_tcp = true;
+static bool opt_udp = true;
+static bool opt_shm = true;
+static bool opt_xdr = true;
+static bool opt_raw = true;
+static int opt_port = 6690;
+static int opt_debug = 0;
+
+// Server state
+static PlayerTCP* ptcp;
+static PlayerUDP* pudp;
+static ConfigFile* cf;
+static volatile bool server_quit = false;
+
+// One client and its measurements
+typedef struct bench_client
+{
+  pthread_t thread;
+  int transport;
+  int encoding;
+  // Take the messages from shared memory
+  bool shm;
+  // Set if the client failed to connect or subscribe
+  bool failed;
+  // Per interface: latencies [s] of the measured messages, message
+  // counts and payload bytes
+  std::vector<double> latency[BENCH_INTERFACES];
+  uint64_t messages[BENCH_INTERFACES];
+  uint64_t bytes[BENCH_INTERFACES];
+  // Start and end of the measurement
+  double start;
+  double end;
+} bench_client_t;
+
+static double
+bench_now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static int
+parse_list(const char* arg, const char** names, int count, bool* set)
+{
+  char buf[128];
+  char* tok;
+  char* save;
+  int i;
+
+  for (i = 0; i < count; i++)
+    set[i] = false;
+  strncpy(buf, arg, sizeof(buf) - 1);
+  buf[sizeof(buf) - 1] = '\0';
+  for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+  {
+    for (i = 0; i < count; i++)
+    {
+      if (strcmp(tok, names[i]) == 0)
+        break;
+    }
+    if (i == count)
+    {
+      fprintf(stderr, "unknown name \"%s\"\n", tok);
+      return -1;
+    }
+    set[i] = true;
+  }
+  return 0;
+}
+
+static int
+parse_args(int argc, char** argv)
+{
+  static const char* transports[3] = { "tcp", "udp", "shm" };
+  static const char* encodings[2] = { "xdr", "raw" };
+  bool t[3];
+  int ch;
+
+  while ((ch = getopt(argc, argv, "n:c:r:t:w:i:T:e:p:d:h")) != -1)
+  {
+    switch (ch)
+    {
+      case 'n':
+        opt_devices = atoi(optarg);
+        break;
+      case 'c':
+        opt_clients = atoi(optarg);
+        break;
+      case 'r':
+        opt_rate = atof(optarg);
+        break;
+      case 't':
+        opt_seconds = atof(optarg);
+        break;
+      case 'w':
+        opt_warmup = atof(optarg);
+        break;
+      case 'i':
+        if (parse_list(optarg, bench_interf_names, BENCH_INTERFACES, opt_interf) < 0)
+          return -1;
+        break;
+      case 'T':
+        if (parse_list(optarg, transports, 3, t) < 0)
+          return -1;
+        opt_tcp = t[0];
+        opt_udp = t[1];
+        opt_shm = t[2];
+        break;
+      case 'e':
+        if (parse_list(optarg, encodings, 2, t) < 0)
+          return -1;
+        opt_xdr = t[0];
+        opt_raw = t[1];
+        break;
+      case 'p':
+        opt_port = atoi(optarg);
+        break;
+      case 'd':
+        opt_debug = atoi(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+  if ((opt_devices < 1) || (opt_clients < 1) || (opt_rate <= 0) ||
+      (opt_seconds <= 0) || (opt_warmup < 0))
+    return -1;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Server side
+
+// Write a config file with the dummy devices; returns its name
+static int
+write_config(char* filename, size_t len)
+{
+  FILE* f;
+  int fd;
+  int i, j;
+
+  snprintf(filename, len, "/tmp/player_bench.XXXXXX");
+  if ((fd = mkstemp(filename)) < 0)
+  {
+    fprintf(stderr, "mkstemp failed: %s\n", strerror(errno));
+    return -1;
+  }
+  f = fdopen(fd, "w");
+  for (i = 0; i < BENCH_INTERFACES; i++)
+  {
+    if (!opt_interf[i])
+      continue;
+    for (j = 0; j < opt_devices; j++)
+      fprintf(f, "driver\n(\n  name \"dummy\"\n  provides [\"%d:%s:%d\"]\n"
+              "  rate %g\n)\n", opt_port, bench_interf_names[i], j, opt_rate);
+  }
+  fclose(f);
+  return 0;
+}
+
+static int
+server_start()
+{
+  char filename[64];
+  int ports[1];
+  bool ok;
+
+  ErrorInit(opt_debug, NULL);
+  player_globals_init();
+  player_register_drivers();
+  playerxdr_ftable_init();
+  itable_init();
+
+  ptcp = new PlayerTCP();
+  pudp = new PlayerUDP();
+
+  if (write_config(filename, sizeof(filename)) < 0)
+    return -1;
+  cf = new ConfigFile("localhost", opt_port);
+  ok = cf->Load(filename) && cf->ParseAllInterfaces() && cf->ParseAllDrivers();
+  unlink(filename);
+  if (!ok)
+  {
+    fprintf(stderr, "failed to set up the dummy devices\n");
+    return -1;
+  }
+
+  ports[0] = opt_port;
+  if ((ptcp->Listen(ports, 1) < 0) || (pudp->Listen(ports, 1) < 0))
+  {
+    fprintf(stderr, "failed to listen on port %d\n", opt_port);
+    return -1;
+  }
+  return 0;
+}
+
+// The server's main loop, as in server.cc
+static void*
+server_main(void* arg)
+{
+  while (!server_quit)
+  {
+    if (fileWatcher->Wait(0.01) > 0)
+    {
+      if ((ptcp->Accept(0) < 0) || (ptcp->Read(0, false) < 0) ||
+          (pudp->Read(0) < 0))
+      {
+        fprintf(stderr, "server failed while reading\n");
+        break;
+      }
+    }
+    deviceTable->UpdateDevices();
+    if ((ptcp->Write(false) < 0) || (pudp->Write() < 0))
+    {
+      fprintf(stderr, "server failed while writing\n");
+      break;
+    }
+  }
+  return NULL;
+}
+
+static void
+server_stop()
+{
+  delete ptcp;
+  delete pudp;
+  player_globals_fini();
+  delete cf;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Client side
+
+static void*
+client_main(void* arg)
+{
+  bench_client_t* bc = (bench_client_t*)arg;
+  playerc_client_t* client;
+  std::vector<playerc_device_t*> devices;
+  std::vector<int> kinds;
+  playerc_device_t* dev;
+  double now, stop;
+  size_t k;
+  int i, j;
+
+  bc->failed = true;
+  client = playerc_client_create(NULL, "localhost", opt_port);
+  playerc_client_set_transport(client, bc->transport);
+  playerc_client_set_encoding(client, bc->encoding);
+  playerc_client_set_shm(client, bc->shm ? PLAYERC_SHM_SIZE : 0);
+  if ((playerc_client_connect(client) != 0) ||
+      (client->read_encoding != bc->encoding) ||
+      ((client->shm != NULL) != bc->shm))
+  {
+    playerc_client_destroy(client);
+    return NULL;
+  }
+
+  for (i = 0; i < BENCH_INTERFACES; i++)
+  {
+    if (!opt_interf[i])
+      continue;
+    for (j = 0; j < opt_devices; j++)
+    {
+      int ret;
+      switch (i)
+      {
+        case BENCH_RANGER:
+        {
+          playerc_ranger_t* p = playerc_ranger_create(client, j);
+          dev = &p->info;
+          ret = playerc_ranger_subscribe(p, PLAYER_OPEN_MODE);
+          break;
+        }
+        case BENCH_CAMERA:
+        {
+          playerc_camera_t* p = playerc_camera_create(client, j);
+          dev = &p->info;
+          ret = playerc_camera_subscribe(p, PLAYER_OPEN_MODE);
+          break;
+        }
+        default:
+        {
+          playerc_pointcloud3d_t* p = playerc_pointcloud3d_create(client, j);
+          dev = &p->info;
+          ret = playerc_pointcloud3d_subscribe(p, PLAYER_OPEN_MODE);
+          break;
+        }
+      }
+      devices.push_back(dev);
+      kinds.push_back(i);
+      if (ret != 0)
+        goto done;
+    }
+  }
+  bc->failed = false;
+
+  bc->start = bench_now() + opt_warmup;
+  stop = bc->start + opt_seconds;
+  while ((now = bench_now()) < stop)
+  {
+    // Don't block for long, in case datagrams got lost
+    if (playerc_client_peek(client, 100) <= 0)
+      continue;
+    if (playerc_client_read(client) == NULL)
+    {
+      bc->failed = true;
+      break;
+    }
+    now = bench_now();
+    for (k = 0; k < devices.size(); k++)
+    {
+      dev = devices[k];
+      if (!dev->fresh)
+        continue;
+      dev->fresh = 0;
+      if (now < bc->start)
+        continue;
+
+      i = kinds[k];
+      bc->latency[i].push_back(now - dev->datatime);
+      bc->messages[i]++;
+      switch (i)
+      {
+        case BENCH_RANGER:
+          bc->bytes[i] += ((playerc_ranger_t*)dev)->ranges_count * sizeof(double);
+          break;
+        case BENCH_CAMERA:
+          bc->bytes[i] += ((playerc_camera_t*)dev)->image_count;
+          break;
+        default:
+          bc->bytes[i] += ((playerc_pointcloud3d_t*)dev)->points_count *
+                          sizeof(playerc_pointcloud3d_element_t);
+          break;
+      }
+    }
+  }
+  bc->end = bench_now();
+
+done:
+  for (k = 0; k < devices.size(); k++)
+  {
+    switch (kinds[k])
+    {
+      case BENCH_RANGER:
+        playerc_ranger_unsubscribe((playerc_ranger_t*)devices[k]);
+        playerc_ranger_destroy((playerc_ranger_t*)devices[k]);
+        break;
+      case BENCH_CAMERA:
+        playerc_camera_unsubscribe((playerc_camera_t*)devices[k]);
+        playerc_camera_destroy((playerc_camera_t*)devices[k]);
+        break;
+      default:
+        playerc_pointcloud3d_unsubscribe((playerc_pointcloud3d_t*)devices[k]);
+        playerc_pointcloud3d_destroy((playerc_pointcloud3d_t*)devices[k]);
+        break;
+    }
+  }
+  playerc_client_disconnect(client);
+  playerc_client_destroy(client);
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Reporting
+
+static double
+percentile(const std::vector<double>& sorted, double p)
+{
+  size_t i;
+
+  if (sorted.empty())
+    return 0;
+  i = (size_t)(p * (sorted.size() - 1) + 0.5);
+  return sorted[i];
+}
+
+static double
+cpu_time()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+         ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+// cpu is the CPU time used per second, or negative if not known
+static void
+report(const char* transport, const char* encoding, const char* interf,
+       bool failed, std::vector<double>& latency, uint64_t messages,
+       uint64_t bytes, double seconds, double cpu)
+{
+  printf("{\"transport\":\"%s\",\"encoding\":\"%s\",\"interface\":\"%s\","
+         "\"devices\":%d,\"clients\":%d,\"rate\":%g,", transport, encoding,
+         interf, opt_devices, opt_clients, opt_rate);
+  if (failed)
+  {
+    printf("\"result\":\"error\"}\n");
+    return;
+  }
+  std::sort(latency.begin(), latency.end());
+  if ((cpu >= 0) && (bytes > 0))
+    printf("\"cpu_percent\":%.1f,\"cpu_us_per_mb\":%.1f,", cpu * 100,
+           cpu * 1e12 / (bytes / seconds));
+  printf("\"seconds\":%.3f,\"messages\":%llu,\"msgs_per_s\":%.1f,"
+         "\"bytes\":%llu,\"bytes_per_s\":%.1f,\"latency_us\":{\"p50\":%.0f,"
+         "\"p90\":%.0f,\"p99\":%.0f,\"p999\":%.0f,\"max\":%.0f}}\n",
+         seconds, (unsigned long long)messages, messages / seconds,
+         (unsigned long long)bytes, bytes / seconds,
+         percentile(latency, 0.5) * 1e6, percentile(latency, 0.9) * 1e6,
+         percentile(latency, 0.99) * 1e6, percentile(latency, 0.999) * 1e6,
+         latency.empty() ? 0.0 : latency.back() * 1e6);
+  fflush(stdout);
+}
+
+// Run all clients over one transport with one encoding and report the
+// results
+static int
+run_phase(int transport, bool shm, const char* name, int encoding,
+          const char* encoding_name)
+{
+  std::vector<bench_client_t> clients(opt_clients);
+  std::vector<double> all_latency;
+  uint64_t all_messages = 0, all_bytes = 0;
+  double start = 0, end = 0;
+  double cpu0, cpu1, t0, t1;
+  bool failed = false;
+  int i, c;
+
+  for (c = 0; c < opt_clients; c++)
+  {
+    clients[c].transport = transport;
+    clients[c].encoding = encoding;
+    clients[c].shm = shm;
+    memset(clients[c].messages, 0, sizeof(clients[c].messages));
+    memset(clients[c].bytes, 0, sizeof(clients[c].bytes));
+    pthread_create(&clients[c].thread, NULL, client_main, &clients[c]);
+  }
+  // The CPU time of the whole process, over (about) the clients'
+  // measurement
+  usleep((useconds_t)(opt_warmup * 1e6) + 100000);
+  t0 = bench_now();
+  cpu0 = cpu_time();
+  usleep((useconds_t)(std::max(opt_seconds - 0.2, 0.1) * 1e6));
+  t1 = bench_now();
+  cpu1 = cpu_time();
+  for (c = 0; c < opt_clients; c++)
+  {
+    pthread_join(clients[c].thread, NULL);
+    if (clients[c].failed)
+    {
+      failed = true;
+      continue;
+    }
+    if ((c == 0) || (clients[c].start < start))
+      start = clients[c].start;
+    if ((c == 0) || (clients[c].end > end))
+      end = clients[c].end;
+  }
+
+  for (i = 0; i < BENCH_INTERFACES; i++)
+  {
+    std::vector<double> latency;
+    uint64_t messages = 0, bytes = 0;
+
+    if (!opt_interf[i])
+      continue;
+    for (c = 0; c < opt_clients; c++)
+    {
+      latency.insert(latency.end(), clients[c].latency[i].begin(),
+                     clients[c].latency[i].end());
+      messages += clients[c].messages[i];
+      bytes += clients[c].bytes[i];
+    }
+    all_latency.insert(all_latency.end(), latency.begin(), latency.end());
+    all_messages += messages;
+    all_bytes += bytes;
+    report(name, encoding_name, bench_interf_names[i], failed, latency,
+           messages, bytes, end - start, -1);
+  }
+  report(name, encoding_name, "all", failed, all_latency, all_messages,
+         all_bytes, end - start, (cpu1 - cpu0) / (t1 - t0));
+  return failed ? -1 : 0;
+}
+
+int
+main(int argc, char** argv)
+{
+  pthread_t server;
+  int ret = 0;
+
+  if (parse_args(argc, argv) < 0)
+  {
+    fprintf(stderr, "%s\n", USAGE);
+    return -1;
+  }
+
+  if (server_start() < 0)
+    return -1;
+  pthread_create(&server, NULL, server_main, NULL);
+
+  if (opt_tcp && opt_xdr &&
+      (run_phase(PLAYERC_TRANSPORT_TCP, false, "tcp", PLAYER_ENCODING_XDR, "xdr") < 0))
+    ret = -1;
+  if (opt_tcp && opt_raw &&
+      (run_phase(PLAYERC_TRANSPORT_TCP, false, "tcp", PLAYER_ENCODING_RAW, "raw") < 0))
+    ret = -1;
+  if (opt_udp && opt_xdr &&
+      (run_phase(PLAYERC_TRANSPORT_UDP, false, "udp", PLAYER_ENCODING_XDR, "xdr") < 0))
+    ret = -1;
+  if (opt_udp && opt_raw &&
+      (run_phase(PLAYERC_TRANSPORT_UDP, false, "udp", PLAYER_ENCODING_RAW, "raw") < 0))
+    ret = -1;
+  if (opt_shm &&
+      (run_phase(PLAYERC_TRANSPORT_TCP, true, "shm", PLAYER_ENCODING_RAW, "raw") < 0))
+    ret = -1;
+
+  server_quit = true;
+  pthread_join(server, NULL);
+  server_stop();
+  return ret;
+}
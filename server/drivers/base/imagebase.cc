@@ -43,6 +43,8 @@
 ImageBase::ImageBase(ConfigFile *cf, int section, bool overwrite_cmds, size_t queue_maxlen, int interf)
 	: ThreadedDriver(cf, section, overwrite_cmds, queue_maxlen, interf)
 {
+  // Main() only processes messages and frames, so we can be run as a task
+  this->TaskCapable = true;
   memset(&this->camera_addr, 0, sizeof(player_devaddr_t));
   stored_data.image = NULL;
   stored_data.image_count = 0;
@@ -62,6 +64,8 @@ ImageBase::ImageBase(ConfigFile *cf, int section, bool overwrite_cmds, size_t qu
 ImageBase::ImageBase(ConfigFile *cf, int section, bool overwrite_cmds, size_t queue_maxlen)
 	: ThreadedDriver(cf, section, overwrite_cmds, queue_maxlen)
 {
+  // Main() only processes messages and frames, so we can be run as a task
+  this->TaskCapable = true;
   memset(&this->camera_addr, 0, sizeof(player_devaddr_t));
   stored_data.image = NULL;
   stored_data.image_count = 0;
@@ -192,13 +196,20 @@ void ImageBase::Main()
 
 		InQueue->Wait();
 
-		ProcessMessages();
-
-		if (HaveData)
-		{
-			ProcessFrame();
-			HaveData = false;
-		}
+		MainStep();
 	}
 
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// Process pending messages, then the latest frame if one came in
+void ImageBase::MainStep()
+{
+	ProcessMessages();
+
+	if (HaveData)
+	{
+		ProcessFrame();
+		HaveData = false;
+	}
+}
@@ -83,6 +83,7 @@ class ImageBase : public ThreadedDriver
 		virtual void Main();
 		virtual int MainSetup();
 		virtual void MainQuit();
+		virtual void MainStep();
 
 		// Input camera stuff
   		Device *camera_driver;
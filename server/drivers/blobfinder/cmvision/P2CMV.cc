@@ -80,6 +80,12 @@ configuration file.
   - Default: 0 (off)
   - maximum number of pixels allowed to qualify as a blob
 
+- threads (int)
+  - Default: 1
+  - Number of threads used to process each image.  The image is split
+    into bands of rows which are classified and segmented in parallel,
+    and the blobs crossing band edges are joined afterwards.
+
 @verbatim
 [Colors]
 (255,  0,  0) 0.000000 10 Red
@@ -103,6 +109,7 @@ driver
   colorfile "/path/to/colorfile"
   minblobarea 1
   maxblobarea 100
+  threads 2
 )
 @endverbatim
 
@@ -134,7 +141,6 @@ Ben Grocholsky, Brad Kratochvil
   #include <libplayerjpeg/playerjpeg.h>
 #endif
 
-#include "conversions.h"
 #include "cmvision.h"
 
 #define CMV_NUM_CHANNELS CMV_MAX_COLORS
@@ -166,11 +172,11 @@ class CMVisionBF: public ThreadedDriver
                                   //            2=everything
     uint16_t         mWidth;
     uint16_t         mHeight;     // the image dimensions
-    uint8_t*         mImg;
     uint8_t*         mTmp;
     const char*      mColorFile;
     uint16_t         mMinArea;
     uint16_t         mMaxArea;
+    int              mThreads;
 
     player_blobfinder_data_t   mData;
     unsigned int     allocated_blobs;
@@ -197,7 +203,7 @@ class CMVisionBF: public ThreadedDriver
     int MainSetup();
     void MainQuit();
     
-    void ProcessImageData();
+    void ProcessImageData(const uint8_t* image, int bpp);
     int ProcessBlobfinderReqSetColor(player_msghdr_t *hdr, 
                                      player_blobfinder_color_config_t *data);
     int ProcessBlobfinderReqGetColor(player_msghdr_t *hdr, 
@@ -223,16 +229,18 @@ CMVisionBF::CMVisionBF( ConfigFile* cf, int section)
            PLAYER_BLOBFINDER_CODE),
            mWidth(0),
            mHeight(0),
-           mImg(NULL),
            mTmp(NULL),
            mColorFile(NULL),
            mCameraDev(NULL),
            mVision(NULL)
 {
+  // Main() only processes messages, so we can be run as a task
+  this->TaskCapable = true;
   mColorFile  = cf->ReadString(section, "colorfile", "");
   mDebugLevel = cf->ReadInt(section, "debuglevel", 0);
   mMinArea    = cf->ReadInt(section, "minblobarea", CMV_MIN_AREA);
   mMaxArea    = cf->ReadInt(section, "maxblobarea", 0);
+  mThreads    = cf->ReadInt(section, "threads", 1);
   // Must have an input camera
   if (cf->ReadDeviceAddr(&mCameraAddr, section, "requires",
                          PLAYER_CAMERA_CODE, -1, NULL) != 0)
@@ -245,7 +253,6 @@ CMVisionBF::CMVisionBF( ConfigFile* cf, int section)
 CMVisionBF::~CMVisionBF()
 {
   if (mVision) delete mVision;
-  if (mImg) delete []mImg;
   if (mTmp) delete []mTmp;
 }
 
@@ -274,6 +281,8 @@ CMVisionBF::MainSetup()
   mVision = new CMVision();
   mVision->set_cmv_min_area(mMinArea);
   mVision->set_cmv_max_area(mMaxArea);
+  if (!mVision->setThreads(mThreads))
+    PLAYER_WARN1("unable to use %d threads, using 1", mThreads);
   // clean our data
   memset(&mData,0,sizeof(mData));
   allocated_blobs = 0;
@@ -312,7 +321,7 @@ CMVisionBF::Main()
 }
 
 void
-CMVisionBF::ProcessImageData()
+CMVisionBF::ProcessImageData(const uint8_t* image, int bpp)
 {
     assert(mVision);
     // this shouldn't change often
@@ -343,7 +352,7 @@ CMVisionBF::ProcessImageData()
       printf("cmvision using camera: [w %d h %d]\n", mWidth, mHeight);
     }
 
-    if (!mVision->processFrame(reinterpret_cast<image_pixel*>(mImg)))
+    if (!mVision->processFrameRGB(image, bpp))
     {
       PLAYER_ERROR("Frame error.");
     }
@@ -455,9 +464,7 @@ CMVisionBF::ProcessMessage(QueuePointer & resp_queue,
     //assert(hdr->size == sizeof(player_camera_data_t));
     player_camera_data_t* camera_data = reinterpret_cast<player_camera_data_t *>(data);
     uint8_t* ptr;
-    uint8_t* ptr1;
-    size_t mSize;
-    int i;
+    int bpp;
 
     assert(camera_data);
 
@@ -477,17 +484,16 @@ CMVisionBF::ProcessMessage(QueuePointer & resp_queue,
 
     if ((camera_data->width) && (camera_data->height))
     {
-      if ((mWidth != camera_data->width) || (mHeight != camera_data->height) || (!mImg) || (!mTmp))
+      if ((mWidth != camera_data->width) || (mHeight != camera_data->height) || (!mTmp))
       {
         mWidth  = camera_data->width;
         mHeight = camera_data->height;
-        if (mImg) delete []mImg; mImg = NULL;
         if (mTmp) delete []mTmp; mTmp = NULL;
         // we need to allocate some memory
-        if (!mImg) mImg = new uint8_t[mWidth * mHeight * 2];
         if (!mTmp) mTmp = new uint8_t[mWidth * mHeight * 3];
       }
       ptr = NULL;
+      bpp = 3;
       if (camera_data->compression == PLAYER_CAMERA_COMPRESS_JPEG)
       {
         assert(camera_data->bpp == 24);
@@ -505,18 +511,9 @@ CMVisionBF::ProcessMessage(QueuePointer & resp_queue,
         ptr = camera_data->image;
         break;
       case 32:
+        // CMVision skips the fourth byte itself
         ptr = camera_data->image;
-        ptr1 = mTmp;
-        mSize = camera_data->width * camera_data->height;
-        for (i = 0; i < static_cast<int>(mSize); i++)
-        {
-          ptr1[0] = ptr[0];
-          ptr1[1] = ptr[1];
-          ptr1[2] = ptr[2];
-          ptr += 4;
-          ptr1 += 3;
-        }
-        ptr = mTmp;
+        bpp = 4;
         break;
       default:
         PLAYER_ERROR1("Unsupported depth %u", camera_data->bpp);
@@ -524,11 +521,9 @@ CMVisionBF::ProcessMessage(QueuePointer & resp_queue,
       }
       assert(ptr);
 
-      // now deal with the data
-      rgb2uyvy(ptr, mImg, mWidth*mHeight);
-
-      // we have a new image,
-      ProcessImageData();
+      // we have a new image; CMVision converts it to YUV as it
+      // classifies the pixels
+      ProcessImageData(ptr, bpp);
     }
     return(0);
   }
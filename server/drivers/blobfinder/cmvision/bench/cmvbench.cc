@@ -0,0 +1,187 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * Frame rate benchmark for CMVision.  Runs a synthetic RGB frame through
+ * the old convert-then-process path used by the cmvision driver, the
+ * YUV path on its own and the fused RGB path, and prints frames per
+ * second for each.  With a color file, its first three colors are
+ * painted into the frame; otherwise built-in thresholds are used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "cmvision.h"
+#include "conversions.h"
+
+#define USAGE "USAGE: cmvbench [<width> <height> [<frames> [<threads> [<colorfile>]]]]"
+
+double get_time(void);
+
+// RGB values inside the built-in thresholds below
+static const unsigned char paint[3][3] = {{230,20,30},{30,200,40},{20,40,210}};
+
+// Makes a frame of color patches on a grey, slightly noisy background
+void make_frame(unsigned char* rgb, int width, int height)
+{
+  int x, y, c, n;
+  unsigned int seed = 1;
+  unsigned char* p;
+
+  for (y = 0; y < height; y++)
+  {
+    for (x = 0; x < width; x++)
+    {
+      p = rgb + 3 * (y * width + x);
+      seed = seed * 1103515245 + 12345;
+      n = (seed >> 16) & 15;
+      c = ((x / 40) + 2 * (y / 30)) % 5;
+      if (c < 3)
+      {
+        p[0] = paint[c][0] + n / 2;
+        p[1] = paint[c][1] + n / 2;
+        p[2] = paint[c][2] + n / 2;
+      }
+      else
+        p[0] = p[1] = p[2] = 100 + n;
+    }
+  }
+}
+
+// Runs fn over the frame and returns the frame rate
+#define BENCH(label, frames, fn) \
+  do { \
+    double t0, t1; \
+    int i; \
+    t0 = get_time(); \
+    for (i = 0; i < (frames); i++) \
+      fn; \
+    t1 = get_time(); \
+    printf("%-28s %8.1f fps\n", label, (frames) / (t1 - t0)); \
+  } while (0)
+
+int
+main(int argc, char** argv)
+{
+  int width = 640;
+  int height = 480;
+  int frames = 200;
+  int threads = 1;
+  const char* colorfile = NULL;
+  unsigned char *rgb, *rgba, *yuv;
+  CMVision vision;
+  int i, c, count;
+  char label[64];
+
+  if (argc == 2 || argc > 6)
+  {
+    puts(USAGE);
+    exit(-1);
+  }
+  if (argc > 2)
+  {
+    width = atoi(argv[1]);
+    height = atoi(argv[2]);
+  }
+  if (argc > 3)
+    frames = atoi(argv[3]);
+  if (argc > 4)
+    threads = atoi(argv[4]);
+  if (argc > 5)
+    colorfile = argv[5];
+
+  rgb = new unsigned char[width * height * 3];
+  rgba = new unsigned char[width * height * 4];
+  yuv = new unsigned char[width * height * 2];
+  make_frame(rgb, width, height);
+  for (i = 0; i < width * height; i++)
+  {
+    memcpy(rgba + 4 * i, rgb + 3 * i, 3);
+    rgba[4 * i + 3] = 0;
+  }
+
+  if (!vision.initialize(width, height))
+  {
+    puts("initialize failed");
+    exit(-1);
+  }
+  vision.set_cmv_min_area(CMV_MIN_AREA);
+  vision.set_cmv_max_area(0);
+  if (colorfile)
+  {
+    if (!vision.loadOptions(const_cast<char*>(colorfile)))
+    {
+      printf("can't load %s\n", colorfile);
+      exit(-1);
+    }
+  }
+  else
+  {
+    vision.setThreshold(0, 25, 164, 80, 120, 150, 240);
+    vision.setThreshold(1, 20, 220, 50, 120, 40, 115);
+    vision.setThreshold(2, 15, 190, 145, 255, 40, 120);
+  }
+
+  printf("%dx%d, %d frames\n", width, height, frames);
+
+  BENCH("rgb2uyvy + processFrame", frames,
+        (rgb2uyvy(rgb, yuv, width * height),
+         vision.processFrame(reinterpret_cast<image_pixel*>(yuv))));
+  BENCH("processFrame (YUV)", frames,
+        vision.processFrame(reinterpret_cast<image_pixel*>(yuv)));
+  BENCH("processFrameRGB (24 bit)", frames, vision.processFrameRGB(rgb, 3));
+  BENCH("processFrameRGB (32 bit)", frames, vision.processFrameRGB(rgba, 4));
+
+  if (threads > 1)
+  {
+    if (!vision.setThreads(threads))
+    {
+      fprintf(stderr, "unable to use %d threads\n", threads);
+      return 1;
+    }
+    snprintf(label, sizeof(label), "processFrame, %d threads", threads);
+    BENCH(label, frames,
+          vision.processFrame(reinterpret_cast<image_pixel*>(yuv)));
+    snprintf(label, sizeof(label), "processFrameRGB, %d threads", threads);
+    BENCH(label, frames, vision.processFrameRGB(rgb, 3));
+  }
+
+  count = 0;
+  for (c = 0; c < CMV_MAX_COLORS; c++)
+    count += vision.numRegions(c);
+  printf("%d regions in the last frame\n", count);
+
+  delete [] yuv;
+  delete [] rgba;
+  delete [] rgb;
+  return 0;
+}
+
+double
+get_time(void)
+{
+  struct timeval curr;
+  gettimeofday(&curr,NULL);
+  return(curr.tv_sec + curr.tv_usec / 1e6);
+}
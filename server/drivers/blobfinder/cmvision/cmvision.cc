@@ -36,6 +36,9 @@
 #if !defined (WIN32)
   #include <strings.h>
 #endif
+#if defined (__SSE2__)
+  #include <emmintrin.h>
+#endif
 
 #if defined (WIN32)
   #define strncasecmp _strnicmp
@@ -102,9 +105,156 @@ inline num top_bit(num n)
 
 //==== Class Implementation ========================================//
 
+// Same integer conversion as rgb2uyvy() in conversions.c, so that
+// processFrameRGB() classifies exactly like converting first.  The
+// weights of each channel sum to 1024 (or 0 for U and V), so for 8 bit
+// inputs the results are always in [0,255] and need no clipping.
+#define CMV_RGB2YUV(r,g,b,y,u,v)\
+  y = (306*r + 601*g + 117*b)  >> 10;\
+  u = ((-172*r - 340*g + 512*b) >> 10)  + 128;\
+  v = ((512*r - 429*g - 83*b) >> 10) + 128
+
+#if defined (__SSE2__)
+// The class tables are built from one Y, U and V range per color, so
+// with SSE2 we classify blocks of 8 pixels by testing each color's
+// ranges rather than doing three table lookups per pixel pair.  The
+// range patterns are laid out like the pixels, so one unsigned compare
+// covers all channels, giving a byte of color bits per channel which
+// are then combined like the table entries would be.  This only works
+// for the first 8 colors, which is what nearly every setup uses.
+struct cmv_sse_classes{
+  __m128i lo[8],span[8],bits[8];
+  int num;
+  // shifts moving each channel of an image_pixel to the low byte
+  __m128i su,sv,sy1,sy2;
+};
+
+static void cmv_sse_setup(cmv_sse_classes &sc,int num,const unsigned *lo,
+                          const unsigned *span,const unsigned *bit)
+{
+  image_pixel p;
+  unsigned char *b = (unsigned char *)&p;
+  int c;
+
+  sc.num = num;
+  for(c=0; c<num; c++){
+    sc.lo[c]   = _mm_set1_epi32(lo[c]);
+    sc.span[c] = _mm_set1_epi32(span[c]);
+    sc.bits[c] = _mm_set1_epi8((char)bit[c]);
+  }
+
+  sc.su  = _mm_cvtsi32_si128(8 * (int)(&p.u  - b));
+  sc.sv  = _mm_cvtsi32_si128(8 * (int)(&p.v  - b));
+  sc.sy1 = _mm_cvtsi32_si128(8 * (int)(&p.y1 - b));
+  sc.sy2 = _mm_cvtsi32_si128(8 * (int)(&p.y2 - b));
+}
+
+// Classifies 4 image_pixels (8 pixels) into map[0..7]
+static inline void cmv_sse_classify(const cmv_sse_classes &sc,__m128i x,
+                                    unsigned *map)
+{
+  __m128i acc,d,in,uv,m1,m2;
+  const __m128i low = _mm_set1_epi32(0xFF);
+  int c;
+
+  acc = _mm_setzero_si128();
+  for(c=0; c<sc.num; c++){
+    d  = _mm_sub_epi8(x,sc.lo[c]);
+    in = _mm_cmpeq_epi8(_mm_min_epu8(d,sc.span[c]),d);
+    acc = _mm_or_si128(acc,_mm_and_si128(in,sc.bits[c]));
+  }
+
+  uv = _mm_and_si128(_mm_srl_epi32(acc,sc.su),_mm_srl_epi32(acc,sc.sv));
+  m1 = _mm_and_si128(_mm_and_si128(uv,_mm_srl_epi32(acc,sc.sy1)),low);
+  m2 = _mm_and_si128(_mm_and_si128(uv,_mm_srl_epi32(acc,sc.sy2)),low);
+
+  // interleave back into pixel order
+  _mm_storeu_si128((__m128i *)(map + 0),_mm_unpacklo_epi32(m1,m2));
+  _mm_storeu_si128((__m128i *)(map + 4),_mm_unpackhi_epi32(m1,m2));
+}
+
+// Sums adjacent pairs of 32 bit products from _mm_madd_epi16 for the
+// pixels in a and b: the result holds one value per pixel.
+static inline __m128i cmv_sse_hadd(__m128i a,__m128i b)
+{
+  __m128 fa = _mm_castsi128_ps(a);
+  __m128 fb = _mm_castsi128_ps(b);
+
+  return(_mm_add_epi32(
+    _mm_castps_si128(_mm_shuffle_ps(fa,fb,_MM_SHUFFLE(2,0,2,0))),
+    _mm_castps_si128(_mm_shuffle_ps(fa,fb,_MM_SHUFFLE(3,1,3,1)))));
+}
+
+// Converts 8 RGBX pixels (4 in each of a and b, one per 32 bit lane)
+// to 4 image_pixels
+static inline __m128i cmv_sse_rgb2yuv(const cmv_sse_classes &sc,
+                                      __m128i a,__m128i b)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i cy = _mm_setr_epi16(306,601,117,0,306,601,117,0);
+  const __m128i cu = _mm_setr_epi16(-172,-340,512,0,-172,-340,512,0);
+  const __m128i cv = _mm_setr_epi16(512,-429,-83,0,512,-429,-83,0);
+  const __m128i off = _mm_set1_epi32(128);
+  __m128i a0,a1,b0,b1;
+  __m128i ya,yb,ua,ub,va,vb;
+  __m128 f1,f2;
+  __m128i y1,y2,u,v;
+
+  // pixels as 16 bit r,g,b,x
+  a0 = _mm_unpacklo_epi8(a,zero);
+  a1 = _mm_unpackhi_epi8(a,zero);
+  b0 = _mm_unpacklo_epi8(b,zero);
+  b1 = _mm_unpackhi_epi8(b,zero);
+
+  ya = _mm_srai_epi32(cmv_sse_hadd(_mm_madd_epi16(a0,cy),_mm_madd_epi16(a1,cy)),10);
+  yb = _mm_srai_epi32(cmv_sse_hadd(_mm_madd_epi16(b0,cy),_mm_madd_epi16(b1,cy)),10);
+  ua = _mm_srai_epi32(cmv_sse_hadd(_mm_madd_epi16(a0,cu),_mm_madd_epi16(a1,cu)),10);
+  ub = _mm_srai_epi32(cmv_sse_hadd(_mm_madd_epi16(b0,cu),_mm_madd_epi16(b1,cu)),10);
+  va = _mm_srai_epi32(cmv_sse_hadd(_mm_madd_epi16(a0,cv),_mm_madd_epi16(a1,cv)),10);
+  vb = _mm_srai_epi32(cmv_sse_hadd(_mm_madd_epi16(b0,cv),_mm_madd_epi16(b1,cv)),10);
+
+  // average U and V over each pair, and split Y into the first and
+  // second pixel of each pair
+  u = _mm_srli_epi32(_mm_add_epi32(cmv_sse_hadd(ua,ub),
+                                   _mm_add_epi32(off,off)),1);
+  v = _mm_srli_epi32(_mm_add_epi32(cmv_sse_hadd(va,vb),
+                                   _mm_add_epi32(off,off)),1);
+  f1 = _mm_castsi128_ps(ya);
+  f2 = _mm_castsi128_ps(yb);
+  y1 = _mm_castps_si128(_mm_shuffle_ps(f1,f2,_MM_SHUFFLE(2,0,2,0)));
+  y2 = _mm_castps_si128(_mm_shuffle_ps(f1,f2,_MM_SHUFFLE(3,1,3,1)));
+
+  return(_mm_or_si128(_mm_or_si128(_mm_sll_epi32(u,sc.su),
+                                   _mm_sll_epi32(v,sc.sv)),
+                      _mm_or_si128(_mm_sll_epi32(y1,sc.sy1),
+                                   _mm_sll_epi32(y2,sc.sy2))));
+}
+
+// Loads 4 pixels of 3 bytes; reads one byte past the last pixel
+static inline __m128i cmv_sse_load_rgb(const unsigned char *p)
+{
+  int x0,x1,x2,x3;
+
+  memcpy(&x0,p + 0,4);
+  memcpy(&x1,p + 3,4);
+  memcpy(&x2,p + 6,4);
+  memcpy(&x3,p + 9,4);
+
+  return(_mm_setr_epi32(x0,x1,x2,x3));
+}
+#endif
+
 void CMVision::classifyFrame(image_pixel * restrict img,unsigned * restrict map)
 // Classifies an image passed in as img, saving bits in the entries
 // of map representing which thresholds that pixel satisfies.
+{
+  classifyPixels(img,map,0,width * height);
+}
+
+void CMVision::classifyPixels(image_pixel * restrict img,
+                              unsigned * restrict map,int start,int end)
+// Classifies pixels [start,end) of img; start must be even, since
+// pixels come in pairs sharing their U and V samples.
 {
   int i,m,s;
   int m1,m2;
@@ -114,10 +264,23 @@ void CMVision::classifyFrame(image_pixel * restrict img,unsigned * restrict map)
   unsigned *vclas = v_class; //   has to consider pointer aliasing
   unsigned *yclas = y_class;
 
-  s = width * height;
+  i = start;
+  s = end;
+
+#if defined (__SSE2__)
+  if(class_simd){
+    cmv_sse_classes sc;
+
+    cmv_sse_setup(sc,class_num,class_lo,class_span,class_bit);
+    for(; i+8<=s; i+=8){
+      cmv_sse_classify(sc,_mm_loadu_si128((const __m128i *)(img + i/2)),
+                       map + i);
+    }
+  }
+#endif
 
   if(options & CMV_DUAL_THRESHOLD){
-    for(i=0; i<s; i+=2){
+    for(; i<s; i+=2){
       p = img[i/2];
       m = uclas[p.u] & vclas[p.v];
       m1 = m & yclas[p.y1];
@@ -126,7 +289,7 @@ void CMVision::classifyFrame(image_pixel * restrict img,unsigned * restrict map)
       map[i + 1] = m2 | (m2 >> 16);
     }
   }else{
-    for(i=0; i<s; i+=2){
+    for(; i<s; i+=2){
       p = img[i/2];
       m = uclas[p.u] & vclas[p.v];
       map[i + 0] = m & yclas[p.y1];
@@ -135,45 +298,208 @@ void CMVision::classifyFrame(image_pixel * restrict img,unsigned * restrict map)
   }
 }
 
+void CMVision::classifyPixelsRGB(const unsigned char * restrict rgb,int bpp,
+                                 unsigned * restrict map,
+                                 image_pixel * restrict img,
+                                 int start,int end)
+// Converts pixels [start,end) of a packed RGB image to YUV and
+// classifies them in the same pass.  If img is given the YUV pixels
+// are stored there as well.  start must be even.
+{
+  int i,m,m1,m2;
+  int r,g,b;
+  int y1,u1,v1,y2,u2,v2;
+  const unsigned char *p,*q;
+
+  unsigned *uclas = u_class;
+  unsigned *vclas = v_class;
+  unsigned *yclas = y_class;
+
+  i = start;
+
+#if defined (__SSE2__)
+  if(class_simd){
+    cmv_sse_classes sc;
+    __m128i a,c,x;
+
+    cmv_sse_setup(sc,class_num,class_lo,class_span,class_bit);
+    // 3 byte pixels are loaded 4 bytes at a time, so stop one pixel
+    // early to stay inside the image
+    for(; i+8+(bpp==3)<=end; i+=8){
+      p = rgb + i * bpp;
+      if(bpp == 4){
+        a = _mm_loadu_si128((const __m128i *)(p + 0));
+        c = _mm_loadu_si128((const __m128i *)(p + 16));
+      }else{
+        a = cmv_sse_load_rgb(p + 0);
+        c = cmv_sse_load_rgb(p + 12);
+      }
+      x = cmv_sse_rgb2yuv(sc,a,c);
+      if(img) _mm_storeu_si128((__m128i *)(img + i/2),x);
+      cmv_sse_classify(sc,x,map + i);
+    }
+  }
+#endif
+
+  for(; i<end; i+=2){
+    p = rgb + i * bpp;
+    q = (i + 1 < end)? p + bpp : p;
+
+    r = p[0]; g = p[1]; b = p[2];
+    CMV_RGB2YUV(r,g,b,y1,u1,v1);
+    r = q[0]; g = q[1]; b = q[2];
+    CMV_RGB2YUV(r,g,b,y2,u2,v2);
+    u1 = (u1 + u2) >> 1;
+    v1 = (v1 + v2) >> 1;
+
+    m = uclas[u1] & vclas[v1];
+    m1 = m & yclas[y1];
+    m2 = m & yclas[y2];
+    if(options & CMV_DUAL_THRESHOLD){
+      m1 |= m1 >> 16;
+      m2 |= m2 >> 16;
+    }
+    map[i + 0] = m1;
+    map[i + 1] = m2;
+
+    if(img){
+      img[i/2].y1 = y1;
+      img[i/2].u  = u1;
+      img[i/2].y2 = y2;
+      img[i/2].v  = v1;
+    }
+  }
+}
+
+void CMVision::updateClassRanges()
+// Recovers the Y, U and V range of every color from the class tables
+// for the vectorised classifier.  Colors that can't match anything
+// are left out.  If a color's bits don't form a single range in some
+// table, or a color past the eighth is used, we stay with the table
+// lookups.
+{
+  unsigned *tab[3] = {y_class,u_class,v_class};
+  int lo[3],hi[3];
+  unsigned k,pl,ps;
+  image_pixel p;
+  int c,t,i;
+  bool empty;
+
+  class_num = 0;
+  class_simd = true;
+
+  for(c=0; c<CMV_MAX_COLORS; c++){
+    k = 1U << c;
+    empty = false;
+
+    for(t=0; t<3; t++){
+      lo[t] = 0;
+      while(lo[t] < CMV_COLOR_LEVELS && !(tab[t][lo[t]] & k)) lo[t]++;
+      if(lo[t] == CMV_COLOR_LEVELS){
+        empty = true;
+        continue;
+      }
+      hi[t] = CMV_COLOR_LEVELS - 1;
+      while(!(tab[t][hi[t]] & k)) hi[t]--;
+      for(i=lo[t]; i<=hi[t]; i++){
+        if(!(tab[t][i] & k)){
+          class_simd = false;
+          return;
+        }
+      }
+    }
+    if(empty) continue;
+    if(c >= 8){
+      class_simd = false;
+      return;
+    }
+
+    memset(&p,0,sizeof(p));
+    p.y1 = p.y2 = lo[0];
+    p.u = lo[1];
+    p.v = lo[2];
+    memcpy(&pl,&p,sizeof(pl));
+    p.y1 = p.y2 = hi[0] - lo[0];
+    p.u = hi[1] - lo[1];
+    p.v = hi[2] - lo[2];
+    memcpy(&ps,&p,sizeof(ps));
+
+    class_lo[class_num]   = pl;
+    class_span[class_num] = ps;
+    class_bit[class_num]  = k;
+    class_num++;
+  }
+}
+
 int CMVision::encodeRuns(rle * restrict out,unsigned * restrict map)
 // Changes the flat array version of the threshold satisfaction map
 // into a run length encoded version, which speeds up later processing
 // since we only have to look at the points where values change.
+{
+  int j,last_row;
+
+  j = encodeRows(out,map,0,height,max_runs,last_row);
+
+  return((j < 0)? 0 : j);
+}
+
+int CMVision::encodeRows(rle * restrict out,unsigned * restrict map,
+                         int y1,int y2,int max,int &last_row)
+// Run length encodes rows [y1,y2) of map into out, numbering runs
+// from 0.  Returns the number of runs, or -1 if more than max were
+// needed.  last_row is set to the index of the first run of row y2-1.
 {
   int x,y,j,l;
   unsigned m,save;
-  int size;
   unsigned *row;
   rle r;
 
-  size = width * height;
-
-  // initialize terminator restore
-  save = map[0];
-
   j = 0;
-  for(y=0; y<height; y++){
+  last_row = 0;
+  for(y=y1; y<y2; y++){
     row = &map[y * width];
-
-    // restore previous terminator and store next
-    // one in the first pixel on the next row
-    row[0] = save;
-    save = row[width];
-    row[width] = CMV_NONE;
+    last_row = j;
 
     x = 0;
-    while(x < width){
-      m = row[x];
-      // m = m & (~m + 1); // get last bit
-      l = x;
-      while(row[x] == m) x++;
-      // x += (row[x] == CMV_NONE); //  && (last & m);
+    if(y+1 < y2 || y2 == height){
+      // store a terminator in the first pixel of the next row (or the
+      // spare element after the map), so the inner loop needs no
+      // bounds check
+      save = row[width];
+      row[width] = CMV_NONE;
+
+      while(x < width){
+        m = row[x];
+        // m = m & (~m + 1); // get last bit
+        l = x;
+        while(row[x] == m) x++;
+        // x += (row[x] == CMV_NONE); //  && (last & m);
+
+        r.color  = m;
+        r.length = x - l;
+        r.parent = j;
+        out[j++] = r;
+        if(j >= max){
+          row[width] = save;
+          return(-1);
+        }
+      }
 
-      r.color  = m;
-      r.length = x - l;
-      r.parent = j;
-      out[j++] = r;
-      if(j >= CMV_MAX_RUNS) return(0);
+      row[width] = save;
+    }else{
+      // the next row belongs to another band which may be working on
+      // it right now, so leave it alone
+      while(x < width){
+        m = row[x];
+        l = x;
+        while(x < width && row[x] == m) x++;
+
+        r.color  = m;
+        r.length = x - l;
+        r.parent = j;
+        out[j++] = r;
+        if(j >= max) return(-1);
+      }
     }
   }
 
@@ -183,10 +509,18 @@ int CMVision::encodeRuns(rle * restrict out,unsigned * restrict map)
 void CMVision::connectComponents(rle * restrict map,int num)
 // Connect components using four-connecteness so that the runs each
 // identify the global parent of the connected region they are a part
-// of.  It does this by scanning adjacent rows and merging where similar
-// colors overlap.  Used to be union by rank w/ path compression, but now
-// is just uses path compression as the global parent index seems to be
-// a simpler fast approximation of rank in practice.
+// of.
+{
+  connectRuns(map,num);
+  compressPaths(map,num);
+}
+
+void CMVision::connectRuns(rle * restrict map,int num)
+// Merges the runs of map by scanning adjacent rows and merging where
+// similar colors overlap.  Used to be union by rank w/ path
+// compression, but now is just uses path compression as the global
+// parent index seems to be a simpler fast approximation of rank in
+// practice.  Parents always have a lower index than their children.
 // WARNING: This code is *extremely* complicated and twitchy.  It appears
 //   to be a correct implementation, but minor changes can easily cause
 //   big problems.  Read the papers on this library and have a good
@@ -195,16 +529,17 @@ void CMVision::connectComponents(rle * restrict map,int num)
   int x1,x2;
   int l1,l2;
   rle r1,r2;
-  int i,p,s,n;
+  int p,s,n;
 
   l1 = l2 = 0;
   x1 = x2 = 0;
 
   // Lower scan begins on second line, so skip over first
-  while(x1 < width){
+  while(x1 < width && l1 < num){
     x1 += map[l1++].length;
   }
   x1 = 0;
+  if(l1 >= num) return;
 
   // Do rest in lock step
   r1 = map[l1];
@@ -242,8 +577,52 @@ void CMVision::connectComponents(rle * restrict map,int num)
       r2 = map[++l2];
     }
   }
+}
+
+void CMVision::mergeRows(rle * restrict map,int upper,int lower)
+// Joins the components of two adjacent rows that were connected
+// separately, the upper row starting at run upper and the lower one
+// at run lower.  Unlike connectRuns() this always merges by root, as
+// the runs of both rows may already have parents.
+{
+  int x1,x2;
+  int l1,l2;
+  int n,p;
+
+  l1 = lower;
+  l2 = upper;
+  x1 = x2 = 0;
+
+  while(x1 < width){
+    if(map[l1].color==map[l2].color && map[l1].color){
+      if((x1>=x2 && x1<x2+map[l2].length) ||
+         (x2>=x1 && x2<x1+map[l1].length)){
+        n = l1;
+        while(n != map[n].parent) n = map[n].parent;
+        p = l2;
+        while(p != map[p].parent) p = map[p].parent;
+
+        if(n < p){
+          map[p].parent = n;
+        }else if(p < n){
+          map[n].parent = p;
+        }
+      }
+    }
+
+    if(x1+map[l1].length < x2+map[l2].length){
+      x1 += map[l1++].length;
+    }else{
+      x2 += map[l2++].length;
+    }
+  }
+}
+
+void CMVision::compressPaths(rle * restrict map,int num)
+// Points every run straight at the root of its component.
+{
+  int i,p;
 
-  // Now we need to compress all parent paths
   for(i=0; i<num; i++){
     p = map[i].parent;
     if(p > i){
@@ -619,11 +998,44 @@ int CMVision::mergeRegions()
 
 #define ZERO(x) memset(x,0,sizeof(x))
 
+CMVision::CMVision()
+{
+  rmap = NULL;
+  max_runs = 0;
+  yuv_image = NULL;
+  width = height = 0;
+
+  ZERO(bands);
+  num_bands = 1;
+  num_threads = 1;
+  job_gen = 0;
+  job_pending = 0;
+  pool_quit = false;
+  job_image = NULL;
+  job_bpp = 0;
+  pthread_mutex_init(&pool_lock,NULL);
+  pthread_cond_init(&job_cond,NULL);
+  pthread_cond_init(&done_cond,NULL);
+
+  clear();
+}
+
+CMVision::~CMVision()
+{
+  stopThreads();
+  close();
+
+  pthread_cond_destroy(&done_cond);
+  pthread_cond_destroy(&job_cond);
+  pthread_mutex_destroy(&pool_lock);
+}
+
 void CMVision::clear()
 {
   ZERO(y_class);
   ZERO(u_class);
   ZERO(v_class);
+  updateClassRanges();
 
   ZERO(region_list);
   ZERO(region_count);
@@ -639,16 +1051,155 @@ bool CMVision::initialize(int nwidth,int nheight)
   width = nwidth;
   height = nheight;
 
-  if(map) delete(map);
+  if(map) delete[] map;
 
   map = new unsigned[width * height + 1];
   // Need 1 extra element to store terminator value in encodeRuns()
 
+  // keep the default run limit for small images, but scale it up for
+  // larger ones so busy frames don't run out of runs
+  delete[] rmap;
+  max_runs = max(CMV_MAX_RUNS,width * height / 4);
+  rmap = new rle[max_runs];
+
+  delete[] yuv_image;
+  yuv_image = NULL;
+
+  setupBands();
+
   options = CMV_THRESHOLD;
 
   return(map != NULL);
 }
 
+void CMVision::setupBands()
+// Splits the image into one band of rows per thread.  Bands start on
+// even rows so that a pixel pair never straddles two bands, even for
+// odd widths.  The first band encodes straight into rmap, the others
+// into their own buffers that are appended after the frame.
+{
+  int b,n;
+
+  for(b=1; b<CMV_MAX_THREADS; b++){
+    delete[] bands[b].runs;
+    bands[b].runs = NULL;
+  }
+
+  n = max(1,min(num_threads,height / 2));
+  for(b=0; b<n; b++){
+    bands[b].y1 = (height * b / n) & ~1;
+    bands[b].y2 = (b+1 < n)? (height * (b+1) / n) & ~1 : height;
+    bands[b].num_runs = 0;
+    bands[b].last_row = 0;
+    if(b == 0){
+      bands[b].runs = rmap;
+      bands[b].max_runs = max_runs;
+    }else{
+      bands[b].max_runs = min(max_runs,
+                              (bands[b].y2 - bands[b].y1) * width + 1);
+      bands[b].runs = new rle[bands[b].max_runs + 1];
+    }
+  }
+  num_bands = n;
+}
+
+bool CMVision::setThreads(int num)
+// Sets the number of threads (including the caller) used to process
+// a frame; 1 processes frames entirely on the calling thread.  Returns
+// false, and processes frames on the calling thread, if the threads
+// could not be started.
+{
+  bool ok;
+
+  if(num < 1 || num > CMV_MAX_THREADS) return(false);
+
+  stopThreads();
+  ok = startThreads(num);
+  if(!ok) stopThreads();
+  if(map) setupBands();
+
+  return(ok);
+}
+
+// Arguments for a worker thread
+struct cmv_worker_arg{
+  CMVision *vision;
+  int index;
+  unsigned gen;
+};
+
+bool CMVision::startThreads(int num)
+// Returns false if a thread could not be started; num_threads then
+// only counts those that were.
+{
+  cmv_worker_arg *arg;
+  int i;
+
+  pool_quit = false;
+  num_threads = num;
+
+  // Thread 0 is the caller
+  for(i=1; i<num_threads; i++){
+    arg = new cmv_worker_arg;
+    arg->vision = this;
+    arg->index = i;
+    arg->gen = job_gen;
+    if(pthread_create(&threads[i],NULL,bandMain,arg) != 0){
+      delete arg;
+      num_threads = i;
+      return(false);
+    }
+  }
+
+  return(true);
+}
+
+void CMVision::stopThreads()
+{
+  int i;
+
+  pthread_mutex_lock(&pool_lock);
+  pool_quit = true;
+  pthread_cond_broadcast(&job_cond);
+  pthread_mutex_unlock(&pool_lock);
+
+  for(i=1; i<num_threads; i++){
+    pthread_join(threads[i],NULL);
+  }
+  num_threads = 1;
+}
+
+void *CMVision::bandMain(void *varg)
+// Worker thread main loop: process our band of every frame
+{
+  cmv_worker_arg *arg = (cmv_worker_arg *)varg;
+  CMVision *v = arg->vision;
+  int index = arg->index;
+  unsigned gen = arg->gen;
+
+  delete arg;
+
+  pthread_mutex_lock(&v->pool_lock);
+  while(true){
+    while(!v->pool_quit && v->job_gen == gen){
+      pthread_cond_wait(&v->job_cond,&v->pool_lock);
+    }
+    if(v->pool_quit) break;
+    gen = v->job_gen;
+    pthread_mutex_unlock(&v->pool_lock);
+
+    v->processBand(index);
+
+    pthread_mutex_lock(&v->pool_lock);
+    if(--v->job_pending == 0){
+      pthread_cond_signal(&v->done_cond);
+    }
+  }
+  pthread_mutex_unlock(&v->pool_lock);
+
+  return(NULL);
+}
+
 // sets bits in k in array arr[l..r]
 template <class num>
 void set_bits(num *arr,int len,int l,int r,num k)
@@ -781,6 +1332,8 @@ bool CMVision::loadOptions(char *filename)
 
   fclose(in);
 
+  updateClassRanges();
+
   return(true);
 }
 
@@ -841,8 +1394,20 @@ bool CMVision::disable(unsigned opt)
 
 void CMVision::close()
 {
-  if(map) delete(map);
+  int b;
+
+  if(map) delete[] map;
   map = NULL;
+
+  for(b=1; b<CMV_MAX_THREADS; b++){
+    delete[] bands[b].runs;
+    bands[b].runs = NULL;
+  }
+  bands[0].runs = NULL;
+  delete[] rmap;
+  rmap = NULL;
+  delete[] yuv_image;
+  yuv_image = NULL;
 }
 
 
@@ -916,6 +1481,8 @@ bool CMVision::setThreshold(int color,
   set_bits(u_class,CMV_COLOR_LEVELS,u_low,u_high,k);
   set_bits(v_class,CMV_COLOR_LEVELS,v_low,v_high,k);
 
+  updateClassRanges();
+
   return(true);
 }
 
@@ -924,29 +1491,147 @@ bool CMVision::setThreshold(int color,
 bool CMVision::processFrame(image_pixel *image)
 {
   int runs;
-  int regions;
-  int max_area;
 
   if(!image) return(false);
 
   if(options & CMV_THRESHOLD){
+    if(num_bands > 1){
+      runs = processBands(image,0);
+    }else{
+      classifyFrame(image,map);
+      runs = encodeRuns(rmap,map);
+      connectComponents(rmap,runs);
+    }
+
+    finishFrame(image,runs);
+  }
+
+  return(true);
+}
 
-    classifyFrame(image,map);
-    runs = encodeRuns(rmap,map);
-    connectComponents(rmap,runs);
+bool CMVision::processFrameRGB(const unsigned char *image,int bpp)
+{
+  image_pixel *img;
+  int runs;
 
-    regions = extractRegions(region_table,rmap,runs);
+  if(!image || (bpp != 3 && bpp != 4)) return(false);
 
+  if(options & CMV_THRESHOLD){
+    // average colors need the YUV pixels, so only then keep them
+    img = NULL;
     if(options & CMV_COLOR_AVERAGES){
-      calcAverageColors(region_table,regions,image,rmap,runs);
+      if(!yuv_image) yuv_image = new image_pixel[(width * height + 1) / 2];
+      img = yuv_image;
     }
 
-    max_area = separateRegions(region_table,regions);
-    sortRegions(max_area);
+    if(num_bands > 1){
+      runs = processBands(image,bpp);
+    }else{
+      classifyPixelsRGB(image,bpp,map,img,0,width * height);
+      runs = encodeRuns(rmap,map);
+      connectComponents(rmap,runs);
+    }
+
+    finishFrame(img,runs);
+  }
 
-    if(options & CMV_DENSITY_MERGE){
-      mergeRegions();
+  return(true);
+}
+
+int CMVision::processBands(const void *image,int bpp)
+// Classifies, encodes and connects every band of a frame in parallel,
+// then appends the runs of the other bands to those of the first,
+// joins the components across the band edges and compresses the
+// paths.  Returns the number of runs in rmap.
+{
+  int b,i,n,num,last;
+  rle *runs;
+
+  job_image = image;
+  job_bpp = bpp;
+
+  if(num_threads > 1){
+    pthread_mutex_lock(&pool_lock);
+    job_pending = num_threads - 1;
+    job_gen++;
+    pthread_cond_broadcast(&job_cond);
+    pthread_mutex_unlock(&pool_lock);
+  }
+
+  processBand(0);
+
+  if(num_threads > 1){
+    pthread_mutex_lock(&pool_lock);
+    while(job_pending > 0){
+      pthread_cond_wait(&done_cond,&pool_lock);
     }
+    pthread_mutex_unlock(&pool_lock);
+  }
+
+  n = bands[0].num_runs;
+  if(n < 0) return(0);
+  last = bands[0].last_row;
+
+  for(b=1; b<num_bands; b++){
+    num = bands[b].num_runs;
+    if(num < 0 || n + num >= max_runs) return(0);
+
+    runs = bands[b].runs;
+    for(i=0; i<num; i++){
+      rmap[n + i] = runs[i];
+      rmap[n + i].parent += n;
+    }
+
+    mergeRows(rmap,last,n);
+    last = n + bands[b].last_row;
+    n += num;
+  }
+
+  compressPaths(rmap,n);
+
+  return(n);
+}
+
+void CMVision::processBand(int b)
+// Does the per band work of processBands()
+{
+  band *bd;
+  int n;
+
+  if(b >= num_bands) return;
+  bd = &bands[b];
+
+  if(job_bpp){
+    classifyPixelsRGB((const unsigned char *)job_image,job_bpp,map,
+                      (options & CMV_COLOR_AVERAGES)? yuv_image : NULL,
+                      bd->y1 * width,bd->y2 * width);
+  }else{
+    classifyPixels((image_pixel *)job_image,map,
+                   bd->y1 * width,bd->y2 * width);
+  }
+
+  n = encodeRows(bd->runs,map,bd->y1,bd->y2,bd->max_runs,bd->last_row);
+  bd->num_runs = n;
+  if(n > 0) connectRuns(bd->runs,n);
+}
+
+bool CMVision::finishFrame(image_pixel *image,int runs)
+// Turns the connected runs of a frame into sorted regions
+{
+  int regions;
+  int max_area;
+
+  regions = extractRegions(region_table,rmap,runs);
+
+  if(image && (options & CMV_COLOR_AVERAGES)){
+    calcAverageColors(region_table,regions,image,rmap,runs);
+  }
+
+  max_area = separateRegions(region_table,regions);
+  sortRegions(max_area);
+
+  if(options & CMV_DENSITY_MERGE){
+    mergeRegions();
   }
 
   return(true);
@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
 
 /*
 Ultra-fast intro to processing steps:
@@ -72,12 +73,16 @@ Options File Format: (RGB merge name)
 #define CMV_DEFAULT_HEIGHT 240
 
 // values may need tweaked, although these seem to work usually
+// (the run table grows with the image if it is larger than the default)
 #define CMV_MAX_RUNS     (CMV_DEFAULT_WIDTH * CMV_DEFAULT_HEIGHT) / 4
 #define CMV_MAX_REGIONS  CMV_MAX_RUNS / 4
 #define CMV_MIN_AREA     20
 
 #define CMV_NONE ((unsigned)(-1))
 
+// most row bands (and so worker threads) a frame is split into
+#define CMV_MAX_THREADS   16
+
 #ifndef NULL
 #define NULL (0)
 #endif
@@ -162,6 +167,14 @@ public:
     int x,y,w,h;
   };
 
+  struct band{
+    int y1,y2;          // rows [y1,y2) handled by this band
+    rle *runs;          // runs of the band (start of rmap for band 0)
+    int max_runs;       // size of runs
+    int num_runs;       // runs found in the last frame (-1 if overflowed)
+    int last_row;       // index of the first run of the band's last row
+  };
+
 protected:
   unsigned y_class[CMV_COLOR_LEVELS];
   unsigned u_class[CMV_COLOR_LEVELS];
@@ -171,7 +184,8 @@ protected:
   region *region_list[CMV_MAX_COLORS];
   int region_count[CMV_MAX_COLORS];
 
-  rle rmap[CMV_MAX_RUNS];
+  rle *rmap;
+  int max_runs;
 
   color_info colors[CMV_MAX_COLORS];
   int width,height;
@@ -182,11 +196,54 @@ protected:
   int cmv_min_area;
   int cmv_max_area;
 
+  // per color thresholds recovered from the class tables, used by
+  // the vectorised classifier (class_simd is false if the tables
+  // can't be handled by it)
+  unsigned class_lo[CMV_MAX_COLORS];
+  unsigned class_span[CMV_MAX_COLORS];
+  unsigned class_bit[CMV_MAX_COLORS];
+  int class_num;
+  bool class_simd;
+
+  // YUV copy of the last RGB frame (only kept for CMV_COLOR_AVERAGES)
+  image_pixel *yuv_image;
+
+  // row bands and the worker threads processing them
+  band bands[CMV_MAX_THREADS];
+  int num_bands;
+  pthread_t threads[CMV_MAX_THREADS];
+  int num_threads;
+  pthread_mutex_t pool_lock;
+  pthread_cond_t job_cond,done_cond;
+  unsigned job_gen;
+  int job_pending;
+  bool pool_quit;
+  const void *job_image;
+  int job_bpp;
+
 protected:
 // Private functions
   void classifyFrame(image_pixel * restrict img,unsigned * restrict map);
+  void classifyPixels(image_pixel * restrict img,unsigned * restrict map,
+                      int start,int end);
+  void classifyPixelsRGB(const unsigned char * restrict rgb,int bpp,
+                         unsigned * restrict map,image_pixel * restrict img,
+                         int start,int end);
+  void updateClassRanges();
+  void setupBands();
   int  encodeRuns(rle * restrict out,unsigned * restrict map);
+  int  encodeRows(rle * restrict out,unsigned * restrict map,
+                  int y1,int y2,int max,int &last_row);
   void connectComponents(rle * restrict map,int num);
+  void connectRuns(rle * restrict map,int num);
+  void mergeRows(rle * restrict map,int upper,int lower);
+  void compressPaths(rle * restrict map,int num);
+  int  processBands(const void *image,int bpp);
+  void processBand(int b);
+  static void *bandMain(void *arg);
+  bool startThreads(int num);
+  void stopThreads();
+  bool finishFrame(image_pixel *image,int runs);
   int  extractRegions(region * restrict reg,rle * restrict rmap,int num);
   void calcAverageColors(region * restrict reg,int num_reg,
                          image_pixel * restrict img,
@@ -202,8 +259,8 @@ protected:
   void clear();
 
 public:
-  CMVision()  {clear();}
-  ~CMVision() {close();}
+  CMVision();
+  ~CMVision();
 
   bool initialize(int nwidth,int nheight);
   bool loadOptions(char *filename);
@@ -239,6 +296,13 @@ public:
 
   bool processFrame(image_pixel *image);
   bool processFrame(unsigned *map);
+
+  // converts and classifies packed RGB (bpp 3) or RGBA (bpp 4) pixels
+  // in one pass, without building the intermediate YUV frame
+  bool processFrameRGB(const unsigned char *image,int bpp);
+
+  // splits frames into row bands processed by num worker threads
+  bool setThreads(int num);
   int numRegions(int color_id);
   region *getRegions(int color_id);
   void set_cmv_min_area(int area) { cmv_min_area = area; }
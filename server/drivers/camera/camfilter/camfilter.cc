@@ -210,6 +210,8 @@ void camfilter_Register(DriverTable *table)
 CamFilter::CamFilter(ConfigFile * cf, int section)
   : ThreadedDriver(cf, section, true, PLAYER_MSGQUEUE_DEFAULT_MAXLEN)
 {
+  // Main() only processes messages, so we can be run as a task
+  this->TaskCapable = true;
   memset(&(this->camera_provided_addr), 0, sizeof(player_devaddr_t));
   memset(&(this->camera_id), 0, sizeof(player_devaddr_t));
   this->camera = NULL;
@@ -140,6 +140,8 @@ void camerauncompress_Register(DriverTable *table)
 CameraUncompress::CameraUncompress( ConfigFile *cf, int section)
   : ThreadedDriver(cf, section, true, PLAYER_MSGQUEUE_DEFAULT_MAXLEN, PLAYER_CAMERA_CODE)
 {
+  // Main() only processes messages, so we can be run as a task
+  this->TaskCapable = true;
   this->frameno = 0;
 
   this->camera = NULL;
@@ -51,6 +51,7 @@ project.
 - @ref interface_camera - Depth image (optional)
 - @ref interface_ptz - Tilt motor
 - @ref interface_imu - Accelerometer
+- @ref interface_pointcloud3d - Depth image as a point cloud (optional)
 
 @par Configuration requests
 
@@ -84,13 +85,26 @@ project.
   - 1 = Med resolution = 640x488
   - 0 = Low Resolution = 320x240
 
+- pointcloud_step (integer)
+  - Default: 2
+  - Only every pointcloud_step'th row and column of the depth image is
+    converted into the point cloud.
+  - Points are given in the Player convention (x forward, y left, z up),
+    using the nominal Kinect depth camera intrinsics, and are colored
+    like the heatmap.  Pixels without a depth reading are left out.
+
+Frames are handed over from the libfreenect callbacks through three
+buffers per stream, allocated once: libfreenect writes straight into the
+back buffer, and each image is published from the front buffer, so it is
+copied only into the outgoing message.
+
 @par Example
 
 @verbatim
 driver
 (
   name "kinect"
-  provides ["color:::camera:0" "depth:::camera:1" "ptz:0" "imu:0"]
+  provides ["color:::camera:0" "depth:::camera:1" "ptz:0" "imu:0" "pointcloud3d:0"]
   heatmap 0
   downsample 1
   color_resolution 2
@@ -102,14 +116,17 @@ driver
  */
 /** @} */
 
-//TODO: Add support for LEDs, pointcloud, user-defined image sizes
-//TODO: Less judicious use of memcpy
+//TODO: Add support for LEDs, user-defined image sizes
 
 #if !defined (WIN32)
 #include <unistd.h>
 #endif
+#include <stdlib.h>
 #include <string.h>
 #include <cmath>
+#if defined (__SSE__)
+#include <xmmintrin.h>
+#endif
 
 #include <libplayercore/playercore.h>
 #include <libusb-1.0/libusb.h>
@@ -120,11 +137,27 @@ driver
 void DepthImageCallback(freenect_device *dev, void *depth, uint32_t timestamp);
 void ColorImageCallback(freenect_device *dev, void *rgb, uint32_t timestamp);
 
+// Triple buffer for the frames of one stream.  libfreenect writes into
+// the back buffer; when a frame is complete the callback swaps it with the
+// middle buffer and marks it fresh.  The driver thread swaps a fresh middle
+// buffer with the front one, which it owns until the next swap.  Neither
+// side ever waits for the other, and the three buffers are reused for the
+// life of the stream; frames are published from the front one.
+#define KINECT_FRAME_FRESH 4
+
+struct KinectFrameSlots
+{
+	uint8_t* buf[3];
+	size_t size;
+	int back;
+	int front;
+	// Index of the middle buffer, or'ed with KINECT_FRAME_FRESH
+	volatile int mid;
+};
+
 // Storage for image data and metadata
-static uint16_t* DepthImage;
-static uint8_t* ColorImage;
-pthread_mutex_t kinect_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int newcdata, newddata;
+static KinectFrameSlots ColorFrames;
+static KinectFrameSlots DepthFrames;
 static freenect_frame_mode colorImageMode;
 static freenect_frame_mode depthImageMode;
 
@@ -132,6 +165,68 @@ const bool DEFAULT_HEATMAP = false;
 const bool DEFAULT_DOWNSAMPLE = false;
 const int DEFAULT_COLOR_RESOLUTION = FREENECT_RESOLUTION_HIGH;
 const int DEFAULT_DEPTH_RESOLUTION = FREENECT_RESOLUTION_MEDIUM;
+const int DEFAULT_POINTCLOUD_STEP = 2;
+
+// Nominal intrinsics of the depth camera at 640x480
+const float KINECT_DEPTH_FX = 594.21f;
+const float KINECT_DEPTH_FY = 591.04f;
+const float KINECT_DEPTH_CX = 339.5f;
+const float KINECT_DEPTH_CY = 242.7f;
+
+// Atomically replace *p with v and return the previous value
+static int kinect_exchange(volatile int* p, int v)
+{
+	int old;
+	do
+	{
+		old = *p;
+	} while (__sync_val_compare_and_swap(p, old, v) != old);
+	return old;
+}
+
+// (Re)allocate the buffers of a stream for frames of the given size
+static void kinect_slots_alloc(KinectFrameSlots* s, size_t size)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		free(s->buf[i]);
+		s->buf[i] = (uint8_t*) calloc(1, size);
+	}
+	s->size = size;
+	s->back = 0;
+	s->mid = 1;
+	s->front = 2;
+}
+
+// Release the buffers of a stream
+static void kinect_slots_free(KinectFrameSlots* s)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		free(s->buf[i]);
+		s->buf[i] = NULL;
+	}
+	s->size = 0;
+}
+
+// Producer side: publish the back buffer and return the one to fill next
+static uint8_t* kinect_slots_produce(KinectFrameSlots* s)
+{
+	int old = kinect_exchange(&s->mid, s->back | KINECT_FRAME_FRESH);
+	s->back = old & 3;
+	return s->buf[s->back];
+}
+
+// Consumer side: move a fresh frame to the front.  Returns 0 if there is
+// no new frame since the last call.
+static int kinect_slots_consume(KinectFrameSlots* s)
+{
+	if (!(s->mid & KINECT_FRAME_FRESH))
+		return 0;
+	int old = kinect_exchange(&s->mid, s->front);
+	s->front = old & 3;
+	return 1;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // The class for the driver
@@ -157,6 +252,7 @@ private:
 	// Routines to publish different data
 	int PublishColorImage();
 	int PublishDepthImage();
+	int PublishPointCloud();
 	int PublishPTZ();
 	int PublishAccelerometer();
 
@@ -169,10 +265,9 @@ private:
 	player_devaddr_t depth_camera_id;
 	player_devaddr_t ptz_id;
 	player_devaddr_t imu_id;
+	player_devaddr_t pointcloud_id;
 
 	// Storage for outgoing interface data
-	player_camera_data_t colordata;
-	player_camera_data_t depthdata;
 	player_ptz_data_t ptzdata;
 	player_imu_data_calib_t imudata;
 
@@ -180,6 +275,7 @@ private:
 	int providedepthimage;
 	int provideptz;
 	int provideimu;
+	int providepointcloud;
 
 	// Timers for publishing ptz and accelerometers regularly
 	double last_acc_pub;
@@ -190,9 +286,21 @@ private:
 	BoolProperty downsample;
 	IntProperty color_resolution;
 	IntProperty depth_resolution;
-
-	// Lookup table for depth image colorization
-	uint16_t t_gamma[2048];
+	IntProperty pointcloud_step;
+
+	// Lookup tables indexed by raw 11-bit depth: heatmap color, MONO8
+	// value and range in meters (0 where there is no reading)
+	uint8_t heat_lut[2048][3];
+	uint8_t mono8_lut[2048];
+	float range_lut[2048];
+
+	// Per-row scratch for the point cloud: lateral factor of each sampled
+	// column, and the range, left and up offsets of the current row
+	int cloud_cols;
+	float* cloud_kx;
+	float* cloud_x;
+	float* cloud_y;
+	float* cloud_z;
 };
 
 
@@ -217,12 +325,16 @@ KinectDriver::KinectDriver(ConfigFile* cf, int section)
   heatmap("heatmap", DEFAULT_HEATMAP, false),
   downsample("downsample", DEFAULT_DOWNSAMPLE, false),
   color_resolution("color_resolution", DEFAULT_COLOR_RESOLUTION, false),
-  depth_resolution("depth_resolution", DEFAULT_DEPTH_RESOLUTION, false)
+  depth_resolution("depth_resolution", DEFAULT_DEPTH_RESOLUTION, false),
+  pointcloud_step("pointcloud_step", DEFAULT_POINTCLOUD_STEP, false)
 {
 	// Initialize flags:
 	providedepthimage = 0;
 	provideptz = 0;
 	provideimu = 0;
+	providepointcloud = 0;
+	cloud_cols = 0;
+	cloud_kx = cloud_x = cloud_y = cloud_z = NULL;
 
 	//Add interface from Configuration File
 	if (cf->ReadDeviceAddr(&(this->color_camera_id), section, "provides", PLAYER_CAMERA_CODE, -1, "image"))
@@ -282,20 +394,50 @@ KinectDriver::KinectDriver(ConfigFile* cf, int section)
 		provideimu = 1;
 	}
 
+	// Check to see if we provide the point cloud interface
+	if (!cf->ReadDeviceAddr(&(this->pointcloud_id), section, "provides", PLAYER_POINTCLOUD3D_CODE, -1, NULL))
+	{
+		if (this->AddInterface(this->pointcloud_id))
+		{
+			PLAYER_ERROR("Kinect's point cloud interface failed to be added.");
+			this->SetError(-1);
+			return;
+		}
+		providepointcloud = 1;
+	}
+
 	// Read config file options
 	RegisterProperty("heatmap", &this->heatmap, cf, section);
 	RegisterProperty("downsample", &this->downsample, cf, section);
 	RegisterProperty("color_resolution", &this->color_resolution, cf, section);
 	RegisterProperty("depth_resolution", &this->depth_resolution, cf, section);
+	RegisterProperty("pointcloud_step", &this->pointcloud_step, cf, section);
 
 
-	// Initialize the color map lookup table
+	// Initialize the lookup tables
 	for (int i=0; i<2048; i++) {
-			float v = i/2048.0;
-			v = powf(v, 3)* 6;
-			t_gamma[i] = v*6*256;
+		float v = i/2048.0;
+		v = powf(v, 3)* 6;
+		int pval = (uint16_t)(v*6*256);
+		int lb = pval & 0xff;
+		uint8_t* c = heat_lut[i];
+		switch (pval>>8) {
+		case 0:  c[0] = 255;    c[1] = 255-lb; c[2] = 255-lb; break;
+		case 1:  c[0] = 255;    c[1] = lb;     c[2] = 0;      break;
+		case 2:  c[0] = 255-lb; c[1] = 255;    c[2] = 0;      break;
+		case 3:  c[0] = 0;      c[1] = 255;    c[2] = lb;     break;
+		case 4:  c[0] = 0;      c[1] = 255-lb; c[2] = 255;    break;
+		case 5:  c[0] = 0;      c[1] = 0;      c[2] = 255-lb; break;
+		default: c[0] = 0;      c[1] = 0;      c[2] = 0;      break;
 		}
 
+		mono8_lut[i] = (uint8_t)((double)i / 2048.0 * 255.0);
+
+		// Raw disparity to range; past ~1080 the fit is no longer valid
+		double z = 0.1236 * tan(i / 2842.5 + 1.1863);
+		range_lut[i] = (i < 2047 && z > 0.0 && z < 10.0) ? (float)z : 0.0f;
+	}
+
 	return;
 }
 
@@ -304,7 +446,6 @@ KinectDriver::KinectDriver(ConfigFile* cf, int section)
 int KinectDriver::MainSetup()
 {
 	PLAYER_MSG0(1,"Kinect driver initializing...");
-	memset(&kinect_mutex, 0, sizeof(pthread_mutex_t));
 
 	if (freenect_init(&fctx, NULL) < 0)
 	{
@@ -326,8 +467,11 @@ int KinectDriver::MainSetup()
 	depthImageMode = freenect_find_depth_mode((freenect_resolution)depth_resolution.GetValue(), FREENECT_DEPTH_11BIT);
 	freenect_set_depth_mode(fdev, depthImageMode);
 
-	colordata.image = NULL;
-	depthdata.image = NULL;
+	// Have libfreenect write frames straight into our buffers
+	kinect_slots_alloc(&ColorFrames, colorImageMode.bytes);
+	kinect_slots_alloc(&DepthFrames, depthImageMode.bytes);
+	freenect_set_video_buffer(fdev, ColorFrames.buf[ColorFrames.back]);
+	freenect_set_depth_buffer(fdev, DepthFrames.buf[DepthFrames.back]);
 
 	freenect_start_depth(fdev);
 	freenect_start_video(fdev);
@@ -348,6 +492,15 @@ void KinectDriver::MainQuit()
 	freenect_stop_video(fdev);
 	freenect_shutdown(fctx);
 
+	kinect_slots_free(&ColorFrames);
+	kinect_slots_free(&DepthFrames);
+	free(cloud_kx);
+	free(cloud_x);
+	free(cloud_y);
+	free(cloud_z);
+	cloud_kx = cloud_x = cloud_y = cloud_z = NULL;
+	cloud_cols = 0;
+
 	PLAYER_MSG0(2,"Kinect driver has been shut down.");
 }
 
@@ -383,10 +536,10 @@ int KinectDriver::ProcessMessage(QueuePointer & resp_queue,
 				PLAYER_WARN1("Setting color image resolution to %d", newres);
 				// Have a different resolution, do something about it.
 				freenect_stop_video(fdev);
-				pthread_mutex_lock(&kinect_mutex);
 				colorImageMode = freenect_find_video_mode((freenect_resolution)newres, FREENECT_VIDEO_RGB);
 				freenect_set_video_mode(fdev, colorImageMode);
-				pthread_mutex_unlock(&kinect_mutex);
+				kinect_slots_alloc(&ColorFrames, colorImageMode.bytes);
+				freenect_set_video_buffer(fdev, ColorFrames.buf[ColorFrames.back]);
 				freenect_start_video(fdev);
 				Publish(hdr->addr, resp_queue, PLAYER_MSGTYPE_RESP_ACK, PLAYER_SET_INTPROP_REQ, NULL, 0, NULL);
 				return 0;
@@ -416,10 +569,10 @@ int KinectDriver::ProcessMessage(QueuePointer & resp_queue,
 				{
 					// Have a different resolution, do something about it.
 					freenect_stop_depth(fdev);
-					pthread_mutex_lock(&kinect_mutex);
-					colorImageMode = freenect_find_depth_mode((freenect_resolution)newres, FREENECT_DEPTH_11BIT);
+					depthImageMode = freenect_find_depth_mode((freenect_resolution)newres, FREENECT_DEPTH_11BIT);
 					freenect_set_depth_mode(fdev, depthImageMode);
-					pthread_mutex_unlock(&kinect_mutex);
+					kinect_slots_alloc(&DepthFrames, depthImageMode.bytes);
+					freenect_set_depth_buffer(fdev, DepthFrames.buf[DepthFrames.back]);
 					freenect_start_depth(fdev);
 					Publish(hdr->addr, resp_queue, PLAYER_MSGTYPE_RESP_ACK, PLAYER_SET_INTPROP_REQ, NULL, 0, NULL);
 					return 0;
@@ -456,20 +609,15 @@ int KinectDriver::ProcessMessage(QueuePointer & resp_queue,
 	return(-1);
 }
 ////////////////////////////////////////////////////////////////////////////////
-// Publish color image data to camera interface
+// Publish color image data to camera interface, straight from the front
+// buffer.
 int KinectDriver::PublishColorImage()
 {
-	if (colordata.image){
-		delete[] colordata.image;
-	}
-	colordata.image = new uint8_t[colorImageMode.bytes];
+	player_camera_data_t colordata;
 
-	pthread_mutex_lock(&kinect_mutex);
+	colordata.image = ColorFrames.buf[ColorFrames.front];
 	colordata.width = colorImageMode.width;
 	colordata.height = colorImageMode.height;
-	memcpy(colordata.image, ColorImage, colorImageMode.bytes);
-	pthread_mutex_unlock(&kinect_mutex);
-
 	colordata.bpp = 24;
 	colordata.compression = PLAYER_CAMERA_COMPRESS_RAW;
 	colordata.fdiv = 1;
@@ -477,115 +625,194 @@ int KinectDriver::PublishColorImage()
 	colordata.format = PLAYER_CAMERA_FORMAT_RGB888;
 
 	PLAYER_MSG2(4,"Writing Color Image size %d, %d", colordata.width, colordata.height);
-	Publish(color_camera_id, PLAYER_MSGTYPE_DATA, PLAYER_CAMERA_DATA_STATE, (void*)&colordata);
-	newcdata = 0;
+	Publish(color_camera_id, PLAYER_MSGTYPE_DATA, PLAYER_CAMERA_DATA_STATE, reinterpret_cast<void *>(&colordata));
 
 	return 0;
 
 }
 ////////////////////////////////////////////////////////////////////////////////
-// Publish depth image data to camera interface
+// Publish depth image data to camera interface.  MONO16 images are
+// published from the front buffer; the other formats are converted through
+// the lookup tables into a new buffer, which the message takes over.
 int KinectDriver::PublishDepthImage()
 {
-
-	if (depthdata.image){
-		delete[] depthdata.image;
+	player_camera_data_t *depthdata = reinterpret_cast<player_camera_data_t *>(malloc(sizeof(player_camera_data_t)));
+	if (!depthdata)
+	{
+		PLAYER_ERROR("Out of memory");
+		return -1;
 	}
-	// Allocate space for maximum possible display image size (RGB888 with depth image's wxh)
-	depthdata.image = new uint8_t[depthImageMode.width * depthImageMode.height * 3];
+
+	const uint16_t* depth = reinterpret_cast<const uint16_t*>(DepthFrames.buf[DepthFrames.front]);
+	bool from_front = false;
+	unsigned int npixels = depthImageMode.width * depthImageMode.height;
+
+	depthdata->width = depthImageMode.width;
+	depthdata->height = depthImageMode.height;
+	depthdata->compression = PLAYER_CAMERA_COMPRESS_RAW;
+	depthdata->fdiv = 1;
 
 	if (heatmap) // Publish colorized RGB888
 	{
-		pthread_mutex_lock(&kinect_mutex);
-		depthdata.width = depthImageMode.width;
-		depthdata.height = depthImageMode.height;
-		for (unsigned int i=0; i<depthdata.width*depthdata.height; i++) {
-			int pval = t_gamma[DepthImage[i]];
-			int lb = pval & 0xff;
-			switch (pval>>8) {
-			case 0:
-				depthdata.image[3*i+0] = 255;
-				depthdata.image[3*i+1] = 255-lb;
-				depthdata.image[3*i+2] = 255-lb;
-				break;
-			case 1:
-				depthdata.image[3*i+0] = 255;
-				depthdata.image[3*i+1] = lb;
-				depthdata.image[3*i+2] = 0;
-				break;
-			case 2:
-				depthdata.image[3*i+0] = 255-lb;
-				depthdata.image[3*i+1] = 255;
-				depthdata.image[3*i+2] = 0;
-				break;
-			case 3:
-				depthdata.image[3*i+0] = 0;
-				depthdata.image[3*i+1] = 255;
-				depthdata.image[3*i+2] = lb;
-				break;
-			case 4:
-				depthdata.image[3*i+0] = 0;
-				depthdata.image[3*i+1] = 255-lb;
-				depthdata.image[3*i+2] = 255;
-				break;
-			case 5:
-				depthdata.image[3*i+0] = 0;
-				depthdata.image[3*i+1] = 0;
-				depthdata.image[3*i+2] = 255-lb;
-				break;
-			default:
-				depthdata.image[3*i+0] = 0;
-				depthdata.image[3*i+1] = 0;
-				depthdata.image[3*i+2] = 0;
-				break;
+		depthdata->image = reinterpret_cast<uint8_t *>(malloc(npixels * 3));
+		if (depthdata->image)
+		{
+			uint8_t* out = depthdata->image;
+			for (unsigned int i=0; i<npixels; i++, out+=3) {
+				const uint8_t* c = heat_lut[depth[i] & 2047];
+				out[0] = c[0];
+				out[1] = c[1];
+				out[2] = c[2];
 			}
 		}
-		pthread_mutex_unlock(&kinect_mutex);
 
-		depthdata.bpp = 24;
-		depthdata.compression = PLAYER_CAMERA_COMPRESS_RAW;
-		depthdata.fdiv = 1;
-		depthdata.image_count = depthdata.width*depthdata.height*3;
-		depthdata.format = PLAYER_CAMERA_FORMAT_RGB888;
+		depthdata->bpp = 24;
+		depthdata->image_count = npixels * 3;
+		depthdata->format = PLAYER_CAMERA_FORMAT_RGB888;
 	}
 	else if (downsample) //Publish downsampled MONO8
 	{
-		pthread_mutex_lock(&kinect_mutex);
-		depthdata.width = depthImageMode.width;
-		depthdata.height = depthImageMode.height;
-		for (unsigned int i=0; i < depthdata.width* depthdata.height; i++)
+		depthdata->image = reinterpret_cast<uint8_t *>(malloc(npixels));
+		if (depthdata->image)
+		{
+			for (unsigned int i=0; i < npixels; i++)
+				depthdata->image[i] = mono8_lut[depth[i] & 2047];
+		}
+
+		depthdata->bpp = 8;
+		depthdata->image_count = npixels;
+		depthdata->format = PLAYER_CAMERA_FORMAT_MONO8;
+	}
+	else // Publish MONO16
+	{
+		depthdata->image = DepthFrames.buf[DepthFrames.front];
+		from_front = true;
+
+		depthdata->bpp = 16;
+		depthdata->image_count = depthImageMode.bytes;
+		depthdata->format = PLAYER_CAMERA_FORMAT_MONO16;
+	}
+
+	if (!depthdata->image)
+	{
+		PLAYER_ERROR("Out of memory");
+		free(depthdata);
+		return -1;
+	}
+
+	PLAYER_MSG2(4,"Writing Depth Image size %d, %d", depthdata->width, depthdata->height);
+	Publish(depth_camera_id, PLAYER_MSGTYPE_DATA, PLAYER_CAMERA_DATA_STATE, reinterpret_cast<void *>(depthdata), 0, NULL, from_front);
+	// copy = false, the message owns depthdata now; otherwise it has a copy
+	// and the front buffer stays with the stream
+	if (from_front)
+		free(depthdata);
+
+	return 0;
+}
+////////////////////////////////////////////////////////////////////////////////
+// Convert the front depth frame into a point cloud.  Ranges come from the
+// lookup table; the lateral and vertical offsets are the range scaled by
+// per-column and per-row factors, computed four points at a time.
+int KinectDriver::PublishPointCloud()
+{
+	const uint16_t* depth = reinterpret_cast<const uint16_t*>(DepthFrames.buf[DepthFrames.front]);
+	int width = depthImageMode.width;
+	int height = depthImageMode.height;
+	int step = pointcloud_step.GetValue();
+	if (step < 1)
+		step = 1;
+	int cols = (width + step - 1) / step;
+	int rows = (height + step - 1) / step;
+
+	// Intrinsics are given for 640x480; scale them to the current mode
+	float scale = width / 640.0f;
+	float fx = KINECT_DEPTH_FX * scale;
+	float fy = KINECT_DEPTH_FY * scale;
+	float cx = KINECT_DEPTH_CX * scale;
+	float cy = KINECT_DEPTH_CY * scale;
+
+	if (cols != cloud_cols)
+	{
+		free(cloud_kx);
+		free(cloud_x);
+		free(cloud_y);
+		free(cloud_z);
+		cloud_kx = reinterpret_cast<float *>(malloc(cols * sizeof(float)));
+		cloud_x = reinterpret_cast<float *>(malloc(cols * sizeof(float)));
+		cloud_y = reinterpret_cast<float *>(malloc(cols * sizeof(float)));
+		cloud_z = reinterpret_cast<float *>(malloc(cols * sizeof(float)));
+		if (!cloud_kx || !cloud_x || !cloud_y || !cloud_z)
 		{
-			uint16_t pixel = DepthImage[i];
-			uint8_t dpixel = (uint8_t)((double)pixel / 2048.0 * 255.0); 
-			depthdata.image[i] = dpixel;
+			PLAYER_ERROR("Out of memory");
+			cloud_cols = 0;
+			return -1;
 		}
-		pthread_mutex_unlock(&kinect_mutex);
+		cloud_cols = cols;
+	}
+	// Recomputed every frame, as the step and resolution may change
+	for (int i = 0; i < cols; i++)
+		cloud_kx[i] = -((float)(i * step) - cx) / fx;
 
-		depthdata.bpp = 8;
-		depthdata.compression = PLAYER_CAMERA_COMPRESS_RAW;
-		depthdata.fdiv = 1;
-		depthdata.image_count = depthImageMode.width * depthImageMode.height;
-		depthdata.format = PLAYER_CAMERA_FORMAT_MONO8;
+	player_pointcloud3d_data_t *cloud = reinterpret_cast<player_pointcloud3d_data_t *>(malloc(sizeof(player_pointcloud3d_data_t)));
+	if (!cloud)
+	{
+		PLAYER_ERROR("Out of memory");
+		return -1;
 	}
-	else // Publish MONO16	
+	cloud->points = reinterpret_cast<player_pointcloud3d_element_t *>(malloc((size_t)rows * cols * sizeof(player_pointcloud3d_element_t)));
+	if (!cloud->points)
 	{
-		pthread_mutex_lock(&kinect_mutex);
-		depthdata.width = depthImageMode.width;
-		depthdata.height = depthImageMode.height;
-		memcpy((void*)depthdata.image, (void*)DepthImage, depthImageMode.bytes);
-		pthread_mutex_unlock(&kinect_mutex);
-
-
-		depthdata.bpp = 16;
-		depthdata.compression = PLAYER_CAMERA_COMPRESS_RAW;
-		depthdata.fdiv = 1;
-		depthdata.image_count = depthImageMode.bytes;
-		depthdata.format = PLAYER_CAMERA_FORMAT_MONO16;
+		PLAYER_ERROR("Out of memory");
+		free(cloud);
+		return -1;
 	}
 
-	PLAYER_MSG2(4,"Writing Depth Image size %d, %d", depthdata.width, depthdata.height);
-	newddata = 0;
-	Publish(depth_camera_id, PLAYER_MSGTYPE_DATA, PLAYER_CAMERA_DATA_STATE, (void*)&depthdata);
+	uint32_t count = 0;
+	for (int v = 0; v < height; v += step)
+	{
+		const uint16_t* row = depth + v * width;
+		float ky = -((float)v - cy) / fy;
+		int i;
+
+		for (i = 0; i < cols; i++)
+			cloud_x[i] = range_lut[row[i * step] & 2047];
+
+		i = 0;
+#if defined (__SSE__)
+		__m128 vky = _mm_set1_ps(ky);
+		for (; i + 4 <= cols; i += 4)
+		{
+			__m128 vx = _mm_loadu_ps(cloud_x + i);
+			_mm_storeu_ps(cloud_y + i, _mm_mul_ps(vx, _mm_loadu_ps(cloud_kx + i)));
+			_mm_storeu_ps(cloud_z + i, _mm_mul_ps(vx, vky));
+		}
+#endif
+		for (; i < cols; i++)
+		{
+			cloud_y[i] = cloud_x[i] * cloud_kx[i];
+			cloud_z[i] = cloud_x[i] * ky;
+		}
+
+		// Keep the points with a valid reading
+		for (i = 0; i < cols; i++)
+		{
+			if (cloud_x[i] <= 0.0f)
+				continue;
+			player_pointcloud3d_element_t* el = cloud->points + count++;
+			const uint8_t* c = heat_lut[row[i * step] & 2047];
+			el->point.px = cloud_x[i];
+			el->point.py = cloud_y[i];
+			el->point.pz = cloud_z[i];
+			el->color.alpha = 255;
+			el->color.red = c[0];
+			el->color.green = c[1];
+			el->color.blue = c[2];
+		}
+	}
+	cloud->points_count = count;
+
+	Publish(pointcloud_id, PLAYER_MSGTYPE_DATA, PLAYER_POINTCLOUD3D_DATA_STATE, reinterpret_cast<void *>(cloud), 0, NULL, false);
+	// copy = false, the message owns cloud now
 
 	return 0;
 }
@@ -635,13 +862,16 @@ void KinectDriver::Main()
 
 		// Check each camera to see if there's new data available
 		// from the callbacks.  If so, publish it.
-		if (newcdata)
+		if (kinect_slots_consume(&ColorFrames))
 		{
 			PublishColorImage();
 		}
-		if (providedepthimage && newddata)
+		if (kinect_slots_consume(&DepthFrames))
 		{
-			PublishDepthImage();
+			if (providepointcloud)
+				PublishPointCloud();
+			if (providedepthimage)
+				PublishDepthImage();
 		}
 
 		double now;
@@ -666,34 +896,18 @@ void KinectDriver::Main()
 	}
 }
 ////////////////////////////////////////////////////////////////////////////////
-// Grab depth image buffer returned by libfreenect and store it in a static buffer
+// A depth frame has been written to the back buffer; hand it to the driver
+// thread and give libfreenect the next buffer to fill
 void DepthImageCallback(freenect_device *dev, void *imagedata, uint32_t timestamp)
 {
-	pthread_mutex_lock(&kinect_mutex);
-	if(DepthImage)
-	{
-		delete[] DepthImage;
-	}
-
-	DepthImage = new uint16_t[depthImageMode.bytes];
-	memcpy(DepthImage, imagedata, depthImageMode.bytes);
-	newddata = 1;
-	pthread_mutex_unlock(&kinect_mutex);
+	freenect_set_depth_buffer(dev, kinect_slots_produce(&DepthFrames));
 	return;
 }
 ////////////////////////////////////////////////////////////////////////////////
-// Grab color image buffer returned by libfreenect and store it in a static buffer
+// A color frame has been written to the back buffer; hand it to the driver
+// thread and give libfreenect the next buffer to fill
 void ColorImageCallback(freenect_device *dev, void *imagedata, uint32_t timestamp)
 {
-	pthread_mutex_lock(&kinect_mutex);
-	if(ColorImage)
-	{
-		delete[] ColorImage;
-	}
-	ColorImage = new uint8_t[colorImageMode.bytes];
-	memcpy(ColorImage, imagedata, colorImageMode.bytes);
-	newcdata = 1;
-	pthread_mutex_unlock(&kinect_mutex);
+	freenect_set_video_buffer(dev, kinect_slots_produce(&ColorFrames));
 	return;
 }
-
@@ -149,6 +149,8 @@ VideoCanny::VideoCanny( ConfigFile *cf, int section)
 {
   const char * func;
 
+  // Main() only processes messages, so we can be run as a task
+  this->TaskCapable = true;
   memset(&(this->camera_id), 0, sizeof(player_devaddr_t));
   memset(&(this->data), 0, sizeof this->data);
   this->data.image = NULL;
@@ -222,6 +222,39 @@ driver
 #define DEFAULT_LASER_RETRIES 3
 #define MAX_CONNECT_RATES 8
 
+// Largest telegram we expect from the laser
+#define MAX_TELEGRAM_LEN (4 + 1024 + 3)
+
+// Telegrams from the laser: STX (0x02), address (0x80), 16-bit length of
+// the data and status, the data, the status and a 16-bit CRC.
+static const uint8_t sick_reply_start[] = {0x02, 0x80};
+
+class SickLMSFrameRules : public SerialFrameRules
+{
+  public:
+    SickLMSFrameRules() : SerialFrameRules(sick_reply_start, 2, 4) {}
+
+    virtual ssize_t FrameLength(const uint8_t* header)
+    {
+      ssize_t len = (int) header[2] | ((int) header[3] << 8);
+      // There's at least the command byte and the status
+      if (len < 2)
+        return -1;
+      return 4 + len + 2;
+    }
+
+    virtual bool CheckFrame(const uint8_t* frame, size_t len)
+    {
+      uint16_t crc = serial_crc16_sick(frame, len - 2);
+      if (crc != MAKEUINT16(frame[len - 2], frame[len - 1]))
+      {
+        PLAYER_ERROR("CRC error, ignoring packet");
+        return false;
+      }
+      return true;
+    }
+};
+
 
 // The laser device class.
 class SickLMS200 : public ThreadedDriver
@@ -337,6 +370,10 @@ class SickLMS200 : public ThreadedDriver
     // laser device file descriptor
     int laser_fd;
 
+    // Cuts the telegrams out of what we read from laser_fd
+    SickLMSFrameRules frame_rules;
+    SerialFramer framer;
+
     // Starup delay
     int startup_delay;
 
@@ -410,7 +447,6 @@ void sicklms200_Register(DriverTable* table)
 #define STX     0x02
 #define ACK     0xA0
 #define NACK    0x92
-#define CRC16_GEN_POL 0x8005
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -421,7 +457,8 @@ void sicklms200_Register(DriverTable* table)
 // Constructor
 SickLMS200::SickLMS200(ConfigFile* cf, int section)
     : ThreadedDriver(cf, section, true, PLAYER_MSGQUEUE_DEFAULT_MAXLEN, PLAYER_LASER_CODE),
-      PLSMode("pls_mode",0,true,this,cf,section)
+      PLSMode("pls_mode",0,true,this,cf,section),
+      framer(-1, &frame_rules)
 {
   // Laser geometry.
   this->pose[0] = cf->ReadTupleLength(section, "pose", 0, 0.0);
@@ -950,6 +987,7 @@ int SickLMS200::OpenTerm()
   // Make sure queue is empty
   //
   tcflush(this->laser_fd, TCIOFLUSH);
+  this->framer.SetFd(this->laser_fd);
 
   return 0;
 }
@@ -1095,6 +1133,7 @@ int SickLMS200::ChangeTermSpeed(int speed)
 	        tcflush(this->laser_fd, TCIFLUSH);
 	        tcsetattr(this->laser_fd, TCSANOW, &term);
 	        tcflush(this->laser_fd, TCIFLUSH);
+	        this->framer.SetFd(this->laser_fd);
 	}
     else if (this->serial_high_speed_mode == 2)
     {
@@ -1795,6 +1834,7 @@ ssize_t SickLMS200::WriteToLaser(uint8_t *data, ssize_t len)
   // Make sure both input and output queues are empty
   //
   tcflush(this->laser_fd, TCIOFLUSH);
+  this->framer.Flush();
 
   ssize_t bytes = 0;
 #if 0
@@ -1863,7 +1903,6 @@ ssize_t SickLMS200::WriteToLaser(uint8_t *data, ssize_t len)
 //
 ssize_t SickLMS200::ReadFromLaser(uint8_t *data, ssize_t maxlen, bool ack, int timeout, int timeout_header)
 {
-
   if(timeout_header == -1)
     timeout_header = timeout;
 
@@ -1871,189 +1910,45 @@ ssize_t SickLMS200::ReadFromLaser(uint8_t *data, ssize_t maxlen, bool ack, int t
   int64_t stop_time = start_time + timeout;
   int64_t stop_time_header = start_time + timeout_header;
 
-  //PLAYER_MSG2(2, "%Ld %Ld", start_time, stop_time);
-
-  int bytes = 0;
-  uint8_t header[5] = {0};
-  uint8_t footer[3];
+  uint8_t frame[MAX_TELEGRAM_LEN];
+  ssize_t framelen;
 
-  // Read until we get a valid header
+  // Read until we get a telegram (an ACK or NACK, if asked to)
   // or we timeout
   //
   while (true)
   {
+    int delay = -1, delay_header = -1;
     if (timeout >= 0)
     {
-      fd_set rfds, efds;
-      FD_ZERO(&rfds);
-      FD_SET(this->laser_fd, &rfds);
-      FD_ZERO(&efds);
-      FD_SET(this->laser_fd, &efds);
-      int64_t delay = stop_time_header - GetTime();
-      if (delay < 0) delay = 0;
-      struct timeval tv;
-      tv.tv_usec = (delay % 1000) * 1000;
-      tv.tv_sec = delay / 1000;
-      int retval = ::select(this->laser_fd + 1, &rfds, 0, &efds, &tv);
-      if (retval < 0)
-      {
-        if (errno == EINTR)
-	      continue;
-        PLAYER_ERROR("error on select (1)");
-        return 0;
-      }
-      if (!retval)
-      {
-        PLAYER_MSG0(2, "timeout on select (1)");
-        return 0;
-      }
+      int64_t now = GetTime();
+      delay = (int) MAX(stop_time - now, 0);
+      delay_header = (int) MAX(stop_time_header - now, 0);
     }
 
-    //printf("reading %d\n", timeout); fflush(stdout);
-    bytes = ::read(this->laser_fd, header + sizeof(header) - 1, 1);
-    if (bytes < 0)
+    framelen = this->framer.ReadFrame(frame, sizeof(frame), delay, delay_header);
+    if (framelen <= 0)
     {
-      if (errno == EINTR)
-	continue;
-      PLAYER_ERROR("error on read (1)");
+      PLAYER_MSG0(2, "timeout or error reading from laser");
       return 0;
     }
-    if (!bytes)
-    {
-      PLAYER_MSG0(2, "eof on read (1)");
-      return 0;
-    }
-    //printf("bytes read %d\n", bytes); fflush(stdout);
-
-    if (header[0] == STX && header[1] == 0x80)
-    {
-      if (!ack)
-        break;
-      if (header[4] == ACK || header[4] == NACK)
-        break;
-    }
-    memmove(header, header + 1, sizeof(header) - 1);
+    if (!ack || frame[4] == ACK || frame[4] == NACK)
+      break;
   }
 
   // Determine data length
   // Includes status, but not CRC, so subtract status to get data packet length.
   //
-  ssize_t len = ((int) header[2] | ((int) header[3] << 8)) - 1;
+  ssize_t len = ((int) frame[2] | ((int) frame[3] << 8)) - 1;
 
   // Check for buffer overflows
   //
   if (len > maxlen)
     RETURN_ERROR(0, "buffer overflow (len > maxlen)");
 
-  // Read in the data
-  // Note that we smooge the packet type from the header
-  // onto the front of the data buffer.
+  // The packet type is the first byte of the data
   //
-  bytes = 0;
-  data[bytes++] = header[4];
-  while (bytes < len)
-  {
-    if (timeout >= 0)
-    {
-      fd_set rfds, efds;
-      FD_ZERO(&rfds);
-      FD_SET(this->laser_fd, &rfds);
-      FD_ZERO(&efds);
-      FD_SET(this->laser_fd, &efds);
-      int64_t delay = stop_time - GetTime();
-      if (delay < 0) delay = 0;
-      struct timeval tv;
-      tv.tv_usec = (delay % 1000) * 1000;
-      tv.tv_sec = delay / 1000;
-      int retval = ::select(this->laser_fd + 1, &rfds, 0, &efds, &tv);
-      if (retval < 0)
-      {
-        if (errno == EINTR)
-	      continue;
-        PLAYER_ERROR("error on select (3)");
-        return 0;
-      }
-      if (!retval)
-      {
-        PLAYER_MSG0(2, "timeout on select (3)");
-        return 0;
-      }
-    }
-    int retval = ::read(this->laser_fd, data + bytes, len - bytes);
-    if (retval < 0)
-    {
-      if (errno == EINTR)
-	    continue;
-	  PLAYER_ERROR("error on read (3)");
-      return 0;
-    }
-    if (!retval)
-    {
-      PLAYER_MSG0(2, "eof on read (3)");
-      return 0;
-    }
-    bytes += retval;
-  }
-
-  // Read in footer
-  //
-  bytes = 0;
-  while (bytes < 3)
-  {
-    if (timeout >= 0)
-    {
-      fd_set rfds, efds;
-      FD_ZERO(&rfds);
-      FD_SET(this->laser_fd, &rfds);
-      FD_ZERO(&efds);
-      FD_SET(this->laser_fd, &efds);
-      int64_t delay = stop_time - GetTime();
-      if (delay < 0) delay = 0;
-      struct timeval tv;
-      tv.tv_usec = (delay % 1000) * 1000;
-      tv.tv_sec = delay / 1000;
-      int retval = ::select(this->laser_fd + 1, &rfds, 0, &efds, &tv);
-      if (retval < 0)
-      {
-        if (errno == EINTR)
-	      continue;
-        PLAYER_ERROR("error on select (4)");
-        return 0;
-      }
-      if (!retval)
-      {
-        PLAYER_MSG0(2, "timeout on select (4)");
-        return 0;
-      }
-    }
-    int retval = ::read(this->laser_fd, footer + bytes, 3 - bytes);
-    if (retval < 0)
-    {
-      if (errno == EINTR)
-        continue;
-      PLAYER_ERROR("error on read (4)");
-      return 0;
-    }
-    if (!retval)
-    {
-      PLAYER_MSG0(2, "eof on read (4)");
-      return 0;
-    }
-    bytes += retval;
-  }
-
-  // Construct entire packet
-  // And check the CRC
-  //
-  uint8_t buffer[4 + 1024 + 1];
-  assert(4 + len + 1 < (ssize_t) sizeof(buffer));
-  memcpy(buffer, header, 4);
-  memcpy(buffer + 4, data, len);
-  memcpy(buffer + 4 + len, footer, 1);
-  uint16_t crc = CreateCRC(buffer, 4 + len + 1);
-  if (crc != MAKEUINT16(footer[1], footer[2]))
-    RETURN_ERROR(0, "CRC error, ignoring packet");
-
+  memcpy(data, frame + 4, len);
   return len;
 }
 
@@ -2063,29 +1958,7 @@ ssize_t SickLMS200::ReadFromLaser(uint8_t *data, ssize_t maxlen, bool ack, int t
 //
 unsigned short SickLMS200::CreateCRC(uint8_t* data, ssize_t len)
 {
-  uint16_t uCrc16;
-  uint8_t abData[2];
-
-  uCrc16 = 0;
-  abData[0] = 0;
-
-  while(len-- )
-  {
-    abData[1] = abData[0];
-    abData[0] = *data++;
-
-    if( uCrc16 & 0x8000 )
-    {
-      uCrc16 = (uCrc16 & 0x7fff) << 1;
-      uCrc16 ^= CRC16_GEN_POL;
-    }
-    else
-    {
-      uCrc16 <<= 1;
-    }
-    uCrc16 ^= MAKEUINT16(abData[0],abData[1]);
-  }
-  return (uCrc16);
+  return serial_crc16_sick(data, len);
 }
 
 
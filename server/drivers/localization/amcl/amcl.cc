@@ -154,6 +154,14 @@ The @p amcl driver requires the following interfaces, some of them named:
   - pf_z (float)
     - Default: 3
     - Control parameter for the particle set size.  See notes below.
+  - pf_threads (integer)
+    - Default: 1
+    - Number of threads used to apply the odometry and laser models.
+      The particle set is split into one slice per thread.
+  - pf_seed (integer)
+    - Default: 0
+    - Seed for the per-thread random number streams.  For a given seed
+      and number of threads the filter output is reproducible.
   - init_pose (tuple: [length length angle])
     - Default: [0 0 0] (m m rad)
     - Initial pose estimate (mean value) for the robot.
@@ -179,13 +187,30 @@ The @p amcl driver requires the following interfaces, some of them named:
     - Maximum number of range readings being used
   - laser_range_max (length)
     - Default: 8.192 m
-    - Maximum range returned by laser
+    - Maximum range returned by laser; also the range covered by the
+      ray-cast table (see laser_range_lut_angles)
   - laser_range_var (length)
     - Default: 0.1 m
     - Variance in range data returned by laser
   - laser_range_bad (float)
     - Default 0.1
     - ???
+  - laser_model (string)
+    - Default: "beam"
+    - Laser sensor model: "beam" ray-casts every beam through the map;
+      "likelihood_field" looks up the distance from each beam end point
+      to the nearest obstacle, which is much cheaper.
+  - laser_likelihood_max_dist (length)
+    - Default: 2.0 m
+    - Maximum obstacle distance computed for the likelihood field model.
+  - laser_range_lut_angles (integer)
+    - Default: 0
+    - Number of discrete angles in a pre-computed ray-cast table for the
+      beam model (0 disables the table).  The table holds 2 bytes per
+      map cell per angle, so keep this small on large maps.  The table
+      is built at startup for laser_range_max; if the laser reports a
+      longer max range, it is rebuilt on the first scan, so set
+      laser_range_max to the laser's max range to avoid building it twice.
 - Debugging:
   - enable_gui (integer)
     - Default: 0
@@ -445,6 +470,10 @@ AdaptiveMCL::AdaptiveMCL( ConfigFile* cf, int section)
   this->pf_err = cf->ReadFloat(section, "pf_err", 0.01);
   this->pf_z = cf->ReadFloat(section, "pf_z", 3);
 
+  // Workers used for the action and sensor updates
+  this->pf_threads = cf->ReadInt(section, "pf_threads", 1);
+  this->pf_seed = (unsigned int) cf->ReadInt(section, "pf_seed", 0);
+
   // Initial pose estimate
   this->pf_init_pose_mean = pf_vector_zero();
   this->pf_init_pose_mean.v[0] = cf->ReadTupleLength(section, "init_pose", 0, 0);
@@ -514,6 +543,7 @@ int AdaptiveMCL::MainSetup(void)
   this->pf = pf_alloc(this->pf_min_samples, this->pf_max_samples);
   this->pf->pop_err = this->pf_err;
   this->pf->pop_z = this->pf_z;
+  pf_set_workers(this->pf, this->pf_threads, this->pf_seed);
 
   // Start sensors
   for (int i = 0; i < this->sensor_count; i++)
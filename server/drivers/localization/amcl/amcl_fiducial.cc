@@ -212,15 +212,14 @@ AMCLFiducial::SetupMap(void)
   // copy in the map info
   this->map->origin_x = this->map->origin_y = 0.0;
   this->map->scale = 1/(ntohl(info.scale) / 1e3);
-  this->map->size_x = ntohl(info.width);
-  this->map->size_y = ntohl(info.height);
-
   this->map->data_range = 1;
 
   // allocate space for map cells
-  assert(this->map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) *
-                                                this->map->size_x *
-                                                this->map->size_y));
+  if(map_alloc_cells(this->map, ntohl(info.width), ntohl(info.height)) != 0)
+  {
+    PLAYER_ERROR("failed to allocate map");
+    return(-1);
+  }
 
   // now, get the map data
   player_map_data_t data_req;
@@ -268,9 +267,9 @@ AMCLFiducial::SetupMap(void)
     {
       for(i=0;i<si;i++)
       {
-        this->map->cells[MAP_INDEX(this->map,oi+i,oj+j)].occ_state =
+        this->map->occ_states[MAP_INDEX(this->map,oi+i,oj+j)] =
                 data_req.data[j*si + i];
-        this->map->cells[MAP_INDEX(this->map,oi+i,oj+j)].occ_dist = 0;
+        this->map->occ_dists[MAP_INDEX(this->map,oi+i,oj+j)] = 0;
       }
     }
 
@@ -34,6 +34,7 @@
 #include <sys/types.h> // required by Darwin
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #if !defined (WIN32)
   #include <unistd.h>
 #endif
@@ -48,6 +49,13 @@ AMCLLaser::AMCLLaser(AdaptiveMCL & aAMCL, player_devaddr_t addr) : AMCLSensor(aA
   this->laser_dev = NULL;
   this->laser_addr = addr;
 
+  this->beam_count = 0;
+  this->beam_alloc = 0;
+  this->beam_ranges = NULL;
+  this->beam_bearings = NULL;
+  this->scratch_alloc = 0;
+  this->scratch_ranges = NULL;
+
   return;
 }
 
@@ -64,6 +72,20 @@ int AMCLLaser::Load(ConfigFile* cf, int section)
   this->max_beams = cf->ReadInt(section, "laser_max_beams", 6);
   this->range_var = cf->ReadLength(section, "laser_range_var", 0.10);
   this->range_bad = cf->ReadFloat(section, "laser_range_bad", 0.10);
+  this->range_max = cf->ReadLength(section, "laser_range_max", 8.192);
+
+  const char *model = cf->ReadString(section, "laser_model", "beam");
+  if (strcmp(model, "beam") == 0)
+    this->model_type = AMCL_LASER_MODEL_BEAM;
+  else if (strcmp(model, "likelihood_field") == 0)
+    this->model_type = AMCL_LASER_MODEL_LIKELIHOOD_FIELD;
+  else
+  {
+    PLAYER_WARN1("unknown laser model [%s]; using beam model", model);
+    this->model_type = AMCL_LASER_MODEL_BEAM;
+  }
+  this->likelihood_max_dist = cf->ReadLength(section, "laser_likelihood_max_dist", 2.0);
+  this->range_lut_angles = cf->ReadInt(section, "laser_range_lut_angles", 0);
 
   this->time = 0.0;
 
@@ -178,17 +200,17 @@ AMCLLaser::SetupMap(void)
   this->map->origin_x = info->origin.px + (info->scale * info->width) / 2.0;
   this->map->origin_y = info->origin.py + (info->scale * info->height) / 2.0;
   this->map->scale = info->scale;
-  this->map->size_x = info->width;
-  this->map->size_y = info->height;
   this->map->data_range = 1;
 
-  delete msg;
-
   // allocate space for map cells
-  this->map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) *
-                                                  this->map->size_x *
-                                                  this->map->size_y);
-  assert(this->map->cells);
+  if(map_alloc_cells(this->map, info->width, info->height) != 0)
+  {
+    PLAYER_ERROR("failed to allocate map");
+    delete msg;
+    return(-1);
+  }
+
+  delete msg;
 
   // now, get the map data
   player_map_data_t* data_req;
@@ -221,7 +243,6 @@ AMCLLaser::SetupMap(void)
     {
       PLAYER_ERROR("failed to get map info");
       free(data_req);
-      free(this->map->cells);
       return(-1);
     }
 
@@ -232,9 +253,9 @@ AMCLLaser::SetupMap(void)
     {
       for(i=0;i<si;i++)
       {
-        this->map->cells[MAP_INDEX(this->map,oi+i,oj+j)].occ_state =
+        this->map->occ_states[MAP_INDEX(this->map,oi+i,oj+j)] =
                 mapdata->data[j*si + i];
-        this->map->cells[MAP_INDEX(this->map,oi+i,oj+j)].occ_dist = 0;
+        this->map->occ_dists[MAP_INDEX(this->map,oi+i,oj+j)] = 0;
       }
     }
 
@@ -254,6 +275,26 @@ AMCLLaser::SetupMap(void)
   if(mapdev->Unsubscribe(AMCL.InQueue) != 0)
     PLAYER_WARN("unable to unsubscribe from map device");
 
+  // Pre-compute whatever the selected model needs
+  if (this->model_type == AMCL_LASER_MODEL_LIKELIHOOD_FIELD)
+  {
+    PLAYER_MSG0(2, "computing obstacle distances");
+    if (map_update_cspace(this->map, this->likelihood_max_dist) != 0)
+    {
+      PLAYER_ERROR("failed to allocate obstacle distance buffers");
+      return(-1);
+    }
+  }
+  else if (this->range_lut_angles > 0)
+  {
+    PLAYER_MSG1(2, "computing ray-cast table for %d angles", this->range_lut_angles);
+    if (map_build_range_lut(this->map, this->range_lut_angles, this->range_max + 1.0) != 0)
+    {
+      PLAYER_WARN("failed to build ray-cast table; ray-casting on the fly");
+      this->range_lut_angles = 0;
+    }
+  }
+
   PLAYER_MSG0(2, "Done");
 
   return(0);
@@ -268,6 +309,12 @@ int AMCLLaser::Shutdown(void)
   this->laser_dev = NULL;
   map_free(this->map);
 
+  delete [] this->beam_ranges;
+  delete [] this->beam_bearings;
+  delete [] this->scratch_ranges;
+  this->beam_ranges = this->beam_bearings = this->scratch_ranges = NULL;
+  this->beam_alloc = this->scratch_alloc = 0;
+
   return 0;
 }
 
@@ -322,39 +369,98 @@ int AMCLLaser::ProcessMessage(QueuePointer &resp_queue,
 // Apply the laser sensor model
 bool AMCLLaser::UpdateSensor(pf_t *pf, AMCLSensorData *data)
 {
+  int i, step;
   AMCLLaserData *ndata;
 
   ndata = (AMCLLaserData*) data;
   if (this->max_beams < 2)
     return false;
 
+  // Pick out the beams we are going to use
+  if (ndata->range_count > this->beam_alloc)
+  {
+    delete [] this->beam_ranges;
+    delete [] this->beam_bearings;
+    this->beam_alloc = ndata->range_count;
+    this->beam_ranges = new double[this->beam_alloc];
+    this->beam_bearings = new double[this->beam_alloc];
+  }
+
+  step = (ndata->range_count - 1) / (this->max_beams - 1);
+  if (step < 1)
+    step = 1;
+  this->beam_count = 0;
+  for (i = 0; i < ndata->range_count; i += step)
+  {
+    this->beam_ranges[this->beam_count] = ndata->ranges[i][0];
+    this->beam_bearings[this->beam_count] = ndata->ranges[i][1];
+    this->beam_count++;
+  }
+
+  // The ray-cast table only covers ranges up to laser_range_max; if the
+  // laser reaches further, rebuild it once for the laser's own range,
+  // rather than ray-casting every beam on the fly
+  if (this->model_type == AMCL_LASER_MODEL_BEAM && this->range_lut_angles > 0 &&
+      ndata->range_max + 1.0 > this->map->range_lut_max)
+  {
+    PLAYER_WARN2("laser max range %.3f m exceeds laser_range_max %.3f m; "
+                 "rebuilding ray-cast table", ndata->range_max, this->range_max);
+    if (map_build_range_lut(this->map, this->range_lut_angles, ndata->range_max + 1.0) != 0)
+    {
+      PLAYER_WARN("failed to build ray-cast table; ray-casting on the fly");
+      this->range_lut_angles = 0;
+    }
+  }
+
+  // Make room for each worker's ray-cast ranges
+  if (pf_get_workers(pf) * this->beam_count > this->scratch_alloc)
+  {
+    delete [] this->scratch_ranges;
+    this->scratch_alloc = pf_get_workers(pf) * this->beam_count;
+    this->scratch_ranges = new double[this->scratch_alloc];
+  }
+
   // Apply the laser sensor model
-  pf_update_sensor(pf, (pf_sensor_model_fn_t) SensorModel, data);
+  if (this->model_type == AMCL_LASER_MODEL_LIKELIHOOD_FIELD)
+    pf_update_sensor_parallel(pf, (pf_sensor_slice_fn_t) LikelihoodFieldModel, data);
+  else
+    pf_update_sensor_parallel(pf, (pf_sensor_slice_fn_t) SensorModel, data);
 
   return true;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// Determine the probability for the given pose
-double AMCLLaser::SensorModel(AMCLLaserData *data, pf_sample_set_t* set)
+// Determine the probability for the samples [first, last).  This may be
+// called from several workers at once, each with its own slice.
+double AMCLLaser::SensorModel(AMCLLaserData *data, pf_sample_set_t* set,
+                              int first, int last, pf_worker_t *worker)
 {
   AMCLLaser *self;
-  int i, j, step;
-  double z, c, pz;
+  int i, j;
+  double z, c2, pz;
   double p;
-  double map_range;
-  double obs_range, obs_bearing;
+  double range_max, range_bad;
   double total_weight;
+  const double *obs_ranges, *obs_bearings;
+  double *map_ranges;
   pf_sample_t *sample;
   pf_vector_t pose;
 
   self = (AMCLLaser*) data->sensor;
 
+  obs_ranges = self->beam_ranges;
+  obs_bearings = self->beam_bearings;
+  map_ranges = self->scratch_ranges + worker->index * self->beam_count;
+
+  range_max = data->range_max;
+  range_bad = self->range_bad;
+  c2 = 2 * self->range_var * self->range_var;
+
   total_weight = 0.0;
 
   // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
+  for (j = first; j < last; j++)
   {
     sample = set->samples + j;
     pose = sample->pose;
@@ -362,48 +468,97 @@ double AMCLLaser::SensorModel(AMCLLaserData *data, pf_sample_set_t* set)
     // Take account of the laser pose relative to the robot
     pose = pf_vector_coord_add(self->laser_pose, pose);
 
-    p = 1.0;
+    // Compute the ranges according to the map; this uses the
+    // pre-computed table, if there is one
+    for (i = 0; i < self->beam_count; i++)
+      map_ranges[i] = map_lookup_range(self->map, pose.v[0], pose.v[1],
+                                       pose.v[2] + obs_bearings[i], range_max + 1.0);
 
-    step = (data->range_count - 1) / (self->max_beams - 1);
-    for (i = 0; i < data->range_count; i += step)
+    // TODO: proper sensor model (using Kolmagorov?)
+    // Simple gaussian model; beams where both the observed and the
+    // expected range are at max range carry no information.
+    p = 1.0;
+    for (i = 0; i < self->beam_count; i++)
     {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
+      z = obs_ranges[i] - map_ranges[i];
+      pz = range_bad + (1 - range_bad) * exp(-(z * z) / c2);
+      if (obs_ranges[i] >= range_max && map_ranges[i] >= range_max)
+        pz = 1.0;
+      p *= pz;
+    }
 
-      // Compute the range according to the map
-      map_range = map_calc_range(self->map, pose.v[0], pose.v[1],
-                                 pose.v[2] + obs_bearing, data->range_max + 1.0);
+    sample->weight *= p;
+    total_weight += sample->weight;
+  }
 
-      if (obs_range >= data->range_max && map_range >= data->range_max)
-      {
-        pz = 1.0;
-      }
-      else
-      {
-        // TODO: proper sensor model (using Kolmagorov?)
-        // Simple gaussian model
-        c = self->range_var;
-        z = obs_range - map_range;
-        pz = self->range_bad + (1 - self->range_bad) * exp(-(z * z) / (2 * c * c));
-      }
+  return(total_weight);
+}
 
-      /*
-         if (obs->range >= 8.0 && map_range >= 8.0)
-         p *= 1.0;
-         else if (obs->range >= 8.0 && map_range < 8.0)
-         p *= self->range_bad;
-         else if (obs->range < 8.0 && map_range >= 8.0)
-         p *= self->range_bad;
-         else
-         p *= laser_sensor_prob(self, obs->range, map_range);
-       */
 
+////////////////////////////////////////////////////////////////////////////////
+// Determine the probability for the samples [first, last) using the
+// likelihood field model.  Rather than ray-casting, each beam end point
+// is looked up in the pre-computed obstacle distance map.
+double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set,
+                                       int first, int last, pf_worker_t *worker)
+{
+  AMCLLaser *self;
+  map_t *map;
+  int i, j;
+  int mi, mj;
+  double z, c2, pz;
+  double p;
+  double hx, hy;
+  double range_max, range_bad;
+  double total_weight;
+  const double *obs_ranges, *obs_bearings;
+  pf_sample_t *sample;
+  pf_vector_t pose;
+
+  self = (AMCLLaser*) data->sensor;
+  map = self->map;
+
+  obs_ranges = self->beam_ranges;
+  obs_bearings = self->beam_bearings;
+
+  range_max = data->range_max;
+  range_bad = self->range_bad;
+  c2 = 2 * self->range_var * self->range_var;
+
+  total_weight = 0.0;
+
+  // Compute the sample weights
+  for (j = first; j < last; j++)
+  {
+    sample = set->samples + j;
+    pose = sample->pose;
+
+    // Take account of the laser pose relative to the robot
+    pose = pf_vector_coord_add(self->laser_pose, pose);
+
+    p = 1.0;
+    for (i = 0; i < self->beam_count; i++)
+    {
+      // Max range readings carry no information in this model
+      if (obs_ranges[i] >= range_max)
+        continue;
+
+      // Beam end point in the map
+      hx = pose.v[0] + obs_ranges[i] * cos(pose.v[2] + obs_bearings[i]);
+      hy = pose.v[1] + obs_ranges[i] * sin(pose.v[2] + obs_bearings[i]);
+      mi = (int) MAP_GXWX(map, hx);
+      mj = (int) MAP_GYWY(map, hy);
+
+      // Distance to the nearest obstacle
+      if (MAP_VALID(map, mi, mj))
+        z = map->occ_dists[MAP_INDEX(map, mi, mj)];
+      else
+        z = map->max_occ_dist;
+
+      pz = range_bad + (1 - range_bad) * exp(-(z * z) / c2);
       p *= pz;
     }
 
-    //printf("%e\n", p);
-    //assert(p >= 0);
-
     sample->weight *= p;
     total_weight += sample->weight;
   }
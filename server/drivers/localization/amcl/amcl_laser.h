@@ -46,6 +46,14 @@ class AMCLLaserData : public AMCLSensorData
 };
 
 
+// Laser sensor models
+typedef enum
+{
+  AMCL_LASER_MODEL_BEAM,
+  AMCL_LASER_MODEL_LIKELIHOOD_FIELD
+} amcl_laser_model_t;
+
+
 // Laseretric sensor model
 class AMCLLaser : public AMCLSensor
 {
@@ -75,9 +83,18 @@ class AMCLLaser : public AMCLSensor
   // filter has been updated.
   public: virtual bool UpdateSensor(pf_t *pf, AMCLSensorData *data);
 
-  // Determine the probability for the given pose
+  // Determine the probability for the samples [first, last)
   private: static double SensorModel(AMCLLaserData *data, 
-                                     pf_sample_set_t* set);
+                                     pf_sample_set_t* set,
+                                     int first, int last,
+                                     pf_worker_t *worker);
+
+  // Determine the probability for the samples [first, last), using the
+  // likelihood field model
+  private: static double LikelihoodFieldModel(AMCLLaserData *data,
+                                              pf_sample_set_t* set,
+                                              int first, int last,
+                                              pf_worker_t *worker);
 
   // retrieve the map
   private: int SetupMap(void);
@@ -99,12 +116,34 @@ class AMCLLaser : public AMCLSensor
   // Max beams to consider
   private: int max_beams;
 
+  // Which sensor model to use
+  private: amcl_laser_model_t model_type;
+
+  // Max obstacle distance considered by the likelihood field model
+  private: double likelihood_max_dist;
+
+  // Number of angles in the pre-computed ray-cast table (0 to disable)
+  private: int range_lut_angles;
+
+  // Max range used when building the ray-cast table
+  private: double range_max;
+
   // Laser range variance
   private: double range_var;
 
   // Probability of bad range readings
   private: double range_bad;
 
+  // The beams selected from the current scan, stored as separate
+  // arrays so the per-beam likelihood loop is a straight array walk
+  private: int beam_count, beam_alloc;
+  private: double *beam_ranges;
+  private: double *beam_bearings;
+
+  // Per-worker workspace for the ray-cast ranges
+  private: int scratch_alloc;
+  private: double *scratch_ranges;
+
 #ifdef INCLUDE_RTKGUI
   // Setup the GUI
   private: virtual void SetupGUI(rtk_canvas_t *canvas, rtk_fig_t *robot_fig);
@@ -193,7 +193,7 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
   this->action_pdf = pf_pdf_gaussian_alloc(x, cx);
 
   // Update the filter
-  pf_update_action(pf, (pf_action_model_fn_t) ActionModel, this);
+  pf_update_action_parallel(pf, (pf_action_slice_fn_t) ActionModel, this);
 
   // Delete the pdf
   pf_pdf_gaussian_free(this->action_pdf);
@@ -206,17 +206,18 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
 ////////////////////////////////////////////////////////////////////////////////
 // The action model function (static method)
 void
-AMCLOdom::ActionModel(AMCLOdom *self, pf_sample_set_t* set)
+AMCLOdom::ActionModel(AMCLOdom *self, pf_sample_set_t* set,
+                      int first, int last, pf_worker_t *worker)
 {
   int i;
   pf_vector_t z;
   pf_sample_t *sample;
 
   // Compute the new sample poses
-  for (i = 0; i < set->sample_count; i++)
+  for (i = first; i < last; i++)
   {
     sample = set->samples + i;
-    z = pf_pdf_gaussian_sample(self->action_pdf);
+    z = pf_pdf_gaussian_sample_r(self->action_pdf, worker);
     sample->pose = pf_vector_coord_add(z, sample->pose);
     sample->weight = 1.0 / set->sample_count;
   }
@@ -73,8 +73,10 @@ class AMCLOdom : public AMCLSensor
   // has been updated.
   public: virtual bool UpdateAction(pf_t *pf, AMCLSensorData *data);
 
-  // The action model callback (static method)
-  public: static void ActionModel(AMCLOdom *self, pf_sample_set_t* set);
+  // The action model callback (static method); updates the samples
+  // [first, last) using the worker's random number stream
+  public: static void ActionModel(AMCLOdom *self, pf_sample_set_t* set,
+                                  int first, int last, pf_worker_t *worker);
   
   // Device info
   private: player_devaddr_t odom_addr;
@@ -53,8 +53,14 @@ map_t *map_alloc(void)
   map->scale = 0;
   map->max_occ_dist = 0;
   
-  // Allocate storage for main map
-  map->cells = (map_cell_t*) NULL;
+  // Storage for the map planes is allocated when the size is known
+  map->occ_states = (int8_t*) NULL;
+  map->occ_dists = (float*) NULL;
+  map->wifi_levels = (int16_t*) NULL;
+
+  map->range_lut_angles = 0;
+  map->range_lut_max = 0;
+  map->range_lut = (uint16_t*) NULL;
   
   return map;
 }
@@ -63,79 +69,169 @@ map_t *map_alloc(void)
 // Destroy a map
 void map_free(map_t *map)
 {
-  free(map->cells);
+  free(map->occ_states);
+  free(map->occ_dists);
+  free(map->wifi_levels);
+  free(map->range_lut);
   free(map);
   return;
 }
 
 
-// Get the cell at the given point
-map_cell_t *map_get_cell(map_t *map, double ox, double oy, double oa)
+// Allocate the occupancy and distance planes
+int map_alloc_cells(map_t *map, int size_x, int size_y)
+{
+  free(map->occ_states);
+  free(map->occ_dists);
+  free(map->wifi_levels);
+  free(map->range_lut);
+  map->wifi_levels = NULL;
+  map->range_lut = NULL;
+  map->range_lut_angles = 0;
+
+  map->size_x = size_x;
+  map->size_y = size_y;
+  map->occ_states = (int8_t*) calloc(size_x * size_y, sizeof(map->occ_states[0]));
+  map->occ_dists = (float*) calloc(size_x * size_y, sizeof(map->occ_dists[0]));
+
+  if (map->occ_states == NULL || map->occ_dists == NULL)
+    return -1;
+  return 0;
+}
+
+
+// Allocate the wifi plane
+int map_alloc_wifi(map_t *map)
+{
+  if (map->wifi_levels != NULL)
+    return 0;
+
+  map->wifi_levels = (int16_t*) calloc(map->size_x * map->size_y * MAP_WIFI_MAX_LEVELS,
+                                       sizeof(map->wifi_levels[0]));
+  if (map->wifi_levels == NULL)
+    return -1;
+  return 0;
+}
+
+
+// Get the cell index at the given point
+int map_get_index(map_t *map, double ox, double oy, double oa)
 {
   int i, j;
-  map_cell_t *cell;
 
   i = (int) MAP_GXWX(map, ox);
   j = (int) MAP_GYWY(map, oy);
   
   if (!MAP_VALID(map, i, j))
-    return NULL;
+    return -1;
 
-  cell = map->cells + MAP_INDEX(map, i, j);
-  return cell;
+  return MAP_INDEX(map, i, j);
 }
 
 
-// Update the cspace distance values
-void map_update_cspace(map_t *map, double max_occ_dist)
+// Squared distance transform of a sampled function in one dimension
+// (Felzenszwalb and Huttenlocher).  [f] holds the input, [d] the
+// output; [v] and [z] are workspace of size n and n + 1.
+static void map_edt_1d(const double *f, double *d, int n, int *v, double *z)
 {
-  int i, j;
-  int ni, nj;
-  int s;
-  double d;
-  map_cell_t *cell, *ncell;
+  int k, q;
+  double s;
 
-  map->max_occ_dist = max_occ_dist;
-  s = (int) ceil(map->max_occ_dist / map->scale);
+  k = 0;
+  v[0] = 0;
+  z[0] = -HUGE_VAL;
+  z[1] = +HUGE_VAL;
 
-  // Reset the distance values
-  for (j = 0; j < map->size_y; j++)
+  for (q = 1; q < n; q++)
   {
-    for (i = 0; i < map->size_x; i++)
+    s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+    while (s <= z[k])
     {
-      cell = map->cells + MAP_INDEX(map, i, j);
-      cell->occ_dist = map->max_occ_dist;
+      k--;
+      s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
     }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = +HUGE_VAL;
+  }
+
+  k = 0;
+  for (q = 0; q < n; q++)
+  {
+    while (z[k + 1] < q)
+      k++;
+    d[q] = (double) (q - v[k]) * (q - v[k]) + f[v[k]];
+  }
+
+  return;
+}
+
+
+// Update the cspace distance values.  This is an exact Euclidean
+// distance transform done as two separable passes, so the cost does
+// not depend on max_occ_dist.  Returns 0 on success.
+int map_update_cspace(map_t *map, double max_occ_dist)
+{
+  int i, j, n;
+  double inf, d;
+  double *f, *g, *z;
+  int *v;
+
+  map->max_occ_dist = max_occ_dist;
+
+  if (map->size_x <= 0 || map->size_y <= 0)
+    return 0;
+
+  n = (map->size_x > map->size_y) ? map->size_x : map->size_y;
+  f = (double*) calloc(n, sizeof(f[0]));
+  g = (double*) malloc(n * sizeof(g[0]));
+  z = (double*) malloc((n + 1) * sizeof(z[0]));
+  v = (int*) malloc(n * sizeof(v[0]));
+  if (f == NULL || g == NULL || z == NULL || v == NULL)
+  {
+    free(v);
+    free(z);
+    free(g);
+    free(f);
+    return -1;
+  }
+
+  // Anything beyond max_occ_dist ends up clamped anyway, so use that
+  // (squared, in cells) as infinity; this keeps the intermediate values
+  // small enough to be stored exactly in the float plane.
+  inf = ceil(map->max_occ_dist / map->scale) + 1;
+  inf = inf * inf;
+
+  // Columns; squared distance (in cells) to the nearest occupied cell
+  for (i = 0; i < map->size_x; i++)
+  {
+    for (j = 0; j < map->size_y; j++)
+      f[j] = (map->occ_states[MAP_INDEX(map, i, j)] == +1) ? 0 : inf;
+    map_edt_1d(f, g, map->size_y, v, z);
+    for (j = 0; j < map->size_y; j++)
+      map->occ_dists[MAP_INDEX(map, i, j)] = (float) ((g[j] < inf) ? g[j] : inf);
   }
 
-  // Find all the occupied cells and update their neighbours
+  // Rows
   for (j = 0; j < map->size_y; j++)
   {
+    for (i = 0; i < map->size_x; i++)
+      f[i] = map->occ_dists[MAP_INDEX(map, i, j)];
+    map_edt_1d(f, g, map->size_x, v, z);
     for (i = 0; i < map->size_x; i++)
     {
-      cell = map->cells + MAP_INDEX(map, i, j);
-      if (cell->occ_state != +1)
-        continue;
-          
-      cell->occ_dist = 0;
-
-      // Update adjacent cells
-      for (nj = -s; nj <= +s; nj++)
-      {
-        for (ni = -s; ni <= +s; ni++)
-        {
-          if (!MAP_VALID(map, i + ni, j + nj))
-            continue;
-
-          ncell = map->cells + MAP_INDEX(map, i + ni, j + nj);
-          d = map->scale * sqrt(ni * ni + nj * nj);
-
-          if (d < ncell->occ_dist)
-            ncell->occ_dist = d;
-        }
-      }
+      d = map->scale * sqrt(g[i]);
+      if (d > map->max_occ_dist)
+        d = map->max_occ_dist;
+      map->occ_dists[MAP_INDEX(map, i, j)] = (float) d;
     }
   }
+
+  free(v);
+  free(z);
+  free(g);
+  free(f);
   
-  return;
+  return 0;
 }
@@ -47,22 +47,15 @@ struct _rtk_fig_t;
 #define MAP_WIFI_MAX_LEVELS 8
 
   
-// Description for a single map cell.
-typedef struct
-{
-  // Occupancy state (-1 = free, 0 = unknown, +1 = occ)
-  int occ_state;
-
-  // Distance to the nearest occupied cell
-  double occ_dist;
-
-  // Wifi levels
-  int wifi_levels[MAP_WIFI_MAX_LEVELS];
+// Occupancy states
+#define MAP_OCC_FREE -1
+#define MAP_OCC_UNKNOWN 0
+#define MAP_OCC_OCC +1
 
-} map_cell_t;
-
-
-// Description for a map
+  
+// Description for a map.  The per-cell data is stored as separate
+// planes, so that the sensor models only pull the data they actually
+// use through the cache.
 typedef struct
 {
   // Map origin; the map is a viewport onto a conceptual larger map.
@@ -79,8 +72,21 @@ typedef struct
   
   unsigned char data_range;
 
-  // The map data, stored as a grid
-  map_cell_t *cells;
+  // Occupancy state plane (-1 = free, 0 = unknown, +1 = occ)
+  int8_t *occ_states;
+
+  // Distance to the nearest occupied cell
+  float *occ_dists;
+
+  // Wifi levels, MAP_WIFI_MAX_LEVELS per cell; NULL unless a wifi map
+  // has been loaded.
+  int16_t *wifi_levels;
+
+  // Pre-computed ray-cast ranges (in cells), range_lut_angles per cell;
+  // NULL unless the table has been built.
+  int range_lut_angles;
+  double range_lut_max;
+  uint16_t *range_lut;
   
 } map_t;
 
@@ -96,8 +102,15 @@ map_t *map_alloc(void);
 // Destroy a map
 void map_free(map_t *map);
 
-// Get the cell at the given point
-map_cell_t *map_get_cell(map_t *map, double ox, double oy, double oa);
+// Allocate the occupancy and distance planes for a map of the given
+// size.  Returns 0 on success.
+int map_alloc_cells(map_t *map, int size_x, int size_y);
+
+// Allocate the (optional) wifi plane.  Returns 0 on success.
+int map_alloc_wifi(map_t *map);
+
+// Get the cell index at the given point (-1 if the point is off the map)
+int map_get_index(map_t *map, double ox, double oy, double oa);
 
 // Load an occupancy map
 int map_load_occ(map_t *map, const char *filename, double scale, int negate);
@@ -105,8 +118,8 @@ int map_load_occ(map_t *map, const char *filename, double scale, int negate);
 // Load a wifi signal strength map
 int map_load_wifi(map_t *map, const char *filename, int index);
 
-// Update the cspace distances
-void map_update_cspace(map_t *map, double max_occ_dist);
+// Update the cspace distances.  Returns 0 on success.
+int map_update_cspace(map_t *map, double max_occ_dist);
 
 
 /**************************************************************************
@@ -116,6 +129,14 @@ void map_update_cspace(map_t *map, double max_occ_dist);
 // Extract a single range reading from the map
 double map_calc_range(map_t *map, double ox, double oy, double oa, double max_range);
 
+// Pre-compute the ray-cast ranges from every free cell for the given
+// number of discrete angles.  Returns 0 on success.
+int map_build_range_lut(map_t *map, int angle_count, double max_range);
+
+// Look up a range reading in the pre-computed table; falls back to
+// map_calc_range() if there is no suitable table.
+double map_lookup_range(map_t *map, double ox, double oy, double oa, double max_range);
+
 
 /**************************************************************************
  * GUI/diagnostic functions
@@ -128,7 +149,7 @@ void map_draw_occ(map_t *map, struct _rtk_fig_t *fig);
 void map_draw_cspace(map_t *map, struct _rtk_fig_t *fig);
 
 // Draw a wifi map
-void map_draw_wifi(map_t *map, struct _rtk_fig_t *fig, int index);
+void map_draw_wifi(map_t *map, struct _rtk_fig_t *fig, int beacon);
 
 
 /**************************************************************************
@@ -149,6 +170,9 @@ void map_draw_wifi(map_t *map, struct _rtk_fig_t *fig, int index);
 // Compute the cell index for the given map coords.
 #define MAP_INDEX(map, i, j) ((i) + (j) * map->size_x)
 
+// Get the wifi level for the given cell index and beacon
+#define MAP_WIFI_LEVEL(map, index, k) (map->wifi_levels[(index) * MAP_WIFI_MAX_LEVELS + (k)])
+
 #ifdef __cplusplus
 }
 #endif
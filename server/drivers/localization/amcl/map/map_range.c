@@ -44,7 +44,6 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
   int i, j;
   int ai, aj, bi, bj;
   double dx, dy;
-  map_cell_t *cell;
   
   if (fabs(cos(oa)) > fabs(sin(oa)))
   {
@@ -61,8 +60,7 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
         j = (int) MAP_GYWY(map, oy + (i - ai) * dy);
         if (MAP_VALID(map, i, j))
         {
-          cell = map->cells + MAP_INDEX(map, i, j);
-          if (cell->occ_state >= 0)
+          if (map->occ_states[MAP_INDEX(map, i, j)] >= 0)
             return sqrt((i - ai) * (i - ai) + (j - aj) * (j - aj)) * map->scale;
         }
         else
@@ -76,8 +74,7 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
         j = (int) MAP_GYWY(map, oy + (i - ai) * dy);
         if (MAP_VALID(map, i, j))
         {
-          cell = map->cells + MAP_INDEX(map, i, j);
-          if (cell->occ_state >= 0)
+          if (map->occ_states[MAP_INDEX(map, i, j)] >= 0)
             return sqrt((i - ai) * (i - ai) + (j - aj) * (j - aj)) * map->scale;
         }
         else
@@ -100,8 +97,7 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
         i = (int) MAP_GXWX(map, ox + (j - aj) * dx);
         if (MAP_VALID(map, i, j))
         {
-          cell = map->cells + MAP_INDEX(map, i, j);
-          if (cell->occ_state >= 0)
+          if (map->occ_states[MAP_INDEX(map, i, j)] >= 0)
             return sqrt((i - ai) * (i - ai) + (j - aj) * (j - aj)) * map->scale;
         }
         else
@@ -115,8 +111,7 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
         i = (int) MAP_GXWX(map, ox + (j - aj) * dx);
         if (MAP_VALID(map, i, j))
         {
-          cell = map->cells + MAP_INDEX(map, i, j);
-          if (cell->occ_state >= 0)
+          if (map->occ_states[MAP_INDEX(map, i, j)] >= 0)
             return sqrt((i - ai) * (i - ai) + (j - aj) * (j - aj)) * map->scale;
         }
         else
@@ -127,3 +122,89 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
   return max_range;
 }
 
+
+
+// Pre-compute the ray-cast ranges from every free cell.  Ranges are
+// stored in cells, as 16 bit values, for [angle_count] evenly spaced
+// angles; non-free cells have zero range, as in map_calc_range().
+int map_build_range_lut(map_t *map, int angle_count, double max_range)
+{
+  int i, j, k;
+  int index;
+  double ox, oy, oa, r;
+  size_t size;
+
+  free(map->range_lut);
+  map->range_lut = NULL;
+  map->range_lut_angles = 0;
+
+  if (angle_count <= 0)
+    return -1;
+  if (max_range / map->scale >= 65535)
+  {
+    PLAYER_ERROR("max range is too large for the ray-cast table");
+    return -1;
+  }
+
+  size = (size_t) map->size_x * map->size_y * angle_count;
+  map->range_lut = (uint16_t*) calloc(size, sizeof(map->range_lut[0]));
+  if (map->range_lut == NULL)
+  {
+    PLAYER_ERROR1("failed to allocate ray-cast table (%lu bytes)",
+                  (unsigned long) (size * sizeof(map->range_lut[0])));
+    return -1;
+  }
+
+  for (j = 0; j < map->size_y; j++)
+  {
+    for (i = 0; i < map->size_x; i++)
+    {
+      index = MAP_INDEX(map, i, j);
+      if (map->occ_states[index] >= 0)
+        continue;
+
+      ox = MAP_WXGX(map, i);
+      oy = MAP_WYGY(map, j);
+      for (k = 0; k < angle_count; k++)
+      {
+        oa = k * 2 * M_PI / angle_count;
+        r = map_calc_range(map, ox, oy, oa, max_range);
+        map->range_lut[(size_t) index * angle_count + k] =
+          (uint16_t) (r / map->scale + 0.5);
+      }
+    }
+  }
+
+  map->range_lut_angles = angle_count;
+  map->range_lut_max = max_range;
+
+  return 0;
+}
+
+
+// Look up a range reading in the pre-computed table
+double map_lookup_range(map_t *map, double ox, double oy, double oa, double max_range)
+{
+  int i, j, k;
+  double r;
+
+  if (map->range_lut == NULL || max_range > map->range_lut_max)
+    return map_calc_range(map, ox, oy, oa, max_range);
+
+  i = (int) MAP_GXWX(map, ox);
+  j = (int) MAP_GYWY(map, oy);
+  if (!MAP_VALID(map, i, j))
+    return 0;
+
+  // Nearest discrete angle
+  k = (int) floor(oa * map->range_lut_angles / (2 * M_PI) + 0.5);
+  k %= map->range_lut_angles;
+  if (k < 0)
+    k += map->range_lut_angles;
+
+  r = map->range_lut[(size_t) MAP_INDEX(map, i, j) * map->range_lut_angles + k] * map->scale;
+  if (r > max_range)
+    r = max_range;
+
+  return r;
+}
@@ -48,7 +48,6 @@ int map_load_occ(map_t *map, const char *filename, double scale, int negate)
   int i, j;
   int ch, occ;
   int width, height, depth;
-  map_cell_t *cell;
 
   // Open file
   file = fopen(filename, "r");
@@ -75,12 +74,14 @@ int map_load_occ(map_t *map, const char *filename, double scale, int negate)
   fscanf(file, " %d %d \n %d \n", &width, &height, &depth);
 
   // Allocate space in the map
-  if (map->cells == NULL)
+  if (map->occ_states == NULL)
   {
     map->scale = scale;
-    map->size_x = width;
-    map->size_y = height;
-    map->cells = calloc(width * height, sizeof(map->cells[0]));
+    if (map_alloc_cells(map, width, height) != 0)
+    {
+      PLAYER_ERROR("failed to allocate map");
+      return -1;
+    }
   }
   else
   {
@@ -122,8 +123,7 @@ int map_load_occ(map_t *map, const char *filename, double scale, int negate)
 
       if (!MAP_VALID(map, i, j))
         continue;
-      cell = map->cells + MAP_INDEX(map, i, j);
-      cell->occ_state = occ;
+      map->occ_states[MAP_INDEX(map, i, j)] = occ;
     }
   }
   
@@ -142,7 +142,6 @@ int map_load_wifi(map_t *map, const char *filename, int index)
   int i, j;
   int ch, level;
   int width, height, depth;
-  map_cell_t *cell;
 
   // Open file
   file = fopen(filename, "r");
@@ -169,11 +168,13 @@ int map_load_wifi(map_t *map, const char *filename, int index)
   fscanf(file, " %d %d \n %d \n", &width, &height, &depth);
 
   // Allocate space in the map
-  if (map->cells == NULL)
+  if (map->occ_states == NULL)
   {
-    map->size_x = width;
-    map->size_y = height;
-    map->cells = calloc(width * height, sizeof(map->cells[0]));
+    if (map_alloc_cells(map, width, height) != 0)
+    {
+      PLAYER_ERROR("failed to allocate map");
+      return -1;
+    }
   }
   else
   {
@@ -184,6 +185,13 @@ int map_load_wifi(map_t *map, const char *filename, int index)
     }
   }
 
+  // The wifi plane is only allocated once a wifi map is actually used
+  if (map_alloc_wifi(map) != 0)
+  {
+    PLAYER_ERROR("failed to allocate wifi map");
+    return -1;
+  }
+
   // Read in the image
   for (j = height - 1; j >= 0; j--)
   {
@@ -199,8 +207,7 @@ int map_load_wifi(map_t *map, const char *filename, int index)
       else
         level = ch * 100 / 255 - 100;
 
-      cell = map->cells + MAP_INDEX(map, i, j);
-      cell->wifi_levels[index] = level;
+      MAP_WIFI_LEVEL(map, MAP_INDEX(map, i, j), index) = level;
     }
   }
   
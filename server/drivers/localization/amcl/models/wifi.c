@@ -73,10 +73,13 @@ double wifi_sensor_model(wifi_t *self, pf_vector_t pose)
   double p, z, a, c;
   int i;
   int mlevel, olevel;
-  map_cell_t *cell;  
+  int index;
 
-  cell = map_get_cell(self->map, pose.v[0], pose.v[1], pose.v[2]);
-  if (!cell)
+  if (self->map->wifi_levels == NULL)
+    return 0;
+
+  index = map_get_index(self->map, pose.v[0], pose.v[1], pose.v[2]);
+  if (index < 0)
     return 0;
 
   // ** HACK
@@ -87,7 +90,7 @@ double wifi_sensor_model(wifi_t *self, pf_vector_t pose)
 
   for (i = 0; i < self->level_count; i++)
   {
-    mlevel = cell->wifi_levels[i];
+    mlevel = MAP_WIFI_LEVEL(self->map, index, i);
     olevel = self->levels[i];
 
     z = (olevel - mlevel);
@@ -36,7 +36,7 @@
 
 #include "pf.h"
 #include "pf_pdf.h"
-#include "pf_kdtree.h"
+#include "pf_hist.h"
 
 
 // Compute the required number of samples, given that there are k bins
@@ -46,6 +46,24 @@ static int pf_resample_limit(pf_t *pf, int k);
 // Re-compute the cluster statistics for a sample set
 static void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set);
 
+// Normalize the sample weights, given their total
+static void pf_normalize(pf_sample_set_t *set, double total);
+
+
+// Information for a parallel update
+typedef struct
+{
+  pf_t *pf;
+  pf_sample_set_t *set;
+  pf_action_slice_fn_t action_fn;
+  pf_sensor_slice_fn_t sensor_fn;
+  void *data;
+} pf_job_t;
+
+// Worker functions for the parallel updates
+static void pf_action_job(void *job_data, pf_worker_t *worker);
+static void pf_sensor_job(void *job_data, pf_worker_t *worker);
+
 
 // Create a new filter
 pf_t *pf_alloc(int min_samples, int max_samples)
@@ -85,14 +103,20 @@ pf_t *pf_alloc(int min_samples, int max_samples)
       sample->weight = 1.0 / max_samples;
     }
 
-    // HACK: is 3 times max_samples enough?
-    set->kdtree = pf_kdtree_alloc(3 * max_samples);
+    // Every sample adds at most one bin
+    set->hist = pf_hist_alloc(max_samples);
+    set->sample_bins = calloc(max_samples, sizeof(int));
 
     set->cluster_count = 0;
     set->cluster_max_count = 100;
     set->clusters = calloc(set->cluster_max_count, sizeof(pf_cluster_t));
   }
 
+  // Default to a single worker (the calling thread)
+  pf->pool = NULL;
+  pf->worker_totals = NULL;
+  pf_set_workers(pf, 1, 0);
+
   return pf;
 }
 
@@ -105,9 +129,12 @@ void pf_free(pf_t *pf)
   for (i = 0; i < 2; i++)
   {
     free(pf->sets[i].clusters);
-    pf_kdtree_free(pf->sets[i].kdtree);
+    pf_hist_free(pf->sets[i].hist);
+    free(pf->sets[i].sample_bins);
     free(pf->sets[i].samples);
   }
+  pf_pool_free(pf->pool);
+  free(pf->worker_totals);
   free(pf);
   
   return;
@@ -124,8 +151,8 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
   
   set = pf->sets + pf->current_set;
   
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hist_clear(set->hist);
 
   set->sample_count = pf->max_samples;
 
@@ -139,7 +166,7 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
     sample->pose = pf_pdf_gaussian_sample(pdf);
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    set->sample_bins[i] = pf_hist_insert(set->hist, sample->pose, sample->weight);
   }
 
   pf_pdf_gaussian_free(pdf);
@@ -160,8 +187,8 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
 
   set = pf->sets + pf->current_set;
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hist_clear(set->hist);
 
   set->sample_count = pf->max_samples;
 
@@ -173,7 +200,7 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
     sample->pose = (*init_fn) (init_data);
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    set->sample_bins[i] = pf_hist_insert(set->hist, sample->pose, sample->weight);
   }
 
   // Re-compute cluster statistics
@@ -199,16 +226,132 @@ void pf_update_action(pf_t *pf, pf_action_model_fn_t action_fn, void *action_dat
 // Update the filter with some new sensor observation
 void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_data)
 {
-  int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
   double total;
 
   set = pf->sets + pf->current_set;
 
   // Compute the sample weights
   total = (*sensor_fn) (sensor_data, set);
+
+  pf_normalize(set, total);
   
+  return;
+}
+
+
+// Set the number of workers used for the parallel updates
+void pf_set_workers(pf_t *pf, int worker_count, unsigned int seed)
+{
+  if (worker_count < 1)
+    worker_count = 1;
+
+  if (pf->pool)
+    pf_pool_free(pf->pool);
+  free(pf->worker_totals);
+
+  pf->pool = pf_pool_alloc(worker_count, seed);
+  pf->worker_totals = calloc(worker_count, sizeof(double));
+
+  return;
+}
+
+
+// Get the number of workers used for the parallel updates
+int pf_get_workers(pf_t *pf)
+{
+  return pf_pool_worker_count(pf->pool);
+}
+
+
+// Update the filter with some new action, spread over the workers
+void pf_update_action_parallel(pf_t *pf, pf_action_slice_fn_t action_fn, void *action_data)
+{
+  pf_job_t job;
+
+  job.pf = pf;
+  job.set = pf->sets + pf->current_set;
+  job.action_fn = action_fn;
+  job.sensor_fn = NULL;
+  job.data = action_data;
+
+  pf_pool_run(pf->pool, pf_action_job, &job);
+
+  return;
+}
+
+
+// Update the filter with some new sensor observation, spread over the workers
+void pf_update_sensor_parallel(pf_t *pf, pf_sensor_slice_fn_t sensor_fn, void *sensor_data)
+{
+  int i;
+  double total;
+  pf_job_t job;
+
+  job.pf = pf;
+  job.set = pf->sets + pf->current_set;
+  job.action_fn = NULL;
+  job.sensor_fn = sensor_fn;
+  job.data = sensor_data;
+
+  pf_pool_run(pf->pool, pf_sensor_job, &job);
+
+  // Sum the partial totals in worker order, so the result does not
+  // depend on which thread finished first
+  total = 0.0;
+  for (i = 0; i < pf_pool_worker_count(pf->pool); i++)
+    total += pf->worker_totals[i];
+
+  pf_normalize(job.set, total);
+
+  return;
+}
+
+
+// Apply the action model to this worker's slice of the samples
+void pf_action_job(void *job_data, pf_worker_t *worker)
+{
+  int n, first, last;
+  pf_job_t *job;
+
+  job = (pf_job_t*) job_data;
+  n = pf_pool_worker_count(job->pf->pool);
+  first = (int) ((long long) job->set->sample_count * worker->index / n);
+  last = (int) ((long long) job->set->sample_count * (worker->index + 1) / n);
+
+  if (first < last)
+    (*job->action_fn) (job->data, job->set, first, last, worker);
+
+  return;
+}
+
+
+// Apply the sensor model to this worker's slice of the samples
+void pf_sensor_job(void *job_data, pf_worker_t *worker)
+{
+  int n, first, last;
+  pf_job_t *job;
+
+  job = (pf_job_t*) job_data;
+  n = pf_pool_worker_count(job->pf->pool);
+  first = (int) ((long long) job->set->sample_count * worker->index / n);
+  last = (int) ((long long) job->set->sample_count * (worker->index + 1) / n);
+
+  job->pf->worker_totals[worker->index] = 0.0;
+  if (first < last)
+    job->pf->worker_totals[worker->index] =
+      (*job->sensor_fn) (job->data, job->set, first, last, worker);
+
+  return;
+}
+
+
+// Normalize the sample weights, given their total
+void pf_normalize(pf_sample_set_t *set, double total)
+{
+  int i;
+  pf_sample_t *sample;
+
   if (total > 0.0)
   {
     // Normalize weights
@@ -229,7 +372,7 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
       sample->weight = 1.0 / set->sample_count;
     }
   }
-  
+
   return;
 }
 
@@ -267,8 +410,8 @@ void pf_update_resample(pf_t *pf)
   // Initialize the random number generator
   //pdf = pf_pdf_discrete_alloc(set_a->sample_count, randlist);
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set_b->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hist_clear(set_b->hist);
   
   // Draw samples from set a to create set b.
   total = 0;
@@ -318,19 +461,17 @@ void pf_update_resample(pf_t *pf)
     assert(sample_a->weight > 0);
 
     // Add sample to list
-    sample_b = set_b->samples + set_b->sample_count++;
+    sample_b = set_b->samples + set_b->sample_count;
     sample_b->pose = sample_a->pose;
     sample_b->weight = 1.0;
     total += sample_b->weight;
 
     // Add sample to histogram
-    pf_kdtree_insert(set_b->kdtree, sample_b->pose, sample_b->weight);
-
-    //fprintf(stderr, "resample %d %d %d\n", set_b->sample_count, set_b->kdtree->leaf_count,
-            //pf_resample_limit(pf, set_b->kdtree->leaf_count));
+    set_b->sample_bins[set_b->sample_count++] =
+      pf_hist_insert(set_b->hist, sample_b->pose, sample_b->weight);
 
     // See if we have enough samples yet
-    if (set_b->sample_count > pf_resample_limit(pf, set_b->kdtree->leaf_count))
+    if (set_b->sample_count > pf_resample_limit(pf, set_b->hist->bin_count))
       break;
 
     m++;
@@ -392,7 +533,7 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
   pf_cluster_t *cluster;
 
   // Cluster the samples
-  pf_kdtree_cluster(set->kdtree);
+  pf_hist_cluster(set->hist);
   
   // Initialize cluster stats
   set->cluster_count = 0;
@@ -419,8 +560,8 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
 
     //printf("%d %f %f %f\n", i, sample->pose.v[0], sample->pose.v[1], sample->pose.v[2]);
 
-    // Get the cluster label for this sample
-    c = pf_kdtree_get_cluster(set->kdtree, sample->pose);
+    // Get the cluster label for this sample; we already know its bin
+    c = set->hist->bins[set->sample_bins[i]].cluster;
     assert(c >= 0);
     if (c >= set->cluster_max_count)
       continue;
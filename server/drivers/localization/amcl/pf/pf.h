@@ -32,7 +32,8 @@
 #define PF_H
 
 #include "pf_vector.h"
-#include "pf_kdtree.h"
+#include "pf_hist.h"
+#include "pf_pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -57,6 +58,20 @@ typedef void (*pf_action_model_fn_t) (void *action_data,
 typedef double (*pf_sensor_model_fn_t) (void *sensor_data, 
                                         struct _pf_sample_set_t* set);
 
+// Function prototype for the parallel action model; generates new poses
+// for the samples [first, last) using the worker's random number stream.
+typedef void (*pf_action_slice_fn_t) (void *action_data,
+                                      struct _pf_sample_set_t* set,
+                                      int first, int last,
+                                      pf_worker_t *worker);
+
+// Function prototype for the parallel sensor model; updates the weights
+// for the samples [first, last) and returns their total weight.
+typedef double (*pf_sensor_slice_fn_t) (void *sensor_data,
+                                        struct _pf_sample_set_t* set,
+                                        int first, int last,
+                                        pf_worker_t *worker);
+
 
 // Information for a single sample
 typedef struct
@@ -96,8 +111,9 @@ typedef struct _pf_sample_set_t
   int sample_count;
   pf_sample_t *samples;
 
-  // A kdtree encoding the histogram
-  pf_kdtree_t *kdtree;
+  // The histogram, and the histogram bin for each sample
+  pf_hist_t *hist;
+  int *sample_bins;
 
   // Clusters
   int cluster_count, cluster_max_count;
@@ -120,6 +136,12 @@ typedef struct _pf_t
   int current_set;
   pf_sample_set_t sets[2];
 
+  // Workers used for the parallel updates
+  struct _pf_pool_t *pool;
+
+  // Per-worker partial sums
+  double *worker_totals;
+
 } pf_t;
 
 
@@ -141,6 +163,20 @@ void pf_update_action(pf_t *pf, pf_action_model_fn_t action_fn, void *action_dat
 // Update the filter with some new sensor observation
 void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_data);
 
+// Set the number of workers (including the calling thread) used for
+// the parallel updates.  The samples are split into equal contiguous
+// slices, so results are reproducible for a given seed and worker count.
+void pf_set_workers(pf_t *pf, int worker_count, unsigned int seed);
+
+// Get the number of workers used for the parallel updates
+int pf_get_workers(pf_t *pf);
+
+// Update the filter with some new action, spread over the workers
+void pf_update_action_parallel(pf_t *pf, pf_action_slice_fn_t action_fn, void *action_data);
+
+// Update the filter with some new sensor observation, spread over the workers
+void pf_update_sensor_parallel(pf_t *pf, pf_sensor_slice_fn_t sensor_fn, void *sensor_data);
+
 // Resample the distribution
 void pf_update_resample(pf_t *pf);
 
@@ -155,7 +191,7 @@ int pf_get_cluster_stats(pf_t *pf, int cluster, double *weight,
 // Display the sample set
 void pf_draw_samples(pf_t *pf, struct _rtk_fig_t *fig, int max_samples);
 
-// Draw the histogram (kdtree)
+// Draw the histogram
 void pf_draw_hist(pf_t *pf, struct _rtk_fig_t *fig);
 
 // Draw the CEP statistics
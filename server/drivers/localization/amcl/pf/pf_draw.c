@@ -43,7 +43,7 @@
 
 #include "pf.h"
 #include "pf_pdf.h"
-#include "pf_kdtree.h"
+#include "pf_hist.h"
 
 
 // Draw the statistics
@@ -80,7 +80,7 @@ void pf_draw_samples(pf_t *pf, rtk_fig_t *fig, int max_samples)
 }
 
 
-// Draw the hitogram (kd tree)
+// Draw the hitogram
 void pf_draw_hist(pf_t *pf, rtk_fig_t *fig)
 {
   pf_sample_set_t *set;
@@ -88,7 +88,7 @@ void pf_draw_hist(pf_t *pf, rtk_fig_t *fig)
   set = pf->sets + pf->current_set;
 
   rtk_fig_color(fig, 0.0, 0.0, 1.0);
-  pf_kdtree_draw(set->kdtree, fig);
+  pf_hist_draw(set->hist, fig);
 
   return;
 }
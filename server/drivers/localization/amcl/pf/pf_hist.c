@@ -0,0 +1,301 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+/**************************************************************************
+ * Desc: Hash grid histogram for KLD-sampling and clustering
+ * CVS: $Id$
+ *************************************************************************/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#include "pf_vector.h"
+#include "pf_hist.h"
+#include <libplayercommon/playercommon.h>
+
+// Compute the key for a pose
+static void pf_hist_key(pf_hist_t *self, pf_vector_t pose, int key[]);
+
+// Find the hash table slot for a key; the slot is either empty or
+// holds the bin with this key
+static int pf_hist_find_slot(pf_hist_t *self, int key[]);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Create a histogram
+pf_hist_t *pf_hist_alloc(int max_size)
+{
+  pf_hist_t *self;
+
+  self = calloc(1, sizeof(pf_hist_t));
+
+  self->size[0] = 0.50;
+  self->size[1] = 0.50;
+  self->size[2] = (10 * M_PI / 180);
+
+  self->bin_count = 0;
+  self->bin_max_count = max_size;
+  self->bins = calloc(self->bin_max_count, sizeof(pf_hist_bin_t));
+  self->stack = calloc(self->bin_max_count, sizeof(int));
+
+  // Keep the load factor at or below 1/2
+  self->table_size = 16;
+  while (self->table_size < 2 * max_size)
+    self->table_size *= 2;
+  self->table = malloc(self->table_size * sizeof(int));
+  memset(self->table, 0xFF, self->table_size * sizeof(int));
+
+  return self;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Destroy a histogram
+void pf_hist_free(pf_hist_t *self)
+{
+  free(self->table);
+  free(self->stack);
+  free(self->bins);
+  free(self);
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear all entries from the histogram.  Only the slots that are in use
+// are touched, so this is proportional to the number of occupied bins.
+void pf_hist_clear(pf_hist_t *self)
+{
+  int i;
+
+  for (i = 0; i < self->bin_count; i++)
+    self->table[self->bins[i].slot] = -1;
+  self->bin_count = 0;
+
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Insert a pose into the histogram
+int pf_hist_insert(pf_hist_t *self, pf_vector_t pose, double value)
+{
+  int key[3];
+  int slot, index;
+  pf_hist_bin_t *bin;
+
+  pf_hist_key(self, pose, key);
+
+  slot = pf_hist_find_slot(self, key);
+  index = self->table[slot];
+
+  // If the bin doesnt exist yet...
+  if (index < 0)
+  {
+    assert(self->bin_count < self->bin_max_count);
+    index = self->bin_count++;
+    self->table[slot] = index;
+
+    bin = self->bins + index;
+    bin->key[0] = key[0];
+    bin->key[1] = key[1];
+    bin->key[2] = key[2];
+    bin->value = 0.0;
+    bin->cluster = -1;
+    bin->slot = slot;
+  }
+
+  self->bins[index].value += value;
+
+  return index;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Determine the probability estimate for the given pose. TODO: this
+// should do a kernel density estimate rather than a simple histogram.
+double pf_hist_get_prob(pf_hist_t *self, pf_vector_t pose)
+{
+  int key[3];
+  int index;
+
+  pf_hist_key(self, pose, key);
+  index = self->table[pf_hist_find_slot(self, key)];
+  if (index < 0)
+    return 0.0;
+  return self->bins[index].value;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Determine the cluster label for the given pose
+int pf_hist_get_cluster(pf_hist_t *self, pf_vector_t pose)
+{
+  int key[3];
+  int index;
+
+  pf_hist_key(self, pose, key);
+  index = self->table[pf_hist_find_slot(self, key)];
+  if (index < 0)
+    return -1;
+  return self->bins[index].cluster;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compute the key for a pose
+void pf_hist_key(pf_hist_t *self, pf_vector_t pose, int key[])
+{
+  key[0] = (int) floor(pose.v[0] / self->size[0]);
+  key[1] = (int) floor(pose.v[1] / self->size[1]);
+  key[2] = (int) floor(pose.v[2] / self->size[2]);
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Find the hash table slot for a key (linear probing)
+int pf_hist_find_slot(pf_hist_t *self, int key[])
+{
+  unsigned int h;
+  int slot, index;
+  pf_hist_bin_t *bin;
+
+  h = (unsigned int) key[0] * 73856093u;
+  h ^= (unsigned int) key[1] * 19349663u;
+  h ^= (unsigned int) key[2] * 83492791u;
+
+  slot = (int) (h & (self->table_size - 1));
+  while (1)
+  {
+    index = self->table[slot];
+    if (index < 0)
+      return slot;
+    bin = self->bins + index;
+    if (bin->key[0] == key[0] && bin->key[1] == key[1] && bin->key[2] == key[2])
+      return slot;
+    slot = (slot + 1) & (self->table_size - 1);
+  }
+
+  return -1;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Label the connected clusters of occupied bins.  Bins are connected
+// if they are adjacent (including diagonally) in (x, y, theta).
+void pf_hist_cluster(pf_hist_t *self)
+{
+  int i, j;
+  int top, index, nindex;
+  int cluster_count;
+  int nkey[3];
+  pf_hist_bin_t *bin, *nbin;
+
+  for (i = 0; i < self->bin_count; i++)
+    self->bins[i].cluster = -1;
+
+  cluster_count = 0;
+
+  // Do connected components for each bin
+  for (i = 0; i < self->bin_count; i++)
+  {
+    // If this bin has already been labelled, skip it
+    if (self->bins[i].cluster >= 0)
+      continue;
+
+    // Assign a label to this cluster, and flood fill from here
+    self->bins[i].cluster = cluster_count++;
+    top = 0;
+    self->stack[top++] = i;
+
+    while (top > 0)
+    {
+      index = self->stack[--top];
+      bin = self->bins + index;
+
+      for (j = 0; j < 3 * 3 * 3; j++)
+      {
+        nkey[0] = bin->key[0] + (j / 9) - 1;
+        nkey[1] = bin->key[1] + ((j % 9) / 3) - 1;
+        nkey[2] = bin->key[2] + ((j % 9) % 3) - 1;
+
+        nindex = self->table[pf_hist_find_slot(self, nkey)];
+        if (nindex < 0)
+          continue;
+
+        nbin = self->bins + nindex;
+
+        // This bin already has a label; skip it.  The label should be
+        // consistent, however.
+        if (nbin->cluster >= 0)
+        {
+          assert(nbin->cluster == bin->cluster);
+          continue;
+        }
+
+        // Label this bin and visit its neighbours later
+        nbin->cluster = bin->cluster;
+        assert(top < self->bin_max_count);
+        self->stack[top++] = nindex;
+      }
+    }
+  }
+
+  return;
+}
+
+
+
+#ifdef INCLUDE_RTKGUI
+
+////////////////////////////////////////////////////////////////////////////////
+// Draw the histogram
+void pf_hist_draw(pf_hist_t *self, rtk_fig_t *fig)
+{
+  int i;
+  double ox, oy;
+  char text[64];
+  pf_hist_bin_t *bin;
+
+  for (i = 0; i < self->bin_count; i++)
+  {
+    bin = self->bins + i;
+
+    ox = (bin->key[0] + 0.5) * self->size[0];
+    oy = (bin->key[1] + 0.5) * self->size[1];
+
+    rtk_fig_rectangle(fig, ox, oy, 0.0, self->size[0], self->size[1], 0);
+
+    snprintf(text, sizeof(text), "%d", bin->cluster);
+    rtk_fig_text(fig, ox, oy, 0.0, text);
+  }
+
+  return;
+}
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+/**************************************************************************
+ * Desc: Hash grid histogram for KLD-sampling and clustering
+ * CVS: $Id$
+ *************************************************************************/
+
+#ifndef PF_HIST_H
+#define PF_HIST_H
+
+#include <playerconfig.h>
+
+#include "pf_vector.h"
+
+#ifdef INCLUDE_RTKGUI
+#include "rtk.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// Info for an occupied bin in the histogram
+typedef struct
+{
+  // The key for this bin
+  int key[3];
+
+  // The value for this bin
+  double value;
+
+  // The cluster label
+  int cluster;
+
+  // The hash table slot holding this bin
+  int slot;
+
+} pf_hist_bin_t;
+
+
+// A histogram over (x, y, theta), stored as an open-addressed hash
+// table over the occupied bins
+typedef struct
+{
+  // Bin size
+  double size[3];
+
+  // The occupied bins, in insertion order
+  int bin_count, bin_max_count;
+  pf_hist_bin_t *bins;
+
+  // Hash table; each slot holds a bin index, or -1 if empty.  The table
+  // size is a power of two.
+  int table_size;
+  int *table;
+
+  // Workspace for clustering
+  int *stack;
+
+} pf_hist_t;
+
+
+// Create a histogram that can hold up to [max_size] occupied bins
+extern pf_hist_t *pf_hist_alloc(int max_size);
+
+// Destroy a histogram
+extern void pf_hist_free(pf_hist_t *self);
+
+// Clear all entries from the histogram
+extern void pf_hist_clear(pf_hist_t *self);
+
+// Insert a pose into the histogram; returns the index of its bin
+extern int pf_hist_insert(pf_hist_t *self, pf_vector_t pose, double value);
+
+// Label the connected clusters of occupied bins
+extern void pf_hist_cluster(pf_hist_t *self);
+
+// Determine the probability estimate for the given pose
+extern double pf_hist_get_prob(pf_hist_t *self, pf_vector_t pose);
+
+// Determine the cluster label for the given pose
+extern int pf_hist_get_cluster(pf_hist_t *self, pf_vector_t pose);
+
+
+#ifdef INCLUDE_RTKGUI
+
+// Draw the histogram
+extern void pf_hist_draw(pf_hist_t *self, rtk_fig_t *fig);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -133,6 +133,28 @@ pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf)
   return x;
 }
 
+// Generate a sample from the the pdf, using the worker's random number
+// stream.
+pf_vector_t pf_pdf_gaussian_sample_r(pf_pdf_gaussian_t *pdf, pf_worker_t *worker)
+{
+  int i, j;
+  pf_vector_t r;
+  pf_vector_t x;
+
+  // Generate a random vector
+  for (i = 0; i < 3; i++)
+    r.v[i] = pf_ran_gaussian_r(pdf->cd.v[i], worker);
+
+  for (i = 0; i < 3; i++)
+  {
+    x.v[i] = pdf->x.v[i];
+    for (j = 0; j < 3; j++)
+      x.v[i] += pdf->cr.m[i][j] * r.v[j];
+  } 
+  
+  return x;
+}
+
 // Draw randomly from a zero-mean Gaussian distribution, with standard
 // deviation sigma.
 // We use the polar form of the Box-Muller transformation, explained here:
@@ -163,6 +185,23 @@ double pf_ran_gaussian(double sigma)
   return(sigma * x2 * sqrt(-2.0*log(w)/w));
 }
 
+// As above, but using the worker's random number stream.
+double pf_ran_gaussian_r(double sigma, pf_worker_t *worker)
+{
+  double x1, x2, w, r;
+
+  do
+  {
+    do { r = pf_worker_drand(worker); } while (r==0.0);
+    x1 = 2.0 * r - 1.0;
+    do { r = pf_worker_drand(worker); } while (r==0.0);
+    x2 = 2.0 * r - 1.0;
+    w = x1*x1 + x2*x2;
+  } while(w > 1.0 || w==0.0);
+
+  return(sigma * x2 * sqrt(-2.0*log(w)/w));
+}
+
 #if 0
 
 /**************************************************************************
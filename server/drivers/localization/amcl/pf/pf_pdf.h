@@ -32,6 +32,7 @@
 #define PF_PDF_H
 
 #include "pf_vector.h"
+#include "pf_pool.h"
 
 //#include <gsl/gsl_rng.h>
 //#include <gsl/gsl_randist.h>
@@ -81,6 +82,13 @@ double pf_ran_gaussian(double sigma);
 // Generate a sample from the the pdf.
 pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf);
 
+// As pf_ran_gaussian(), but using the worker's random number stream.
+double pf_ran_gaussian_r(double sigma, pf_worker_t *worker);
+
+// As pf_pdf_gaussian_sample(), but using the worker's random number
+// stream; safe to call from several workers at once.
+pf_vector_t pf_pdf_gaussian_sample_r(pf_pdf_gaussian_t *pdf, pf_worker_t *worker);
+
 
 #if 0
 
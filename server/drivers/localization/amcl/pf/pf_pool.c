@@ -0,0 +1,234 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+/**************************************************************************
+ * Desc: Worker pool for the particle filter updates
+ * CVS: $Id$
+ *************************************************************************/
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <libplayercommon/playercommon.h>
+
+#include "pf_pool.h"
+
+
+// Information for a pool
+typedef struct _pf_pool_t
+{
+  // The workers; worker 0 is run on the calling thread
+  int worker_count;
+  pf_worker_t *workers;
+  pthread_t *threads;
+
+  // The current job
+  pf_pool_fn_t job_fn;
+  void *job_data;
+
+  // Job generation counter; bumped for every new job
+  unsigned int job_gen;
+
+  // Number of workers still running the current job
+  int job_pending;
+
+  // Set when the pool is shutting down
+  int quit;
+
+  pthread_mutex_t lock;
+  pthread_cond_t job_cond;
+  pthread_cond_t done_cond;
+
+} pf_pool_t;
+
+
+// Per-thread arguments
+typedef struct
+{
+  pf_pool_t *pool;
+  pf_worker_t *worker;
+} pf_pool_arg_t;
+
+
+// Worker thread main loop
+static void *pf_pool_main(void *arg);
+
+
+// Create a pool
+pf_pool_t *pf_pool_alloc(int worker_count, unsigned int seed)
+{
+  int i;
+  pf_pool_t *pool;
+  pf_pool_arg_t *arg;
+
+  if (worker_count < 1)
+    worker_count = 1;
+
+  pool = calloc(1, sizeof(pf_pool_t));
+  pool->worker_count = worker_count;
+  pool->workers = calloc(worker_count, sizeof(pf_worker_t));
+  pool->threads = calloc(worker_count, sizeof(pthread_t));
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->job_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  // Seed the per-worker random number streams
+  for (i = 0; i < worker_count; i++)
+  {
+    pool->workers[i].index = i;
+    pool->workers[i].rng[0] = 0x330E;
+    pool->workers[i].rng[1] = (unsigned short) (seed & 0xFFFF);
+    pool->workers[i].rng[2] = (unsigned short) ((seed >> 16) + 0x9E37 * i);
+  }
+
+  // Start the helper threads; worker 0 runs on the caller
+  for (i = 1; i < worker_count; i++)
+  {
+    arg = malloc(sizeof(pf_pool_arg_t));
+    arg->pool = pool;
+    arg->worker = pool->workers + i;
+    if (pthread_create(pool->threads + i, NULL, pf_pool_main, arg) != 0)
+    {
+      // Carry on with the workers that did start; pf_pool_run() only
+      // waits for those
+      PLAYER_WARN2("failed to start particle filter worker %d; using %d workers", i, i);
+      free(arg);
+      pool->worker_count = i;
+      break;
+    }
+  }
+
+  return pool;
+}
+
+
+// Destroy a pool
+void pf_pool_free(pf_pool_t *pool)
+{
+  int i;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->job_cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (i = 1; i < pool->worker_count; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->job_cond);
+  pthread_mutex_destroy(&pool->lock);
+
+  free(pool->threads);
+  free(pool->workers);
+  free(pool);
+  return;
+}
+
+
+// Get the number of workers in the pool
+int pf_pool_worker_count(pf_pool_t *pool)
+{
+  return pool->worker_count;
+}
+
+
+// Run a job on every worker and wait for all of them to finish
+void pf_pool_run(pf_pool_t *pool, pf_pool_fn_t fn, void *job_data)
+{
+  if (pool->worker_count > 1)
+  {
+    pthread_mutex_lock(&pool->lock);
+    assert(pool->job_pending == 0);
+    pool->job_fn = fn;
+    pool->job_data = job_data;
+    pool->job_pending = pool->worker_count - 1;
+    pool->job_gen++;
+    pthread_cond_broadcast(&pool->job_cond);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  // Do our share of the work
+  (*fn) (job_data, pool->workers + 0);
+
+  if (pool->worker_count > 1)
+  {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->job_pending > 0)
+      pthread_cond_wait(&pool->done_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return;
+}
+
+
+// Draw a uniform random number from the worker's stream
+double pf_worker_drand(pf_worker_t *worker)
+{
+#if defined (WIN32)
+  // TODO: this isn't quite the same behaviour: erand48 returns uniformly-distributed values
+  return (double) rand() / ((double) RAND_MAX + 1.0);
+#else
+  return erand48(worker->rng);
+#endif
+}
+
+
+// Worker thread main loop
+void *pf_pool_main(void *varg)
+{
+  pf_pool_arg_t *arg;
+  pf_pool_t *pool;
+  pf_worker_t *worker;
+  unsigned int gen;
+
+  arg = (pf_pool_arg_t*) varg;
+  pool = arg->pool;
+  worker = arg->worker;
+  free(arg);
+
+  gen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  while (1)
+  {
+    while (!pool->quit && pool->job_gen == gen)
+      pthread_cond_wait(&pool->job_cond, &pool->lock);
+    if (pool->quit)
+      break;
+    gen = pool->job_gen;
+    pthread_mutex_unlock(&pool->lock);
+
+    (*pool->job_fn) (pool->job_data, worker);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->job_pending == 0)
+      pthread_cond_signal(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
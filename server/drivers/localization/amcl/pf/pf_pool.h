@@ -0,0 +1,80 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+/**************************************************************************
+ * Desc: Worker pool for the particle filter updates
+ * CVS: $Id$
+ *************************************************************************/
+
+#ifndef PF_POOL_H
+#define PF_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Forward declarations
+struct _pf_pool_t;
+
+
+// Information for a single worker.  Each worker owns its own random
+// number stream, seeded from the pool seed and the worker index, so
+// that the filter output only depends on the seed and the number of
+// workers, and not on the thread scheduling.
+typedef struct
+{
+  // Worker index (0 is the calling thread)
+  int index;
+
+  // Random number generator state (for erand48)
+  unsigned short rng[3];
+
+} pf_worker_t;
+
+
+// Function prototype for a job; called once by every worker.
+typedef void (*pf_pool_fn_t) (void *job_data, pf_worker_t *worker);
+
+
+// Create a pool with the given number of workers (including the
+// calling thread)
+struct _pf_pool_t *pf_pool_alloc(int worker_count, unsigned int seed);
+
+// Destroy a pool
+void pf_pool_free(struct _pf_pool_t *pool);
+
+// Get the number of workers in the pool
+int pf_pool_worker_count(struct _pf_pool_t *pool);
+
+// Run a job on every worker and wait for all of them to finish
+void pf_pool_run(struct _pf_pool_t *pool, pf_pool_fn_t fn, void *job_data);
+
+// Draw a uniform random number in [0, 1) from the worker's stream
+double pf_worker_drand(pf_worker_t *worker);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -69,7 +69,7 @@ ObservedFeatures::~ObservedFeatures()
 {
 }
 
-void ObservedFeatures::AddObservedFeature(Feature f)
+void ObservedFeatures::AddObservedFeature(const Feature &f)
 {
     features_.push_back(f);
     is_paired_.push_back(false);
@@ -92,64 +92,46 @@ const Feature & ObservedFeatures::features(int f) const
     return features_[f];
 }
 
-void IntegrateScanPoint(Uloc segment, Uloc point, MatrixXd &Fk, MatrixXd &Nk)
+void IntegrateScanPoint(const Uloc &segment, const Uloc &point,
+                        Matrix2d &FkTotal, Vector2d &NkTotal)
+// Adds the information of one scan point to the segment totals. This is
+// EIFnn specialised to a scalar measurement (bep = [0 1 0]), so everything
+// stays in fixed-size matrices and the innovation is inverted in closed form.
 {
-    //MatrixXd hk = MatrixXd(0, 0);
-    //MatrixXd Hk = MatrixXd(0, 0);
-    //MatrixXd Gk = MatrixXd(0, 0);
-    //MatrixXd Sk = MatrixXd(0, 0);
-
     const Transf xep = Compose(Inv(segment.kX()), point.kX());
 
-    MatrixXd bep = MatrixXd(1, 3);
-    bep(0, 1) = 1;
-
-    const MatrixXd hp = bep * xep;
-    MatrixXd hk(hp);
-    //hk.Include(hp, 0, 0);
+    const double hk = xep.tY();
 
-    const MatrixXd Hp = -bep * J1zero(xep) * segment.kBind().transpose();
-    MatrixXd Hk(Hp);
-    //Hk.Include(Hp, 0, 0);
+    const RowVector2d Hk = -J1zero(xep).row(1) * segment.kBind().transpose();
+    const RowVector2d Gk =  J2zero(xep).row(1) * point.kBind().transpose();
 
-    const MatrixXd Gp = bep * J2zero(xep) * point.kBind().transpose();
-    MatrixXd Gk(Gp);
-    //Gk.Include(Gp, 0, 0);
+    const MatrixXd &Sk = point.kCov();
+    const double Ak = Gk(0) * (Sk(0, 0) * Gk(0) + Sk(0, 1) * Gk(1)) +
+                      Gk(1) * (Sk(1, 0) * Gk(0) + Sk(1, 1) * Gk(1));
 
-    MatrixXd Sk(point.kCov());
-    //Sk.Include(point.kCov(), 0, 0);
-
-    EIFnn(Hk, Gk, hk, Sk, Fk, Nk);
+    FkTotal += Hk.transpose() * Hk / Ak;
+    NkTotal += Hk.transpose() * (hk / Ak);
 }
 
-void IntegrateScanPoints(Uloc *seg, Scan sTbl, int pFrom, int pEnd, int step)
+void IntegrateScanPoints(Uloc *seg, const Scan &sTbl, int pFrom, int pEnd, int step)
 {
-    MatrixXd FkTotal = MatrixXd(2, 2);
-    MatrixXd NkTotal = MatrixXd(2, 1);
-
-    MatrixXd Nk, Fk;
+    Matrix2d FkTotal = Matrix2d::Zero();
+    Vector2d NkTotal = Vector2d::Zero();
 
     for (int pk = pFrom; pk < pEnd; pk += step)
-    {
-        IntegrateScanPoint(*seg, sTbl.uloc(pk), Fk, Nk);
-        FkTotal = FkTotal + Fk;
-        NkTotal = NkTotal + Nk;
-    }
-
-    IntegrateScanPoint(*seg, sTbl.uloc(pEnd), Fk, Nk);
-    FkTotal = FkTotal + Fk;
-    NkTotal = NkTotal + Nk;
+        IntegrateScanPoint(*seg, sTbl.uloc(pk), FkTotal, NkTotal);
 
-    MatrixXd Mean(FkTotal.rows(), 1);
-    CalculateEstimationEIFnn(FkTotal, NkTotal, Mean, seg->Cov());
+    IntegrateScanPoint(*seg, sTbl.uloc(pEnd), FkTotal, NkTotal);
 
-    seg->Pert()(0, 0) = Mean(0, 0);
-    seg->Pert()(1, 0) = Mean(1, 0);
+    // As CalculateEstimationEIFnn
+    const Matrix2d P = FkTotal.inverse();
+    seg->Cov()  = P;
+    seg->Pert() = -(P * NkTotal);
 
     seg->CenterUloc();
 }
 
-void Feature::GeometricRelationsObservationPointToPoint(Uloc Lsp1, Uloc Lsp2)
+void Feature::GeometricRelationsObservationPointToPoint(const Uloc &Lsp1, const Uloc &Lsp2)
 {
 
     Transf xp1p2 = TRel(Lsp1.kX(), Lsp2.kX());
@@ -167,12 +149,12 @@ void Feature::GeometricRelationsObservationPointToPoint(Uloc Lsp1, Uloc Lsp2)
             Lsp2.kCov()(1, 1) * pow(sin(phi2), 2);
 }
 
-void Feature::ComputeSegmentLength(Uloc pnt1, Uloc pnt2)
+void Feature::ComputeSegmentLength(const Uloc &pnt1, const Uloc &pnt2)
 {
     GeometricRelationsObservationPointToPoint(pnt1, pnt2);
 }
 
-void ComputeSegments(Scan sTbl, const RegionsVector &rTbl, ObservedFeatures *mTbl)
+void ComputeSegments(const Scan &sTbl, const RegionsVector &rTbl, ObservedFeatures *mTbl)
 {
     Feature seg = Feature(EDGE);
     int pFrom, pTo;
@@ -221,9 +203,11 @@ void ComputeSegments(Scan sTbl, const RegionsVector &rTbl, ObservedFeatures *mTb
     }
 }
 
-void ScanDataSegmentation(const Scan &laser_raw_data, ObservedFeatures *feat_table)
+void ScanDataSegmentation(const Scan &laser_raw_data,
+                          ObservedFeatures *feat_table,
+                          SegmentationScratch *scratch)
 {
-    RegionsVector HomRegionsTable;
+    RegionsVector &HomRegionsTable = scratch->regions;
 
     FindHomogeneousRegions(laser_raw_data, &HomRegionsTable);
     IterativeLineFitting(laser_raw_data, &HomRegionsTable);
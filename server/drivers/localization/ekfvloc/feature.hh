@@ -26,6 +26,7 @@
 #define MAX_OBS_FEATURES 100
 
 #include <vector>
+#include "hregions.hh"
 #include "scan.hh"
 #include "types.hh"
 #include "uloc.hh"
@@ -48,13 +49,13 @@ public:
     const Uloc& uloc(void) const { return uloc_; };
     void set_uloc(const Uloc& u) { uloc_ = u; };
 
-    void ComputeSegmentLength(Uloc p1, Uloc p2);
+    void ComputeSegmentLength(const Uloc &p1, const Uloc &p2);
 
     void SetScan(const GuiSplit &split) { split_ = split; };
     // Keep the original raw data for debug
     const GuiSplit &GetScan(void) const { return split_; };
 private:
-    void GeometricRelationsObservationPointToPoint(Uloc Lsp1, Uloc Lsp2);
+    void GeometricRelationsObservationPointToPoint(const Uloc &Lsp1, const Uloc &Lsp2);
 
     double dimension_;
     double codimension_;
@@ -70,18 +71,28 @@ public:
     ObservedFeatures();
     virtual ~ObservedFeatures();
 
-    void AddObservedFeature(Feature f);
+    void AddObservedFeature(const Feature &f);
     int Count() const;
     //void SetPaired(int i, bool b);
     const Feature & features(int f) const;
     
-    void Clear(void) { features_.clear(); }
+    void Clear(void) { features_.clear(); is_paired_.clear(); }
     
 private:
     vector<Feature> features_;
     vector<bool>    is_paired_;
 };
 
-void ScanDataSegmentation(const Scan &laser_raw_data, ObservedFeatures *feat_table);
+/// Working storage for the segmentation. The owner keeps one alive between
+/// scans so that the region tables are not reallocated every time.
+class SegmentationScratch
+{
+public:
+    RegionsVector regions;
+};
+
+void ScanDataSegmentation(const Scan &laser_raw_data,
+                          ObservedFeatures *feat_table,
+                          SegmentationScratch *scratch);
 
 #endif /* FEATURE_H_ */
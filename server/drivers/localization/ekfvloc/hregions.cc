@@ -55,7 +55,7 @@ double randomNormal(double mean, double stdDev)
     return (((sum - half_sum) / dt_sum * stdDev) + mean);
 }
 
-double computeLengthHRegion(Scan s, int from, int to)
+double computeLengthHRegion(const Scan &s, int from, int to)
 // Computes the distance between the extremes of the HRegion
 {
     const Transf x12 = TRel(s.uloc(from).kX(), s.uloc(to).kX());
@@ -69,12 +69,21 @@ HRegion::HRegion(const Scan &s, int idxFrom, int idxTo) : scan_(&s)
     endpoints_.push_back(Endpoint(s, idxTo));
 }
 
+void HRegion::Reset(const Scan &s, int idxFrom, int idxTo)
+{
+    scan_ = &s;
+    endpoints_.clear();
+    endpoints_.push_back(Endpoint(s, idxFrom));
+    endpoints_.push_back(Endpoint(s, idxTo));
+}
+
 void FindHomogeneousRegions(const Scan &s, RegionsVector *r)
 {
 
     int    from, to;
+    size_t count = 0;
 
-    r->clear(); // RG_LEN   (*r)             = 0;
+    // RG_LEN   (*r)             = 0;
     // RG_NUM_EP(*r, RG_LEN(*r)) = 0;
 
     for (int k = 0; k < s.ScanCount(); /* below */)
@@ -93,7 +102,11 @@ void FindHomogeneousRegions(const Scan &s, RegionsVector *r)
         const double len = computeLengthHRegion(s, from, to);
         if ((len > kMinRegionLength) && (to - from > kMinPointsInRegion))
         {
-            r->push_back(HRegion(s, from, to));
+            if (count < r->size())
+                (*r)[count].Reset(s, from, to);
+            else
+                r->push_back(HRegion(s, from, to));
+            count++;
             // RG_NUM_EP(*r, RG_LEN(*r)) = 2;
             // RG_FROM  (*r, RG_LEN(*r)) = from;
             // RG_TO    (*r, RG_LEN(*r)) = to;
@@ -101,9 +114,11 @@ void FindHomogeneousRegions(const Scan &s, RegionsVector *r)
         }
         k++;
     }
+
+    r->erase(r->begin() + count, r->end());
 }
 
-int farthestPointToEdge(Scan s,
+int farthestPointToEdge(const Scan &s,
                         int from,
                         int to,
                         double *maxd2,
@@ -140,7 +155,7 @@ int farthestPointToEdge(Scan s,
     return bp;
 }
 
-double calculateResidual(Scan s, int from, int to)
+double calculateResidual(const Scan &s, int from, int to)
 /* Calculates the residual*/
 {
     Uloc Lse = integrateEndpointsInEdge(s.uloc(from), s.uloc(to));
@@ -152,7 +167,7 @@ double calculateResidual(Scan s, int from, int to)
     return r;
 }
 
-bool verifyResidualConditions(Scan s, int from, int to, int bp, double r)
+bool verifyResidualConditions(const Scan &s, int from, int to, int bp, double r)
 {
     /* Verifies whether the new edge improves the representation    */
 
@@ -164,7 +179,7 @@ bool verifyResidualConditions(Scan s, int from, int to, int bp, double r)
     return (r >= (r1 + r2));
 }
 
-bool verifyEndPointsAlignment(Scan s, int from, int to, int bp, double maxAngle)
+bool verifyEndPointsAlignment(const Scan &s, int from, int to, int bp, double maxAngle)
 /* Verifies whether the detected endpoint is aligned with the endpoints */
 {
     double x1, y1, xb, yb, x2, y2, phi;
@@ -183,7 +198,7 @@ bool verifyEndPointsAlignment(Scan s, int from, int to, int bp, double maxAngle)
     return (fabs(phi) >= maxAngle);
 }
 
-double computeDistanceEndPoints(Scan s, int from, int to)
+double computeDistanceEndPoints(const Scan &s, int from, int to)
 // Computes the distance between two endpoints
 {
     Transf x12 = TRel(s.uloc(from).kX(), s.uloc(to).kX());
@@ -81,6 +81,9 @@ class HRegion
 public:
     HRegion(const Scan &s, int idxFrom, int idxTo);
     virtual ~HRegion() {}
+
+    /// Reinitialize in place, keeping the endpoint storage
+    void Reset(const Scan &s, int idxFrom, int idxTo);
     
     const int NumEps(void) const { return endpoints_.size(); }
     const Endpoint &Ep(int i) const { return endpoints_.at(i); }
@@ -121,6 +124,8 @@ typedef std::vector<HRegion> RegionsVector;
 #define HRP_MAX_EBE_ANG(p)		((p).maxAngEBE)
 */
 
+/// Regions already in r are reused, so passing the same vector for every
+/// scan avoids reallocating the endpoint tables.
 void FindHomogeneousRegions(const Scan &s, RegionsVector *r);
 void IterativeLineFitting(const Scan &s, RegionsVector *r);
 
@@ -51,7 +51,7 @@ void RobotLocation::SetPoses(double ox, double oy, double oth,
 void RobotLocation::SetCurrentError(double ex, double ey, double eth)
 {
 
-    MatrixXd cov = MatrixXd(3, 3);
+    MatrixXd cov = MatrixXd::Zero(3, 3);
     cov(0, 0) = pow(ex / 2, 2);
     cov(1, 1) = pow(ey / 2, 2);
     cov(2, 2) = pow(eth / 2, 2);
@@ -70,12 +70,12 @@ void RobotLocation::Prediction()
     d = sqrt((Xrk_1rk.tX() * Xrk_1rk.tX()) +
              (Xrk_1rk.tY() * Xrk_1rk.tY()));
 
-    MatrixXd Crk_1rk = MatrixXd(3, 3);
+    Matrix3d Crk_1rk = Matrix3d::Zero();
     Crk_1rk(0, 0)  = pow(sx * d, 2);
     Crk_1rk(1, 1)  = pow(sy * d, 2);
     Crk_1rk(2, 2)  = pow(sphi * Xrk_1rk.tPhi(), 2);
 
-    const MatrixXd JRkRk_1 = InvJacobian(Xrk_1rk);
+    const Matrix3d JRkRk_1 = InvJacobian(Xrk_1rk);
 
     XwRk.SetLoc(Compose(XwRk_1.kX(), Xrk_1rk));
     XwRk.SetCov(JRkRk_1 * XwRk_1.kCov() * JRkRk_1.transpose() + Crk_1rk);
@@ -90,74 +90,66 @@ bool verifyOverlapping(Transf XME, double mLen, double eLen)
 double MahalaDist(const Uloc &robot, const Feature &obs, const Transf &feat,
         Transf *Xme)
 {
-    MatrixXd Bme = MatrixXd(2, 3);
-    Bme(0, 1)  = 1;
-    Bme(1, 2)  = 1;
-
-    const Transf Xre = obs.Loc();
-    const MatrixXd Ce  = obs.Cov();
+    const Transf &Xre = obs.Loc();
+    const Matrix2d Ce  = obs.Cov();
 
     const Transf &Xwm = feat;
     *Xme = TRel(Xwm, Compose(robot.kX(), Xre));
 
+    // Bme selects the (y, phi) rows
     // Compute h
-    const MatrixXd h = Bme * (*Xme);
+    const Vector2d h = Xme->block<2, 1>(1, 0);
 
     // Compute HR
-    const MatrixXd Jer = InvJacobian(Xre);
-    const MatrixXd J2  = J2zero(*Xme);
-    const MatrixXd HR  = Bme * J2 * Jer;
+    const Matrix3d Jer = InvJacobian(Xre);
+    const Matrix3d J2  = J2zero(*Xme);
+    const Matrix<double, 2, 3> HR = J2.bottomRows<2>() * Jer;
 
     // Compute GE
-    const MatrixXd GE = Bme * J2 * Bme.transpose();
+    const Matrix2d GE = J2.bottomRightCorner<2, 2>();
 
     // Hypothesis test -> Mahalanobis distance
-    MatrixXd Cinn = (HR * robot.kCov() * (HR.transpose()) + GE * Ce * (GE.transpose())).inverse();
-    MatrixXd d2   = (h.transpose()) * Cinn * h;
+    const Matrix3d Cr = robot.kCov();
+    const Matrix2d Cinn = (HR * Cr * HR.transpose() + GE * Ce * GE.transpose()).inverse();
 
-    return d2(0, 0);
+    return h.dot(Cinn * h);
 }
 
 void UpdateWithMatch(Uloc *XwRk, const Feature &obs, const Transf &feat)
 {
-    MatrixXd Bme = MatrixXd(2, 3);
-    Bme(0, 1)  = 1;
-    Bme(1, 2)  = 1;
-
-    const Transf Xre = obs.Loc();
-    const MatrixXd Ce  = obs.Cov();
+    const Transf &Xre = obs.Loc();
+    const Matrix2d Ce  = obs.Cov();
 
     const Transf &Xwm = feat;
     const Transf Xme = TRel(Xwm, Compose(XwRk->kX(), Xre));
 
-    const MatrixXd h = Bme * Xme;
+    // Bme selects the (y, phi) rows
+    const Vector2d h = Xme.block<2, 1>(1, 0);
 
-    const MatrixXd Jer = InvJacobian(Xre);
-    const MatrixXd J2  = J2zero(Xme);
-    const MatrixXd HR  = Bme * J2 * Jer;
+    const Matrix3d Jer = InvJacobian(Xre);
+    const Matrix3d J2  = J2zero(Xme);
+    const Matrix<double, 2, 3> HR = J2.bottomRows<2>() * Jer;
 
-    const MatrixXd GE = Bme * J2 * Bme.transpose();
+    const Matrix2d GE = J2.bottomRightCorner<2, 2>();
 
-    MatrixXd Cinn = (HR * XwRk->kCov() * (HR.transpose()) + GE * Ce * (GE.transpose())).inverse();
+    const Matrix3d Cr = XwRk->kCov();
+    const Matrix2d Cinn = (HR * Cr * HR.transpose() + GE * Ce * GE.transpose()).inverse();
 
-    MatrixXd K  = XwRk->kCov() * HR.transpose() * Cinn;
-    MatrixXd Xk = -K * h;
+    const Matrix<double, 3, 2> K = Cr * HR.transpose() * Cinn;
+    const Transf Xk(-K * h);
 
-    const MatrixXd P = XwRk->kCov() - K * HR * XwRk->kCov();
+    const Matrix3d P = Cr - K * HR * Cr;
 
     //Centering
+    const Matrix3d InvJ2k = InvJ2zero(Xk);
     XwRk->SetLoc(Compose(XwRk->kX(), Xk));
-    XwRk->SetCov(InvJ2zero(Xk) * P * InvJ2zero(Xk).transpose());
+    XwRk->SetCov(InvJ2k * P * InvJ2k.transpose());
 }
 
-void RobotLocation::Update(ObservedFeatures obs)
+void RobotLocation::Update(const ObservedFeatures &obs)
 {
     int matched = 0;
 
-    MatrixXd Bme = MatrixXd(2, 3);
-    Bme(0, 1)  = 1;
-    Bme(1, 2)  = 1;
-
     //  Match obs, in scan order, to the closest feature
 
     for (int i = 0; i < obs.Count(); i++)
@@ -336,7 +328,7 @@ void RobotLocation::Update(ObservedFeatures obs)
         PLAYER_WARN("Ekfvloc: No matching features!");
 }
 
-bool RobotLocation::Locate(const Transf odom, const Scan s)
+bool RobotLocation::Locate(const Transf &odom, const Scan &s)
 {
 //     if ((X(odom)   != X(odomk_1)) ||
 //         (Y(odom)   != Y(odomk_1)) ||
@@ -351,11 +343,10 @@ bool RobotLocation::Locate(const Transf odom, const Scan s)
         Prediction();
 
         //SEGMENTACION
-        ObservedFeatures obs;
-        ScanDataSegmentation(s, &obs);
+        ScanDataSegmentation(s, &obs_, &scratch_);
 
         //Matching & EKF
-        Update(obs);
+        Update(obs_);
 
         const Transf rel(TRel(odomk_1, odom));
         PLAYER_MSG3(8, "REL[1]: %8.3f %8.3f %8.3f\n", rel.tX(), rel.tY(), rel.tPhi());
@@ -49,7 +49,7 @@ public:
 
 	// Usage
 
-	bool Locate(const Transf odom, const Scan s); // true if performed
+	bool Locate(const Transf &odom, const Scan &s); // true if performed
 	void PrintState() const;
 
 	Pose   EstimatedPose(void) const;
@@ -61,7 +61,7 @@ public:
     const double odom_noise_th_;
 private:
 	void Prediction();
-	void Update(ObservedFeatures obs);
+	void Update(const ObservedFeatures &obs);
 
 	Uloc XwRk_1;
     Uloc XwRk;
@@ -69,6 +69,10 @@ private:
     Transf odomk;
     SegmentMap map_;
 
+    // Reused from scan to scan
+    SegmentationScratch scratch_;
+    ObservedFeatures obs_;
+
     bool first_update_;
 };
 
@@ -23,7 +23,7 @@
 #include "sub_opt.hh"
 
 
-void CalculateEstimationEIFnn(MatrixXd Fk, MatrixXd Nk, MatrixXd &x, MatrixXd &P){
+void CalculateEstimationEIFnn(const MatrixXd &Fk, const MatrixXd &Nk, MatrixXd &x, MatrixXd &P){
 
 	P = Fk.inverse();
 	x = P * Nk;
@@ -32,7 +32,7 @@ void CalculateEstimationEIFnn(MatrixXd Fk, MatrixXd Nk, MatrixXd &x, MatrixXd &P
 		x(i,0) *= -1;
 }
 
-void EIFnn(MatrixXd H, MatrixXd G, MatrixXd h, MatrixXd S, MatrixXd &F, MatrixXd &N){
+void EIFnn(const MatrixXd &H, const MatrixXd &G, const MatrixXd &h, const MatrixXd &S, MatrixXd &F, MatrixXd &N){
 
 	MatrixXd R = H.transpose() * (G * S * G.transpose()).inverse();
 
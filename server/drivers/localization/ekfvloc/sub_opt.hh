@@ -25,7 +25,7 @@
 
 #include "transf.hh"
 
-void EIFnn(MatrixXd H, MatrixXd G, MatrixXd h, MatrixXd S, MatrixXd &F, MatrixXd &N);
-void CalculateEstimationEIFnn(MatrixXd Fk, MatrixXd Nk, MatrixXd &x, MatrixXd &P);
+void EIFnn(const MatrixXd &H, const MatrixXd &G, const MatrixXd &h, const MatrixXd &S, MatrixXd &F, MatrixXd &N);
+void CalculateEstimationEIFnn(const MatrixXd &Fk, const MatrixXd &Nk, MatrixXd &x, MatrixXd &P);
 
 #endif /* SUB_OPT_H_ */
@@ -26,7 +26,7 @@
 #include "transf.hh"
 
 Transf::Transf() :
-        MatrixXd(3, 1)
+        MatrixXd(MatrixXd::Zero(3, 1))
 {
 }
 
@@ -38,7 +38,7 @@ Transf::Transf(double x, double y, double phi) :
     operator()(2, 0) = phi;
 }
 
-Transf::Transf(MatrixXd &m) :
+Transf::Transf(const MatrixXd &m) :
         MatrixXd(3, 1)
 {
     if ((m.rows() != 3) or(m.cols() != 1))
@@ -105,7 +105,7 @@ double Normalize(double p)
     return result;
 }
 
-Transf Compose(Transf Tab, Transf Tbc)
+Transf Compose(const Transf &Tab, const Transf &Tbc)
 {
     Transf Tac;
 
@@ -122,7 +122,7 @@ Transf Compose(Transf Tab, Transf Tbc)
     return Tac;
 }
 
-Transf Inv(Transf Tab)
+Transf Inv(const Transf &Tab)
 {
     Transf Tba;
     Tba.x() = -Tab.tY() * sin(Tab.tPhi()) -
@@ -136,14 +136,14 @@ Transf Inv(Transf Tab)
     return Tba;
 }
 
-Transf TRel(Transf Twa, Transf Twb)
+Transf TRel(const Transf &Twa, const Transf &Twb)
 {
     return Compose(Inv(Twa), Twb);
 }
 
-MatrixXd Jacobian(Transf Tab)
+Matrix3d Jacobian(const Transf &Tab)
 {
-    MatrixXd Jab(3, 3);
+    Matrix3d Jab;
 
     Jab(0, 0) =  cos(Tab.tPhi());
     Jab(0, 1) = -sin(Tab.tPhi());
@@ -158,9 +158,9 @@ MatrixXd Jacobian(Transf Tab)
     return Jab;
 }
 
-MatrixXd InvJacobian(Transf Tab)
+Matrix3d InvJacobian(const Transf &Tab)
 {
-    MatrixXd Jba(3, 3);
+    Matrix3d Jba;
 
     Jba(0, 0) =  cos(Tab.tPhi());
     Jba(0, 1) =  sin(Tab.tPhi());
@@ -175,9 +175,9 @@ MatrixXd InvJacobian(Transf Tab)
     return Jba;
 }
 
-MatrixXd J1(Transf Ta, Transf Tb)
+Matrix3d J1(const Transf &Ta, const Transf &Tb)
 {
-    MatrixXd J1(3, 3);
+    Matrix3d J1;
 
     J1(0, 0) =  1;
     J1(0, 1) =  0;
@@ -192,9 +192,9 @@ MatrixXd J1(Transf Ta, Transf Tb)
     return J1;
 }
 
-MatrixXd InvJ1(Transf Ta, Transf Tb)
+Matrix3d InvJ1(const Transf &Ta, const Transf &Tb)
 {
-    MatrixXd InvJ1(3, 3);
+    Matrix3d InvJ1;
 
     InvJ1(0, 0) =  1;
     InvJ1(0, 1) =  0;
@@ -209,9 +209,9 @@ MatrixXd InvJ1(Transf Ta, Transf Tb)
     return InvJ1;
 }
 
-MatrixXd J1zero(Transf Ta)
+Matrix3d J1zero(const Transf &Ta)
 {
-    MatrixXd J1z(3, 3);
+    Matrix3d J1z;
 
     J1z(0, 0) =  1;
     J1z(0, 1) =  0;
@@ -226,9 +226,9 @@ MatrixXd J1zero(Transf Ta)
     return J1z;
 }
 
-MatrixXd InvJ1zero(Transf Ta)
+Matrix3d InvJ1zero(const Transf &Ta)
 {
-    MatrixXd InvJ1z(3, 3);
+    Matrix3d InvJ1z;
 
     InvJ1z(0, 0) =  1;
     InvJ1z(0, 1) =  0;
@@ -243,9 +243,9 @@ MatrixXd InvJ1zero(Transf Ta)
     return InvJ1z;
 }
 
-MatrixXd J2(Transf Ta, Transf Tb)
+Matrix3d J2(const Transf &Ta, const Transf &Tb)
 {
-    MatrixXd J2(3, 3);
+    Matrix3d J2;
 
     J2(0, 0) =  cos(Ta.tPhi());
     J2(0, 1) = -sin(Ta.tPhi());
@@ -260,9 +260,9 @@ MatrixXd J2(Transf Ta, Transf Tb)
     return J2;
 }
 
-MatrixXd InvJ2(Transf Ta, Transf Tb)
+Matrix3d InvJ2(const Transf &Ta, const Transf &Tb)
 {
-    MatrixXd InvJ2(3, 3);
+    Matrix3d InvJ2;
 
     InvJ2(0, 0) =  cos(Ta.tPhi());
     InvJ2(0, 1) =  sin(Ta.tPhi());
@@ -277,9 +277,9 @@ MatrixXd InvJ2(Transf Ta, Transf Tb)
     return InvJ2;
 }
 
-MatrixXd J2zero(Transf Ta)
+Matrix3d J2zero(const Transf &Ta)
 {
-    MatrixXd J2z(3, 3);
+    Matrix3d J2z;
 
     J2z(0, 0) =  cos(Ta.tPhi());
     J2z(0, 1) = -sin(Ta.tPhi());
@@ -296,9 +296,9 @@ MatrixXd J2zero(Transf Ta)
     return J2z;
 }
 
-MatrixXd InvJ2zero(Transf Ta)
+Matrix3d InvJ2zero(const Transf &Ta)
 {
-    MatrixXd InvJ2z(3, 3);
+    Matrix3d InvJ2z;
 
     InvJ2z(0, 0) =  cos(Ta.tPhi());
     InvJ2z(0, 1) =  sin(Ta.tPhi());
@@ -39,7 +39,7 @@ public:
 	//Constructor and destructor
 	Transf();
 	Transf(double x, double y, double phi);
-	Transf(MatrixXd &m);
+	Transf(const MatrixXd &m);
 	virtual ~Transf();
 
 	//////////////
@@ -58,19 +58,21 @@ public:
     double Distance(const Transf &b) const;
 };
 
-Transf Compose(Transf Tab, Transf Tbc);
-Transf Inv(Transf Tab);
-Transf TRel(Transf Twa, Transf Twb);
-MatrixXd Jacobian (Transf Tab);
-MatrixXd InvJacobian (Transf Tab);
-MatrixXd J1 (Transf Ta, Transf Tb);
-MatrixXd InvJ1 (Transf Ta, Transf Tb);
-MatrixXd J1zero (Transf Ta);
-MatrixXd InvJ1zero (Transf Ta);
-MatrixXd J2 (Transf Ta, Transf Tb);
-MatrixXd InvJ2 (Transf Ta, Transf Tb);
-MatrixXd J2zero (Transf Ta);
-MatrixXd InvJ2zero (Transf Ta);
+// The Jacobians are fixed-size so that they live on the stack; they mix
+// freely with MatrixXd in expressions.
+Transf Compose(const Transf &Tab, const Transf &Tbc);
+Transf Inv(const Transf &Tab);
+Transf TRel(const Transf &Twa, const Transf &Twb);
+Matrix3d Jacobian (const Transf &Tab);
+Matrix3d InvJacobian (const Transf &Tab);
+Matrix3d J1 (const Transf &Ta, const Transf &Tb);
+Matrix3d InvJ1 (const Transf &Ta, const Transf &Tb);
+Matrix3d J1zero (const Transf &Ta);
+Matrix3d InvJ1zero (const Transf &Ta);
+Matrix3d J2 (const Transf &Ta, const Transf &Tb);
+Matrix3d InvJ2 (const Transf &Ta, const Transf &Tb);
+Matrix3d J2zero (const Transf &Ta);
+Matrix3d InvJ2zero (const Transf &Ta);
 double spAtan2 (double y, double x);
 double Normalize (double p);
 
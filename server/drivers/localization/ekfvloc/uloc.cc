@@ -27,24 +27,24 @@ Uloc::Uloc(GeometricEntityKinds ge) {
     x_ = Transf();
     entity = ge;
     if (ge == POINT) {
-        b_ = MatrixXd(2, 3);
+        b_ = MatrixXd::Zero(2, 3);
         b_(0, 0) = 1;
         b_(1, 1) = 1;
-        p_ = MatrixXd(2, 1);
-        c_ = MatrixXd(2, 2);
+        p_ = MatrixXd::Zero(2, 1);
+        c_ = MatrixXd::Zero(2, 2);
     }
     else if (ge == EDGE) {
-        b_ = MatrixXd(2, 3);
+        b_ = MatrixXd::Zero(2, 3);
         b_(0, 1) = 1;
         b_(1, 2) = 1;
-        p_ = MatrixXd(2, 1);
-        c_ = MatrixXd(2, 2);
+        p_ = MatrixXd::Zero(2, 1);
+        c_ = MatrixXd::Zero(2, 2);
     }
     else if (ge == ROBOT) {
         b_ = MatrixXd(3, 3);
         b_.setIdentity();
-        p_ = MatrixXd(3, 1);
-        c_ = MatrixXd(3, 3);
+        p_ = MatrixXd::Zero(3, 1);
+        c_ = MatrixXd::Zero(3, 3);
     }
     else {
         std::cerr << "Uloc: Undefined entity name\n";
@@ -56,23 +56,23 @@ Uloc::~Uloc() {
     // TODO Auto-generated destructor stub
 }
 
-GeometricEntityKinds Uloc::uGEntity() {
+GeometricEntityKinds Uloc::uGEntity() const {
     return entity;
 }
 
-void Uloc::SetLoc(Transf loc) {
+void Uloc::SetLoc(const Transf &loc) {
     x_ = loc;
 }
 
-void Uloc::SetPert(MatrixXd pert) {
+void Uloc::SetPert(const MatrixXd &pert) {
     p_ = pert;
 }
 
-void Uloc::SetBind(MatrixXd bind) {
+void Uloc::SetBind(const MatrixXd &bind) {
     b_ = bind;
 }
 
-void Uloc::SetCov(MatrixXd cov) {
+void Uloc::SetCov(const MatrixXd &cov) {
     c_ = cov;
 }
 
@@ -82,13 +82,13 @@ Transf Uloc::DifferentialLocation() {
     return Transf(df);
 }
 
-Uloc inverse_uloc(Uloc Lab) {
+Uloc inverse_uloc(const Uloc &Lab) {
     Uloc Lba(Lab.uGEntity());
 
     Lba.SetLoc (Inv(Lab.kX()));
     Lba.SetBind(Lab.kBind());
 
-    MatrixXd Jab = Jacobian(Lab.kX());
+    Matrix3d Jab = Jacobian(Lab.kX());
     MatrixXd J   = Lba.kBind() * Jab * Lba.kBind().transpose();
 
     Lba.SetPert(J * Lab.kPert());
@@ -107,15 +107,10 @@ void Uloc::CenterUloc() {
     MatrixXd D = b_ * InvJ2zero(de) * b_.transpose();
     c_ = D * c_ * D.transpose();
 
-    if (entity == POINT)
-        p_ = MatrixXd(2, 1);
-    if (entity == EDGE)
-        p_ = MatrixXd(2, 1);
-    if (entity == ROBOT)
-        p_ = MatrixXd(3, 1);
+    p_.setZero();
 }
 
-Uloc compose_uloc_transf(Uloc Lwf, Transf Xfe) {
+Uloc compose_uloc_transf(const Uloc &Lwf, const Transf &Xfe) {
     // Chages the associated reference of Lwf, as given by Xfe, giving Lwe.
 
     Uloc Lwe(Lwf.uGEntity());
@@ -128,7 +123,7 @@ Uloc compose_uloc_transf(Uloc Lwf, Transf Xfe) {
     return Lwe;
 }
 
-Uloc compose_uloc(Uloc Lwf, Uloc Lfe) {
+Uloc compose_uloc(const Uloc &Lwf, const Uloc &Lfe) {
     // Composes two (independent!) uncertain locations Lwf and Lfe, giving Lwe.
     Uloc Lwe(Lwf.uGEntity());
     Lwe.Loc() = Compose(Lwf.kX(), Lfe.kX());
@@ -140,7 +135,7 @@ Uloc compose_uloc(Uloc Lwf, Uloc Lfe) {
     return Lwe;
 }
 
-Uloc compose_transf_uloc(Transf Xwf, Uloc Lfe) {
+Uloc compose_transf_uloc(const Transf &Xwf, const Uloc &Lfe) {
     //Changes the base reference of Lfe as indicated by Xwf, giving Lwe.
 
     Uloc Lwe(Lfe.uGEntity());
@@ -152,7 +147,7 @@ Uloc compose_transf_uloc(Transf Xwf, Uloc Lfe) {
     return Lwe;
 }
 
-double mahalanobis_distance_edge_point(Uloc Lwe, Uloc Lwp) {
+double mahalanobis_distance_edge_point(const Uloc &Lwe, const Uloc &Lwp) {
 
     Transf xep = TRel(Lwe.kX(), Lwp.kX());
 
@@ -165,7 +160,7 @@ double mahalanobis_distance_edge_point(Uloc Lwe, Uloc Lwp) {
               );
 }
 
-Uloc CalculateAnalyticalEdge(Transf xp1, Transf xp2) {
+Uloc CalculateAnalyticalEdge(const Transf &xp1, const Transf &xp2) {
     // Estimates the reference attached to an edge from two of its points with the x-axis pointing from p1 to p2
 
     Uloc Lse = Uloc(EDGE);
@@ -178,10 +173,10 @@ Uloc CalculateAnalyticalEdge(Transf xp1, Transf xp2) {
     return Lse;
 }
 
-void information_filter(MatrixXd Hk,
-                        MatrixXd Gk,
-                        MatrixXd hk,
-                        MatrixXd Sk,
+void information_filter(const MatrixXd &Hk,
+                        const MatrixXd &Gk,
+                        const MatrixXd &hk,
+                        const MatrixXd &Sk,
                         MatrixXd &Fk,
                         MatrixXd &Nk) {
     // Calculates de information matrix Fk, and related contribution Nk for the data.
@@ -193,59 +188,56 @@ void information_filter(MatrixXd Hk,
     Nk = Ck * hk;
 }
 
-void integrate_laserpoint_on_laseredge(Uloc Lre,
-                                       Uloc Lrp,
-                                       MatrixXd &Fk,
-                                       MatrixXd &Nk) {
-    // Filter Subfeature (LaserPoint) Feature (LaserEdge) Direct
+static void integrate_laserpoint_on_laseredge(const Uloc &Lre,
+                                              const Uloc &Lrp,
+                                              Matrix2d &Q,
+                                              Vector2d &N) {
+    // Filter Subfeature (LaserPoint) Feature (LaserEdge) Direct, adding the
+    // information matrix and vector of the point to Q and N. The measurement
+    // is scalar, so the innovation covariance is inverted in closed form.
 
     Transf xep = TRel(Lre.kX(), Lrp.kX());
-    MatrixXd hk  = MatrixXd(1, 1);
-    hk(0, 0)   = xep.y();
-    MatrixXd Hk  = MatrixXd(1, 2);
-    Hk(0, 0)   = -1;
-    Hk(0, 1)   = -xep.x();
-    MatrixXd Gk  = MatrixXd(1, 2);
-    Gk(0, 0)   = sin(xep.phi());
-    Gk(0, 1)   = cos(xep.phi());
-
-    information_filter(Hk, Gk, hk, Lrp.kCov(), Fk, Nk);
-}
+    double hk  = xep.y();
+    RowVector2d Hk(-1, -xep.x());
+    RowVector2d Gk(sin(xep.phi()), cos(xep.phi()));
 
-void calculate_estimation(MatrixXd Q, MatrixXd N, MatrixXd &P, MatrixXd &X) {
-    P = Q.inverse();
-    X = P * N.transpose();
+    const MatrixXd &Sk = Lrp.kCov();
+    double Ak = Gk(0) * (Sk(0, 0) * Gk(0) + Sk(0, 1) * Gk(1)) +
+                Gk(1) * (Sk(1, 0) * Gk(0) + Sk(1, 1) * Gk(1));
+
+    Q += Hk.transpose() * Hk / Ak;
+    N += Hk.transpose() * (hk / Ak);
 }
 
-Uloc integrateEndpointsInEdge(Uloc Lsp1, Uloc Lsp2) {
+Uloc integrateEndpointsInEdge(const Uloc &Lsp1, const Uloc &Lsp2) {
     //Computes an uncertain edge from two uncertain points
 
     Uloc Lse = CalculateAnalyticalEdge(Lsp1.kX(), Lsp2.kX());
-    MatrixXd Fk, Nk, Q, N;
+    Matrix2d Q = Matrix2d::Zero();
+    Vector2d N = Vector2d::Zero();
 
     integrate_laserpoint_on_laseredge(Lse, Lsp1, Q, N);
-    integrate_laserpoint_on_laseredge(Lse, Lsp2, Fk, Nk);
-
-    Q += Fk;//Q = Fk + Q;
-    N += Nk;//N = Nk + N;
+    integrate_laserpoint_on_laseredge(Lse, Lsp2, Q, N);
 
-    calculate_estimation(Q, N, Lse.Cov(), Lse.Pert());
+    Matrix2d P = Q.inverse();
+    Lse.Cov()  = P;
+    Lse.Pert() = P * N;
     Lse.CenterUloc();
 
     return Lse;
 }
 
-void estimate_relative_location(Uloc Lwe, Uloc Lwm, Transf &Xem, MatrixXd &Cem) {
+void estimate_relative_location(const Uloc &Lwe, const Uloc &Lwm, Transf &Xem, MatrixXd &Cem) {
 
     Xem = Compose(Inv(Lwe.kX()), Lwm.kX());
-    MatrixXd Ja = J1zero(Xem);
-    MatrixXd Jb = J2zero(Xem);
-    MatrixXd Ca = Ja * Lwe.kBind().transpose() * Lwe.kCov() * Lwe.kBind() * Ja.transpose();
-    MatrixXd Cb = Jb * Lwm.kBind().transpose() * Lwm.kCov() * Lwm.kBind() * Jb.transpose();
+    Matrix3d Ja = J1zero(Xem);
+    Matrix3d Jb = J2zero(Xem);
+    Matrix3d Ca = Ja * Lwe.kBind().transpose() * Lwe.kCov() * Lwe.kBind() * Ja.transpose();
+    Matrix3d Cb = Jb * Lwm.kBind().transpose() * Lwm.kCov() * Lwm.kBind() * Jb.transpose();
     Cem = Ca + Cb;
 }
 
-double mahalanobis_distance(Uloc Lwa, Uloc Lwb, MatrixXd Bab) {
+double mahalanobis_distance(const Uloc &Lwa, const Uloc &Lwb, const MatrixXd &Bab) {
     Transf Xab;
     MatrixXd Cab;
 
@@ -258,22 +250,22 @@ double mahalanobis_distance(Uloc Lwa, Uloc Lwb, MatrixXd Bab) {
     return d(0, 0);
 }
 
-void Uloc::ChangeBinding(MatrixXd newb) {
+void Uloc::ChangeBinding(const MatrixXd &newb) {
 
     c_ = newb * b_.transpose() * c_ * b_ * newb.transpose();
     p_ = newb * DifferentialLocation();
     b_ = newb;
 }
 
-void Uloc::FilterFeatureRobotDirect(Uloc Lre,
-                                       Transf Xmw,
+void Uloc::FilterFeatureRobotDirect(const Uloc &Lre,
+                                       const Transf &Xmw,
                                        MatrixXd &Fk,
                                        MatrixXd &Nk) {
     //El (This) es Lwr
 
     Transf Xmr = Compose(Xmw, x_);
     Transf Xme = Compose(Xmr, Lre.kX());
-    MatrixXd Be = Lre.kBind();
+    const MatrixXd &Be = Lre.kBind();
 
     MatrixXd hk = Be * Xme;
     MatrixXd Hk = (Be * J1zero(Xme) * Be.transpose()) * (Be * Jacobian(Xmr));
@@ -296,7 +288,7 @@ void integrate_innovation(MatrixXd Fk,
     Xk = Pk * (Q * X - Nk);
 }
 
-void Uloc::IntegrateEdge(Uloc Lre, Transf Xma) {
+void Uloc::IntegrateEdge(const Uloc &Lre, const Transf &Xma) {
 
     MatrixXd Fk, Nk;
 
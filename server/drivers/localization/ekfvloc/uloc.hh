@@ -37,7 +37,7 @@ public:
 	Uloc(GeometricEntityKinds ge);
 	virtual ~Uloc();
 
-	GeometricEntityKinds uGEntity();
+	GeometricEntityKinds uGEntity() const;
 
 	MatrixXd& Loc()  { return x_; };
 	MatrixXd& Pert() { return p_; };
@@ -49,16 +49,16 @@ public:
 	const MatrixXd& kBind() const { return b_; };
 	const MatrixXd& kCov()  const { return c_; };
 
-	void SetLoc(Transf loc);
-	void SetPert(MatrixXd pert);
-	void SetBind(MatrixXd bind);
-	void SetCov(MatrixXd cov);
+	void SetLoc(const Transf &loc);
+	void SetPert(const MatrixXd &pert);
+	void SetBind(const MatrixXd &bind);
+	void SetCov(const MatrixXd &cov);
 
 	void CenterUloc ();
 	Transf DifferentialLocation ();
-	void ChangeBinding (MatrixXd newb);
-	void FilterFeatureRobotDirect (Uloc Lre, Transf Xmw, MatrixXd &Fk, MatrixXd &Nk);
-	void IntegrateEdge (Uloc Lre, Transf Xma);
+	void ChangeBinding (const MatrixXd &newb);
+	void FilterFeatureRobotDirect (const Uloc &Lre, const Transf &Xmw, MatrixXd &Fk, MatrixXd &Nk);
+	void IntegrateEdge (const Uloc &Lre, const Transf &Xma);
 
 private:
 	Transf  x_;
@@ -67,7 +67,7 @@ private:
 	MatrixXd  c_;
 };
 
-inline ostream& operator << (ostream& ostrm, Uloc& u)
+inline ostream& operator << (ostream& ostrm, const Uloc& u)
 {
 
 	if (u.uGEntity() == POINT) 	ostrm << "Uloc: Point" << endl;
@@ -86,15 +86,15 @@ inline ostream& operator << (ostream& ostrm, Uloc& u)
    return ostrm;
 }
 
-Uloc inverse_uloc (Uloc Lab);
-Uloc compose_uloc_transf (Uloc Lwf, Transf Xfe);
-Uloc compose_uloc (Uloc Lwf, Uloc Lfe);
-Uloc compose_transf_uloc (Transf Xwf, Uloc Lfe);
-Uloc CalculateAnalyticalEdge (Transf xp1, Transf xp2);
-void information_filter (MatrixXd Hk, MatrixXd Gk, MatrixXd hk, MatrixXd Sk, MatrixXd &Fk, MatrixXd &Nk);
-Uloc integrateEndpointsInEdge(Uloc Lsp1, Uloc Lsp2);
-void estimate_relative_location (Uloc Lwe, Uloc Lwm, Transf &Xem, MatrixXd &Cem);
-double mahalanobis_distance (Uloc Lwa, Uloc Lwb, MatrixXd Bab);
-double mahalanobis_distance_edge_point(Uloc Lwe, Uloc Lwp);
+Uloc inverse_uloc (const Uloc &Lab);
+Uloc compose_uloc_transf (const Uloc &Lwf, const Transf &Xfe);
+Uloc compose_uloc (const Uloc &Lwf, const Uloc &Lfe);
+Uloc compose_transf_uloc (const Transf &Xwf, const Uloc &Lfe);
+Uloc CalculateAnalyticalEdge (const Transf &xp1, const Transf &xp2);
+void information_filter (const MatrixXd &Hk, const MatrixXd &Gk, const MatrixXd &hk, const MatrixXd &Sk, MatrixXd &Fk, MatrixXd &Nk);
+Uloc integrateEndpointsInEdge(const Uloc &Lsp1, const Uloc &Lsp2);
+void estimate_relative_location (const Uloc &Lwe, const Uloc &Lwm, Transf &Xem, MatrixXd &Cem);
+double mahalanobis_distance (const Uloc &Lwa, const Uloc &Lwb, const MatrixXd &Bab);
+double mahalanobis_distance_edge_point(const Uloc &Lwe, const Uloc &Lwp);
 
 #endif /* ULOC_H_ */
@@ -65,18 +65,20 @@ namespace Geom2D {
 
 class ICP {
 public:
-	ICP();
+	ICP(NNBackend backend = NN_GRID);
 	~ICP();
-	Pose align(std::vector<Point> , std::vector<Point>,Pose , double , int , bool );
+	Pose align(const std::vector<Point> &, const std::vector<Point> &,Pose , double , int , bool );
 	const std::vector<Point> get_ref_points() { return b; }
 	const std::vector<Point> get_obs_points() { return a; }
 	bool warning_misalign;
+	NNBackend nn_backend;
 private:
-	vector<Point>   ref;
-	SweepSearch * nn;
+	NNSearch * nn;
 	vector<Point> a;
 	vector<Point> b;
 	vector<int> index;
+	vector<Point> obs_global;
+	vector<int> nn_index;
 };
 
 } // namespace Geom2D 
@@ -27,11 +27,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 
-/* Nearest-neighbours algorithm for 2D point-sets.
+/* Nearest-neighbours algorithms for 2D point-sets.
  * Compute the single nearest-neighbour of a point, or the set of k-nearest neighbours.
  *
- * This is a very simple algorithm that is reasonably efficient for planar
- * points. However much faster algorithms are possible.
+ * SweepSearch is a very simple algorithm that is reasonably efficient for planar
+ * points. GridSearch hashes the points into a uniform grid with cells as large as
+ * the search limit, so that a query only visits the 3x3 cells around the point;
+ * this is much faster for large reference sets.
  *
  * Tim Bailey 2004.
  */
@@ -44,18 +46,22 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace Geom2D {
 
-// Simple 2D k-nearest-neighbours search
+// Common interface of the k-nearest-neighbours searches. Only neighbours
+// closer than the maximum search distance given at construction are found.
 //
-class SweepSearch {
+class NNSearch {
 public:
 	enum { NOT_FOUND = -1 };
 
-	SweepSearch(const std::vector<Point> &p, double dmax);
+	virtual ~NNSearch() {}
 
-	int query(const Point &q) const;
-	std::vector<double>& query(const Point &q, std::vector<int> &idx);
+	virtual int query(const Point &q) const = 0;
+	virtual std::vector<double>& query(const Point &q, std::vector<int> &idx) = 0;
 
-private:	
+	// Nearest-neighbour of each point of a batch
+	virtual void query(const std::vector<Point> &q, std::vector<int> &idx) const;
+
+protected:
 	struct PointIdx { 
 		PointIdx() {}
 		PointIdx(const Point &p_, const int& i_) : p(p_), i(i_) {}
@@ -63,20 +69,60 @@ private:
 		int i; 
 	};
 
+	static bool is_nearer(double &d2min, int &idxmin, const Point &q, const PointIdx &pi);
+
+	static bool insert_neighbour(const Point &q, const PointIdx &pi, 
+		std::vector<double> &nndists, std::vector<int> &idx);
+};
+
+// Available nearest-neighbours searches
+enum NNBackend { NN_SWEEP, NN_GRID };
+
+// Create a search of the given type over the points p
+NNSearch* create_nn_search(NNBackend type, const std::vector<Point> &p, double dmax);
+
+// Simple 2D k-nearest-neighbours search
+//
+class SweepSearch : public NNSearch {
+public:
+	SweepSearch(const std::vector<Point> &p, double dmax);
+
+	int query(const Point &q) const;
+	std::vector<double>& query(const Point &q, std::vector<int> &idx);
+	using NNSearch::query;
+
+private:	
 	const double limit;
 	std::vector<PointIdx> dataset;
 	std::vector<double> nndists;
 
-	bool is_nearer(double &d2min, int &idxmin, const Point &q, const PointIdx &pi) const;
-
-	bool insert_neighbour(const Point &q, const PointIdx &pi, 
-		std::vector<double> &nndists, std::vector<int> &idx);
-
 	static bool yorder (const PointIdx& p, const PointIdx& q) {
 		return p.p.y < q.p.y;
 	}
 };
 
+// Uniform grid hash k-nearest-neighbours search
+//
+class GridSearch : public NNSearch {
+public:
+	GridSearch(const std::vector<Point> &p, double dmax);
+
+	int query(const Point &q) const;
+	std::vector<double>& query(const Point &q, std::vector<int> &idx);
+	using NNSearch::query;
+
+private:
+	const double limit;
+	double scale;				// inverse of the cell size
+	unsigned int mask;			// number of buckets - 1
+	std::vector<int> start;			// first point of each bucket in dataset
+	std::vector<PointIdx> dataset;		// points, ordered by bucket
+	std::vector<double> nndists;
+
+	unsigned int bucket(const Point &p) const;
+	int neighbour_buckets(const Point &q, unsigned int *b) const;
+};
+
 }
 
 #endif
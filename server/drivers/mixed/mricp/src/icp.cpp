@@ -36,8 +36,8 @@ using namespace std;
 
 namespace Geom2D
 {
-	ICP::ICP()
-		: warning_misalign(true)
+	ICP::ICP(NNBackend backend)
+		: warning_misalign(true), nn_backend(backend)
 		{
 			index.push_back(0);
 			index.push_back(0);
@@ -47,13 +47,11 @@ namespace Geom2D
 			a.clear();
 			b.clear();
 			index.clear();
-			ref.clear();
 		}
 
-Pose ICP::align(vector<Point> reference, vector<Point> obs,Pose init, double gate, int nits, bool interp)
+Pose ICP::align(const vector<Point> &ref, const vector<Point> &obs,Pose init, double gate, int nits, bool interp)
 {
-	ref = reference;
-	nn = new SweepSearch(reference, gate);
+	nn = create_nn_search(nn_backend, ref, gate);
 	Pose pse = init;
 	double gate_sqr = sqr(gate);
 	int size_obs = obs.size();
@@ -64,18 +62,27 @@ Pose ICP::align(vector<Point> reference, vector<Point> obs,Pose init, double gat
 		Transform2D tr(pse);
 		a.clear();
 		b.clear();
+		// transform obs to estimated ref coord-frame
+		obs_global.resize(size_obs);
+		for (int i = 0; i < size_obs; ++i)
+		{
+			obs_global[i] = obs[i];
+			tr.transform_to_global(obs_global[i]);
+		}
+		// simple ICP: find the NN of all the points in one batch
+		if (interp == false)
+			nn->query(obs_global, nn_index);
 		// For each point in obs, find its NN in ref
 		for (int i = 0; i < size_obs; ++i)
 		{
-			Point p = obs[i];
-			tr.transform_to_global(p); // transform obs[i] to estimated ref coord-frame
+			const Point &p = obs_global[i];
 
 			Point q;
 			// simple ICP
 			if (interp == false)
 			{
-				int idx = nn->query(p);
-				if (idx == SweepSearch::NOT_FOUND)
+				int idx = nn_index[i];
+				if (idx == NNSearch::NOT_FOUND)
 					continue;
 
 				q = ref[idx];
@@ -85,7 +92,7 @@ Pose ICP::align(vector<Point> reference, vector<Point> obs,Pose init, double gat
 			{
 				(void) nn->query(p, index);
 				assert(index.size() == 2);
-				if (index[1] == SweepSearch::NOT_FOUND)
+				if (index[1] == NNSearch::NOT_FOUND)
 					continue;
 
 				Line lne;
@@ -145,6 +145,10 @@ them named:
 - gate2 (float)
   - Default "0.05"
   - 2nd data association gate for each point in scan
+- nn_search (string)
+  - Default "grid"
+  - Nearest-neighbour search used by the ICP: "grid" (uniform grid hash) or
+    "sweep" (sorted sweep, slower on large maps)
 - debug (bool)
   - Default: 0
   - Display Debug Messages
@@ -370,6 +374,17 @@ MrIcp::MrIcp(ConfigFile* cf, int section)  : ThreadedDriver(cf, section)
     this->gate1 =            cf->ReadFloat(section,"gate1",0.5);
     this->gate2 =            cf->ReadFloat(section,"gate2",0.05);
     this->interpolate =      cf->ReadInt  (section, "interpolate", 1);
+    const char *nn_search =  cf->ReadString(section,"nn_search","grid");
+    if (strcmp(nn_search, "sweep") == 0)
+        icp.nn_backend = NN_SWEEP;
+    else if (strcmp(nn_search, "grid") == 0)
+        icp.nn_backend = NN_GRID;
+    else
+    {
+        PLAYER_ERROR1("unknown nn_search type [%s]", nn_search);
+        this->SetError(-1);
+        return;
+    }
     this->map_path  =(char *)cf->ReadString(section,"map_path","maps/");
     this->debug           =  cf->ReadInt(section,"debug",0);
     this->warning_misalign = icp.warning_misalign = cf->ReadInt(section,"warning",1);
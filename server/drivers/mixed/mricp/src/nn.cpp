@@ -38,6 +38,22 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using namespace Geom2D;
 using namespace std;
+
+void NNSearch::query(const vector<Point> &q, vector<int> &idx) const
+// Input: set of query points.
+// Output: index of the nearest-neighbour of each query point.
+{
+	idx.resize(q.size());
+	for (int i=0; i < (int)q.size(); ++i)
+		idx[i] = query(q[i]);
+}
+
+NNSearch* Geom2D::create_nn_search(NNBackend type, const vector<Point> &p, double dmax)
+{
+	if (type == NN_SWEEP)
+		return new SweepSearch(p, dmax);
+	return new GridSearch(p, dmax);
+}
 	
 SweepSearch::SweepSearch(const vector<Point> &p, double lim) : limit(lim)
 // Input: set of points, p, and maximum search distance, lim.
@@ -81,7 +97,7 @@ int SweepSearch::query(const Point& q) const
 }
 
 inline 
-bool SweepSearch::is_nearer(double &d2min, int &idxmin, const Point &q, const PointIdx &pi) const
+bool NNSearch::is_nearer(double &d2min, int &idxmin, const Point &q, const PointIdx &pi)
 // Check whether new point is closer than previous points. If so, update d2min and idxmin.
 {
 	double d2 = dist_sqr(q, pi.p);
@@ -138,7 +154,7 @@ std::vector<double>& SweepSearch::query(const Point &q, std::vector<int> &idx)
 	return nndists;
 }
 
-bool SweepSearch::insert_neighbour(const Point &q, const PointIdx &pi, 
+bool NNSearch::insert_neighbour(const Point &q, const PointIdx &pi, 
 		std::vector<double> &nndists, std::vector<int> &idx)
 // Check if new point is closer than any of the existing near-neighbours. If so,
 // place the new point into near-neighbour set (in ascending order).
@@ -162,3 +178,110 @@ bool SweepSearch::insert_neighbour(const Point &q, const PointIdx &pi,
 
 	return true;
 }
+
+GridSearch::GridSearch(const vector<Point> &p, double lim) : limit(lim)
+// Input: set of points, p, and maximum search distance, lim.
+// Function: hash the points into grid cells of size lim.
+{
+	scale = 1.0 / limit;
+
+					// about two buckets per point
+	unsigned int size = 1;
+	while (size < 2*p.size())
+		size <<= 1;
+	mask = size - 1;
+
+					// count the points in each bucket
+	vector<unsigned int> keys(p.size());
+	start.assign(size + 1, 0);
+	for (int i=0; i < (int)p.size(); ++i) {
+		keys[i] = bucket(p[i]);
+		++start[keys[i] + 1];
+	}
+	for (unsigned int b=0; b < size; ++b)
+		start[b + 1] += start[b];
+
+					// store the points ordered by bucket
+	dataset.resize(p.size());
+	vector<int> next(start.begin(), start.end() - 1);
+	for (int i=0; i < (int)p.size(); ++i)
+		dataset[next[keys[i]]++] = PointIdx(p[i], i);
+}
+
+inline
+unsigned int GridSearch::bucket(const Point &p) const
+{
+	int cx = (int) floor(p.x * scale);
+	int cy = (int) floor(p.y * scale);
+	return ((unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u) & mask;
+}
+
+int GridSearch::neighbour_buckets(const Point &q, unsigned int *b) const
+// Output: the distinct buckets of the 3x3 cells around q. Every point
+// closer than limit to q is in one of them.
+{
+	int cx = (int) floor(q.x * scale);
+	int cy = (int) floor(q.y * scale);
+	int n = 0;
+	for (int dy = -1; dy <= 1; ++dy) {
+		for (int dx = -1; dx <= 1; ++dx) {
+			unsigned int h = ((unsigned int)(cx + dx) * 73856093u ^ 
+				(unsigned int)(cy + dy) * 19349663u) & mask;
+			int j;
+			for (j=0; j < n && b[j] != h; ++j)
+				;
+			if (j == n)
+				b[n++] = h;
+		}
+	}
+	return n;
+}
+
+int GridSearch::query(const Point& q) const
+// Input: query point.
+// Output: index of nearest-neighbour.
+{
+	double d2min = sqr(limit);
+	int idxmin = NOT_FOUND;
+
+	unsigned int b[9];
+	int n = neighbour_buckets(q, b);
+	for (int j=0; j < n; ++j)
+		for (int i = start[b[j]]; i < start[b[j] + 1]; ++i)
+			is_nearer(d2min, idxmin, q, dataset[i]);
+
+	return idxmin;
+}
+
+std::vector<double>& GridSearch::query(const Point &q, std::vector<int> &idx) 
+// Input: query point and vector<int> of size k (number of neighbours)
+// Output: vector<int> indices of nearest-neighbours.
+// Returns: set of distances to k nn's.
+{
+					// can't have more nn's than reference points
+	assert(idx.size() > 0);
+	int size = idx.size();
+	if ((int)dataset.size() < size) {
+		size = dataset.size();
+		idx.resize(size);
+	}
+	if ((int)nndists.size() != size)
+		nndists.resize(size);
+
+					// initialise set
+	for (int j=0; j<size; ++j) {
+		idx[j] = NOT_FOUND;
+		nndists[j] = sqr(limit);
+	}
+
+	unsigned int b[9];
+	int n = neighbour_buckets(q, b);
+	for (int j=0; j < n; ++j)
+		for (int i = start[b[j]]; i < start[b[j] + 1]; ++i)
+			insert_neighbour(q, dataset[i], nndists, idx);
+
+					// convert square distances to distances
+	for (int i=0; i<size; ++i)
+		nndists[i] = sqrt(nndists[i]);
+	return nndists;
+}
@@ -561,6 +561,7 @@ P2OS::P2OS(ConfigFile* cf, int section)
 
   // Read config file options
   this->ignore_checksum = cf->ReadBool(section, "ignore_checksum", false);
+  this->frame_rules.ignore_checksum = this->ignore_checksum;
   this->bumpstall = cf->ReadInt(section,"bumpstall",-1);
   this->pulse = cf->ReadFloat(section,"pulse",-1);
   this->rot_kp = cf->ReadInt(section, "rot_kp", -1);
@@ -687,6 +688,7 @@ P2OS::P2OS(ConfigFile* cf, int section)
   }
 
   this->psos_fd = -1;
+  this->framer = NULL;
 
   sentGripperCmd = false;
   sentArmGripperCmd = true;
@@ -1080,6 +1082,9 @@ int P2OS::MainSetup()
     return(1);
   }
 
+  // From now on, read whole packets at a time
+  this->framer = new SerialFramer(this->psos_fd, &this->frame_rules);
+
   cnt = 4;
   cnt += snprintf(name, sizeof(name), "%s", &receivedpacket.packet[cnt]);
   cnt++;
@@ -1356,6 +1361,8 @@ void P2OS::MainQuit()
 
   close(this->psos_fd);
   this->psos_fd = -1;
+  delete this->framer;
+  this->framer = NULL;
   puts("P2OS has been shutdown");
   delete this->sippacket;
   this->sippacket = NULL;
@@ -1728,7 +1735,7 @@ P2OS::SendReceive(P2OSPacket* pkt, bool publish_data)
 
     /* receive a packet */
     pthread_testcancel();
-    if(packet.Receive(this->psos_fd, this->ignore_checksum))
+    if(packet.Receive(*this->framer))
     {
       puts("RunPsosThread(): Receive errored");
       pthread_exit(NULL);
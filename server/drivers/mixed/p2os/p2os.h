@@ -342,6 +342,8 @@ class P2OS : public ThreadedDriver
     int param_idx;  // index in the RobotParams table for this robot
     int direct_wheel_vel_control; // false -> separate trans and rot vel
     int psos_fd;               // p2os device file descriptor
+    P2OSFrameRules frame_rules;
+    SerialFramer* framer;      // reads packets from psos_fd once synced
     const char* psos_serial_port; // name of serial port device
     bool psos_use_tcp;    // use TCP port instead of serial port
     const char* psos_tcp_host;  // hostname to use if using TCP
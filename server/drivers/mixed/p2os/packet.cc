@@ -70,7 +70,11 @@ bool P2OSPacket::Check( bool ignore_checksum ) {
 }
 
 int P2OSPacket::CalcChkSum() {
-  unsigned char *buffer = &packet[3];
+  return CalcChkSum(packet, size);
+}
+
+int P2OSPacket::CalcChkSum(const unsigned char* packet, int size) {
+  const unsigned char *buffer = &packet[3];
   int c = 0;
   int n;
 
@@ -138,6 +142,44 @@ int P2OSPacket::Receive( int fd, bool ignore_checksum )
   return(0);
 }
 
+int P2OSPacket::Receive( SerialFramer& framer )
+{
+  ssize_t len;
+
+  if ((len = framer.ReadFrame(packet, sizeof(packet))) <= 0)
+  {
+    puts("Error reading packet from robot connection: P2OSPacket():Receive()");
+    return(1);
+  }
+  size = len;
+  timestamp = framer.GetFrameTime();
+  return(0);
+}
+
+static const uint8_t p2os_packet_start[] = {0xFA, 0xFB};
+
+P2OSFrameRules::P2OSFrameRules()
+  : SerialFrameRules(p2os_packet_start, 2, 3), ignore_checksum(false)
+{
+}
+
+ssize_t P2OSFrameRules::FrameLength(const uint8_t* header)
+{
+  // The count includes the checksum
+  if (header[2] < 2)
+    return(-1);
+  return(header[2] + 3);
+}
+
+bool P2OSFrameRules::CheckFrame(const uint8_t* frame, size_t len)
+{
+  if (ignore_checksum)
+    return(true);
+  unsigned short recv_chksum = static_cast<unsigned short>(P2OSPacket::CalcChkSum(frame, len) & 0xffff);
+  unsigned short pkg_chksum = (static_cast<unsigned short>(frame[len-2]) << 8) | frame[len-1];
+  return recv_chksum == pkg_chksum;
+}
+
 int P2OSPacket::Build( unsigned char *data, unsigned char datasize ) {
   unsigned short chksum;
 
@@ -33,10 +33,23 @@
 #include <string.h>
 
 #include <libplayercore/globals.h>
+#include <libplayercore/serialframer.h>
 #include <libplayercore/wallclocktime.h>
 
 #define PACKET_LEN 256
 
+// Framing of P2OS packets: 0xFA 0xFB, byte count, data, 16-bit checksum
+class P2OSFrameRules : public SerialFrameRules
+{
+ public:
+  P2OSFrameRules();
+
+  virtual ssize_t FrameLength(const uint8_t* header);
+  virtual bool CheckFrame(const uint8_t* frame, size_t len);
+
+  bool ignore_checksum;
+};
+
 class P2OSPacket 
 {
  public:
@@ -45,12 +58,14 @@ class P2OSPacket
   double timestamp;
 
   int CalcChkSum();
+  static int CalcChkSum(const unsigned char* packet, int size);
 
   void Print();
   void PrintHex();
   int Build( unsigned char *data, unsigned char datasize );
   int Send( int fd );
   int Receive( int fd, bool ignore_checksum );
+  int Receive( SerialFramer& framer );
   bool Check( bool ignore_checksum = false );
 
   bool operator!= ( P2OSPacket p ) {
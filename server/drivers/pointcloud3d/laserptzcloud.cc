@@ -50,6 +50,21 @@ thread is started. Based on Brian's laserposerinterpolator.
 
 @par Configuration file options
 
+- max_distance (float)
+  - Default: 10
+  - Readings at or beyond this range [m] are discarded.
+
+- min_distance (float)
+  - Default: 0.02
+  - Readings at or below this range [m] are discarded.
+
+- voxel_size (float)
+  - Default: 0 (disabled)
+  - Edge length [m] of a voxel grid used to downsample each cloud.  The
+    points falling in the same voxel are replaced by their centroid, so
+    the size of the published clouds is bounded by the scanned volume
+    rather than by the laser resolution.
+
 @par Example
 
 @verbatim
@@ -58,6 +73,7 @@ driver
   name "laserptzcloud"
   provides ["pointcloud3d:0"]
   requires ["laser:0" "ptz:0"]
+  voxel_size 0.05
 )
 @endverbatim
 
@@ -72,7 +88,11 @@ driver
 #include <float.h>
 #include <stdlib.h>
 #include <assert.h>
+#if defined (__SSE__)
+#include <xmmintrin.h>
+#endif
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 
@@ -80,6 +100,7 @@ driver
 
 #define DEFAULT_MAXDISTANCE 10
 #define DEFAULT_MINDISTANCE 0.020
+#define DEFAULT_VOXELSIZE 0
 
 
 // PTZ defaults for tilt
@@ -119,15 +140,29 @@ class LaserPTZCloud : public Driver
                             void * data);
     private:
 
+        // Rebuild the per-beam sin/cos tables if the scan geometry changed
+        void UpdateBeamTables (const ScanHelper &scan);
+
+        // Convert one scan taken at the given tilt into points; returns the
+        // number of points written
+        uint32_t ConvertScan (const ScanHelper &scan, double angle_y,
+                              player_pointcloud3d_element_t *points);
+
+        // Replace the points of each voxel by their centroid, in place;
+        // returns the new number of points
+        uint32_t VoxelFilter (player_pointcloud3d_element_t *points,
+                              uint32_t count);
+
         // device bookkeeping
         player_devaddr_t laser_addr;
         player_devaddr_t ptz_addr;
         Device*          laser_device;
         Device*          ptz_device;
 
-        // Laser scans
-    vector<ScanHelper> scans;
-
+        // Laser scans waiting for a pose.  Entries past scans_count are
+        // kept so that their range storage is reused by the next scans.
+        vector<ScanHelper> scans;
+        size_t scans_count;
 
         // Maximum distance that we should consider from the laser
         float maxdistance;
@@ -135,8 +170,6 @@ class LaserPTZCloud : public Driver
 
         // PTZ tilt parameters
         float ptz_pan_or_tilt;
-		
-		player_laser_data_t test_data;	
 
         // Timeouts, delays
         float delay;
@@ -144,6 +177,25 @@ class LaserPTZCloud : public Driver
         // First PTZ pose
         player_ptz_data_t lastpose;
         double            lastposetime;
+
+        // Per-beam sin/cos of the horizontal angle, and the scan geometry
+        // they were computed for
+        vector<float> cos_table;
+        vector<float> sin_table;
+        float         table_min_angle;
+        float         table_resolution;
+
+        // Per-beam scratch for the conversion of one scan
+        vector<float> scratch_x;
+        vector<float> scratch_y;
+        vector<float> scratch_z;
+
+        // Voxel grid downsampling; an open addressing hash table from
+        // voxel key to centroid accumulator (sum of x, y, z and count)
+        float            voxelsize;
+        vector<uint64_t> voxel_keys;
+        vector<int>      voxel_index;
+        vector<double>   voxel_sums;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -169,6 +221,10 @@ LaserPTZCloud::LaserPTZCloud (ConfigFile* cf, int section)
     : Driver(cf, section, false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN,
              PLAYER_POINTCLOUD3D_CODE)
 {
+    this->scans_count      = 0;
+    this->table_min_angle  = 0;
+    this->table_resolution = 0;
+
     // Must have an input laser
     if (cf->ReadDeviceAddr (&this->laser_addr, section, "requires",
         PLAYER_LASER_CODE, -1, NULL) != 0)
@@ -195,7 +251,15 @@ LaserPTZCloud::LaserPTZCloud (ConfigFile* cf, int section)
 
     // Maximum allowed distance
     this->maxdistance = static_cast<float> (cf->ReadFloat (section, "max_distance", DEFAULT_MAXDISTANCE));
-    this->mindistance = static_cast<float> (cf->ReadFloat (section, "min_distance", DEFAULT_MINDISTANCE));       
+    this->mindistance = static_cast<float> (cf->ReadFloat (section, "min_distance", DEFAULT_MINDISTANCE));
+
+    // Voxel grid downsampling
+    this->voxelsize = static_cast<float> (cf->ReadFloat (section, "voxel_size", DEFAULT_VOXELSIZE));
+    if (this->voxelsize < 0)
+    {
+        PLAYER_WARN ("voxel_size must not be negative, disabling downsampling");
+        this->voxelsize = 0;
+    }
 
     return;
 }
@@ -235,6 +299,7 @@ int LaserPTZCloud::Setup()
     }
 
     this->lastposetime = -1;
+    this->scans_count  = 0;
     return (0);
 }
 
@@ -248,6 +313,155 @@ int LaserPTZCloud::Shutdown()
     return (0);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Rebuild the per-beam sin/cos tables if the scan geometry changed
+void LaserPTZCloud::UpdateBeamTables (const ScanHelper &scan)
+{
+    if (this->cos_table.size () == scan.ranges_count &&
+        this->table_min_angle == scan.min_angle &&
+        this->table_resolution == scan.resolution)
+        return;
+
+    this->cos_table.resize (scan.ranges_count);
+    this->sin_table.resize (scan.ranges_count);
+    this->scratch_x.resize (scan.ranges_count);
+    this->scratch_y.resize (scan.ranges_count);
+    this->scratch_z.resize (scan.ranges_count);
+
+    for (unsigned i = 0; i < scan.ranges_count; i++)
+    {
+        double angle_x = scan.min_angle + i * static_cast<double> (scan.resolution);
+        this->cos_table[i] = static_cast<float> (cos (angle_x));
+        this->sin_table[i] = static_cast<float> (sin (angle_x));
+    }
+    this->table_min_angle  = scan.min_angle;
+    this->table_resolution = scan.resolution;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Convert one scan into points.  The coordinates of all beams are computed
+// first (four at a time where SSE is available), then the beams within the
+// distance limits are written out.
+uint32_t LaserPTZCloud::ConvertScan (const ScanHelper &scan, double angle_y,
+                                     player_pointcloud3d_element_t *points)
+{
+    unsigned n = scan.ranges_count;
+    const float *r  = &scan.ranges[0];
+    const float *cx = &this->cos_table[0];
+    const float *sx = &this->sin_table[0];
+    float *x = &this->scratch_x[0];
+    float *y = &this->scratch_y[0];
+    float *z = &this->scratch_z[0];
+    float sy = static_cast<float> (sin (angle_y));
+    float cy = static_cast<float> (cos (angle_y));
+    unsigned i = 0;
+
+#if defined (__SSE__)
+    __m128 vsy = _mm_set1_ps (sy);
+    __m128 vcy = _mm_set1_ps (cy);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 vr  = _mm_loadu_ps (r + i);
+        __m128 vrc = _mm_mul_ps (vr, _mm_loadu_ps (cx + i));
+        _mm_storeu_ps (x + i, _mm_mul_ps (vrc, vsy));
+        _mm_storeu_ps (y + i, _mm_mul_ps (vrc, vcy));
+        _mm_storeu_ps (z + i, _mm_mul_ps (vr, _mm_loadu_ps (sx + i)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        float rc = r[i] * cx[i];
+        x[i] = rc * sy;
+        y[i] = rc * cy;
+        z[i] = r[i] * sx[i];
+    }
+
+    uint32_t count = 0;
+    for (i = 0; i < n; i++)
+    {
+        if (r[i] < this->maxdistance && r[i] > this->mindistance)
+        {
+            player_pointcloud3d_element_t *element = points + count++;
+            element->point.px    = x[i];
+            element->point.py    = y[i];
+            element->point.pz    = z[i];
+            element->color.alpha = 255;
+            element->color.red   = 255;
+            element->color.green = 255;
+            element->color.blue  = 255;
+        }
+    }
+    return (count);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Voxel grid downsampling.  Points are binned by their integer voxel
+// coordinates; each occupied voxel is numbered in the order it is first
+// hit, and element v of the output is voxel v: the centroid of its points,
+// with the color of the first of them.
+uint32_t LaserPTZCloud::VoxelFilter (player_pointcloud3d_element_t *points,
+                                     uint32_t count)
+{
+    if (count == 0)
+        return (0);
+
+    // Table size: a power of two at least twice the number of points
+    size_t size = 16;
+    while (size < 2 * static_cast<size_t> (count))
+        size <<= 1;
+    size_t mask = size - 1;
+    if (this->voxel_keys.size () < size)
+    {
+        this->voxel_keys.resize (size);
+        this->voxel_index.resize (size);
+    }
+    std::fill (this->voxel_index.begin (), this->voxel_index.begin () + size, -1);
+    this->voxel_sums.resize (4 * static_cast<size_t> (count));
+
+    double inv = 1.0 / this->voxelsize;
+    uint32_t voxels = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const player_point_3d_t &p = points[i].point;
+        // 21 bits per axis, offset so that negative coordinates pack too
+        uint64_t key =
+            (static_cast<uint64_t> (static_cast<int64_t> (floor (p.px * inv)) + (1 << 20)) & 0x1FFFFF) |
+            ((static_cast<uint64_t> (static_cast<int64_t> (floor (p.py * inv)) + (1 << 20)) & 0x1FFFFF) << 21) |
+            ((static_cast<uint64_t> (static_cast<int64_t> (floor (p.pz * inv)) + (1 << 20)) & 0x1FFFFF) << 42);
+
+        size_t slot = static_cast<size_t> ((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+        while (this->voxel_index[slot] >= 0 && this->voxel_keys[slot] != key)
+            slot = (slot + 1) & mask;
+
+        double *sum;
+        if (this->voxel_index[slot] < 0)
+        {
+            this->voxel_keys[slot]  = key;
+            this->voxel_index[slot] = voxels;
+            // Element voxels has been summed already (voxels <= i),
+            // so its color can go
+            points[voxels].color = points[i].color;
+            sum = &this->voxel_sums[4 * voxels++];
+            sum[0] = sum[1] = sum[2] = sum[3] = 0;
+        }
+        else
+            sum = &this->voxel_sums[4 * this->voxel_index[slot]];
+        sum[0] += p.px;
+        sum[1] += p.py;
+        sum[2] += p.pz;
+        sum[3] += 1;
+    }
+
+    for (uint32_t v = 0; v < voxels; v++)
+    {
+        const double *sum = &this->voxel_sums[4 * v];
+        points[v].point.px = sum[0] / sum[3];
+        points[v].point.py = sum[1] / sum[3];
+        points[v].point.pz = sum[2] / sum[3];
+    }
+    return (voxels);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // ProcessMessage
 int LaserPTZCloud::ProcessMessage (QueuePointer &resp_queue,
@@ -256,29 +470,23 @@ int LaserPTZCloud::ProcessMessage (QueuePointer &resp_queue,
 {
     // Is it a laser scan?
     if (Message::MatchMessage (hdr, PLAYER_MSGTYPE_DATA,
-	PLAYER_LASER_DATA_SCAN,
+        PLAYER_LASER_DATA_SCAN,
         this->laser_addr))
     {
+        player_laser_data_t *laser = reinterpret_cast<player_laser_data_t *> (data);
 
-	player_laser_data_t laser;
-
-	laser=*((player_laser_data_t*)data);
-
-	ScanHelper storage;
-	vector<float>::iterator iter;
-
-	storage.min_angle=laser.min_angle;
-	storage.resolution=laser.resolution;
-	storage.ranges_count=laser.ranges_count;
-	storage.timestamp=hdr->timestamp;
+        // Reuse a previously allocated scan entry where possible
+        if (this->scans_count == this->scans.size ())
+            this->scans.push_back (ScanHelper ());
+        ScanHelper &storage = this->scans[this->scans_count++];
 
-	for (unsigned  i=0;i<storage.ranges_count;i++)
-	    storage.ranges.push_back(laser.ranges[i]);
+        storage.min_angle    = laser->min_angle;
+        storage.resolution   = laser->resolution;
+        storage.ranges_count = laser->ranges_count;
+        storage.timestamp    = hdr->timestamp;
+        storage.ranges.assign (laser->ranges, laser->ranges + laser->ranges_count);
 
-	scans.push_back(storage);
-
-            return (0);
-	
+        return (0);
     }
     // Is it a ptz pose?
     else if (Message::MatchMessage (hdr, PLAYER_MSGTYPE_DATA,
@@ -286,11 +494,8 @@ int LaserPTZCloud::ProcessMessage (QueuePointer &resp_queue,
     {
         player_ptz_data_t newpose = *((player_ptz_data_t*)data);
 
-	ScanHelper laserdata;
-	player_pointcloud3d_data_t cloud_data;
-	double t1,t0;
-	double angle_x,angle_y;
-	vector <player_pointcloud3d_element_t> pointlist;
+        double t1,t0;
+        double angle_y;
 
         // Is it the first pose?
         if (this->lastposetime < 0)
@@ -305,61 +510,46 @@ int LaserPTZCloud::ProcessMessage (QueuePointer &resp_queue,
             t1 = hdr->timestamp - this->lastposetime;
 
             if (newpose.tilt != lastpose.tilt)
-        	{
-
-		while (!scans.empty()){	 
-		    //take first scan from vector
-		    laserdata=scans.front();	
-
-		    //process it
-		    t0 = laserdata.timestamp - this->lastposetime;
-		    
-		    angle_y = this->lastpose.tilt + t0 * (newpose.tilt - this->lastpose.tilt) / t1;
-
-                // Calculate the horizontal angles and the cartesian coordinates
-		    angle_x    = laserdata.min_angle;
-
-		    //process all points in a scan 
-		    for (unsigned i = 0; i < laserdata.ranges_count; i++)
-		    {
-
-			if (laserdata.ranges[i] < maxdistance && laserdata.ranges[i] > mindistance)
+            {
+                for (size_t s = 0; s < this->scans_count; s++)
                 {
-			    player_pointcloud3d_element_t element;			    
-
-			    element.point.px = laserdata.ranges[i] * cos (angle_x) * sin (angle_y);
-			    element.point.py = laserdata.ranges[i] * cos (angle_x) * cos (angle_y);
-			    element.point.pz = laserdata.ranges[i] * sin (angle_x);
-			    
-			    pointlist.push_back(element);
-                }
-
-			angle_x += laserdata.resolution;
+                    const ScanHelper &laserdata = this->scans[s];
+                    if (laserdata.ranges_count == 0)
+                        continue;
+
+                    t0 = laserdata.timestamp - this->lastposetime;
+                    angle_y = this->lastpose.tilt + t0 * (newpose.tilt - this->lastpose.tilt) / t1;
+
+                    // Points are written straight into the buffer that is
+                    // handed over to the outgoing message
+                    player_pointcloud3d_data_t *cloud_data =
+                        reinterpret_cast<player_pointcloud3d_data_t *> (malloc (sizeof (player_pointcloud3d_data_t)));
+                    if (!cloud_data)
+                    {
+                        PLAYER_ERROR ("Out of memory");
+                        break;
+                    }
+                    cloud_data->points =
+                        reinterpret_cast<player_pointcloud3d_element_t *> (malloc (laserdata.ranges_count * sizeof (player_pointcloud3d_element_t)));
+                    if (!cloud_data->points)
+                    {
+                        PLAYER_ERROR ("Out of memory");
+                        free (cloud_data);
+                        break;
+                    }
+
+                    UpdateBeamTables (laserdata);
+                    cloud_data->points_count = ConvertScan (laserdata, angle_y, cloud_data->points);
+                    if (this->voxelsize > 0)
+                        cloud_data->points_count = VoxelFilter (cloud_data->points, cloud_data->points_count);
+
+                    Publish (this->device_addr, PLAYER_MSGTYPE_DATA,
+                             PLAYER_POINTCLOUD3D_DATA_STATE, cloud_data,
+                             0, NULL, false);
+                    // copy = false, the message owns cloud_data now
                 }
-
-
-		    //publish pointcloud
-		    cloud_data.points_count = pointlist.size();
-		    cloud_data.points = new player_pointcloud3d_element_t[cloud_data.points_count];
-		    int i=0;
-		    while (!pointlist.empty())
-		    {
-			cloud_data.points[i] = pointlist.front();
-			pointlist.erase(pointlist.begin());
-			i++;			
-		    }			
-
-                Publish (this->device_addr, PLAYER_MSGTYPE_DATA,
-                     PLAYER_POINTCLOUD3D_DATA_STATE, &cloud_data,
-                     sizeof (player_pointcloud3d_data_t), NULL);
-		    delete []cloud_data.points;
-
-		    laserdata.ranges.erase(laserdata.ranges.begin(),laserdata.ranges.end());
-		    scans.erase(scans.begin());
-
-        	}
-	    }
-	    pointlist.erase(pointlist.begin(),pointlist.end());
+                this->scans_count = 0;
+            }
             this->lastpose     = newpose;
             this->lastposetime = hdr->timestamp;
         }
@@ -368,4 +558,3 @@ int LaserPTZCloud::ProcessMessage (QueuePointer &resp_queue,
     // Don't know how to handle this message.
     return (-1);
 }
-
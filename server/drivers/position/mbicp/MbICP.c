@@ -34,6 +34,7 @@
 #include "calcul.h"
 #include "sp_matrix.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include "percolate.h"
 
@@ -62,47 +63,9 @@
 // ---------------------------------------------------------------
 // ---------------------------------------------------------------
 
-float MAXLASERRANGE;
-
-
-// ************************
-// Extern variables
-
-// structure to initialize the SM parameters
-TSMparams params;
-
-// Original points to be aligned
-Tscan ptosRef;
-Tscan ptosNew;
-
-// Structure of the associations before filtering
-TAsoc cp_associations[MAXLASERPOINTS];
-int cntAssociationsT;
-
-// Filtered Associations
-TAsoc cp_associationsTemp[MAXLASERPOINTS];
-int cntAssociationsTemp;
-
-// Those points removed by the projection filter
-Tscan ptosNoView;
-
-// Current motion estimation
-Tsc motion2;
-
-
 // ************************
-// Some precomputations for each scan to speed up
-static float refdqx[MAXLASERPOINTS];
-static float refdqx2[MAXLASERPOINTS];
-static float refdqy[MAXLASERPOINTS];
-static float refdqy2[MAXLASERPOINTS];
-static float distref[MAXLASERPOINTS];
-static float refdqxdqy[MAXLASERPOINTS];
-
-
-// value of errors
-static float error_k1;
-static int numConverged;
+// Context used by the non reentrant interface
+static TMbICP defaultSM;
 
 
 // ---------------------------------------------------------------
@@ -112,17 +75,23 @@ static int numConverged;
 // ---------------------------------------------------------------
 
 // Function for compatibility with the scans
-static void preProcessingLib(Tpfp *laserK, Tpfp *laserK1,
+static void preProcessingLib(TMbICP *sm, Tpfp *laserK, Tpfp *laserK1,
 					  Tsc *initialMotion);
 
+// Function that builds the angular index of the reference scan
+static void buildAngularIndex(TMbICP *sm);
+
+// Function that finds the first reference point with angle >= t
+static int angularLowerBound(TMbICP *sm, float t);
+
 // Function that does the association step of the MbICP
-static int EStep();
+static int EStep(TMbICP *sm);
 
 // Function that does the minimization step of the MbICP
-static int MStep(Tsc *solucion);
+static int MStep(TMbICP *sm, Tsc *solucion);
 
 // Function to do the least-squares but optimized for the metric
-static int computeMatrixLMSOpt(TAsoc *cp_ass, int cnt, Tsc *estimacion);
+static int computeMatrixLMSOpt(TMbICP *sm, TAsoc *cp_ass, int cnt, Tsc *estimacion);
 
 // ---------------------------------------------------------------
 // ---------------------------------------------------------------
@@ -143,25 +112,46 @@ void Init_MbICP_ScanMatching(float max_laser_range,float Bw, float Br,
 					  int MaxIter, float error_ratio,
 					  float error_x, float error_y, float error_t, int IterSmoothConv){
 
+  Init_MbICP_ScanMatching_r(&defaultSM,max_laser_range,Bw,Br,L,laserStep,
+			MaxDistInter,filter,ProjectionFilter,AsocError,
+			MaxIter,error_ratio,error_x,error_y,error_t,IterSmoothConv);
+}
+
+
+// ************************
+// Function that initializes the SM parameters of a context
+// ************************
+
+void Init_MbICP_ScanMatching_r(TMbICP *sm, float max_laser_range,float Bw, float Br,
+					  float L, int laserStep,
+					  float MaxDistInter,
+					  float filter,
+					  int ProjectionFilter,
+					  float AsocError,
+					  int MaxIter, float error_ratio,
+					  float error_x, float error_y, float error_t, int IterSmoothConv){
+
+  TSMparams *params = &sm->params;
+
   #ifdef INTMATSM_DEB
 	printf("-- Init EM params . . ");
   #endif
 
-  MAXLASERRANGE = max_laser_range;
-  params.Bw = Bw;
-  params.Br = Br*Br;
-  params.error_th=error_ratio;
-  params.MaxIter=MaxIter;
-  params.LMET=L;
-  params.laserStep=laserStep;
-  params.MaxDistInter=MaxDistInter;
-  params.filter=filter;
-  params.ProjectionFilter=ProjectionFilter;
-  params.AsocError=AsocError;
-  params.errx_out=error_x;
-  params.erry_out=error_y;
-  params.errt_out=error_t;
-  params.IterSmoothConv=IterSmoothConv;
+  sm->maxLaserRange = max_laser_range;
+  params->Bw = Bw;
+  params->Br = Br*Br;
+  params->error_th=error_ratio;
+  params->MaxIter=MaxIter;
+  params->LMET=L;
+  params->laserStep=laserStep;
+  params->MaxDistInter=MaxDistInter;
+  params->filter=filter;
+  params->ProjectionFilter=ProjectionFilter;
+  params->AsocError=AsocError;
+  params->errx_out=error_x;
+  params->erry_out=error_y;
+  params->errt_out=error_t;
+  params->IterSmoothConv=IterSmoothConv;
 
   #ifdef INTMATSM_DEB
 	printf(". OK!\n");
@@ -171,29 +161,40 @@ void Init_MbICP_ScanMatching(float max_laser_range,float Bw, float Br,
 
 
 // ************************
-// Function that initializes the SM parameters
+// Function that does the scan matching
 // ************************
 
 int MbICPmatcher(Tpfp *laserK, Tpfp *laserK1,
 				Tsc *sensorMotion, Tsc *solution){
 
+	return MbICPmatcher_r(&defaultSM,laserK,laserK1,sensorMotion,solution);
+}
+
+
+// ************************
+// Function that does the scan matching with a context
+// ************************
+
+int MbICPmatcher_r(TMbICP *sm, Tpfp *laserK, Tpfp *laserK1,
+				Tsc *sensorMotion, Tsc *solution){
+
 	int resEStep=1;
 	int resMStep=1;
 	int numIteration=0;
 
 	// Preprocess both scans
-	preProcessingLib(laserK,laserK1,sensorMotion);
+	preProcessingLib(sm,laserK,laserK1,sensorMotion);
 
-	while (numIteration<params.MaxIter){
+	while (numIteration<sm->params.MaxIter){
 
 		// Compute the correspondences of the MbICP
-		resEStep=EStep();;
+		resEStep=EStep(sm);
 
 		if (resEStep!=1)
 			return -1;
 
 		// Minize and compute the solution
-		resMStep=MStep(solution);
+		resMStep=MStep(sm,solution);
 
 		if (resMStep==1)
 			return 1;
@@ -208,6 +209,26 @@ int MbICPmatcher(Tpfp *laserK, Tpfp *laserK1,
 }
 
 
+// ************************
+// Functions that create and destroy a context
+// ************************
+
+TMbICP *MbICP_Create(void){
+
+	return (TMbICP *) calloc(1,sizeof(TMbICP));
+}
+
+void MbICP_Destroy(TMbICP *sm){
+
+	free(sm);
+}
+
+TMbICP *MbICP_Default(void){
+
+	return &defaultSM;
+}
+
+
 
 // ---------------------------------------------------------------
 // ---------------------------------------------------------------
@@ -219,15 +240,20 @@ int MbICPmatcher(Tpfp *laserK, Tpfp *laserK1,
 // Function that does the association step of the MbICP
 // ************************
 
-static int EStep()
+static int EStep(TMbICP *sm)
 {
   int cnt;
   int i,J;
 
-  static Tscan ptosNewRef;
-  static int indexPtosNewRef[MAXLASERPOINTS];
+  TSMparams *params = &sm->params;
+  Tscan *ptosRef = &sm->ptosRef;
+  Tscan *ptosNew = &sm->ptosNew;
+  Tscan *ptosNewRef = &sm->ptosNewRef;
+  Tscan *ptosNoView = &sm->ptosNoView;
+  int *indexPtosNewRef = sm->indexPtosNewRef;
+  TAsoc *cp_associations = sm->cp_associations;
 
-  int L,R,Io;
+  int L,R;
   float dist;
   float cp_ass_ptX,cp_ass_ptY,cp_ass_ptD;
   float tmp_cp_indD;
@@ -236,18 +262,20 @@ static int EStep()
   float landaMin;
   float A,B,C,D;
   float LMET2;
+  float rp,dr;
 
-  LMET2=params.LMET*params.LMET;
+  LMET2=params->LMET*params->LMET;
 
 
 	// Transform the points according to the current pose estimation
 
-	ptosNewRef.numPuntos=0;
-	for (i=0; i<ptosNew.numPuntos; i++){
-		transfor_directa_p ( ptosNew.laserC[i].x, ptosNew.laserC[i].y,
-			&motion2, &ptosNewRef.laserC[ptosNewRef.numPuntos]);
-		car2pol(&ptosNewRef.laserC[ptosNewRef.numPuntos],&ptosNewRef.laserP[ptosNewRef.numPuntos]); 
-		ptosNewRef.numPuntos++;
+	ptosNewRef->numPuntos=0;
+	for (i=0; i<ptosNew->numPuntos; i++){
+		transfor_directa_p ( ptosNew->laserC[i].x, ptosNew->laserC[i].y,
+			&sm->motion2, &ptosNewRef->laserC[ptosNewRef->numPuntos]);
+		car2pol(&ptosNewRef->laserC[ptosNewRef->numPuntos],&ptosNewRef->laserP[ptosNewRef->numPuntos]);
+		indexPtosNewRef[ptosNewRef->numPuntos]=i;
+		ptosNewRef->numPuntos++;
 	}
 
 	// ----
@@ -256,118 +284,111 @@ static int EStep()
 	/* Furthermore it orders the points with the angle */
 
 	cnt = 1; /* Becarefull with this filter (order) when the angles are big >90 */
-	ptosNoView.numPuntos=0;
-	if (params.ProjectionFilter==1){
-		for (i=1;i<ptosNewRef.numPuntos;i++){
-			if (ptosNewRef.laserP[i].t>=ptosNewRef.laserP[cnt-1].t){ 
-				ptosNewRef.laserP[cnt]=ptosNewRef.laserP[i];
-				ptosNewRef.laserC[cnt]=ptosNewRef.laserC[i];
+	ptosNoView->numPuntos=0;
+	if (params->ProjectionFilter==1){
+		for (i=1;i<ptosNewRef->numPuntos;i++){
+			if (ptosNewRef->laserP[i].t>=ptosNewRef->laserP[cnt-1].t){
+				ptosNewRef->laserP[cnt]=ptosNewRef->laserP[i];
+				ptosNewRef->laserC[cnt]=ptosNewRef->laserC[i];
+				indexPtosNewRef[cnt]=indexPtosNewRef[i];
 				cnt++;
 			}
 			else{
-				ptosNoView.laserP[ptosNoView.numPuntos]=ptosNewRef.laserP[i];
-				ptosNoView.laserC[ptosNoView.numPuntos]=ptosNewRef.laserC[i];
-				ptosNoView.numPuntos++;
+				ptosNoView->laserP[ptosNoView->numPuntos]=ptosNewRef->laserP[i];
+				ptosNoView->laserC[ptosNoView->numPuntos]=ptosNewRef->laserC[i];
+				ptosNoView->numPuntos++;
 			}
 		}
-		ptosNewRef.numPuntos=cnt;
+		ptosNewRef->numPuntos=cnt;
 	}
 
 
 	// ----
-	/* Build the index for the windows (this is the role of the Bw parameter */
+	/* Look for potential correspondences between the scans */
 	/* The correspondences are searched between windows in both scans */
-	/* Like this you speed up the algorithm */
+	/* (this is the role of the Bw parameter). The window of each point */
+	/* is looked up in the angular index of the reference scan, so the */
+	/* new points do not need to be ordered */
 
-	L=0; R=0; /* index of the window for ptoRef */
-	Io=0; /* index of the window for ptoNewRef */
-
-	if (ptosNewRef.laserP[Io].t<ptosRef.laserP[L].t) {
-		if (ptosNewRef.laserP[Io].t + params.Bw < ptosRef.laserP[L].t){
-			while (Io<ptosNewRef.numPuntos-1 && ptosNewRef.laserP[Io].t + params.Bw < ptosRef.laserP[L].t) {
-				Io++;
-			}
-		}
-		else{
-			while (R<ptosRef.numPuntos-1 && ptosNewRef.laserP[Io].t + params.Bw > ptosRef.laserP[R+1].t)
-				R++;
-		}
-	}
-	else{
-		while (L<ptosRef.numPuntos-1 && ptosNewRef.laserP[Io].t - params.Bw > ptosRef.laserP[L].t)
-			L++;
-		R=L;
-		while (R<ptosRef.numPuntos-1 && ptosNewRef.laserP[Io].t + params.Bw > ptosRef.laserP[R+1].t)
-			R++;
-	}
+	cnt=0;
+	for (i=0;i<ptosNewRef->numPuntos;i++){
 
-	// ----
-	/* Look for potential correspondences between the scans */
-	/* Here is where we use the windows */
+		// Find the window
+		L=angularLowerBound(sm,ptosNewRef->laserP[i].t - params->Bw);
+		R=angularLowerBound(sm,ptosNewRef->laserP[i].t + params->Bw)-1;
 
-	cnt=0;
-	for (i=Io;i<ptosNewRef.numPuntos;i++){
+		// No reference point within the window
+		if (L>R)
+			continue;
 
 		// Keep the index of the original scan ordering
 		cp_associations[cnt].index=indexPtosNewRef[i];
 
-		// Move the window
-		while  (L < ptosRef.numPuntos-1 && ptosNewRef.laserP[i].t - params.Bw > ptosRef.laserP[L].t)
-			L = L + 1;
-		while (R <ptosRef.numPuntos-1 && ptosNewRef.laserP[i].t + params.Bw > ptosRef.laserP[R+1].t)
-			R = R + 1;
-
 		cp_associations[cnt].L=L;
 		cp_associations[cnt].R=R;
 
+		p2x=ptosNewRef->laserC[i].x; p2y=ptosNewRef->laserC[i].y;
+		rp=ptosNewRef->laserP[i].r;
+
 		if (L==R){
 			// Just one possible correspondence
 
 			// precompute stuff to speed up
-			qx=ptosRef.laserC[R].x; qy=ptosRef.laserC[R].y;
-			p2x=ptosNewRef.laserC[i].x;	p2y=ptosNewRef.laserC[i].y;
+			qx=ptosRef->laserC[R].x; qy=ptosRef->laserC[R].y;
 			dx=p2x-qx; dy=p2y-qy;
 			dist=dx*dx+dy*dy-(dx*qy-dy*qx)*(dx*qy-dy*qx)/(qx*qx+qy*qy+LMET2);
 
-			if (dist<params.Br){
-				cp_associations[cnt].nx=ptosNewRef.laserC[i].x;
-				cp_associations[cnt].ny=ptosNewRef.laserC[i].y;
-				cp_associations[cnt].rx=ptosRef.laserC[R].x;
-				cp_associations[cnt].ry=ptosRef.laserC[R].y;
+			if (dist<params->Br){
+				cp_associations[cnt].nx=p2x;
+				cp_associations[cnt].ny=p2y;
+				cp_associations[cnt].rx=qx;
+				cp_associations[cnt].ry=qy;
 				cp_associations[cnt].dist=dist;
 				cnt++;
 			}
 		}
-		else if (L<R)
+		else
 		{
 			// More possible correspondences
 
 			cp_ass_ptX=0;
 			cp_ass_ptY=0;
-			cp_ass_ptD=100000;
+			cp_ass_ptD=params->Br;
+
+			// Precompute the terms that only depend on the new point
+			A=1/(p2x*p2x+p2y*p2y+LMET2);
+			B=(1-A*p2y*p2y);
+			C=(1-A*p2x*p2x);
+			D=A*p2x*p2y;
 
 			/* Metric based Closest point rule */
 			for (J=L+1;J<=R;J++){
 
+				// Skip the segments that are too far in range to improve
+				// the best association (or to pass the Br test)
+				if (rp<sm->refRangeLo[J-1])
+					dr=sm->refRangeLo[J-1]-rp;
+				else if (rp>sm->refRangeHi[J-1])
+					dr=rp-sm->refRangeHi[J-1];
+				else
+					dr=0;
+				if (dr>0 && dr*dr*sm->refRangeK[J-1]>=cp_ass_ptD)
+					continue;
+
 				// Precompute stuff to speed up
-				q1x=ptosRef.laserC[J-1].x; q1y=ptosRef.laserC[J-1].y;
-				q2x=ptosRef.laserC[J].x; q2y=ptosRef.laserC[J].y;
-				p2x=ptosNewRef.laserC[i].x; p2y=ptosNewRef.laserC[i].y;
+				q1x=ptosRef->laserC[J-1].x; q1y=ptosRef->laserC[J-1].y;
+				q2x=ptosRef->laserC[J].x; q2y=ptosRef->laserC[J].y;
 
-				dqx=refdqx[J-1]; dqy=refdqy[J-1];
+				dqx=sm->refdqx[J-1]; dqy=sm->refdqy[J-1];
 				dqpx=q1x-p2x;  dqpy=q1y-p2y;
-				A=1/(p2x*p2x+p2y*p2y+LMET2);
-				B=(1-A*p2y*p2y);
-				C=(1-A*p2x*p2x);
-				D=A*p2x*p2y;
 
-				landaMin=(D*(dqx*dqpy+dqy*dqpx)+B*dqx*dqpx+C*dqy*dqpy)/(B*refdqx2[J-1]+C*refdqy2[J-1]+2*D*refdqxdqy[J-1]);
+				landaMin=(D*(dqx*dqpy+dqy*dqpx)+B*dqx*dqpx+C*dqy*dqpy)/(B*sm->refdqx2[J-1]+C*sm->refdqy2[J-1]+2*D*sm->refdqxdqy[J-1]);
 
 				if (landaMin<0){ // Out of the segment on one side
 					qx=q1x; qy=q1y;}
 				else if (landaMin>1){ // Out of the segment on the other side
 					qx=q2x; qy=q2y;}
-				else if (distref[J-1]<params.MaxDistInter) { // Within the segment and interpotation OK
+				else if (sm->distref[J-1]<params->MaxDistInter) { // Within the segment and interpotation OK
 					qx=(1-landaMin)*q1x+landaMin*q2x;
 					qy=(1-landaMin)*q1y+landaMin*q2y;
 				}
@@ -392,9 +413,9 @@ static int EStep()
 			}
 
 			// Association compatible in distance (Br parameter)
-			if (cp_ass_ptD< params.Br){
-				cp_associations[cnt].nx=ptosNewRef.laserC[i].x;
-				cp_associations[cnt].ny=ptosNewRef.laserC[i].y;
+			if (cp_ass_ptD< params->Br){
+				cp_associations[cnt].nx=p2x;
+				cp_associations[cnt].ny=p2y;
 				cp_associations[cnt].rx=cp_ass_ptX;
 				cp_associations[cnt].ry=cp_ass_ptY;
 				cp_associations[cnt].dist=cp_ass_ptD;
@@ -402,23 +423,15 @@ static int EStep()
 				cnt++;
 			}
 		}
-		else { // This cannot happen but just in case ...
-			cp_associations[cnt].nx=ptosNewRef.laserC[i].x;
-			cp_associations[cnt].ny=ptosNewRef.laserC[i].y;
-			cp_associations[cnt].rx=0;
-			cp_associations[cnt].ry=0;
-			cp_associations[cnt].dist=params.Br;
-			cnt++;
-		}
-	}  // End for (i=Io;i<ptosNewRef.numPuntos;i++){
+	}  // End for (i=0;i<ptosNewRef->numPuntos;i++){
 
-	cntAssociationsT=cnt;
+	sm->cntAssociationsT=cnt;
 
 	// Check if the number of associations is ok
-	if (cntAssociationsT<ptosNewRef.numPuntos*params.AsocError){
+	if (sm->cntAssociationsT<ptosNewRef->numPuntos*params->AsocError){
 		#ifdef INTMATSM_DEB
 			printf("Number of associations too low <%d out of %f>\n",
-				cntAssociationsT,ptosNewRef.numPuntos*params.AsocError);
+				sm->cntAssociationsT,ptosNewRef->numPuntos*params->AsocError);
 		#endif
 		return 0;
 	}
@@ -431,55 +444,55 @@ static int EStep()
 // Function that does the minimization step of the MbICP
 // ************************
 
-static int MStep(Tsc *solucion){
+static int MStep(TMbICP *sm, Tsc *solucion){
 
   Tsc estim_cp;
   int i,cnt,res;
   float error_ratio, error;
   float cosw, sinw, dtx, dty, tmp1, tmp2;
-  static TAsoc cp_tmp[MAXLASERPOINTS+1];
+  TAsoc *cp_tmp = sm->cp_tmp;
 
 	// Filtering of the spurious data
 	// Used the trimmed versions that orders the point by distance between associations
 
-     if (params.filter<1){
+     if (sm->params.filter<1){
 
 		// Add Null element in array position 0	(this is because heapsort requirement)
-		for (i=0;i<cntAssociationsT;i++){
-			cp_tmp[i+1]=cp_associations[i];
+		for (i=0;i<sm->cntAssociationsT;i++){
+			cp_tmp[i+1]=sm->cp_associations[i];
 		}
 		cp_tmp[0].dist=-1;
 		// Sort array
-		heapsort(cp_tmp, cntAssociationsT);
+		heapsort(cp_tmp, sm->cntAssociationsT);
 		// Filter out big distances
-		cnt=((int)(cntAssociationsT*100*params.filter))/100;
+		cnt=((int)(sm->cntAssociationsT*100*sm->params.filter))/100;
 		// Remove Null element
 		for (i=0;i<cnt;i++){
-			cp_associationsTemp[i]=cp_tmp[i+1];
+			sm->cp_associationsTemp[i]=cp_tmp[i+1];
 		}
 	 }
 	 else{ // Just build the Temp array to minimize
 		cnt=0;
-		for (i=0; i<cntAssociationsT;i++){
-			if (cp_associations[i].dist<params.Br){
-				cp_associationsTemp[cnt]=cp_associations[i];
+		for (i=0; i<sm->cntAssociationsT;i++){
+			if (sm->cp_associations[i].dist<sm->params.Br){
+				sm->cp_associationsTemp[cnt]=sm->cp_associations[i];
 				cnt++;
 			}
 		}
 	}
 
-	cntAssociationsTemp=cnt;
+	sm->cntAssociationsTemp=cnt;
 
 	#ifdef INTMATSM_DEB
 		printf("All assoc: %d  Filtered: %d  Percentage: %f\n",
-			cntAssociationsT, cntAssociationsTemp, cntAssociationsTemp*100.0/cntAssociationsT);
+			sm->cntAssociationsT, sm->cntAssociationsTemp, sm->cntAssociationsTemp*100.0/sm->cntAssociationsT);
 	#endif
 
 	// ---
 	/* Do de minimization Minimize Metric-based distance */
 	/* This function is optimized to speed up */
 
-	res=computeMatrixLMSOpt(cp_associationsTemp,cnt,&estim_cp);
+	res=computeMatrixLMSOpt(sm,sm->cp_associationsTemp,cnt,&estim_cp);
 	if (res==-1)
 		return -1;
 
@@ -497,37 +510,37 @@ static int MStep(Tsc *solucion){
 
 	error=0;
 	for (i = 0; i<cnt;i++){
-		tmp1=cp_associationsTemp[i].nx * cosw - cp_associationsTemp[i].ny * sinw + dtx - cp_associationsTemp[i].rx;tmp1*=tmp1;
-		tmp2=cp_associationsTemp[i].nx * sinw + cp_associationsTemp[i].ny * cosw + dty - cp_associationsTemp[i].ry;tmp2*=tmp2;
+		tmp1=sm->cp_associationsTemp[i].nx * cosw - sm->cp_associationsTemp[i].ny * sinw + dtx - sm->cp_associationsTemp[i].rx;tmp1*=tmp1;
+		tmp2=sm->cp_associationsTemp[i].nx * sinw + sm->cp_associationsTemp[i].ny * cosw + dty - sm->cp_associationsTemp[i].ry;tmp2*=tmp2;
 		error = error+ tmp1+tmp2;
 	}
 
-	error_ratio = error / error_k1;
+	error_ratio = error / sm->error_k1;
 
 	#ifdef INTMATSM_DEB
 		printf("<err,errk1,errRatio>=<%f,%f,%f>\n estim=<%f,%f,%f>\n",
-			error,error_k1,error_ratio, estim_cp.x,estim_cp.y, estim_cp.tita);
+			error,sm->error_k1,error_ratio, estim_cp.x,estim_cp.y, estim_cp.tita);
 	#endif
 
 	// ----
 	/* Check the exit criteria */
 	/* Error ratio */
-	if (fabs(1.0-error_ratio)<=params.error_th ||
-		(fabs(estim_cp.x)<params.errx_out && fabs(estim_cp.y)<params.erry_out
-		&& fabs(estim_cp.tita)<params.errt_out) ){
-		numConverged++;
+	if (fabs(1.0-error_ratio)<=sm->params.error_th ||
+		(fabs(estim_cp.x)<sm->params.errx_out && fabs(estim_cp.y)<sm->params.erry_out
+		&& fabs(estim_cp.tita)<sm->params.errt_out) ){
+		sm->numConverged++;
 	}
 	else
-		numConverged=0;
+		sm->numConverged=0;
 
 	//--
 	/* Build the solution */
-	composicion_sis(&estim_cp, &motion2, solucion);
-	motion2=*solucion;
-	error_k1=error;
+	composicion_sis(&estim_cp, &sm->motion2, solucion);
+	sm->motion2=*solucion;
+	sm->error_k1=error;
 
 	/* Number of iterations doing convergence (smooth criterion of convergence) */
-	if (numConverged>params.IterSmoothConv)
+	if (sm->numConverged>sm->params.IterSmoothConv)
 		return 1;
 	else
 		return 0;
@@ -538,7 +551,7 @@ static int MStep(Tsc *solucion){
 // Function to do the least-squares but optimized for the metric
 // ************************
 
-static int computeMatrixLMSOpt(TAsoc *cp_ass, int cnt, Tsc *estimacion) {
+static int computeMatrixLMSOpt(TMbICP *sm, TAsoc *cp_ass, int cnt, Tsc *estimacion) {
 
 	int i;
 	float LMETRICA2;
@@ -558,7 +571,7 @@ static int computeMatrixLMSOpt(TAsoc *cp_ass, int cnt, Tsc *estimacion) {
 	C1=0;C2=0;C3=0;D1=0;D2=0;D3=0;
 
 
-	LMETRICA2=params.LMET*params.LMET;
+	LMETRICA2=sm->params.LMET*sm->params.LMET;
 
 	for (i=0; i<cnt; i++){
 		X1[i]=cp_ass[i].nx*cp_ass[i].nx;
@@ -626,68 +639,149 @@ static int computeMatrixLMSOpt(TAsoc *cp_ass, int cnt, Tsc *estimacion) {
 // Function added by Javi for compatibility
 // ------------------------------------
 
-static void preProcessingLib(Tpfp *laserK, Tpfp *laserK1,
+static void preProcessingLib(TMbICP *sm, Tpfp *laserK, Tpfp *laserK1,
 					  Tsc *initialMotion)
 {
 
 	int i,j;
+	float r1,r2,rmax,rmin,LMET2;
 
-	motion2=*initialMotion;
+	sm->motion2=*initialMotion;
 
 	// ------------------------------------------------//
 	// Compute xy coordinates of the points in laserK1
-	ptosNew.numPuntos=0;
+	sm->ptosNew.numPuntos=0;
 	for (i=0; i<MAXLASERPOINTS; i++) {
-                if (laserK1[i].r <MAXLASERRANGE){
-			ptosNew.laserP[ptosNew.numPuntos].r=laserK1[i].r;
-			ptosNew.laserP[ptosNew.numPuntos].t=laserK1[i].t;
-			ptosNew.laserC[ptosNew.numPuntos].x=(float)(laserK1[i].r * cos(laserK1[i].t));
-			ptosNew.laserC[ptosNew.numPuntos].y=(float)(laserK1[i].r * sin(laserK1[i].t));
-		    ptosNew.numPuntos++;
+                if (laserK1[i].r <sm->maxLaserRange){
+			sm->ptosNew.laserP[sm->ptosNew.numPuntos].r=laserK1[i].r;
+			sm->ptosNew.laserP[sm->ptosNew.numPuntos].t=laserK1[i].t;
+			sm->ptosNew.laserC[sm->ptosNew.numPuntos].x=(float)(laserK1[i].r * cos(laserK1[i].t));
+			sm->ptosNew.laserC[sm->ptosNew.numPuntos].y=(float)(laserK1[i].r * sin(laserK1[i].t));
+		    sm->ptosNew.numPuntos++;
 		}
         }
 
 	// Choose one point out of params.laserStep points
 	j=0;
-	for (i=0; i<ptosNew.numPuntos; i+=params.laserStep) {
-		ptosNew.laserC[j]=ptosNew.laserC[i];
+	for (i=0; i<sm->ptosNew.numPuntos; i+=sm->params.laserStep) {
+		sm->ptosNew.laserC[j]=sm->ptosNew.laserC[i];
 		j++;
 	}
-	ptosNew.numPuntos=j;
+	sm->ptosNew.numPuntos=j;
 
 	// Compute xy coordinates of the points in laserK
-	ptosRef.numPuntos=0;
+	sm->ptosRef.numPuntos=0;
 	for (i=0; i<MAXLASERPOINTS; i++) {
- 		if (laserK[i].r <MAXLASERRANGE){
-			ptosRef.laserP[ptosRef.numPuntos].r=laserK[i].r;
-			ptosRef.laserP[ptosRef.numPuntos].t=laserK[i].t;
-			ptosRef.laserC[ptosRef.numPuntos].x=(float)(laserK[i].r * cos(laserK1[i].t));
-			ptosRef.laserC[ptosRef.numPuntos].y=(float)(laserK[i].r * sin(laserK1[i].t));
-		    ptosRef.numPuntos++;
+ 		if (laserK[i].r <sm->maxLaserRange){
+			sm->ptosRef.laserP[sm->ptosRef.numPuntos].r=laserK[i].r;
+			sm->ptosRef.laserP[sm->ptosRef.numPuntos].t=laserK[i].t;
+			sm->ptosRef.laserC[sm->ptosRef.numPuntos].x=(float)(laserK[i].r * cos(laserK1[i].t));
+			sm->ptosRef.laserC[sm->ptosRef.numPuntos].y=(float)(laserK[i].r * sin(laserK1[i].t));
+		    sm->ptosRef.numPuntos++;
 		}
 	}
 
 	// Choose one point out of params.laserStep points
 	j=0;
-	for (i=0; i<ptosRef.numPuntos; i+=params.laserStep) {
-		ptosRef.laserC[j]=ptosRef.laserC[i];
+	for (i=0; i<sm->ptosRef.numPuntos; i+=sm->params.laserStep) {
+		sm->ptosRef.laserC[j]=sm->ptosRef.laserC[i];
 		j++;
 	}
-	ptosRef.numPuntos=j;
+	sm->ptosRef.numPuntos=j;
 	// ------------------------------------------------//
 
 	// Preprocess reference points
-	for (i=0;i<ptosRef.numPuntos-1;i++) {
-		car2pol(&ptosRef.laserC[i],&ptosRef.laserP[i]);
-		refdqx[i]=ptosRef.laserC[i].x - ptosRef.laserC[i+1].x;
-		refdqy[i]=ptosRef.laserC[i].y - ptosRef.laserC[i+1].y;
-		refdqx2[i]=refdqx[i]*refdqx[i];
-		refdqy2[i]=refdqy[i]*refdqy[i];
-		distref[i]=refdqx2[i] + refdqy2[i];
-		refdqxdqy[i]=refdqx[i]*refdqy[i];
+	for (i=0;i<sm->ptosRef.numPuntos-1;i++) {
+		car2pol(&sm->ptosRef.laserC[i],&sm->ptosRef.laserP[i]);
+		sm->refdqx[i]=sm->ptosRef.laserC[i].x - sm->ptosRef.laserC[i+1].x;
+		sm->refdqy[i]=sm->ptosRef.laserC[i].y - sm->ptosRef.laserC[i+1].y;
+		sm->refdqx2[i]=sm->refdqx[i]*sm->refdqx[i];
+		sm->refdqy2[i]=sm->refdqy[i]*sm->refdqy[i];
+		sm->distref[i]=sm->refdqx2[i] + sm->refdqy2[i];
+		sm->refdqxdqy[i]=sm->refdqx[i]*sm->refdqy[i];
+	}
+	car2pol(&sm->ptosRef.laserC[sm->ptosRef.numPuntos-1],&sm->ptosRef.laserP[sm->ptosRef.numPuntos-1]);
+
+	// Range bounds of the reference segments. The metric distance from
+	// p to q is at least |p-q|^2*L^2/(|q|^2+L^2), and |p-q| is at least
+	// the distance from |p| to the ranges spanned by the segment (with
+	// a small margin for the rounding)
+	LMET2=sm->params.LMET*sm->params.LMET;
+	for (i=0;i<sm->ptosRef.numPuntos-1;i++) {
+		r1=sm->ptosRef.laserP[i].r;
+		r2=sm->ptosRef.laserP[i+1].r;
+		rmax=(r1>r2) ? r1 : r2;
+		rmin=((r1<r2) ? r1 : r2) - 0.5F*(float)sqrt(sm->distref[i]);
+		sm->refRangeLo[i]=rmin-0.001F;
+		sm->refRangeHi[i]=rmax+0.001F;
+		sm->refRangeK[i]=LMET2/(rmax*rmax+LMET2);
 	}
-	car2pol(&ptosRef.laserC[ptosRef.numPuntos-1],&ptosRef.laserP[ptosRef.numPuntos-1]);
 
-	error_k1=BIG_INITIAL_ERROR;
-	numConverged=0;
+	buildAngularIndex(sm);
+
+	sm->error_k1=BIG_INITIAL_ERROR;
+	sm->numConverged=0;
+}
+
+
+// ------------------------------------
+// Angular index of the reference scan
+// ------------------------------------
+
+// The reference points are ordered by angle, and are split in as many
+// buckets of equal angular width as there are points. The association
+// window of a point is then found with a bucket lookup plus a short
+// scan, instead of sliding the window over the whole scan.
+
+static void buildAngularIndex(TMbICP *sm)
+{
+	int b,j,n;
+	float tmin,tmax;
+
+	n=sm->ptosRef.numPuntos;
+	if (n<=0){
+		sm->numBuckets=0;
+		return;
+	}
+
+	tmin=sm->ptosRef.laserP[0].t;
+	tmax=sm->ptosRef.laserP[n-1].t;
+
+	sm->numBuckets=n;
+	sm->bucketMin=tmin;
+	sm->bucketScale=(tmax>tmin) ? n/(tmax-tmin) : 0;
+
+	j=0;
+	for (b=0;b<=sm->numBuckets;b++){
+		while (j<n && (int)((sm->ptosRef.laserP[j].t-tmin)*sm->bucketScale)<b)
+			j++;
+		sm->bucketFirst[b]=j;
+	}
+}
+
+static int angularLowerBound(TMbICP *sm, float t)
+{
+	int b,j,n;
+	float f;
+
+	n=sm->ptosRef.numPuntos;
+	if (sm->numBuckets==0)
+		return n;
+
+	f=(t-sm->bucketMin)*sm->bucketScale;
+	if (f<=0)
+		b=0;
+	else if (f>=sm->numBuckets)
+		b=sm->numBuckets;
+	else
+		b=(int)f;
+
+	// Correct the bucket guess (rounding, points out of order)
+	j=sm->bucketFirst[b];
+	while (j>0 && sm->ptosRef.laserP[j-1].t>=t)
+		j--;
+	while (j<n && sm->ptosRef.laserP[j].t<t)
+		j++;
+
+	return j;
 }
@@ -81,6 +81,8 @@ typedef struct {
 // SPECIFIC TYPES
 // ----------------------------------------------------------------------------
 
+// Scan matcher context (see MbICP2.h)
+typedef struct _TMbICP TMbICP;
 
 
 // ----------------------------------------------------------------------------
@@ -210,6 +212,46 @@ void Init_MbICP_ScanMatching(
 int MbICPmatcher(Tpfp *laserK, Tpfp *laserK1,
 				 Tsc *sensorMotion, Tsc *solution);
 
+// -------------------------------------------------------------
+
+// ************************
+// Reentrant interface
+// ************************
+
+// The functions above share a single matcher inside the library, so
+// only one scan matching can run at a time. Every function below works
+// on its own context instead; a context must not be used by more than
+// one thread at the same time, but different contexts are independent.
+
+// Allocate a matcher context (NULL if out of memory)
+TMbICP *MbICP_Create(void);
+
+// Free a matcher context
+void MbICP_Destroy(TMbICP *sm);
+
+// Same as Init_MbICP_ScanMatching, for the given context
+void Init_MbICP_ScanMatching_r(
+			     TMbICP *sm,
+			     float max_laser_range,
+			     float Bw,
+			     float Br,
+			     float L,
+			     int   laserStep,
+			     float MaxDistInter,
+			     float filter,
+			     int   ProjectionFilter,
+			     float AsocError,
+			     int   MaxIter,
+			     float errorRatio,
+			     float errx_out,
+			     float erry_out,
+			     float errt_out,
+			     int IterSmoothConv);
+
+// Same as MbICPmatcher, for the given context
+int MbICPmatcher_r(TMbICP *sm, Tpfp *laserK, Tpfp *laserK1,
+				 Tsc *sensorMotion, Tsc *solution);
+
 #ifdef __cplusplus
 }
 #endif
@@ -147,34 +147,75 @@ typedef struct {
 
 // ---------------------------------------------------------------
 // ---------------------------------------------------------------
-// Variables definition
+// Matcher context
 // ---------------------------------------------------------------
 // ---------------------------------------------------------------
 
 
 // ************************
-// Static structure to initialize the SM parameters
-extern TSMparams params;
+// All the state of one scan matcher. Each context can be used from
+// its own thread, so several matchers can run concurrently.
 
-// Original points to be aligned
-extern Tscan ptosRef;
-extern Tscan ptosNew;
+struct _TMbICP {
 
-// At each step::
+	// Structure to initialize the SM parameters
+	TSMparams params;
+	float maxLaserRange;
 
-// Those points removed by the projection filter (see Lu&Millios -- IDC)
-extern Tscan ptosNoView; // Only with ProjectionFilter=1;
+	// Original points to be aligned
+	Tscan ptosRef;
+	Tscan ptosNew;
 
-// Structure of the associations before filtering
-extern TAsoc cp_associations[MAXLASERPOINTS];
-extern int cntAssociationsT;
+	// At each step::
 
-// Filtered Associations
-extern TAsoc cp_associationsTemp[MAXLASERPOINTS];
-extern int cntAssociationsTemp;
+	// Those points removed by the projection filter (see Lu&Millios -- IDC)
+	Tscan ptosNoView; // Only with ProjectionFilter=1;
 
-// Current motion estimation
-extern Tsc motion2;
+	// Structure of the associations before filtering
+	TAsoc cp_associations[MAXLASERPOINTS];
+	int cntAssociationsT;
+
+	// Filtered Associations
+	TAsoc cp_associationsTemp[MAXLASERPOINTS];
+	int cntAssociationsTemp;
+
+	// Current motion estimation
+	Tsc motion2;
+
+	// Some precomputations for each reference scan to speed up
+	float refdqx[MAXLASERPOINTS];
+	float refdqx2[MAXLASERPOINTS];
+	float refdqy[MAXLASERPOINTS];
+	float refdqy2[MAXLASERPOINTS];
+	float distref[MAXLASERPOINTS];
+	float refdqxdqy[MAXLASERPOINTS];
+
+	// Range interval spanned by each reference segment, and the factor
+	// that turns a range difference into a lower bound of the metric
+	float refRangeLo[MAXLASERPOINTS];
+	float refRangeHi[MAXLASERPOINTS];
+	float refRangeK[MAXLASERPOINTS];
+
+	// Angular bucket index of the reference scan (ordered by angle)
+	// bucketFirst[b] is the first reference point in bucket b or later
+	float bucketMin, bucketScale;
+	int numBuckets;
+	int bucketFirst[MAXLASERPOINTS+1];
+
+	// Working memory of the association and minimization steps
+	Tscan ptosNewRef;
+	int indexPtosNewRef[MAXLASERPOINTS];
+	TAsoc cp_tmp[MAXLASERPOINTS+1];
+
+	// value of errors
+	float error_k1;
+	int numConverged;
+};
+
+
+// ************************
+// Context used by Init_MbICP_ScanMatching and MbICPmatcher
+struct _TMbICP *MbICP_Default(void);
 
 #ifdef __cplusplus
 }
@@ -24,11 +24,12 @@ int C_Fixed_Num_Readings (void)
 
 int C_Num_Associations (float max_dist)
 {
+  TMbICP *sm = MbICP_Default ();
   int result = 0;
   int i;
 
-  for (i = 0; i < cntAssociationsTemp; i++) {
-    if (cp_associationsTemp [i].dist <= max_dist)
+  for (i = 0; i < sm->cntAssociationsTemp; i++) {
+    if (sm->cp_associationsTemp [i].dist <= max_dist)
       result++;
   }
 
@@ -37,16 +38,17 @@ int C_Num_Associations (float max_dist)
 
 float C_Mean_Error (void)
 {
+  TMbICP *sm = MbICP_Default ();
   float error = 0.0;
   int i;
 
-  if (cntAssociationsTemp == 0)
+  if (sm->cntAssociationsTemp == 0)
     return 1000000.0f;
 
-  for (i = 0; i < cntAssociationsTemp; i++) {
-    error += cp_associationsTemp [i].dist;
+  for (i = 0; i < sm->cntAssociationsTemp; i++) {
+    error += sm->cp_associationsTemp [i].dist;
   }
 
-  return error / (float)cntAssociationsTemp;
+  return error / (float)sm->cntAssociationsTemp;
 }
 
@@ -245,6 +245,9 @@ private:
 
 	bool		havePrevious;
 
+	// Scan matcher state for this instance
+	TMbICP		*matcher;
+
 	//Compute scanMatching
 	void compute();
 
@@ -319,7 +322,8 @@ int mbicp::MainSetup(){
 ////////////////////////////////////////////////////////////////////////////////
 void mbicp::setupScanMatching(){
 
-Init_MbICP_ScanMatching(
+Init_MbICP_ScanMatching_r(
+			this->matcher,
 			this->max_laser_range,
 			this->Bw,
  			this->Br,
@@ -350,6 +354,12 @@ mbicp::mbicp( ConfigFile* cf, int section)
   : ThreadedDriver(cf, section, true, PLAYER_MSGQUEUE_DEFAULT_MAXLEN,
            PLAYER_POSITION2D_CODE){
 
+	this->matcher = MbICP_Create();
+	if (this->matcher == NULL){
+		PLAYER_ERROR("Unable to allocate the scan matcher");
+		this->SetError(-1);
+		return;
+	}
 
 	this->max_laser_range		= static_cast<float> (cf->ReadFloat(section, "max_laser_range", 7.9));
 	this->Bw			= static_cast<float> (cf->ReadFloat(section, "angular_window", 1.57/3.0));
@@ -409,6 +419,8 @@ mbicp::~mbicp(){
 		delete[] previousScan.ranges;
 	if (previousScan.intensity != NULL)
 		delete[] previousScan.intensity;
+	if (this->matcher != NULL)
+		MbICP_Destroy(this->matcher);
 }
 
 
@@ -647,7 +659,7 @@ void mbicp::compute()
 	playerLaser2Tpfp(previousScan,previousScanTpfp);
 	playerLaser2Tpfp(currentScan,currentScanTpfp);
 
-	salidaMbicp = MbICPmatcher(previousScanTpfp,currentScanTpfp,&outComposicion3, &solutionTsc);
+	salidaMbicp = MbICPmatcher_r(this->matcher,previousScanTpfp,currentScanTpfp,&outComposicion3, &solutionTsc);
 
 	if (salidaMbicp == 1){
 
@@ -279,7 +279,9 @@ int CmdSplitter::ProcessMessage(QueuePointer & resp_queue, player_msghdr * hdr,
         PLAYER_ERROR("ACK/NACK subtype does not match");
         return -1;
       }
-      this->Publish(this->provided_addr, this->rq_ptrs[this->last_rq], hdr->type, hdr->subtype, data, 0, &(hdr->timestamp), true); // copy = true
+      newhdr = *hdr;
+      newhdr.addr = this->provided_addr;
+      this->ForwardMessage(this->rq_ptrs[this->last_rq], &newhdr, data);
       this->rq_ptrs[this->last_rq] = null;
       assert(this->rq[this->last_rq]);
       if (this->payloads[this->last_rq])
@@ -313,9 +315,9 @@ int CmdSplitter::ProcessMessage(QueuePointer & resp_queue, player_msghdr * hdr,
       assert(data);
       if (!i)
       {
-        this->Publish(this->provided_addr,
-                      PLAYER_MSGTYPE_DATA, hdr->subtype,
-                      data, 0, &(hdr->timestamp), true); // copy = true
+        newhdr = *hdr;
+        newhdr.addr = this->provided_addr;
+        this->ForwardMessage(&newhdr, data);
       }
       return 0;
     }
@@ -325,8 +327,7 @@ int CmdSplitter::ProcessMessage(QueuePointer & resp_queue, player_msghdr * hdr,
     for (i = 0; i < (this->devices); i++)
     {
       newhdr = *hdr;
-      newhdr.addr = this->required_addrs[i];
-      this->required_devs[i]->PutMsg(this->InQueue, &newhdr, data, true); // copy = true
+      this->ForwardMessage(this->required_devs[i], &newhdr, data);
     }
     return 0;
   }
@@ -139,6 +139,7 @@ public:
 	virtual void Unsubscribe(player_devaddr_t addr);
 
 	void PutMsg(player_msghdr_t* hdr, void* src);
+	void PutMsg(player_msghdr_t* hdr, void* src, Message* payload);
 
 	typedef map<player_devaddr_t, Device*, PlayerAddressCompare> DeviceMap_t;
 	DeviceMap_t DeviceMap;
@@ -246,6 +247,22 @@ void PassthroughRemoteConnection::PutMsg(player_msghdr_t* hdr, void* src)
 	}
 }
 
+void PassthroughRemoteConnection::PutMsg(player_msghdr_t* hdr, void* src, Message* payload)
+{
+	if (payload == NULL)
+	{
+		PutMsg(hdr, src);
+	}
+	else if (DeviceMap.count(hdr->addr) && DeviceMap[hdr->addr])
+	{
+		DeviceMap[hdr->addr]->PutMsg(ConnectionQueue, hdr, *payload);
+	}
+	else
+	{
+		PLAYER_MSG4(8,"Passthrough recieved message for null device: %d %d %d %d",hdr->addr.host, hdr->addr.robot,hdr->addr.interf,hdr->addr.index);
+	}
+}
+
 PassThrough::PassThrough(ConfigFile* cf, int section) :
 	RemoteDriver(cf, section), RemoteHost("remote_host", "", false, this, cf,
 			section), RemotePort("remote_port", -1, false, this, cf, section),
@@ -386,7 +403,9 @@ void PassThrough::Update()
 		{
 			player_msghdr * hdr = msg->GetHeader();
 			void * data = msg->GetPayload();
+			CurrentMessage = msg;
 			ProcessMessage(*itr, hdr, data);
+			CurrentMessage = NULL;
 			delete msg;
 		}
 
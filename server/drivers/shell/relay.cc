@@ -105,6 +105,10 @@ relay_Register(DriverTable* table)
 
 int Relay::ProcessMessage (QueuePointer &resp_queue, player_msghdr * hdr, void * data)
 {
-  Publish(device_addr, PLAYER_MSGTYPE_DATA, hdr->subtype, data, hdr->size);
+  player_msghdr_t newhdr = *hdr;
+  newhdr.addr = device_addr;
+  newhdr.type = PLAYER_MSGTYPE_DATA;
+  GlobalTime->GetTimeDouble(&newhdr.timestamp);
+  ForwardMessage(&newhdr, data);
   return 0;
 }
@@ -51,7 +51,7 @@ The situation is essentially the same when running a simulation.
 @section Usage
 
 @code
-player [-q] [-d <level>] [-p <port>] [-h] <cfgfile>
+player [-q] [-d <level>] [-p <port>] [-w <workers>] [-m] [-t <tracefile>] [-h] <cfgfile>
 @endcode
 Arguments:
 - -h : Give help info; also lists drivers that were compiled into the server.
@@ -63,6 +63,16 @@ more output.  Default: 1.
 any devices in the configuration file without an explicit port assignment.
 Default: 6665.
 - -l \<logfile\>: File to log messages to (default stdout only)
+- -w \<workers\> : Number of worker threads shared by the drivers that are
+configured with @c scheduling "task".  Default: one per CPU.
+- -m : Lock all of the server's memory into RAM (mlockall), so that drivers
+with real-time settings don't stall on page faults.  Usually needs root
+or a raised RLIMIT_MEMLOCK.
+- -t \<tracefile\> : Trace the path of messages through the server and
+write the last events of every thread to the given file, in the Chrome
+trace event format, when the server exits.  Open it in chrome://tracing
+or https://ui.perfetto.dev.  Needs the ENABLE_TRACE CMake option (on by
+default).
 - \<cfgfile\> : The configuration file to read.
 
 @section Example
@@ -133,9 +143,12 @@ int ParseArgs(int* port, int* debuglevel,
               int argc, char** argv);
 void Quit(int signum);
 void Cleanup();
+int Multicast(void* arg, Device* device, bool join);
 
 int lockfile_id = -1;
 bool process_is_daemon = false;
+bool lock_memory = false;
+char* trace_filename = NULL;
 
 #ifdef PLAYER_UNIX
 runtime_error posix_exception(const string &prefix);
@@ -204,6 +217,9 @@ main(int argc, char** argv)
   pudp = new PlayerUDP();
   assert(pudp);
 
+  // Devices published over multicast go out through the UDP transport
+  ptcp->SetMulticast(Multicast, pudp);
+
   PrintVersion();
 
   bool should_daemonize = false;
@@ -287,6 +303,14 @@ main(int argc, char** argv)
 
   PrintCopyrightMsg();
 
+  // Locks are not inherited across fork(), so this comes after daemonizing
+  if (lock_memory)
+    player_rt_lock_memory();
+
+  if (trace_filename &&
+      (player_trace_start(PLAYER_TRACE_DEFAULT_EVENTS) == 0))
+    printf("Tracing messages to %s\n", trace_filename);
+
   cf = new ConfigFile("localhost",port);
   assert(cf);
 
@@ -391,7 +415,9 @@ main(int argc, char** argv)
   {
     snprintf(servicename,sizeof(servicename),"%s %s:%u",
              host, interf_to_str(device->addr.interf), device->addr.index);
-    if(player_sd_register(globalSD,servicename,device->addr) != 0)
+    if(player_sd_register_multicast(globalSD,servicename,device->addr,
+                                    device->multicast_group,
+                                    device->multicast_port) != 0)
     {
       PLAYER_WARN("player_sd_register returned error");
     }
@@ -401,6 +427,19 @@ main(int argc, char** argv)
   printf("registered %d devices\n", zcnt);
 #endif
 
+  for(Device* device = deviceTable->GetFirstDevice();
+      device;
+      device = deviceTable->GetNextDevice(device))
+  {
+    if(!device->multicast_port)
+      continue;
+    char group[16];
+    packedaddr_to_dottedip(group,sizeof(group),device->multicast_group);
+    printf("Multicast %s:%u on %s:%u\n",
+           interf_to_str(device->addr.interf), device->addr.index,
+           group, device->multicast_port);
+  }
+
   printf("Listening on ports: ");
   for(int i=0;i<num_ports;i++)
     printf("%d ", new_ports[i]);
@@ -462,6 +501,19 @@ main(int argc, char** argv)
   return(0);
 }
 
+int
+Multicast(void* arg, Device* device, bool join)
+{
+  PlayerUDP* udp = (PlayerUDP*)arg;
+
+  if(!join)
+  {
+    udp->LeaveGroup(device);
+    return(0);
+  }
+  return(udp->JoinGroup(device));
+}
+
 void
 Cleanup()
 {
@@ -485,6 +537,12 @@ Cleanup()
 #endif
   player_globals_fini();
   delete cf;
+
+  if(trace_filename && player_trace_on)
+  {
+    player_trace_stop();
+    player_trace_write(trace_filename);
+  }
 }
 
 void
@@ -533,6 +591,9 @@ PrintUsage()
   fprintf(stderr, "  -q             : quiet mode: minimizes the console output on startup.\n");
   fprintf(stderr, "  -l <logfile>   : log player output to the specified file\n");
   fprintf(stderr, "  -s             : fork to a daemon process as the current user.\n");
+  fprintf(stderr, "  -w <workers>   : worker threads for drivers run as tasks. Default: one per CPU\n");
+  fprintf(stderr, "  -m             : lock all memory into RAM (mlockall).\n");
+  fprintf(stderr, "  -t <tracefile> : trace messages and write them to a Chrome trace file on exit.\n");
   fprintf(stderr, "  <configfile>   : load the the indicated config file\n");
   fprintf(stderr, "\nThe following %d drivers were compiled into Player:\n\n    ",
           driverTable->Size());
@@ -557,7 +618,7 @@ ParseArgs(int* port, int* debuglevel, char** cfgfilename, int* gz_serverid,
           int argc, char** argv)
 {
   int ch;
-  const char* optflags = "d:p:l:hqs";
+  const char* optflags = "d:p:l:w:t:hmqs";
 
   // Get letter options
   while((ch = getopt(argc, argv, optflags)) != -1)
@@ -579,6 +640,15 @@ ParseArgs(int* port, int* debuglevel, char** cfgfilename, int* gz_serverid,
       case 's':
         should_daemonize = true;
         break;
+      case 'w':
+        driverScheduler->SetWorkerCount(atoi(optarg));
+        break;
+      case 'm':
+        lock_memory = true;
+        break;
+      case 't':
+        trace_filename = optarg;
+        break;
       case '?':
       case ':':
       case 'h':
@@ -0,0 +1,286 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2005
+ *     Brian Gerkey
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/** @ingroup utils */
+/** @{ */
+/** @defgroup util_playerstat playerstat
+ * @brief Live view of a server's performance counters
+
+@par Synopsis
+
+@b playerstat periodically reads the performance counters of a running
+server with the @ref PLAYER_PLAYER_REQ_STATS request and prints, in the
+manner of top, what changed since the previous reading: for every
+driver the messages it handled per second, the time ProcessMessage()
+took and the state of its incoming queue; for every device the rate at
+which it publishes; for every client connection the state of its
+outgoing queue.  No device needs to be subscribed, so playerstat can be
+pointed at a server without disturbing it.
+
+@par Usage
+
+@verbatim
+$ playerstat [options]
+@endverbatim
+
+Where [options] can be:
+- -h &lt;hostname&gt; : host that is running player (default: localhost)
+- -p &lt;port&gt; : the port number of the host (default: 6665)
+- -i &lt;seconds&gt; : refresh interval (default: 1)
+- -n &lt;count&gt; : number of refreshes before exiting (default: 0, forever)
+- -b : batch mode; append each refresh instead of redrawing the screen
+
+@par Output
+
+@verbatim
+DRIVER                msg/s  busy%  mean us   p99 us  queue   max limit   drop/s  repl/s
+camerav4l2             30.0    0.1     41.2       64      0     3  1024      0.0     0.0
+
+DEVICE             driver                pub/s  subs
+camera:0           camerav4l2             30.0     2
+
+CLIENT                  port  enc shm    msg/s  queue   max limit   drop/s  repl/s
+127.0.0.1:42158         6665  raw   1     60.0      0     2  1024      0.0     0.0
+@endverbatim
+
+busy% is the share of the interval spent in ProcessMessage(); p99 is the
+upper bound of the histogram bucket holding the 99th percentile.  max is
+the longest the queue has been since the server started.  A client's
+msg/s counts the messages taken off its queue, that is, sent to it.
+
+@author Brian Gerkey
+*/
+/** @} */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <libplayerc/playerc.h>
+
+#define USAGE "Usage: playerstat [-h <host>] [-p <port>] [-i <seconds>] [-n <count>] [-b]"
+
+// Rate of a counter between two readings, or 0 if there is no earlier
+// reading
+#define RATE(cur, prev, field, dt) \
+  ((prev) ? ((cur)->field - (prev)->field) / (dt) : 0.0)
+
+// Find the previous reading of a driver; drivers are listed in the
+// order of the device table, so the same index with the same name is
+// the same driver
+static player_stats_driver_t*
+find_driver(player_device_stats_req_t* prev, uint32_t i, const char* name)
+{
+  if(!prev || (i >= prev->drivers_count) ||
+     strcmp(prev->drivers[i].name, name) != 0)
+    return NULL;
+  return prev->drivers + i;
+}
+
+static player_stats_device_t*
+find_device(player_device_stats_req_t* prev, player_devaddr_t addr)
+{
+  uint32_t i;
+  for(i = 0; prev && (i < prev->devices_count); i++)
+  {
+    if((prev->devices[i].addr.interf == addr.interf) &&
+       (prev->devices[i].addr.index == addr.index))
+      return prev->devices + i;
+  }
+  return NULL;
+}
+
+static player_stats_client_t*
+find_client(player_device_stats_req_t* prev, player_stats_client_t* c)
+{
+  uint32_t i;
+  for(i = 0; prev && (i < prev->clients_count); i++)
+  {
+    if((prev->clients[i].host == c->host) &&
+       (prev->clients[i].port == c->port))
+      return prev->clients + i;
+  }
+  return NULL;
+}
+
+// Upper bound, in us, of the histogram bucket holding the 99th
+// percentile of the calls made between the two readings
+static double
+p99(player_stats_driver_t* cur, player_stats_driver_t* prev)
+{
+  int64_t total = 0, seen = 0, n;
+  uint32_t i;
+
+  for(i = 0; i < cur->hist_count; i++)
+    total += cur->hist[i] - (prev ? prev->hist[i] : 0);
+  if(total == 0)
+    return 0;
+  for(i = 0; i < cur->hist_count; i++)
+  {
+    n = cur->hist[i] - (prev ? prev->hist[i] : 0);
+    seen += n;
+    if(seen * 100 >= total * 99)
+      break;
+  }
+  return (double)(1u << (i < 31 ? i : 31));
+}
+
+static void
+print_queue(player_stats_queue_t* cur, player_stats_queue_t* prev, double dt)
+{
+  printf(" %6u %5u %5u %8.1f %7.1f\n",
+         cur->length, cur->max_length, cur->limit,
+         prev ? (cur->drops - prev->drops) / dt : 0.0,
+         prev ? (cur->replaced - prev->replaced) / dt : 0.0);
+}
+
+static void
+print_stats(player_device_stats_req_t* cur, player_device_stats_req_t* prev)
+{
+  double dt = prev ? cur->time - prev->time : 0;
+  uint32_t i;
+
+  if(dt <= 0)
+    prev = NULL;
+
+  printf("%-18s %8s %6s %8s %8s %6s %5s %5s %8s %7s\n", "DRIVER", "msg/s",
+         "busy%", "mean us", "p99 us", "queue", "max", "limit", "drop/s", "repl/s");
+  for(i = 0; i < cur->drivers_count; i++)
+  {
+    player_stats_driver_t* d = cur->drivers + i;
+    player_stats_driver_t* p = find_driver(prev, i, d->name);
+    int64_t msgs = d->messages - (p ? p->messages : 0);
+    int64_t ns = d->process_ns - (p ? p->process_ns : 0);
+    printf("%-18.18s %8.1f %6.1f %8.1f %8.0f", d->name,
+           RATE(d, p, messages, dt), p ? 100.0 * ns / (dt * 1e9) : 0.0,
+           msgs ? ns / 1e3 / msgs : 0.0, p99(d, p));
+    print_queue(&d->queue, p ? &p->queue : NULL, dt);
+  }
+
+  printf("\n%-18s %-18s %8s %5s\n", "DEVICE", "driver", "pub/s", "subs");
+  for(i = 0; i < cur->devices_count; i++)
+  {
+    player_stats_device_t* d = cur->devices + i;
+    player_stats_device_t* p = find_device(prev, d->addr);
+    char name[64];
+    snprintf(name, sizeof(name), "%s:%u", interf_to_str(d->addr.interf),
+             d->addr.index);
+    printf("%-18.18s %-18.18s %8.1f %5u\n", name,
+           ((d->driver >= 0) && ((uint32_t)d->driver < cur->drivers_count)) ?
+           cur->drivers[d->driver].name : "-",
+           RATE(d, p, publishes, dt), d->subscriptions);
+  }
+
+  printf("\n%-21s %6s %4s %3s %8s %6s %5s %5s %8s %7s\n", "CLIENT", "port",
+         "enc", "shm", "msg/s", "queue", "max", "limit", "drop/s", "repl/s");
+  for(i = 0; i < cur->clients_count; i++)
+  {
+    player_stats_client_t* c = cur->clients + i;
+    player_stats_client_t* p = find_client(prev, c);
+    struct in_addr in;
+    char name[64];
+    in.s_addr = c->host;
+    snprintf(name, sizeof(name), "%s:%u", inet_ntoa(in), c->port);
+    printf("%-21.21s %6u %4s %3u %8.1f", name, c->server_port,
+           (c->encoding == PLAYER_ENCODING_RAW) ? "raw" : "xdr", c->shm,
+           p ? (c->queue.pops - p->queue.pops) / dt : 0.0);
+    print_queue(&c->queue, p ? &p->queue : NULL, dt);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  playerc_client_t *client;
+  player_device_stats_req_t *cur, *prev = NULL;
+  const char* host = "localhost";
+  int port = 6665;
+  double interval = 1.0;
+  int count = 0, batch = 0, n, ch;
+
+  while((ch = getopt(argc, argv, "h:p:i:n:b")) != -1)
+  {
+    switch(ch)
+    {
+      case 'h':
+        host = optarg;
+        break;
+      case 'p':
+        port = atoi(optarg);
+        break;
+      case 'i':
+        interval = atof(optarg);
+        break;
+      case 'n':
+        count = atoi(optarg);
+        break;
+      case 'b':
+        batch = 1;
+        break;
+      default:
+        puts(USAGE);
+        exit(-1);
+    }
+  }
+  if(!isatty(STDOUT_FILENO))
+    batch = 1;
+
+  client = playerc_client_create(NULL, host, port);
+  if(playerc_client_connect(client) != 0)
+  {
+    fprintf(stderr, "failed to connect to %s:%d: %s\n", host, port,
+            playerc_error_str());
+    return -1;
+  }
+
+  // The first reading only serves as the base of the first rates
+  for(n = -1; (count <= 0) || (n < count); n++)
+  {
+    if(prev)
+      usleep((useconds_t)(interval * 1e6));
+    if(playerc_client_get_stats(client, &cur) != 0)
+    {
+      fprintf(stderr, "failed to get the counters: %s\n", playerc_error_str());
+      break;
+    }
+    if(!prev)
+    {
+      prev = cur;
+      continue;
+    }
+    if(batch)
+      printf("--- %s:%d at %.3f\n", host, port, cur->time);
+    else
+      printf("\033[H\033[2J%s:%d at %.3f\n", host, port, cur->time);
+    print_stats(cur, prev);
+    printf("\n");
+    fflush(stdout);
+    player_device_stats_req_t_free(prev);
+    prev = cur;
+  }
+  if(prev)
+    player_device_stats_req_t_free(prev);
+
+  playerc_client_disconnect(client);
+  playerc_client_destroy(client);
+  return 0;
+}
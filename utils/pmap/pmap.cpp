@@ -51,13 +51,17 @@
 #include "pmap.h"
 
 
+// Drop a sample's references to its map tiles
+static void pmap_release_tiles(pmap_t *self, pmap_sample_t *sample);
+
+
 // Create object
 pmap_t *pmap_alloc(int num_ranges, double range_max,
                    double range_start, double range_step, int samples_len,
                    double grid_width, double grid_height, double grid_scale)
 {
   pmap_t *self;
-  int i, sample_size, scans_size, total_size;
+  int i, j, sample_size, scans_size, total_size;
   pmap_sample_t *sample;
   
   self = new pmap_t;
@@ -78,10 +82,14 @@ pmap_t *pmap_alloc(int num_ranges, double range_max,
   self->grid_sy = (int) ceil(grid_height / grid_scale);
   self->grid_res = grid_scale;
 
-  self->traj_size = self->step_max_count * sizeof(pose2_t);
-  self->grid_size = self->grid_sx * self->grid_sy * sizeof(char);
+  self->tiles_sx = (self->grid_sx + PMAP_TILE_SIZE - 1) / PMAP_TILE_SIZE;
+  self->tiles_sy = (self->grid_sy + PMAP_TILE_SIZE - 1) / PMAP_TILE_SIZE;
+  self->tile_count = 0;
 
-  sample_size = self->grid_size + self->traj_size;
+  // Map tiles are allocated on demand and shared between samples, so
+  // only count the tile tables and trajectories here
+  sample_size = self->tiles_sx * self->tiles_sy * sizeof(pmap_tile_t*) +
+    self->step_max_count * sizeof(pose2_t);
   total_size += self->samples_len * 2 * sample_size;
   
   self->samples = new pmap_sample_t[2 * self->samples_len];
@@ -89,8 +97,10 @@ pmap_t *pmap_alloc(int num_ranges, double range_max,
   {
     sample = self->samples + i;
     sample->global_points = new vector2_t[self->num_ranges];
-    sample->poses = new pose2_t[self->traj_size];
-    sample->cells = new signed char[self->grid_size];
+    sample->poses = new pose2_t[self->step_max_count];
+    sample->tiles = new pmap_tile_t*[self->tiles_sx * self->tiles_sy];
+    for (j = 0; j < self->tiles_sx * self->tiles_sy; j++)
+      sample->tiles[j] = NULL;
   }
 
   // Allocate space for stored range scans
@@ -142,7 +152,8 @@ void pmap_free(pmap_t *self)
   for (i = 0; i < 2 * self->samples_len; i++)
   {
     sample = self->samples + i;
-    delete [] sample->cells;
+    pmap_release_tiles(self, sample);
+    delete [] sample->tiles;
     delete [] sample->poses;
     delete [] sample->global_points;
   }
@@ -153,6 +164,75 @@ void pmap_free(pmap_t *self)
 }
 
 
+// Drop a sample's references to its map tiles
+void pmap_release_tiles(pmap_t *self, pmap_sample_t *sample)
+{
+  int i;
+  pmap_tile_t *tile;
+
+  for (i = 0; i < self->tiles_sx * self->tiles_sy; i++)
+  {
+    tile = sample->tiles[i];
+    if (tile == NULL)
+      continue;
+    if (--tile->refs == 0)
+    {
+      delete tile;
+      self->tile_count--;
+    }
+    sample->tiles[i] = NULL;
+  }
+  return;
+}
+
+
+// Get the value of a grid cell in a sample map
+int pmap_get_cell(pmap_t *self, pmap_sample_t *sample, int x, int y)
+{
+  pmap_tile_t *tile;
+
+  tile = sample->tiles[PMAP_TILE_INDEX(self, x, y)];
+  if (tile == NULL)
+    return 0;
+  return (int) tile->cells[PMAP_TILE_CELL(x, y)];
+}
+
+
+// Get a writable pointer to a grid cell in a sample map
+signed char *pmap_get_cell_w(pmap_t *self, pmap_sample_t *sample, int x, int y)
+{
+  int index;
+  pmap_tile_t *tile, *copy;
+
+  index = PMAP_TILE_INDEX(self, x, y);
+  tile = sample->tiles[index];
+
+  // Allocate empty tiles on first write
+  if (tile == NULL)
+  {
+    tile = new pmap_tile_t;
+    tile->refs = 1;
+    memset(tile->cells, 0, sizeof(tile->cells));
+    sample->tiles[index] = tile;
+    self->tile_count++;
+  }
+
+  // Take a private copy of shared tiles
+  else if (tile->refs > 1)
+  {
+    copy = new pmap_tile_t;
+    copy->refs = 1;
+    memcpy(copy->cells, tile->cells, sizeof(tile->cells));
+    tile->refs--;
+    sample->tiles[index] = copy;
+    self->tile_count++;
+    tile = copy;
+  }
+
+  return tile->cells + PMAP_TILE_CELL(x, y);
+}
+
+
 // Sorting function for neighborhood cells
 int pmap_sort_nbors(pmap_nbor_t *a, pmap_nbor_t *b)
 {
@@ -391,7 +471,7 @@ void pmap_apply_sensor_sample(pmap_t *self, int sample_index, double *ranges)
       mx = nx + nbor->dx;
       my = ny + nbor->dy;        
       if (PMAP_GRID_VALID(self, mx, my))
-        occ = (int) sample->cells[PMAP_GRID_INDEX(self, mx, my)];
+        occ = pmap_get_cell(self, sample, mx, my);
       else
         occ = 0;
         
@@ -457,7 +537,7 @@ double pmap_entropy(pmap_t *self, int scan_count)
 // Resample
 void pmap_resample(pmap_t *self, int scan_count)
 {
-  int i, n;
+  int i, j, n;
   double e, p, norm=0.0;
   gsl_ran_discrete_t *dist=NULL;
   pmap_sample_t *oldset=NULL, *newset=NULL;
@@ -507,10 +587,23 @@ void pmap_resample(pmap_t *self, int scan_count)
     newsample->w = 0.0;
     newsample->err = old->err;
     newsample->pose = old->pose;
-    memcpy(newsample->cells, old->cells, self->grid_size);
-    memcpy(newsample->poses, old->poses, self->traj_size);
+
+    // Share the parent's map tiles; they are copied on write
+    pmap_release_tiles(self, newsample);
+    for (j = 0; j < self->tiles_sx * self->tiles_sy; j++)
+    {
+      newsample->tiles[j] = old->tiles[j];
+      if (newsample->tiles[j])
+        newsample->tiles[j]->refs++;
+    }
+    memcpy(newsample->poses, old->poses, self->step_count * sizeof(pose2_t));
   }  
 
+  // The old set is no longer used; drop its references so that tiles
+  // owned by a single new sample can be written in place
+  for (i = 0; i < self->samples_len; i++)
+    pmap_release_tiles(self, oldset + i);
+
   gsl_ran_discrete_free(dist);
   delete [] sample_probs;
 
@@ -556,7 +649,8 @@ void pmap_add_scan_sample(pmap_t *self, int sample_index, double *ranges)
   double r;
   vector2_t p;
   pmap_sample_t *sample;
-  int nx, ny, nindex, occ;
+  signed char *cell;
+  int nx, ny, occ;
 
   // Set some pointers
   sample = PMAP_GET_SAMPLE(self, sample_index);
@@ -575,11 +669,11 @@ void pmap_add_scan_sample(pmap_t *self, int sample_index, double *ranges)
               
     if (PMAP_GRID_VALID(self, nx, ny))
     {
-      nindex = PMAP_GRID_INDEX(self, nx, ny);
-      occ = (int) sample->cells[nindex] + 1;
+      cell = pmap_get_cell_w(self, sample, nx, ny);
+      occ = (int) *cell + 1;
       if (occ > 127)
         occ = 127;
-      sample->cells[nindex] = occ;
+      *cell = occ;
     }
   }
 
@@ -712,6 +806,8 @@ void pmap_draw_sample_map(pmap_t *self, double scale, int sample_index)
 #ifdef GLUT_FOUND
   int i, j;
   pmap_sample_t *sample;
+  pmap_tile_t *tile;
+  static signed char empty[PMAP_TILE_SIZE * PMAP_TILE_SIZE];
 
   sample = PMAP_GET_SAMPLE(self, sample_index);
 
@@ -726,19 +822,21 @@ void pmap_draw_sample_map(pmap_t *self, double scale, int sample_index)
   glPixelTransferf(GL_BLUE_BIAS, 0.5);
 
   // Draw the image in tiles to prevent the whole thing from being
-  // clipped
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, self->grid_sx);
+  // clipped; each 16x16 block lies inside a single map tile
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, PMAP_TILE_SIZE);
   for (j = 0; j < self->grid_sy / 16; j++)
   {
     for (i = 0; i < self->grid_sx / 16; i++)
     {
+      tile = sample->tiles[PMAP_TILE_INDEX(self, i * 16, j * 16)];
       glRasterPos2f(-self->grid_sx / 2 * self->grid_res + i * 16 * self->grid_res,
                     -self->grid_sy / 2 * self->grid_res + j * 16 * self->grid_res);
       glDrawPixels(16, 16,
                    GL_LUMINANCE, GL_BYTE,
-                   sample->cells + i * 16 + j * 16 * self->grid_sx);
+                   (tile ? tile->cells : empty) + PMAP_TILE_CELL(i * 16, j * 16));
     }
   }
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
   return;
 #endif
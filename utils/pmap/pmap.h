@@ -40,10 +40,12 @@ represents a very sparse sampling of this space.  In practice, it
 therefore necessary to pre-process raw odometry data (using the lodo
 library, for example) to minimize the odometric drift rate.
 
-- Maintaining a PF over maps is very memory intensive (the pmap
-library stores a complete map for each particle).  For example, a 2500
-sq. m map with 10cm resolution requires 0.25 Mb of storage for each
-map, or 250 Mb of storage for 1000 particles.  When using this
+- Maintaining a PF over maps is very memory intensive.  Each sample
+map is stored as a grid of reference-counted tiles that are shared
+between samples with a common ancestor, and a tile is only copied when
+a scan modifies it.  Worst case, however, every sample owns a complete
+map; a 2500 sq. m map with 10cm resolution requires 0.25 Mb of storage
+for each map, or 250 Mb of storage for 1000 particles.  When using this
 library, take care not to exceed the physical memory of the machine.
 
 - The algorithm has constant update time for each new sensor reading,
@@ -66,6 +68,11 @@ extern "C"
 
 /// Limits
 #define PMAP_MAX_RANGES 1024
+
+/// Map tile size (cells along each side; must be a power of two)
+#define PMAP_TILE_SHIFT 6
+#define PMAP_TILE_SIZE (1 << PMAP_TILE_SHIFT)
+#define PMAP_TILE_MASK (PMAP_TILE_SIZE - 1)
   
   
 /// @brief Structure for neighborhood lookup table
@@ -80,6 +87,19 @@ typedef struct
 } pmap_nbor_t;
 
 
+/// @brief Structure for a single map tile, shared (copy-on-write)
+/// between samples.
+typedef struct
+{
+  /// Number of samples referring to this tile
+  int refs;
+
+  /// Cell values
+  signed char cells[PMAP_TILE_SIZE * PMAP_TILE_SIZE];
+
+} pmap_tile_t;
+
+
 /// @brief Structure storing a single range scan
 typedef struct
 {
@@ -107,8 +127,8 @@ typedef struct
   /// Sample trajectory
   pose2_t *poses;
   
-  /// Grid map
-  signed char *cells;
+  /// Grid map, as a grid of tiles; NULL tiles are empty
+  pmap_tile_t **tiles;
 
 } pmap_sample_t;
 
@@ -133,8 +153,11 @@ typedef struct
   double grid_res;
   int grid_sx, grid_sy;
 
-  /// Grid and trajectory dimensions (for copying samples)
-  int traj_size, grid_size;
+  /// Tile grid dimensions
+  int tiles_sx, tiles_sy;
+
+  /// Number of tiles currently allocated
+  int tile_count;
 
   /// Action model (coefficients for action distribution).
   matrix44_t action_model;
@@ -272,7 +295,17 @@ void pmap_draw_sample_map(pmap_t *self, double scale, int sample_index);
 #define PMAP_GRIDX(self, x) ((int) floor((x) / self->grid_res) + self->grid_sx / 2)
 #define PMAP_GRIDY(self, y) ((int) floor((y) / self->grid_res) + self->grid_sy / 2)
 #define PMAP_GRID_VALID(self, x, y) ((x) >= 0 && (x) < self->grid_sx && (y) >= 0 && (y) < self->grid_sy)
-#define PMAP_GRID_INDEX(self, x, y) ((x) + (y) * self->grid_sx)
+
+/// @brief Tile access macros
+#define PMAP_TILE_INDEX(self, x, y) (((x) >> PMAP_TILE_SHIFT) + ((y) >> PMAP_TILE_SHIFT) * self->tiles_sx)
+#define PMAP_TILE_CELL(x, y) (((x) & PMAP_TILE_MASK) + ((y) & PMAP_TILE_MASK) * PMAP_TILE_SIZE)
+
+/// @brief Get the value of a grid cell in a sample map
+int pmap_get_cell(pmap_t *self, pmap_sample_t *sample, int x, int y);
+
+/// @brief Get a writable pointer to a grid cell in a sample map; the
+/// tile holding the cell is copied first if it is shared.
+signed char *pmap_get_cell_w(pmap_t *self, pmap_sample_t *sample, int x, int y);
 
   
 #ifdef __cplusplus